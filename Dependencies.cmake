@@ -73,6 +73,56 @@ function(SimulationPlayground_setup_dependencies)
 	  cpmaddpackage("gh:tinyobjloader/tinyobjloader@2.0.0rc10")
   endif()
 
+  if(NOT TARGET shaderc)
+    # shaderc and glslang are submodules, the SPIRV pieces shaderc expects in its third_party come from here
+    cpmaddpackage(
+	NAME SPIRV-Headers
+	GITHUB_REPOSITORY "KhronosGroup/SPIRV-Headers"
+	GIT_TAG "vulkan-sdk-1.3.268.0"
+	DOWNLOAD_ONLY YES)
+    cpmaddpackage(
+	NAME SPIRV-Tools
+	GITHUB_REPOSITORY "KhronosGroup/SPIRV-Tools"
+	GIT_TAG "vulkan-sdk-1.3.268.0"
+	DOWNLOAD_ONLY YES)
+    set(SHADERC_SPIRV_HEADERS_DIR ${SPIRV-Headers_SOURCE_DIR})
+    set(SHADERC_SPIRV_TOOLS_DIR ${SPIRV-Tools_SOURCE_DIR})
+    set(SHADERC_GLSLANG_DIR ${CMAKE_SOURCE_DIR}/external/glslang)
+    set(SHADERC_SKIP_TESTS ON)
+    set(SHADERC_SKIP_EXAMPLES ON)
+    set(SHADERC_SKIP_INSTALL ON)
+    set(SHADERC_SKIP_COPYRIGHT_CHECK ON)
+    set(SPIRV_SKIP_EXECUTABLES ON)
+    set(SPIRV_SKIP_TESTS ON)
+    set(ENABLE_GLSLANG_BINARIES OFF)
+    add_subdirectory(${CMAKE_SOURCE_DIR}/external/shaderc ${CMAKE_BINARY_DIR}/_deps/shaderc-build EXCLUDE_FROM_ALL)
+
+    # the commits the submodules are at, ShaderCompiler keys its cache on them so SPIR-V from another
+    # compiler build is never loaded. Reconfigures when either submodule moves
+    set(revisions "")
+    foreach(submodule shaderc glslang)
+      execute_process(
+        COMMAND git rev-parse HEAD --absolute-git-dir
+        WORKING_DIRECTORY ${CMAKE_SOURCE_DIR}/external/${submodule}
+        OUTPUT_VARIABLE git_output
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+        RESULT_VARIABLE git_result
+        ERROR_QUIET)
+      if(git_result EQUAL 0)
+        string(REPLACE "\n" ";" git_output "${git_output}")
+        list(GET git_output 0 submodule_sha)
+        list(GET git_output 1 submodule_git_dir)
+        set_property(DIRECTORY ${CMAKE_SOURCE_DIR} APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${submodule_git_dir}/HEAD")
+      else()
+        set(submodule_sha "unknown")
+      endif()
+      list(APPEND revisions "${submodule}-${submodule_sha}")
+    endforeach()
+    # joined with + as a ; would split the compile definition in two
+    list(JOIN revisions "+" revision)
+    set(SHADER_COMPILER_REVISION "${revision}" PARENT_SCOPE)
+  endif()
+
   #if (NOT TARGET spirv)
   #  cpmaddpackage(
   #	    NAME spirv
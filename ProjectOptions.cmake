@@ -87,6 +87,9 @@ macro(SimulationPlayground_setup_options)
 
   option(SimulationPlayground_BUILD_FUZZ_TESTS "Enable fuzz testing executable" ${DEFAULT_FUZZER})
 
+  # the CPU profiler's zones in sim-p, --trace writes them out. Off compiles PROFILE_ZONE to nothing
+  option(SimulationPlayground_ENABLE_CPU_PROFILER "Compile CPU profiler zones into sim-p" OFF)
+
 endmacro()
 
 macro(SimulationPlayground_global_options)
@@ -1,13 +1,17 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial;
 
-layout(binding = 1) uniform sampler2D texSampler;
+// the BindlessTextures table, indexed by each instance's material
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    // neighbouring instances in one draw can have different materials
+    outColor = texture(textures[nonuniformEXT(fragMaterial)], fragTexCoord);
 }
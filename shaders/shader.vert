@@ -1,20 +1,37 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(binding = 0) uniform FrameUniforms {
     mat4 view;
     mat4 proj;
-} ubo;
+    mat4 viewProj;
+} frame;
+
+layout(push_constant) uniform MeshConstants {
+    // mesh to model space, shared by every instance
+    mat4 model;
+} mesh;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
+// inPosition, inTexCoord, the instance transform and material and, when the layout has one, inColor
+#include "vertex_inputs.glsl"
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec3 local = (mesh.model * vec4(inPosition, 1.0)).xyz;
+    vec3 world = rotate(normalize(inInstanceRotation), local * inInstancePositionScale.w) + inInstancePositionScale.xyz;
+    gl_Position = frame.viewProj * vec4(world, 1.0);
+#ifdef VERTEX_HAS_COLOR
     fragColor = inColor;
+#else
+    fragColor = vec3(1.0);
+#endif
 	 fragTexCoord = inTexCoord;
+    fragMaterial = inInstanceMaterial;
 }
@@ -0,0 +1,6 @@
+// generated by vertex-inputs from ModelVertex and InstanceTransform (vertex_format.h), do not edit
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec4 inInstancePositionScale;
+layout(location = 4) in vec4 inInstanceRotation;
+layout(location = 5) in uint inInstanceMaterial;
@@ -0,0 +1,119 @@
+#include "agents.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const float SPIN_RATE = glm::radians(90.0f);
+	//golden angle, spreads the phases without visible patterns across the grid
+	const float PHASE_STEP = 2.39996323f;
+	//the circles stay inside their cell, neighbours never overlap
+	const float MIN_ORBIT = 0.1f;
+	const float MAX_ORBIT = 0.3f;
+	//agents whose rates were drawn near each other still drift apart
+	const float RATE_SPREAD = 0.5f;
+
+	// 0 to 1, fixed per agent
+	float agentFraction(uint32_t i, float step) {
+		const float x = static_cast<float>(i) * step;
+		return x - std::floor(x);
+	}
+}
+
+AgentField::AgentField() : FirstObject(0), Motions(), Levels(), ChunkLevels(), Radius(0.0f) {
+
+}
+
+void AgentField::init(uint32_t count, float spacing, Scene &scene, uint32_t mesh) {
+	const uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+	const float half = static_cast<float>(side - 1) * 0.5f;
+	FirstObject = scene.size();
+	Motions.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		const float x = static_cast<float>(i % side) - half;
+		const float y = static_cast<float>(i / side) - half;
+		Motion &motion = Motions[i];
+		motion.home = glm::vec3(x * spacing, y * spacing, 0.0f);
+		motion.radius = spacing * (MIN_ORBIT + (MAX_ORBIT - MIN_ORBIT) * agentFraction(i, PHASE_STEP * 0.5f));
+		motion.rate = SPIN_RATE * (1.0f + RATE_SPREAD * (agentFraction(i, PHASE_STEP * 0.25f) - 0.5f));
+		motion.phase = std::fmod(static_cast<float>(i) * PHASE_STEP, glm::radians(360.0f));
+		scene.addObject({motion.home + glm::vec3(motion.radius, 0.0f, 0.0f), 1.0f, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), mesh, 0});
+	}
+	Radius = std::max(spacing, half * spacing);
+}
+
+void AgentField::setMaterials(Scene &scene, const std::vector<uint32_t> &materials) const {
+	if (materials.empty()) {
+		return;
+	}
+	for (uint32_t i = 0; i < size(); ++i) {
+		scene.object(FirstObject + i).material = materials[i % materials.size()];
+	}
+}
+
+void AgentField::animate(float time, Scene &scene) const {
+	const uint32_t count = size();
+	const uint32_t chunks = (count + WRITE_CHUNK - 1) / WRITE_CHUNK;
+	scene.forEach(chunks, [this, &scene, time, count](size_t chunk) {
+		const uint32_t first = static_cast<uint32_t>(chunk) * WRITE_CHUNK;
+		const uint32_t last = std::min(count, first + WRITE_CHUNK);
+		for (uint32_t i = first; i < last; ++i) {
+			const Motion &motion = Motions[i];
+			const float angle = time * motion.rate + motion.phase;
+			SceneObject &object = scene.object(FirstObject + i);
+			object.position = motion.home + glm::vec3(std::cos(angle), std::sin(angle), 0.0f) * motion.radius;
+			//a quarter turn ahead of where it is on the circle, along its path
+			object.rotation = glm::angleAxis(angle + glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		}
+	});
+}
+
+void AgentField::writeInstances(const Scene &scene, const std::vector<uint32_t> &visible, const glm::vec3 &meshCenter
+		, const std::vector<MeshLod> &lods, const LodView &view, InstanceTransform *dst, std::vector<InstanceBatch> &batches) {
+	batches.clear();
+	if (lods.empty()) {
+		return;
+	}
+	const uint32_t count = static_cast<uint32_t>(visible.size());
+	const uint32_t chunks = (count + WRITE_CHUNK - 1) / WRITE_CHUNK;
+	Levels.resize(count);
+	ChunkLevels.assign(size_t{chunks} * MESH_MAX_LODS, 0);
+	scene.forEach(chunks, [&](size_t chunk) {
+		const uint32_t first = static_cast<uint32_t>(chunk) * WRITE_CHUNK;
+		const uint32_t last = std::min(count, first + WRITE_CHUNK);
+		uint32_t *perLevel = &ChunkLevels[chunk * MESH_MAX_LODS];
+		for (uint32_t i = first; i < last; ++i) {
+			const SceneObject &object = scene.object(visible[i]);
+			const glm::vec3 center = object.position + object.rotation * (meshCenter * object.scale);
+			//lod errors are in model units, a mesh scaled up by s looks like the unscaled one at 1/s the distance
+			const float distance = glm::length(view.eye - center) / object.scale;
+			const uint32_t level = selectLod(lods, distance, view.fovY, view.viewportHeight, view.pixelError);
+			Levels[i] = static_cast<uint8_t>(level);
+			++perLevel[level];
+		}
+	});
+	//counting sort into one contiguous run per level, each chunk's share of a run following the chunks before it,
+	//so the order is what a single thread would have written
+	uint32_t first = 0;
+	for (uint32_t level = 0; level < MESH_MAX_LODS; ++level) {
+		const uint32_t levelFirst = first;
+		for (uint32_t chunk = 0; chunk < chunks; ++chunk) {
+			uint32_t &slot = ChunkLevels[size_t{chunk} * MESH_MAX_LODS + level];
+			const uint32_t inChunk = slot;
+			slot = first;
+			first += inChunk;
+		}
+		if (first != levelFirst) {
+			batches.push_back({level, levelFirst, first - levelFirst});
+		}
+	}
+	scene.forEach(chunks, [&](size_t chunk) {
+		const uint32_t firstVisible = static_cast<uint32_t>(chunk) * WRITE_CHUNK;
+		const uint32_t last = std::min(count, firstVisible + WRITE_CHUNK);
+		uint32_t next[MESH_MAX_LODS];
+		std::copy_n(&ChunkLevels[chunk * MESH_MAX_LODS], MESH_MAX_LODS, next);
+		for (uint32_t i = firstVisible; i < last; ++i) {
+			const SceneObject &object = scene.object(visible[i]);
+			dst[next[Levels[i]]++] = InstanceTransform::make(object.position, object.scale, object.rotation, object.material);
+		}
+	});
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "mesh_simplify.h"
+#include "scene.h"
+#include "vertex_format.h"
+#include <cstdint>
+#include <vector>
+
+// One instanced draw: a run of instances that share a mesh and level of detail.
+struct InstanceBatch {
+	uint32_t lod;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+
+	bool operator==(const InstanceBatch &other) const {
+		return lod == other.lod && firstInstance == other.firstInstance && instanceCount == other.instanceCount;
+	}
+};
+
+// Where the levels of detail are picked from, see selectLod
+struct LodView {
+	glm::vec3 eye;
+	float fovY;
+	float viewportHeight;
+	float pixelError;
+};
+
+// A population of agents sharing the model, each circling its own cell of a
+// square grid around the origin at its own radius, speed and phase, facing
+// where it is heading. The agents are objects of a Scene, which culls them
+// before their instances are written. Both the moves and the writes run on
+// the scene's workers. Stands in for the simulation until it drives the
+// transforms itself.
+class AgentField {
+public:
+	//visible agents one worker writes at a time
+	static const uint32_t WRITE_CHUNK = 4096;
+public:
+	AgentField();
+	// adds count agents to scene, all showing mesh with material 0
+	void init(uint32_t count, float spacing, Scene &scene, uint32_t mesh);
+	// deals materials out to the agents in turn
+	void setMaterials(Scene &scene, const std::vector<uint32_t> &materials) const;
+	uint32_t size() const { return static_cast<uint32_t>(Motions.size()); }
+	// half the side of the square the agents cover, at least spacing
+	float radius() const { return Radius; }
+	// moves every agent's scene object to where it is at time
+	void animate(float time, Scene &scene) const;
+	// writes the transforms of the visible scene objects into dst, grouped so
+	// all instances at one level of detail are contiguous, and returns one
+	// batch per level in use. meshCenter is the mesh's center in model space,
+	// distances are measured from it. Every chunk writes its instances as a few
+	// sequential runs, which suits a dst in write combined memory.
+	void writeInstances(const Scene &scene, const std::vector<uint32_t> &visible, const glm::vec3 &meshCenter
+			, const std::vector<MeshLod> &lods, const LodView &view, InstanceTransform *dst, std::vector<InstanceBatch> &batches);
+private:
+	struct Motion {
+		glm::vec3 home;
+		float radius;
+		float rate;
+		float phase;
+	};
+	uint32_t FirstObject;
+	std::vector<Motion> Motions;
+	//scratch, kept between updates to save the allocations
+	std::vector<uint8_t> Levels;
+	//instances per level of detail, per chunk of the visible list
+	std::vector<uint32_t> ChunkLevels;
+	float Radius;
+};
@@ -1,21 +1,10 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#define TINYOBJLOADER_IMPLEMENTATION
-#define GLM_ENABLE_EXPERIMENTAL
 #include "app.h"
 
 #define OBJ_LOAD
-#ifdef OBJ_LOAD
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wuseless-cast"
-#pragma GCC diagnostic ignored "-Wdouble-promotion"
-#pragma GCC diagnostic ignored "-Wsign-conversion"
-#pragma GCC diagnostic ignored "-Wuseless-cast"
-#pragma GCC diagnostic ignored "-Wfloat-conversion"
-#include <tiny_obj_loader.h>
-#pragma GCC diagnostic pop
-#endif
 
+#include <ctime>
 #include <cstdio>
 #include <stdexcept>
 #include <iostream>
@@ -25,11 +14,16 @@
 #include <limits>
 #include <algorithm>
 #include <cstdint>
-#include "utils.h"
+#include <thread>
+#include "cpu_profiler.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "mesh_optimize.h"
+#include "obj_reader.h"
+#include "parallel.h"
+#include "texture_container.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/hash.hpp>
-#include <unordered_map>
 #define STB_IMAGE_IMPLEMENTATION
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -47,68 +41,41 @@ const uint32_t WIDTH = 1024;
 const uint32_t HEIGHT = 768;
 
 static const std::string MODEL_PATH = "models/viking_room.obj";
+static const std::string MODEL_CACHE_PATH = "models/viking_room.mesh";
 static const std::string TEXTURE_PATH = "textures/viking_room.png";
-
-
-struct Vertex {
-	glm::vec3 pos;
-	glm::vec3 color;
-	glm::vec2 texCoord;
-
-	static VkVertexInputBindingDescription getBindingDescription() {
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
-	bool operator==(const Vertex& other) const {
-		return pos == other.pos && color == other.color && texCoord == other.texCoord;
-	}
+static const std::string TEXTURE_CONTAINER_PATH = "textures/viking_room.stex";
+static const std::string SHADER_CACHE_DIR = "shader.cache";
+static const std::string PIPELINE_CACHE_PATH = "pipeline.cache";
+static const size_t PIPELINE_COMPILE_THREADS = 2;
+static const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+//headless frames advance the simulation by a fixed step, so a run renders the same frames every time
+static const float HEADLESS_FRAME_TIME = 1.0f / 60.0f;
+//persistently mapped, every streamed upload goes through it
+static const VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+//how far, in pixels, a level of detail may be off from the full mesh before a finer one is picked
+static const float LOD_PIXEL_ERROR = 1.0f;
+static const float FOV_Y = glm::radians(45.0f);
+static const glm::vec3 EYE_POSITION(2.0f, 2.0f, 2.0f);
+static const float AGENT_SPACING = 2.0f;
+
+
+//what every draw of a frame shares, one uniform buffer per frame slot
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 viewProj;
 };
 
-struct UniformBufferObject {
+//per mesh, pushed with its draws; per object data is in the instance buffers
+struct MeshConstants {
 	glm::mat4 model;
-	glm::mat4 view;
-	glm::mat4 proj;
 };
 
 
 #ifdef OBJ_LOAD
-std::vector<Vertex> Vertices;
-std::vector<uint32_t> Indices;
 VkBuffer VertexBuffer = 0;
 VkDeviceMemory VertexBufferMemory=0;
 
-namespace std {
-    template<> struct hash<Vertex> {
-        size_t operator()(Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                   (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                   (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
-
 #else
 const std::vector<Vertex> Vertices = {
     {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
@@ -128,6 +95,27 @@ const std::vector<uint16_t> Indices = {
 };
 #endif
 
+//whatever backs a streamed model or texture until its bytes are staged
+struct LoadedModel {
+	MeshCache cache;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<ModelVertex> packed;
+	std::vector<uint16_t> narrowIndices;
+};
+
+//handed back with the streamed model
+struct ModelInfo {
+	MeshBounds bounds;
+	uint32_t indexSize;
+	std::vector<MeshLod> lods;
+};
+
+struct LoadedTexture {
+	TextureContainer container;
+	std::vector<uint8_t> levelData;
+};
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback([[maybe_unused]] VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity
 		, [[maybe_unused]]VkDebugUtilsMessageTypeFlagsEXT messageType
 		, [[maybe_unused]] const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, [[maybe_unused]] void* pUserData) {
@@ -148,6 +136,13 @@ void App::framebufferResizeCallback(GLFWwindow* window, [[maybe_unused]]int widt
 	app->FramebufferResized = true;
 }
 
+void App::keyCallback(GLFWwindow* window, int key, [[maybe_unused]] int scancode, int action, [[maybe_unused]] int mods) {
+	if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+		auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+		app->writeTrace();
+	}
+}
+
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
 #else
@@ -174,23 +169,85 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 
 
 App::App(): Window(nullptr), Instance(0), DebugMessenger(0), PhysicalDevice(VK_NULL_HANDLE), SelectedDevice(0)
-	, GraphicsQueue(0), Surface(0), PresentQueue(0), SwapChain(0), SwapChainImages(), SwapChainImageFormat()
-	, SwapChainExtent(), SwapChainImageViews(), PipelineLayout(0), RenderPass(0), GraphicsPipeline(0)
-	, SwapChainFramebuffers(), CommandPool(0), CommandBuffer(), ImageAvailableSemaphore(), RenderFinishedSemaphore() 
-	, InFlightFence(), CurrentFrame(0), FramebufferResized(false), VertexBuffer(0), VertexBufferMemory(0), IndexBuffer(0)
-	, IndexBufferMemory(0), DescriptorSetLayout(0), UniformBuffers(),UniformBuffersMemory(), UniformBuffersMapped()
-	, DescriptorPool(0), DescriptorSets(), TextureImage(0), TextureImageMemory(0), TextureImageView(0), TextureSampler(0)
-	, DepthImage(0), DepthImageMemory (0), DepthImageView(0), MipLevels(0) {
+	, DrawIndirectCount(false), MultiDrawIndirect(false)
+	, GraphicsQueue(0), Surface(0), PresentQueue(0), TransferQueue(0), QueueMutex(), SwapChain(0), SwapChainImages(), SwapChainImageFormat()
+	, SwapChainExtent(), SwapChainImageViews(), Headless(false), HeadlessFrames(0), FrameOutputDir(), FrameCallback(), OffscreenMemory()
+	, Readback(), ReadbackCommandBuffer(), FrameNumber(0), PipelineLayout(0), RenderPass(0), GraphicsPipeline(0), Shaders(), Pipelines(), Compiler(), ScenePipeline(0)
+	, SwapChainFramebuffers(), CommandPool(0), CommandBuffer(), Commands(), SceneLayer(0), FramesInFlight(DEFAULT_FRAMES_IN_FLIGHT)
+	, PresentMode(VK_PRESENT_MODE_MAILBOX_KHR), PresentWait(false), Pacer(), CurrentFrame(0), Profiler(), HostQueryReset(false)
+	, PipelineStatistics(false), InheritedQueries(false), ReadbackScope(0), TracePath(), FramebufferResized(false), VertexBuffer(0), VertexBufferMemory(), IndexBuffer(0)
+	, IndexBufferMemory(), DescriptorSetLayout(0), UniformBuffers(),UniformBuffersMemory(), UniformBuffersMapped(), Culler()
+	, AgentCount(1), Agents(), World(), AgentMesh(0), Visible(), ViewScale(1.0f)
+	, DescriptorPool(0), DescriptorSets(), TextureImage(0), TextureImageMemory(), TextureImageView(0), TextureSampler(0)
+	, Textures(), TextureSlot(0)
+	, DepthImage(0), DepthImageMemory(), DepthImageView(0), MipLevels(0), IndexType(VK_INDEX_TYPE_UINT32), ModelDequantize(1.0f), ModelCenter(0.0f), ModelRadius(0.0f), ModelLods(), Allocator(), Streamer(), ModelRequest(0), TextureRequest(0)
+	, ModelResident(false), TextureResident(false), PendingBufferAcquires(), PendingImageAcquires(), PendingAcquireStages(0)
+	, PendingTimelineValue(0) {
+
+}
+
+void App::setAgents(uint32_t count) {
+	AgentCount = std::max(1u, count);
+}
+
+void App::setHeadless(uint32_t width, uint32_t height, uint32_t frames, const std::string &outputDir) {
+	Headless = true;
+	SwapChainExtent = {std::max(1u, width), std::max(1u, height)};
+	HeadlessFrames = frames;
+	FrameOutputDir = outputDir;
+}
+
+void App::setFrameCallback(ReadbackCallback callback) {
+	FrameCallback = std::move(callback);
+}
+
+void App::setFramePacing(uint32_t framesInFlight, VkPresentModeKHR presentMode) {
+	FramesInFlight = FramePacer::clampFramesInFlight(framesInFlight);
+	PresentMode = presentMode;
+}
 
+void App::setPipelineStatistics(bool enabled) {
+	PipelineStatistics = enabled;
+}
+
+void App::setTrace(const std::string &path) {
+	TracePath = path;
+	if (!CpuProfiler::compiledIn()) {
+		std::cout << "built without SimulationPlayground_ENABLE_CPU_PROFILER, the trace will be empty" << std::endl;
+	}
+	CpuProfiler::enable();
+}
+
+void App::writeTrace() {
+	if (TracePath.empty()) {
+		return;
+	}
+	const CpuProfilerStats stats = CpuProfiler::stats();
+	if (!CpuProfiler::writeTrace(TracePath)) {
+		std::cout << "unable to write trace " << TracePath << std::endl;
+		return;
+	}
+	std::cout << "trace: " << stats.zones << " zones on " << stats.threads << " threads written to " << TracePath;
+	if (stats.dropped != 0) {
+		std::cout << ", " << stats.dropped << " dropped once a thread's buffer was full";
+	}
+	std::cout << std::endl;
 }
 
 void App::initVulkan() {
 	createInstance();
 	setupDebugMessenger();
-	createSurface();
+	if (!Headless) {
+		createSurface();
+	}
 	pickPhysicalDevice();
 	createLogicalDevice();
-	createSwapChain();
+	createPipelineCompiler();
+	if (Headless) {
+		createOffscreenTargets();
+	} else {
+		createSwapChain();
+	}
 	createImageViews();
 	createRenderPass();
 	createDescriptorSetLayout();
@@ -198,56 +255,195 @@ void App::initVulkan() {
 	createCommandPool();
 	createDepthResources();
 	createFrameBuffers();
-	createTextureImage();
-	createTextureImageView();
 	createTextureSampler();
-	loadModel();
-	createVertexBuffer();
-	createIndexBuffer();
 	createUniformBuffers();
+	createInstanceBuffers();
 	createDescriptorPool();
 	createDescriptorSets();
 	createCommandBuffers();
+	createCommandCache();
 	createSyncObjects();
-}
-
-void App::loadModel() {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
-
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-		throw std::runtime_error(warn + err);
+	if (Headless) {
+		createReadback();
 	}
+	createStreamer();
+	requestAssets();
+}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
-
-			vertex.pos = {
-				attrib.vertices[static_cast<std::vector<float>::size_type>(3 * index.vertex_index + 0)],
-				attrib.vertices[static_cast<std::vector<float>::size_type>(3 * index.vertex_index + 1)],
-				attrib.vertices[static_cast<std::vector<float>::size_type>(3 * index.vertex_index + 2)]
-			};
-
-			vertex.texCoord = {
-				attrib.texcoords[static_cast<std::vector<float>::size_type>(2 * index.texcoord_index + 0)],
-				1.0f - attrib.texcoords[static_cast<std::vector<float>::size_type>(2 * index.texcoord_index + 1)]
-			};
-
-			vertex.color = {1.0f, 1.0f, 1.0f};
+void App::createStreamer() {
+	QueueFamilyIndices indices = findQueueFamilies(PhysicalDevice);
+	//keep a core for the render loop and one for the upload thread
+	size_t loaders = std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency() / 2));
+	Streamer.init(SelectedDevice, TransferQueue, indices.transferFamily.value(), indices.graphicsFamily.value(), &QueueMutex
+		, &Allocator, loaders, STAGING_RING_SIZE);
+	std::cout << "streaming on queue family " << indices.transferFamily.value() << " with " << loaders << " loader threads"
+		<< (Streamer.ownershipTransfer() ? " (dedicated transfer family)" : "") << std::endl;
+}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(Vertices.size());
-				Vertices.push_back(vertex);
-			}
+void App::requestAssets() {
+	ModelRequest = Streamer.request(loadModel);
+	TextureRequest = Streamer.request(loadTexture);
+}
 
-			Indices.push_back(uniqueVertices[vertex]);
+void App::collectStreamedAssets() {
+	if (Streamer.outstanding() == 0) {
+		return;
+	}
+	std::vector<StreamedAsset> ready;
+	Streamer.collect(ready);
+	for (auto &asset : ready) {
+		if (asset.failed) {
+			throw std::runtime_error("failed to stream asset: " + asset.error);
+		}
+		if (asset.id == ModelRequest) {
+			VertexBuffer = asset.buffers[0];
+			VertexBufferMemory = asset.bufferMemory[0];
+			IndexBuffer = asset.buffers[1];
+			IndexBufferMemory = asset.bufferMemory[1];
+			auto info = std::static_pointer_cast<ModelInfo>(asset.metadata);
+			IndexType = info->indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			ModelLods = info->lods;
+			ModelDequantize = ModelVertex::dequantize(info->bounds);
+			ModelCenter = (info->bounds.min + info->bounds.max) * 0.5f;
+			ModelRadius = glm::length(info->bounds.max - info->bounds.min) * 0.5f;
+			World.setMeshSphere(AgentMesh, glm::vec4(ModelCenter, ModelRadius));
+			Commands.markDirty(SceneLayer);
+			const VkDeviceSize vertexCount = asset.bufferSizes[0] / sizeof(ModelVertex);
+			std::cout << "model: " << vertexCount << " vertices, " << asset.bufferSizes[0] / 1024 << " KB at "
+				<< sizeof(ModelVertex) << " bytes/vertex (" << vertexCount * sizeof(Vertex) / 1024 << " KB unpacked), "
+				<< asset.bufferSizes[1] / info->indexSize << " " << info->indexSize * 8 << " bit indices in "
+				<< ModelLods.size() << " levels of detail" << std::endl;
+			ModelResident = true;
+		} else if (asset.id == TextureRequest) {
+			TextureImage = asset.images[0];
+			TextureImageMemory = asset.imageMemory[0];
+			MipLevels = asset.imageMipLevels[0];
+			createTextureImageView();
+			TextureSlot = Textures.add(TextureImageView, TextureSampler);
+			Agents.setMaterials(World, {TextureSlot});
+			TextureResident = true;
+			Commands.markDirty(SceneLayer);
+		}
+		PendingBufferAcquires.insert(PendingBufferAcquires.end(), asset.bufferAcquires.begin(), asset.bufferAcquires.end());
+		PendingImageAcquires.insert(PendingImageAcquires.end(), asset.imageAcquires.begin(), asset.imageAcquires.end());
+		PendingAcquireStages |= asset.acquireStages;
+		PendingTimelineValue = std::max(PendingTimelineValue, asset.timelineValue);
+	}
+	if (!ready.empty() && Streamer.outstanding() == 0) {
+		UploadStats stats = Streamer.stats();
+		std::cout << "uploads: " << stats.copies << " copies in " << stats.flushes << " submits, "
+			<< stats.bytes / 1024 << " KB total, " << (stats.flushes ? stats.bytes / stats.flushes / 1024 : 0) << " KB/submit avg, "
+			<< stats.maxFlushBytes / 1024 << " KB max, " << stats.stalls << " ring stalls (" << stats.stallMs << " ms), "
+			<< stats.oversize << " oversize" << std::endl;
+		Allocator.logStats();
+	}
+}
+
+void App::loadModel(AssetPayload &payload) {
+	auto model = std::make_shared<LoadedModel>();
+	const void *vertices = nullptr;
+	const void *indices = nullptr;
+	VkDeviceSize vertexSize = 0, indexSize = 0;
+	auto info = std::make_shared<ModelInfo>();
+#ifdef OBJ_LOAD
+	if (!model->cache.open(MODEL_CACHE_PATH, MODEL_PATH)) {
+		std::string err;
+		if (!readObj(MODEL_PATH, model->vertices, model->indices, err)) {
+			throw std::runtime_error(err);
+		}
+		//only paid when (re)baking, the cache stores the optimized mesh and its lod chain
+		optimizeMesh(model->vertices, model->indices);
+		buildLodChain(model->vertices, model->indices, info->lods);
+		if (MeshCache::bake(MODEL_CACHE_PATH, MODEL_PATH, model->vertices, model->indices, info->lods)
+				&& model->cache.open(MODEL_CACHE_PATH, MODEL_PATH)) {
+			//the mapped cache is what gets staged, no need to keep a second copy around
+			std::vector<Vertex>().swap(model->vertices);
+			std::vector<uint32_t>().swap(model->indices);
+		} else {
+			std::cout << "unable to write mesh cache " << MODEL_CACHE_PATH << std::endl;
 		}
 	}
+	if (model->cache.isOpen()) {
+		info->bounds = model->cache.bounds();
+		info->indexSize = model->cache.indexSize();
+		info->lods = model->cache.lods();
+		vertices = model->cache.vertices();
+		indices = model->cache.indices();
+		vertexSize = sizeof(ModelVertex) * model->cache.vertexCount();
+		indexSize = VkDeviceSize{info->indexSize} * model->cache.indexCount();
+	} else {
+		info->bounds = MeshCache::computeBounds(model->vertices);
+		ModelVertex::pack(model->vertices.data(), model->vertices.size(), info->bounds, model->packed);
+		vertices = model->packed.data();
+		if (fitsIndex16(model->vertices.size())) {
+			narrowIndices(model->indices, model->narrowIndices);
+			info->indexSize = sizeof(uint16_t);
+			indices = model->narrowIndices.data();
+		} else {
+			info->indexSize = sizeof(uint32_t);
+			indices = model->indices.data();
+		}
+		vertexSize = sizeof(ModelVertex) * model->packed.size();
+		indexSize = VkDeviceSize{info->indexSize} * model->indices.size();
+	}
+#else
+	info->bounds = MeshCache::computeBounds(Vertices);
+	info->indexSize = sizeof(uint16_t);
+	info->lods.push_back({0, static_cast<uint32_t>(Indices.size()), 0.0f});
+	ModelVertex::pack(Vertices.data(), Vertices.size(), info->bounds, model->packed);
+	vertices = model->packed.data();
+	indices = Indices.data();
+	vertexSize = sizeof(ModelVertex) * model->packed.size();
+	indexSize = sizeof(uint16_t) * Indices.size();
+#endif
+	payload.buffers.push_back({vertices, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+			, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT});
+	payload.buffers.push_back({indices, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+			, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT});
+	payload.storage = model;
+	payload.metadata = info;
+}
+
+void App::loadTexture(AssetPayload &payload) {
+	auto texture = std::make_shared<LoadedTexture>();
+	ImageUpload image{};
+	image.format = VK_FORMAT_R8G8B8A8_SRGB;
+
+	if (texture->container.open(TEXTURE_CONTAINER_PATH, TEXTURE_PATH)) {
+		const TextureContainerHeader &header = texture->container.header();
+		if (header.format != VK_FORMAT_R8G8B8A8_SRGB) {
+			throw std::runtime_error("unsupported baked texture format!");
+		}
+		image.levels.assign(header.levels, header.levels + header.mipLevels);
+		image.data = texture->container.data();
+		image.size = header.dataSize;
+		image.width = header.width;
+		image.height = header.height;
+	} else {
+		//no (up to date) baked container, decode and build the mips on the CPU the same way tex-bake does
+		std::cout << "no baked texture at " << TEXTURE_CONTAINER_PATH << ", decoding " << TEXTURE_PATH << std::endl;
+		int textWidth, textHeight, texChannels;
+		//decoded straight out of the mapping
+		MappedFile encoded;
+#ifdef OBJ_LOAD
+		const bool opened = encoded.open(TEXTURE_PATH);
+#else
+		const bool opened = encoded.open("textures/dragon.jpg");
+#endif
+		stbi_uc * pixels = opened ? stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &textWidth, &textHeight
+			, &texChannels, STBI_rgb_alpha) : nullptr;
+		if(!pixels) {
+			throw std::runtime_error("failed to load texture image");
+		}
+		image.width = static_cast<uint32_t>(textWidth);
+		image.height = static_cast<uint32_t>(textHeight);
+		buildMipChain(pixels, image.width, image.height, texture->levelData, image.levels);
+		stbi_image_free(pixels);
+		image.data = texture->levelData.data();
+		image.size = texture->levelData.size();
+	}
+	payload.images.push_back(std::move(image));
+	payload.storage = texture;
 }
 
 bool App::hasStencilComponent(VkFormat format) {
@@ -277,10 +473,7 @@ void App::createDepthResources() {
 	VkFormat depthFormat = findDepthFormat();
 	createImage(SwapChainExtent.width, SwapChainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DepthImage, DepthImageMemory);
 
-	DepthImageView = createImageView(DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-
-	//transitionImageLayout(DepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED
-	//		, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+	DepthImageView = createImageView(DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
 void App::createTextureSampler() {
@@ -303,7 +496,8 @@ void App::createTextureSampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = static_cast<float>(MipLevels);
+	//the texture streams in after the sampler exists, let the view decide the mip range
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	if (vkCreateSampler(SelectedDevice, &samplerInfo, nullptr, &TextureSampler) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture sampler!");
@@ -311,7 +505,7 @@ void App::createTextureSampler() {
 }
 
 
-VkImageView App::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+VkImageView App::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
@@ -319,7 +513,7 @@ VkImageView App::createImageView(VkImage image, VkFormat format, VkImageAspectFl
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = MipLevels;
+	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
 	//viewInfo.components = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -332,10 +526,10 @@ VkImageView App::createImageView(VkImage image, VkFormat format, VkImageAspectFl
 }
 
 void App::createTextureImageView() {
-	TextureImageView = createImageView(TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+	TextureImageView = createImageView(TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, MipLevels);
 }
 
-void App::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void App::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, DeviceAllocation& imageMemory) {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -351,148 +545,20 @@ void App::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFor
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkCreateImage(SelectedDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create image!");
-	}
-
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(SelectedDevice, image, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(SelectedDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-
-	vkBindImageMemory(SelectedDevice, image, imageMemory, 0);
-}
-
-void App::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-	// Check if image format supports linear blitting
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(PhysicalDevice, imageFormat, &formatProperties);
-
-	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-		throw std::runtime_error("texture image format does not support linear blitting!");
-	}
-
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.image = image;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.levelCount = 1;
-
-	int32_t mipWidth = texWidth;
-	int32_t mipHeight = texHeight;
-
-	for (uint32_t i = 1; i < mipLevels; i++) {
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT
-				, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		VkImageBlit blit{};
-		blit.srcOffsets[0] = {0, 0, 0};
-		blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.srcSubresource.mipLevel = i - 1;
-		blit.srcSubresource.baseArrayLayer = 0;
-		blit.srcSubresource.layerCount = 1;
-		blit.dstOffsets[0] = {0, 0, 0};
-		blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.dstSubresource.mipLevel = i;
-		blit.dstSubresource.baseArrayLayer = 0;
-		blit.dstSubresource.layerCount = 1;
-
-		vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit, VK_FILTER_LINEAR);
-
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, nullptr, 0, nullptr, 1, &barrier);
-
-		if (mipWidth > 1) mipWidth /= 2;
-		if (mipHeight > 1) mipHeight /= 2;
-	}
-
-	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-		0, nullptr, 0, nullptr, 1, &barrier);
-
-	endSingleTimeCommands(commandBuffer);
-}
-
-void App::createTextureImage() {
-	int textWidth, textHeight, texChannels;
-#ifdef OBJ_LOAD
-	stbi_uc * pixels = stbi_load(TEXTURE_PATH.c_str(), &textWidth, &textHeight, &texChannels, STBI_rgb_alpha);
-#else
-	stbi_uc * pixels = stbi_load("textures/dragon.jpg", &textWidth, &textHeight, &texChannels, STBI_rgb_alpha);
-#endif
-	MipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(textWidth, textHeight)))) + 1;
-	VkDeviceSize imageSize = static_cast<uint32_t>(textWidth) * static_cast<uint32_t>(textHeight) * 4UL;
-	if(!pixels) {
-		throw std::runtime_error("failed to load texture image");
-	}
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-			, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-	void* data;
-	vkMapMemory(SelectedDevice, stagingBufferMemory, 0, imageSize, 0, &data); 
-	memcpy(data, pixels, imageSize);
-	vkUnmapMemory(SelectedDevice, stagingBufferMemory);
-	stbi_image_free(pixels);
-	createImage(static_cast<uint32_t>(textWidth), static_cast<uint32_t>(textHeight), MipLevels, VK_FORMAT_R8G8B8A8_SRGB
-			, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
-			, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, TextureImage, TextureImageMemory);
-
-	transitionImageLayout(TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED
-			, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, MipLevels);
-	copyBufferToImage(stagingBuffer, TextureImage, static_cast<uint32_t>(textWidth), static_cast<uint32_t>(textHeight));
-	//transitionImageLayout(TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, MipLevels);
-
-	vkDestroyBuffer(SelectedDevice, stagingBuffer, nullptr);
-	vkFreeMemory(SelectedDevice, stagingBufferMemory, nullptr);
-
-	generateMipmaps(TextureImage, VK_FORMAT_R8G8B8A8_SRGB, textWidth, textHeight, MipLevels);
+	Allocator.createImage(imageInfo, properties, image, imageMemory);
 }
 
 void App::createDescriptorPool() {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	//the textures live in their own pool, see BindlessTextures
+	std::array<VkDescriptorPoolSize, 1> poolSizes{};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[0].descriptorCount = FramesInFlight;
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolInfo.maxSets = FramesInFlight;
 
 	if (vkCreateDescriptorPool(SelectedDevice, &poolInfo, nullptr, &DescriptorPool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor pool!");
@@ -500,67 +566,88 @@ void App::createDescriptorPool() {
 }
 
 void App::createDescriptorSets() {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, DescriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> layouts(FramesInFlight, DescriptorSetLayout);
 
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = DescriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.descriptorSetCount = FramesInFlight;
 	allocInfo.pSetLayouts = layouts.data();
 
-	DescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	DescriptorSets.resize(FramesInFlight);
 
 	if (vkAllocateDescriptorSets(SelectedDevice, &allocInfo, DescriptorSets.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+	for (size_t i = 0; i < FramesInFlight; i++) {
 		VkDescriptorBufferInfo bufferInfo{};
 		bufferInfo.buffer = UniformBuffers[i];
 		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
-
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = TextureImageView;
-		imageInfo.sampler = TextureSampler;
-
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = DescriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
-	
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = DescriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+		bufferInfo.range = sizeof(FrameUniforms);
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = DescriptorSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
 
-		vkUpdateDescriptorSets(SelectedDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		vkUpdateDescriptorSets(SelectedDevice, 1, &descriptorWrite, 0, nullptr);
 	}
 }
 
 void App::createUniformBuffers() {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	VkDeviceSize bufferSize = sizeof(FrameUniforms);
 
-	UniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	UniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	UniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	UniformBuffers.resize(FramesInFlight);
+	UniformBuffersMemory.resize(FramesInFlight);
+	UniformBuffersMapped.resize(FramesInFlight);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+	for (size_t i = 0; i < FramesInFlight; i++) {
 		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UniformBuffers[i], UniformBuffersMemory[i]);
-            
-		vkMapMemory(SelectedDevice, UniformBuffersMemory[i], 0, bufferSize, 0, &UniformBuffersMapped[i]);
+		//host visible allocations stay mapped for their lifetime
+		UniformBuffersMapped[i] = UniformBuffersMemory[i].mapped;
 	}
 }
 
+void App::createInstanceBuffers() {
+	World.init(workerCount());
+	//a point until the model is resident and its bounds are known
+	AgentMesh = World.addMesh(glm::vec4(0.0f));
+	Agents.init(AgentCount, AGENT_SPACING, World, AgentMesh);
+	World.build();
+	ViewScale = Agents.radius() / AGENT_SPACING;
+
+	std::vector<uint32_t> cullShaderCode;
+	std::string error;
+	if (!Shaders.compile("shaders/cull.comp", GpuCuller::shaderDefines(), cullShaderCode, error)) {
+		throw std::runtime_error("failed to compile shaders/cull.comp: " + error);
+	}
+	Culler.init(SelectedDevice, &Allocator, &Pipelines, FramesInFlight, AgentCount, cullShaderCode, DrawIndirectCount, MultiDrawIndirect);
+	std::cout << "agents: " << AgentCount << " instances, " << sizeof(InstanceTransform) << " bytes each, "
+		<< sizeof(InstanceTransform) * AgentCount / 1024 << " KB per frame, culled on the GPU with "
+		<< (DrawIndirectCount ? "indirect count draws" : MultiDrawIndirect ? "multi draw indirect" : "single indirect draws") << std::endl;
+}
+
+void App::updateInstances(uint32_t frameSlot, float time, const glm::vec3 &eye, const glm::mat4 &viewProj) {
+	if (ModelLods.empty()) {
+		return;
+	}
+	//the scene drops whole regions of agents, the GPU then tests the spheres of what's left;
+	//the recorded dispatch and draws read all of this from the slot's buffers, nothing is re-recorded
+	const Frustum frustum = Frustum::fromViewProj(viewProj);
+	Agents.animate(time, World);
+	World.update();
+	World.cull(frustum, Visible);
+	std::vector<InstanceBatch> batches;
+	const LodView view{eye, FOV_Y, static_cast<float>(SwapChainExtent.height), LOD_PIXEL_ERROR};
+	Agents.writeInstances(World, Visible, ModelCenter, ModelLods, view, Culler.instances(frameSlot), batches);
+	Culler.update(frameSlot, frustum, glm::vec4(ModelCenter, ModelRadius), static_cast<uint32_t>(Visible.size()), ModelLods, batches);
+}
+
 void App::createDescriptorSetLayout() {
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
 	uboLayoutBinding.binding = 0;
@@ -569,14 +656,7 @@ void App::createDescriptorSetLayout() {
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+	std::array<VkDescriptorSetLayoutBinding, 1> bindings = {uboLayoutBinding};
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -586,216 +666,21 @@ void App::createDescriptorSetLayout() {
 	if (vkCreateDescriptorSetLayout(SelectedDevice, &layoutInfo, nullptr, &DescriptorSetLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layout!");
 	}
-}
 
-void App::createIndexBuffer() {
-	VkDeviceSize bufferSize = sizeof(Indices[0]) * Indices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(SelectedDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, Indices.data(), bufferSize);
-	vkUnmapMemory(SelectedDevice, stagingBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, IndexBuffer, IndexBufferMemory);
-
-	copyBuffer(stagingBuffer, IndexBuffer, bufferSize);
-
-	vkDestroyBuffer(SelectedDevice, stagingBuffer, nullptr);
-	vkFreeMemory(SelectedDevice, stagingBufferMemory, nullptr);
+	//set 1, the textures every frame shares
+	Textures.init(PhysicalDevice, SelectedDevice, BindlessTextures::MAX_TEXTURES);
+	std::cout << "textures: " << Textures.capacity() << " bindless slots" << std::endl;
 }
 
 void App::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties
-		, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = size;
-	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	if (vkCreateBuffer(SelectedDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create buffer!");
-	}
-
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(SelectedDevice, buffer, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(SelectedDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
-
-	vkBindBufferMemory(SelectedDevice, buffer, bufferMemory, 0);
-}
-
-VkCommandBuffer App::beginSingleTimeCommands() {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = CommandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(SelectedDevice, &allocInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
+		, VkBuffer& buffer, DeviceAllocation& bufferMemory) {
+	Allocator.createBuffer(size, usage, properties, buffer, bufferMemory);
 }
 
-void App::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-	vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(GraphicsQueue);
-
-	vkFreeCommandBuffers(SelectedDevice, CommandPool, 1, &commandBuffer);
-}
-
-
-void App::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-void App::transitionImageLayout(VkImage image,[[maybe_unused]] VkFormat format, VkImageLayout oldLayout
-		, VkImageLayout newLayout, uint32_t mipLevels) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-	
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = mipLevels;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.srcAccessMask = 0; // TODO
-	barrier.dstAccessMask = 0; //TODO
-
-	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-		if (hasStencilComponent(format)) {
-			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-	} else {
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	}
-
-	vkCmdPipelineBarrier( commandBuffer, 0 /* TODO */, 0 /* TODO */, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	} else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	} else {
-		throw std::invalid_argument("unsupported layout transition!");
-	}
-
-	vkCmdPipelineBarrier( commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	endSingleTimeCommands(commandBuffer);
-}
-
-void App::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-
-	region.imageOffset = {0, 0, 0};
-	region.imageExtent = { width, height, 1 };
-
-	vkCmdCopyBufferToImage( commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	endSingleTimeCommands(commandBuffer);
-}
-
-void App::createVertexBuffer() {
-	VkDeviceSize bufferSize = sizeof(Vertices[0]) * Vertices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(SelectedDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, Vertices.data(), bufferSize);
-	vkUnmapMemory(SelectedDevice, stagingBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VertexBuffer, VertexBufferMemory);
-
-	copyBuffer(stagingBuffer, VertexBuffer, bufferSize);
-	vkDestroyBuffer(SelectedDevice, stagingBuffer, nullptr);
-	vkFreeMemory(SelectedDevice, stagingBufferMemory, nullptr);
-}
-
-uint32_t App::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &memProperties);
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
-	}
-
-	throw std::runtime_error("failed to find suitable memory type!");
-}
 
 void App::cleanupSwapChain() {
 	vkDestroyImageView(SelectedDevice, DepthImageView, nullptr);
-	vkDestroyImage(SelectedDevice, DepthImage, nullptr);
-	vkFreeMemory(SelectedDevice, DepthImageMemory, nullptr);
+	Allocator.destroyImage(DepthImage, DepthImageMemory);
 
 	for (size_t i = 0; i < SwapChainFramebuffers.size(); i++) {
         vkDestroyFramebuffer(SelectedDevice, SwapChainFramebuffers[i], nullptr);
@@ -805,6 +690,12 @@ void App::cleanupSwapChain() {
         vkDestroyImageView(SelectedDevice, SwapChainImageViews[i], nullptr);
     }
 
+	if (Headless) {
+		for (size_t i = 0; i < SwapChainImages.size(); i++) {
+			Allocator.destroyImage(SwapChainImages[i], OffscreenMemory[i]);
+		}
+		return;
+	}
     vkDestroySwapchainKHR(SelectedDevice, SwapChain, nullptr);
 }
 
@@ -816,59 +707,93 @@ void App::recreateSwapChain() {
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(SelectedDevice);
+	{
+		std::lock_guard<std::mutex> lock(QueueMutex);
+		vkDeviceWaitIdle(SelectedDevice);
+	}
+	//presents still being timed refer to the swap chain about to go
+	Pacer.drain();
 	cleanupSwapChain();
 
 	createSwapChain();
 	createImageViews();
 	createDepthResources();
 	createFrameBuffers();
+	updateCommandTargets();
 }
 
 void App::createSyncObjects() {
-	ImageAvailableSemaphore.resize(MAX_FRAMES_IN_FLIGHT);
-	RenderFinishedSemaphore.resize(MAX_FRAMES_IN_FLIGHT);
-	InFlightFence.resize(MAX_FRAMES_IN_FLIGHT);
-
-	VkSemaphoreCreateInfo semaphoreInfo{};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (uint32_t i=0;i<MAX_FRAMES_IN_FLIGHT;++i) {
-		if (vkCreateSemaphore(SelectedDevice, &semaphoreInfo, nullptr, &ImageAvailableSemaphore[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(SelectedDevice, &semaphoreInfo, nullptr, &RenderFinishedSemaphore[i]) != VK_SUCCESS ||
-			vkCreateFence(SelectedDevice, &fenceInfo, nullptr, &InFlightFence[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create semaphores!");
+	PFN_vkWaitForPresentKHR presentWait = nullptr;
+	if (PresentWait) {
+		presentWait = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(SelectedDevice, "vkWaitForPresentKHR"));
+	}
+	Pacer.init(SelectedDevice, FramesInFlight, presentWait, &QueueMutex);
+	std::cout << "frame pacing: " << FramesInFlight << " frames in flight, "
+		<< (Headless ? "headless" : FramePacer::presentModeName(PresentMode)) << ", latency measured to "
+		<< (presentWait ? "present" : "GPU completion") << std::endl;
+}
+
+void App::createCommandCache() {
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(PhysicalDevice);
+	//leave room for the loader and upload threads
+	const uint32_t recordWorkers = std::max(1u, std::min(8u, workerCount() / 2));
+	Commands.init(SelectedDevice, queueFamilyIndices.graphicsFamily.value(), FramesInFlight, recordWorkers);
+	if (HostQueryReset) {
+		Profiler.init(Instance, PhysicalDevice, SelectedDevice, queueFamilyIndices.graphicsFamily.value(), FramesInFlight
+				, PipelineStatistics, InheritedQueries);
+		Commands.setProfiler(&Profiler);
+		if (Headless) {
+			ReadbackScope = Profiler.addScope("readback", false);
 		}
+	} else {
+		std::cout << "hostQueryReset isn't supported, no GPU timings are taken" << std::endl;
 	}
+	Commands.addPrePass("cull", [this](VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+		Culler.recordCull(commandBuffer, frameSlot);
+	});
+	SceneLayer = Commands.addParallelLayer([this](uint32_t frameSlot) { return sceneDrawCount(frameSlot); }
+			, [this](VkCommandBuffer commandBuffer, size_t begin, size_t end, uint32_t frameSlot) {
+		recordScene(commandBuffer, begin, end, frameSlot);
+	});
+	updateCommandTargets();
 }
 
-void App::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+void App::updateCommandTargets() {
+	std::vector<VkClearValue> clearValues(2);
+	clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+	clearValues[1].depthStencil = {1.0f, 0};
+	Commands.setTargets(RenderPass, SwapChainFramebuffers, SwapChainExtent, clearValues);
+}
+
+bool App::recordAcquireBarriers(VkCommandBuffer commandBuffer) {
+	if (PendingBufferAcquires.empty() && PendingImageAcquires.empty()) {
+		return false;
+	}
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
+	vkCmdPipelineBarrier(commandBuffer, PendingAcquireStages, PendingAcquireStages, 0, 0, nullptr
+			, static_cast<uint32_t>(PendingBufferAcquires.size()), PendingBufferAcquires.data()
+			, static_cast<uint32_t>(PendingImageAcquires.size()), PendingImageAcquires.data());
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+	return true;
+}
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = RenderPass;
-	renderPassInfo.framebuffer = SwapChainFramebuffers[imageIndex];
-	renderPassInfo.renderArea.offset = {0, 0};
-	renderPassInfo.renderArea.extent = SwapChainExtent;
-
-	std::array<VkClearValue, 2> clearValues{};
-	clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-	clearValues[1].depthStencil = {1.0f, 0};
-
-	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderPassInfo.pClearValues = clearValues.data();
-
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+size_t App::sceneDrawCount(uint32_t) const {
+	//nothing is drawn until the mesh, its texture and the pipeline are all there, then the whole field is one indirect draw
+	return ModelResident && TextureResident && GraphicsPipeline != VK_NULL_HANDLE ? 1 : 0;
+}
 
+//runs on the recording threads, only reads App state that is fixed while the scene layer records
+void App::recordScene(VkCommandBuffer commandBuffer, size_t begin, size_t end, uint32_t frameSlot) {
+	if (GraphicsPipeline == VK_NULL_HANDLE) {
+		return;
+	}
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipeline);
 
 	VkViewport viewport{};
@@ -883,33 +808,29 @@ void App::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex
 	VkRect2D scissor{};
 	scissor.offset = {0, 0};
 	scissor.extent = SwapChainExtent;
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);            
-
-
-	VkBuffer vertexBuffers[] = {VertexBuffer};
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-#ifdef OBJ_LOAD
-	vkCmdBindIndexBuffer(commandBuffer, IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-#else
-	vkCmdBindIndexBuffer(commandBuffer, IndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-#endif
-
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 1
-			, &DescriptorSets[CurrentFrame], 0, nullptr);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(Indices.size()), 1, 0, 0, 0);
-	//vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+	if (begin == end) {
+		return;
+	}
+	VkBuffer vertexBuffers[] = {VertexBuffer, Culler.visibleInstances(frameSlot)};
+	VkDeviceSize offsets[] = {0, 0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, IndexBuffer, 0, IndexType);
 
-	vkCmdEndRenderPass(commandBuffer);
+	//the only descriptor bind, every material's texture is in set 1
+	const VkDescriptorSet sets[] = {DescriptorSets[frameSlot], Textures.set()};
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 2, sets, 0, nullptr);
+	//positions may be quantized against the mesh bounds, undo that before the instance transforms
+	const MeshConstants constants{ModelDequantize};
+	vkCmdPushConstants(commandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to record command buffer!");
-	}
+	//one instanced draw per level of detail in use, with the counts the cull pass left behind
+	Culler.recordDraws(commandBuffer, frameSlot);
 }
 
 void App::createCommandBuffers() {
-	CommandBuffer.resize(MAX_FRAMES_IN_FLIGHT);
+	CommandBuffer.resize(FramesInFlight);
 
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -920,6 +841,13 @@ void App::createCommandBuffers() {
 	if (vkAllocateCommandBuffers(SelectedDevice, &allocInfo, CommandBuffer.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate command buffers!");
 	}
+	if (Headless) {
+		//re-recorded every frame, the readback slot a frame copies into changes
+		ReadbackCommandBuffer.resize(FramesInFlight);
+		if (vkAllocateCommandBuffers(SelectedDevice, &allocInfo, ReadbackCommandBuffer.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+	}
 }
 
 void App::createCommandPool() {
@@ -967,7 +895,8 @@ void App::createRenderPass() {
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	//offscreen targets are copied out instead of presented
+	colorAttachment.finalLayout = Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.attachment = 0;
@@ -993,13 +922,22 @@ void App::createRenderPass() {
 	subpass.pColorAttachments = &colorAttachmentRef;
 	subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-	VkSubpassDependency dependency{};
+	std::array<VkSubpassDependency, 2> dependencies{};
+	VkSubpassDependency &dependency = dependencies[0];
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
 	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	dependency.srcAccessMask = 0;
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	//the readback copy that follows the pass when headless
+	VkSubpassDependency &readback = dependencies[1];
+	readback.srcSubpass = 0;
+	readback.dstSubpass = VK_SUBPASS_EXTERNAL;
+	readback.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	readback.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	readback.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	readback.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 	std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
 	VkRenderPassCreateInfo renderPassInfo{};
@@ -1008,8 +946,8 @@ void App::createRenderPass() {
 	renderPassInfo.pAttachments = attachments.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+	renderPassInfo.dependencyCount = Headless ? 2u : 1u;
+	renderPassInfo.pDependencies = dependencies.data();
 
 	if (vkCreateRenderPass(SelectedDevice, &renderPassInfo, nullptr, &RenderPass) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create render pass!");
@@ -1021,10 +959,38 @@ void App::createImageViews() {
 	SwapChainImageViews.resize(SwapChainImages.size());
 
 	for (uint32_t i = 0; i < SwapChainImages.size(); i++) {
-		SwapChainImageViews[i] = createImageView(SwapChainImages[i], SwapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		SwapChainImageViews[i] = createImageView(SwapChainImages[i], SwapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 	}
 }
 
+void App::createOffscreenTargets() {
+	//the extent was fixed by setHeadless
+	SwapChainImageFormat = OFFSCREEN_FORMAT;
+	SwapChainImages.resize(FramesInFlight);
+	OffscreenMemory.resize(FramesInFlight);
+	for (uint32_t i = 0; i < FramesInFlight; ++i) {
+		createImage(SwapChainExtent.width, SwapChainExtent.height, 1, SwapChainImageFormat, VK_IMAGE_TILING_OPTIMAL
+				, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+				, SwapChainImages[i], OffscreenMemory[i]);
+	}
+}
+
+void App::createReadback() {
+	ReadbackCallback callback = FrameCallback;
+	if (!callback && !FrameOutputDir.empty()) {
+		const std::string dir = FrameOutputDir;
+		callback = [dir](const ReadbackFrame &frame) {
+			char name[32];
+			snprintf(name, sizeof(name), "/frame_%06llu.ppm", static_cast<unsigned long long>(frame.frame));
+			if (!writePpm(dir + name, frame)) {
+				std::cout << "unable to write " << dir << name << std::endl;
+			}
+		};
+	}
+	//one more slot than frames in flight, so a frame is delivered while the ones after it render
+	Readback.init(SelectedDevice, &Allocator, SwapChainExtent, SwapChainImageFormat, FramesInFlight + 1, callback);
+}
+
 void App::createSwapChain() {
 	SwapChainSupportDetails swapChainSupport;
 	querySwapChainSupport(PhysicalDevice, swapChainSupport);
@@ -1124,136 +1090,71 @@ void App::createInstance() {
 	
 }
 
-void App::createGraphicsPipeline() {
-	std::vector<char> vertShaderCode;
-	std::vector<char> fragShaderCode;
-
-	if(readWholeFile("shaders/vert.spv", vertShaderCode)) {
-		if(readWholeFile("shaders/frag.spv",fragShaderCode)) {
-			VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-			VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-			VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-			vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-			vertShaderStageInfo.module = vertShaderModule;
-			vertShaderStageInfo.pName = "main";
-
-			VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-			fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			fragShaderStageInfo.module = fragShaderModule;
-			fragShaderStageInfo.pName = "main";
-			
-			
-			VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-			
-			auto bindingDescription = Vertex::getBindingDescription();
-			auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-			VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-			vertexInputInfo.vertexBindingDescriptionCount = 1;
-			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-			vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-			vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-			VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-			inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-			inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-			inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-			VkPipelineViewportStateCreateInfo viewportState{};
-			viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-			viewportState.viewportCount = 1;
-			viewportState.scissorCount = 1;
-
-			VkPipelineRasterizationStateCreateInfo rasterizer{};
-			rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-			rasterizer.depthClampEnable = VK_FALSE;
-			rasterizer.rasterizerDiscardEnable = VK_FALSE;
-			rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-			rasterizer.lineWidth = 1.0f;
-			rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-			rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; //VK_FRONT_FACE_CLOCKWISE;
-			rasterizer.depthBiasEnable = VK_FALSE;
-
-			VkPipelineMultisampleStateCreateInfo multisampling{};
-			multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-			multisampling.sampleShadingEnable = VK_FALSE;
-			multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-			colorBlendAttachment.blendEnable = VK_FALSE;
-
-			VkPipelineColorBlendStateCreateInfo colorBlending{};
-			colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-			colorBlending.logicOpEnable = VK_FALSE;
-			colorBlending.logicOp = VK_LOGIC_OP_COPY;
-			colorBlending.attachmentCount = 1;
-			colorBlending.pAttachments = &colorBlendAttachment;
-			colorBlending.blendConstants[0] = 0.0f;
-			colorBlending.blendConstants[1] = 0.0f;
-			colorBlending.blendConstants[2] = 0.0f;
-			colorBlending.blendConstants[3] = 0.0f;
-
-			std::vector<VkDynamicState> dynamicStates = {
-				VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR
-			};
-			VkPipelineDynamicStateCreateInfo dynamicState{};
-			dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-			dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-			dynamicState.pDynamicStates = dynamicStates.data();
-
-			VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-			pipelineLayoutInfo.setLayoutCount = 1;
-			pipelineLayoutInfo.pSetLayouts = &DescriptorSetLayout;
-			//pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-			if (vkCreatePipelineLayout(SelectedDevice, &pipelineLayoutInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create pipeline layout!");
-			}
-
-			VkPipelineDepthStencilStateCreateInfo depthStencil{};
-			depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-			depthStencil.depthTestEnable = VK_TRUE;
-			depthStencil.depthWriteEnable = VK_TRUE;
-			depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-			depthStencil.depthBoundsTestEnable = VK_FALSE;
-			depthStencil.minDepthBounds = 0.0f; // Optional
-			depthStencil.maxDepthBounds = 1.0f; // Optional
-			depthStencil.stencilTestEnable = VK_FALSE;
-			depthStencil.front = {}; // Optional
-			depthStencil.back = {}; // Optional
-			
-			VkGraphicsPipelineCreateInfo pipelineInfo{};
-			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-			pipelineInfo.stageCount = 2;
-			pipelineInfo.pStages = shaderStages;
-			pipelineInfo.pVertexInputState = &vertexInputInfo;
-			pipelineInfo.pInputAssemblyState = &inputAssembly;
-			pipelineInfo.pViewportState = &viewportState;
-			pipelineInfo.pRasterizationState = &rasterizer;
-			pipelineInfo.pMultisampleState = &multisampling;
-			pipelineInfo.pColorBlendState = &colorBlending;
-			pipelineInfo.pDynamicState = &dynamicState;
-			pipelineInfo.layout = PipelineLayout;
-			pipelineInfo.renderPass = RenderPass;
-			pipelineInfo.subpass = 0;
-			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-			pipelineInfo.pDepthStencilState = &depthStencil;
-
-
-			if (vkCreateGraphicsPipelines(SelectedDevice,VK_NULL_HANDLE,1,&pipelineInfo, nullptr,&GraphicsPipeline)!= VK_SUCCESS) {
-				throw std::runtime_error("failed to create graphics pipeline!");
-			}
+void App::createPipelineCompiler() {
+	Shaders.init(SHADER_CACHE_DIR);
+	Pipelines.init(PhysicalDevice, SelectedDevice, PIPELINE_CACHE_PATH);
+	//a couple of threads is plenty for a handful of pipelines and leaves the loaders their cores
+	Compiler.init(SelectedDevice, &Pipelines, &Shaders, PIPELINE_COMPILE_THREADS);
+}
 
-			vkDestroyShaderModule(SelectedDevice, fragShaderModule, nullptr);
-			vkDestroyShaderModule(SelectedDevice, vertShaderModule, nullptr);
+void App::createGraphicsPipeline() {
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	//per frame uniforms in set 0, the bindless textures in set 1
+	const VkDescriptorSetLayout setLayouts[] = {DescriptorSetLayout, Textures.layout()};
+	pipelineLayoutInfo.setLayoutCount = 2;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(MeshConstants);
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	if (vkCreatePipelineLayout(SelectedDevice, &pipelineLayoutInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	GraphicsPipelineDesc desc{};
+	desc.name = "scene";
+	desc.stages = {{VK_SHADER_STAGE_VERTEX_BIT, "shaders/shader.vert", {}}, {VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/shader.frag", {}}};
+	//mesh vertices on binding 0, instance transforms on binding 1
+	desc.bindings = {ModelVertex::getBindingDescription(), InstanceTransform::getBindingDescription()};
+	for (const auto &a : ModelVertex::getAttributeDescriptions()) {
+		desc.attributes.push_back(a);
+	}
+	for (const auto &a : InstanceTransform::getAttributeDescriptions()) {
+		desc.attributes.push_back(a);
+	}
+	desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	desc.polygonMode = VK_POLYGON_MODE_FILL;
+	desc.cullMode = VK_CULL_MODE_BACK_BIT;
+	desc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	desc.depthTest = true;
+	desc.depthWrite = true;
+	desc.depthCompare = VK_COMPARE_OP_LESS;
+	desc.blend = false;
+	desc.layout = PipelineLayout;
+	desc.renderPass = RenderPass;
+	desc.subpass = 0;
+	//compiles while the assets stream in, the scene layer draws nothing until collectPipelines() has it
+	ScenePipeline = Compiler.request(desc);
+}
+
+void App::collectPipelines() {
+	if (GraphicsPipeline != VK_NULL_HANDLE) {
+		return;
+	}
+	std::vector<PipelineHandle> done;
+	Compiler.collect(done);
+	for (PipelineHandle handle : done) {
+		if (handle != ScenePipeline) {
+			continue;
+		}
+		if (Compiler.failed(handle)) {
+			throw std::runtime_error("failed to create graphics pipeline!");
 		}
+		GraphicsPipeline = Compiler.pipeline(handle);
+		Commands.markDirty(SceneLayer);
 	}
 }
 
@@ -1261,26 +1162,87 @@ void App::createLogicalDevice() {
 	QueueFamilyIndices indices = findQueueFamilies(PhysicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value()};
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &queueFamilyCount, queueFamilies.data());
 
-	float queuePriority = 1.0f;
+	//without a transfer only family, uploads still get their own queue if the graphics family has a second one
+	uint32_t transferQueueIndex = 0;
+	if (indices.transferFamily == indices.graphicsFamily && queueFamilies[indices.graphicsFamily.value()].queueCount > 1) {
+		transferQueueIndex = 1;
+	}
+
+	float queuePriorities[] = {1.0f, 1.0f};
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = (queueFamily == indices.graphicsFamily.value() && transferQueueIndex == 1) ? 2u : 1u;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 	
+	//the culled draws use these when they are there and fall back to one indirect draw per level otherwise
+	VkPhysicalDeviceVulkan12Features supported12{};
+	supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supported12;
+	vkGetPhysicalDeviceFeatures2(PhysicalDevice, &supportedFeatures);
+	DrawIndirectCount = supported12.drawIndirectCount == VK_TRUE;
+	MultiDrawIndirect = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+
+	//with these the frame pacer times each frame until it is on screen rather than until the GPU is done with it
+	std::vector<const char*> extensions = requiredDeviceExtensions();
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWait{};
+	presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	VkPhysicalDevicePresentIdFeaturesKHR presentId{};
+	presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	PresentWait = false;
+	if (!Headless && hasDeviceExtension(PhysicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+			&& hasDeviceExtension(PhysicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+		presentId.pNext = &presentWait;
+		VkPhysicalDeviceFeatures2 presentFeatures{};
+		presentFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		presentFeatures.pNext = &presentId;
+		vkGetPhysicalDeviceFeatures2(PhysicalDevice, &presentFeatures);
+		PresentWait = presentId.presentId == VK_TRUE && presentWait.presentWait == VK_TRUE;
+	}
+	if (PresentWait) {
+		extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan12{};
+	vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12.pNext = PresentWait ? &presentId : nullptr;
+	vulkan12.timelineSemaphore = VK_TRUE;
+	vulkan12.drawIndirectCount = supported12.drawIndirectCount;
+	BindlessTextures::enableFeatures(vulkan12);
+	//the GPU profiler resets its queries from the host, it stays off without it
+	HostQueryReset = supported12.hostQueryReset == VK_TRUE;
+	vulkan12.hostQueryReset = supported12.hostQueryReset;
+	if (PipelineStatistics && supportedFeatures.features.pipelineStatisticsQuery != VK_TRUE) {
+		std::cout << "pipeline statistics queries aren't supported, only timings are taken" << std::endl;
+		PipelineStatistics = false;
+	}
+	InheritedQueries = PipelineStatistics && supportedFeatures.features.inheritedQueries == VK_TRUE;
+
 	VkPhysicalDeviceSynchronization2Features sync2{};
 	sync2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+	sync2.pNext = &vulkan12;
 	sync2.synchronization2 = VK_TRUE;
 
 	VkPhysicalDeviceFeatures2 deviceFeatures2{};
 	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 	deviceFeatures2.pNext = &sync2;
 	deviceFeatures2.features.samplerAnisotropy = VK_TRUE;
+	deviceFeatures2.features.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+	deviceFeatures2.features.pipelineStatisticsQuery = PipelineStatistics ? VK_TRUE : VK_FALSE;
+	deviceFeatures2.features.inheritedQueries = InheritedQueries ? VK_TRUE : VK_FALSE;
 
 	//VkPhysicalDeviceFeatures deviceFeatures{};
 	//deviceFeatures.samplerAnisotropy = VK_TRUE;
@@ -1293,8 +1255,8 @@ void App::createLogicalDevice() {
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	//createInfo.pEnabledFeatures = &deviceFeatures;
 	createInfo.pEnabledFeatures = nullptr;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -1309,13 +1271,22 @@ void App::createLogicalDevice() {
 	}
 	vkGetDeviceQueue(SelectedDevice, indices.graphicsFamily.value(), 0, &GraphicsQueue);
 	vkGetDeviceQueue(SelectedDevice, indices.presentFamily.value() , 0, &PresentQueue);
+	vkGetDeviceQueue(SelectedDevice, indices.transferFamily.value(), transferQueueIndex, &TransferQueue);
+	Allocator.init(PhysicalDevice, SelectedDevice);
 }
 
 void App::run() {
-   initWindow();
-   initVulkan();
-   mainLoop();
-   cleanUp();
+	PROFILE_THREAD("main");
+	if (!Headless) {
+		initWindow();
+	}
+	initVulkan();
+	if (Headless) {
+		renderOffscreen();
+	} else {
+		mainLoop();
+	}
+	cleanUp();
 }
 
 void App::initWindow() {
@@ -1325,39 +1296,54 @@ void App::initWindow() {
 	Window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 	glfwSetWindowUserPointer(Window, this);
 	glfwSetFramebufferSizeCallback(Window, framebufferResizeCallback);
+	glfwSetKeyCallback(Window, keyCallback);
 }
 
 void App::mainLoop() {
 	while (!glfwWindowShouldClose(Window)) {
+		PROFILE_ZONE("frame");
 		glfwPollEvents();
 		drawFrame();
 	}
+	std::lock_guard<std::mutex> lock(QueueMutex);
 	vkDeviceWaitIdle(SelectedDevice);
 }
 
 void App::updateUniformBuffer(uint32_t currentImage) {
+	PROFILE_ZONE("update");
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	if (Headless) {
+		time = static_cast<float>(FrameNumber) * HEADLESS_FRAME_TIME;
+	}
 
-	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f)
+	FrameUniforms ubo{};
+	const glm::vec3 eye = EYE_POSITION * ViewScale;
+	ubo.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.proj = glm::perspective(FOV_Y
 			, static_cast<float>(SwapChainExtent.width) / static_cast<float>(SwapChainExtent.height)
-			, 0.1f, 10.0f);
+			, 0.1f * ViewScale, 10.0f * ViewScale);
 	ubo.proj[1][1] *= -1;
+	ubo.viewProj = ubo.proj * ubo.view;
+
+	updateInstances(currentImage, time, eye, ubo.viewProj);
 
 	memcpy(UniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 }
 
 void App::drawFrame() {
-	vkWaitForFences(SelectedDevice, 1, &InFlightFence[CurrentFrame], VK_TRUE, UINT64_MAX);
+	CurrentFrame = Pacer.beginFrame();
+	Profiler.beginFrame(CurrentFrame);
 
 	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(SelectedDevice, SwapChain, UINT64_MAX
-			, ImageAvailableSemaphore[CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult result;
+	{
+		PROFILE_ZONE("acquire");
+		result = vkAcquireNextImageKHR(SelectedDevice, SwapChain, UINT64_MAX
+				, Pacer.imageAvailable(CurrentFrame), VK_NULL_HANDLE, &imageIndex);
+	}
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
@@ -1367,31 +1353,55 @@ void App::drawFrame() {
 	}
 
 	updateUniformBuffer(CurrentFrame);
+	Textures.reclaim(Pacer.completed());
+	collectStreamedAssets();
+	collectPipelines();
 
-	vkResetFences(SelectedDevice, 1, &InFlightFence[CurrentFrame]);
-
-	vkResetCommandBuffer(CommandBuffer[CurrentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-	recordCommandBuffer (CommandBuffer[CurrentFrame], imageIndex);
+	//the scene replays as recorded unless something in it changed
+	VkCommandBuffer commandBuffers[] = {CommandBuffer[CurrentFrame], Commands.acquire(imageIndex, CurrentFrame)};
+	const bool acquires = recordAcquireBarriers(CommandBuffer[CurrentFrame]);
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[] = {ImageAvailableSemaphore[CurrentFrame]};
-	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submitInfo.waitSemaphoreCount = 1;
+	//uploads collected this frame are already complete on the host's view of the timeline,
+	//the wait only orders the acquire barriers after the transfer queue's release
+	VkSemaphore waitSemaphores[] = {Pacer.imageAvailable(CurrentFrame), Streamer.timeline()};
+	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, PendingAcquireStages};
+	uint64_t waitValues[] = {0, PendingTimelineValue};
+	//present only takes the binary one, the pacer waits on the frame's timeline value before reusing its slot
+	VkSemaphore signalSemaphores[] = {Pacer.renderFinished(CurrentFrame), Pacer.timeline()};
+	uint64_t signalValues[] = {0, Pacer.submitting()};
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = PendingTimelineValue != 0 ? 2 : 1;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = timelineInfo.waitSemaphoreValueCount;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &CommandBuffer[CurrentFrame];
+	submitInfo.commandBufferCount = acquires ? 2 : 1;
+	submitInfo.pCommandBuffers = acquires ? commandBuffers : commandBuffers + 1;
 
-	VkSemaphore signalSemaphores[] = {RenderFinishedSemaphore[CurrentFrame]};
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = 2;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
-	if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, InFlightFence[CurrentFrame]) != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit draw command buffer!");
+	//waiting for the queue counts as submitting, the upload thread may hold it
+	std::unique_lock<std::mutex> queueLock(QueueMutex, std::defer_lock);
+	{
+		PROFILE_ZONE("submit");
+		queueLock.lock();
+		if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
 	}
+	PendingBufferAcquires.clear();
+	PendingImageAcquires.clear();
+	PendingAcquireStages = 0;
+	PendingTimelineValue = 0;
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1405,7 +1415,21 @@ void App::drawFrame() {
 
 	presentInfo.pImageIndices = &imageIndex;
 
-	result = vkQueuePresentKHR(PresentQueue, &presentInfo);
+	VkPresentIdKHR presentIds{};
+	const uint64_t presentId = Pacer.presentId();
+	if (presentId != 0) {
+		presentIds.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIds.swapchainCount = 1;
+		presentIds.pPresentIds = &presentId;
+		presentInfo.pNext = &presentIds;
+	}
+
+	{
+		PROFILE_ZONE("present");
+		result = vkQueuePresentKHR(PresentQueue, &presentInfo);
+		queueLock.unlock();
+	}
+	Pacer.endFrame(SwapChain);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || FramebufferResized) {
 		FramebufferResized = false;
@@ -1413,26 +1437,134 @@ void App::drawFrame() {
 	} else if (result != VK_SUCCESS) {
 		throw std::runtime_error("failed to present swap chain image!");
 	}
+}
+
+//drawFrame without a swap chain: the frame's own target is rendered and copied out instead of acquired and presented
+void App::drawOffscreenFrame() {
+	CurrentFrame = Pacer.beginFrame();
+	Profiler.beginFrame(CurrentFrame);
+	const uint32_t imageIndex = CurrentFrame;
+
+	updateUniformBuffer(CurrentFrame);
+	Textures.reclaim(Pacer.completed());
+	collectStreamedAssets();
+	collectPipelines();
+
+	const uint32_t slot = Readback.acquire();
 
-	CurrentFrame = (CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	VkCommandBuffer readbackCommands = ReadbackCommandBuffer[CurrentFrame];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(readbackCommands, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+	if (HostQueryReset) {
+		Profiler.begin(readbackCommands, CurrentFrame, ReadbackScope);
+	}
+	Readback.recordCopy(readbackCommands, SwapChainImages[imageIndex], slot);
+	if (HostQueryReset) {
+		Profiler.end(readbackCommands, CurrentFrame, ReadbackScope);
+	}
+	if (vkEndCommandBuffer(readbackCommands) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+
+	VkCommandBuffer commandBuffers[] = {CommandBuffer[CurrentFrame], Commands.acquire(imageIndex, CurrentFrame), readbackCommands};
+	const bool acquires = recordAcquireBarriers(CommandBuffer[CurrentFrame]);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+	VkSemaphore waitSemaphores[] = {Streamer.timeline()};
+	VkPipelineStageFlags waitStages[] = {PendingAcquireStages};
+	uint64_t waitValues[] = {PendingTimelineValue};
+	VkSemaphore signalSemaphores[] = {Pacer.timeline(), Readback.timeline()};
+	uint64_t signalValues[] = {Pacer.submitting(), Readback.signalValue(slot)};
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = PendingTimelineValue != 0 ? 1 : 0;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = timelineInfo.waitSemaphoreValueCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+
+	submitInfo.commandBufferCount = acquires ? 3 : 2;
+	submitInfo.pCommandBuffers = acquires ? commandBuffers : commandBuffers + 1;
+
+	submitInfo.signalSemaphoreCount = 2;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	{
+		PROFILE_ZONE("submit");
+		std::lock_guard<std::mutex> queueLock(QueueMutex);
+		if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+	}
+	Pacer.endFrame(VK_NULL_HANDLE);
+	Readback.submitted(slot);
+	PendingBufferAcquires.clear();
+	PendingImageAcquires.clear();
+	PendingAcquireStages = 0;
+	PendingTimelineValue = 0;
+
+	++FrameNumber;
+}
+
+void App::renderOffscreen() {
+	//frames before the scene is resident would all be black, wait the stream out first
+	while (sceneDrawCount(CurrentFrame) == 0) {
+		collectStreamedAssets();
+		collectPipelines();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	const std::clock_t cpuStart = std::clock();
+	for (uint32_t i = 0; i < HeadlessFrames; ++i) {
+		PROFILE_ZONE("frame");
+		drawOffscreenFrame();
+	}
+	{
+		std::lock_guard<std::mutex> lock(QueueMutex);
+		vkDeviceWaitIdle(SelectedDevice);
+	}
+	Readback.flush();
+	//process time covers every thread, the delivery thread and the driver's included
+	const double cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "headless: " << HeadlessFrames << " frames at " << SwapChainExtent.width << "x" << SwapChainExtent.height
+		<< " in " << seconds << " s (" << HeadlessFrames / seconds << " frames/s), " << cpuSeconds << " CPU s ("
+		<< (cpuSeconds > 0.0 ? HeadlessFrames / cpuSeconds : 0.0) << " frames per CPU second)" << std::endl;
 }
 
 
 void App::cleanUp() {
+	Streamer.shutdown();
+	if (Headless) {
+		ReadbackStats readbackStats = Readback.stats();
+		std::cout << "readback: " << readbackStats.frames << " frames, " << readbackStats.bytes / (1024 * 1024) << " MB, "
+			<< readbackStats.stalls << " stalls (" << readbackStats.stallMs << " ms), " << readbackStats.deliverMs
+			<< " ms delivering" << std::endl;
+		Readback.shutdown();
+	}
 	cleanupSwapChain();
 
 	vkDestroySampler(SelectedDevice, TextureSampler, nullptr);
 	vkDestroyImageView(SelectedDevice, TextureImageView, nullptr);
-	vkDestroyImage(SelectedDevice, TextureImage, nullptr);
-	vkFreeMemory(SelectedDevice, TextureImageMemory, nullptr);
+	Allocator.destroyImage(TextureImage, TextureImageMemory);
 
-	vkDestroyPipeline(SelectedDevice, GraphicsPipeline, nullptr);
+	//owns GraphicsPipeline
+	Compiler.shutdown();
 	vkDestroyPipelineLayout(SelectedDevice, PipelineLayout, nullptr);
 	vkDestroyRenderPass(SelectedDevice, RenderPass, nullptr);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyBuffer(SelectedDevice, UniformBuffers[i], nullptr);
-		vkFreeMemory(SelectedDevice, UniformBuffersMemory[i], nullptr);
+	for (size_t i = 0; i < FramesInFlight; i++) {
+		Allocator.destroyBuffer(UniformBuffers[i], UniformBuffersMemory[i]);
 	}
 
 	//You don't need to explicitly clean up descriptor sets, because they will be automatically freed when 
@@ -1440,19 +1572,71 @@ void App::cleanUp() {
 	vkDestroyDescriptorPool(SelectedDevice, DescriptorPool, nullptr);
 
 	vkDestroyDescriptorSetLayout(SelectedDevice, DescriptorSetLayout, nullptr);
-
-	vkDestroyBuffer(SelectedDevice, IndexBuffer, nullptr);
-	vkFreeMemory(SelectedDevice, IndexBufferMemory, nullptr);
-	vkDestroyBuffer(SelectedDevice, VertexBuffer, nullptr);
-	vkFreeMemory(SelectedDevice, VertexBufferMemory, nullptr);
-
-	for(size_t i = 0;i<MAX_FRAMES_IN_FLIGHT;++i) {
-		vkDestroySemaphore(SelectedDevice, ImageAvailableSemaphore[i], nullptr);
-		vkDestroySemaphore(SelectedDevice, RenderFinishedSemaphore[i], nullptr);
-		vkDestroyFence(SelectedDevice, InFlightFence[i], nullptr);
-	}
+	BindlessStats textureStats = Textures.stats();
+	std::cout << "textures: " << textureStats.peak << " of " << textureStats.capacity << " slots used at most, "
+		<< textureStats.adds << " added, " << textureStats.removes << " removed" << std::endl;
+	Textures.shutdown();
+
+	Allocator.destroyBuffer(IndexBuffer, IndexBufferMemory);
+	Allocator.destroyBuffer(VertexBuffer, VertexBufferMemory);
+
+	FramePacingStats pacingStats = Pacer.stats();
+	std::cout << "frame pacing: " << pacingStats.frames << " frames, " << pacingStats.waits << " waits on the GPU ("
+		<< pacingStats.waitMs << " ms), submit to " << (pacingStats.presentWait ? "present" : "GPU completion") << " latency "
+		<< pacingStats.latencyMeanMs << " ms mean, " << pacingStats.latencyP50Ms << " ms p50, " << pacingStats.latencyP99Ms
+		<< " ms p99, " << pacingStats.latencyMaxMs << " ms worst" << std::endl;
+	Pacer.shutdown();
 	
+	CommandCacheStats commandStats = Commands.stats();
+	std::cout << "command cache: " << commandStats.frames << " frames, " << commandStats.primariesRecorded
+		<< " primaries and " << commandStats.secondariesRecorded << " secondaries recorded" << std::endl;
+	Commands.shutdown();
 	vkDestroyCommandPool(SelectedDevice, CommandPool, nullptr);
+	for (const GpuScopeStats &scope : Profiler.stats()) {
+		std::cout << "gpu " << scope.name << ": " << scope.meanMs << " ms mean, " << scope.p50Ms << " ms p50, " << scope.p99Ms
+			<< " ms p99, " << scope.maxMs << " ms worst over the last " << std::min(scope.samples, uint64_t{GpuProfiler::WINDOW})
+			<< " of " << scope.samples << " frames";
+		if (scope.statistics) {
+			std::cout << ", last frame " << scope.pipeline.vertexInvocations << " vertex, " << scope.pipeline.fragmentInvocations
+				<< " fragment and " << scope.pipeline.computeInvocations << " compute invocations, "
+				<< scope.pipeline.clippedPrimitives << " of " << scope.pipeline.inputPrimitives << " primitives past clipping";
+		}
+		std::cout << std::endl;
+	}
+	Profiler.shutdown();
+	CullStats cullStats = Culler.stats();
+	if (cullStats.frames != 0) {
+		std::cout << "culling: " << cullStats.frames << " frames, " << cullStats.drawn / cullStats.frames << " of "
+			<< cullStats.instances / cullStats.frames << " instances drawn per frame on average, "
+			<< (cullStats.instances - cullStats.drawn) / cullStats.frames << " culled" << std::endl;
+	}
+	Culler.shutdown();
+	SceneStats sceneStats = World.stats();
+	if (sceneStats.culls != 0) {
+		std::cout << "scene: " << sceneStats.visible / sceneStats.culls << " of " << World.size() << " objects visible per frame on average, "
+			<< sceneStats.fullRebuilds << " full and " << sceneStats.subtreeRebuilds << " subtree rebuilds over "
+			<< sceneStats.updates << " updates" << std::endl;
+	}
+	World.shutdown();
+	PipelineCompilerStats compilerStats = Compiler.stats();
+	if (compilerStats.compiled != 0) {
+		std::cout << "pipeline compiles: " << compilerStats.requests << " requests, " << compilerStats.coalesced << " coalesced, "
+			<< compilerStats.compiled << " compiled, " << compilerStats.failed << " failed, "
+			<< compilerStats.latencyMs / static_cast<double>(compilerStats.compiled) << " ms from request to ready on average, "
+			<< compilerStats.maxLatencyMs << " ms worst" << std::endl;
+	}
+	ShaderCompilerStats shaderStats = Shaders.stats();
+	std::cout << "shaders: " << shaderStats.hits << " cache hits in " << shaderStats.hitMs << " ms, " << shaderStats.misses
+		<< " compiled in " << shaderStats.compileMs << " ms, " << shaderStats.failed << " failed" << std::endl;
+	Shaders.shutdown();
+	PipelineCacheStats pipelineStats = Pipelines.stats();
+	std::cout << "pipelines: " << pipelineStats.hits << " cache hits, " << pipelineStats.misses << " misses, "
+		<< pipelineStats.unreported << " unreported, " << pipelineStats.compileMs << " ms creating them" << std::endl;
+	if (!Pipelines.save()) {
+		std::cout << "unable to write pipeline cache " << PIPELINE_CACHE_PATH << std::endl;
+	}
+	Pipelines.shutdown();
+	Allocator.shutdown();
 	vkDestroyDevice(SelectedDevice, nullptr);
 
 	if (enableValidationLayers) {
@@ -1460,8 +1644,12 @@ void App::cleanUp() {
 	}
 	vkDestroySurfaceKHR(Instance, Surface, nullptr);
 	vkDestroyInstance(Instance, nullptr);
-	glfwDestroyWindow(Window);
-	glfwTerminate();
+	if (!Headless) {
+		glfwDestroyWindow(Window);
+		glfwTerminate();
+	}
+	//every thread that recorded zones has been joined by now
+	writeTrace();
 }
 
 
@@ -1486,9 +1674,12 @@ void App::setupDebugMessenger() {
 }
 
 void App::getRequiredExtensions(std::vector<const char*> &extensions) {
+	//nothing to present to, GLFW is never initialized
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = nullptr;
+	if (!Headless) {
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
 
 	printf("Extensions: %u\n", glfwExtensionCount);
 	for(uint32_t i = 0;i<glfwExtensionCount;++i) {
@@ -1496,7 +1687,18 @@ void App::getRequiredExtensions(std::vector<const char*> &extensions) {
 		extensions.push_back(glfwExtensions[i]);
 	}
 
-	if (enableValidationLayers) {
+	//also labels the GPU profiler's scopes for capture tools, so it's on whenever the loader has it
+	bool debugUtils = enableValidationLayers;
+	uint32_t extensionCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> available(extensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, available.data());
+	for (const auto &extension : available) {
+		if (strcmp(extension.extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0) {
+			debugUtils = true;
+		}
+	}
+	if (debugUtils) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	}
 }
@@ -1606,17 +1808,42 @@ void App::logFeatures(VkPhysicalDeviceFeatures &f) {
 bool App::isDeviceSuitable(const VkPhysicalDevice &device) {
 	QueueFamilyIndices indices = findQueueFamilies(device);
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = Headless;
+	if (extensionsSupported && !Headless) {
 		SwapChainSupportDetails swapChainSupport;
 		querySwapChainSupport(device, swapChainSupport);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
 
-	VkPhysicalDeviceFeatures supportedFeatures;
-	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+	VkPhysicalDeviceVulkan12Features vulkan12{};
+	vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &vulkan12;
+	vkGetPhysicalDeviceFeatures2(device, &supportedFeatures);
+
+	//asset streaming signals completion with a timeline semaphore, the textures are one descriptor indexed table
+	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.features.samplerAnisotropy
+		&& vulkan12.timelineSemaphore && BindlessTextures::supported(vulkan12);
+}
 
-	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+const std::vector<const char*> &App::requiredDeviceExtensions() const {
+	//headless never makes a swap chain, so a device without one (lavapipe built without WSI) still qualifies
+	static const std::vector<const char*> none;
+	return Headless ? none : deviceExtensions;
+}
+
+bool App::hasDeviceExtension(VkPhysicalDevice device, const char *name) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, name) == 0) {
+			return true;
+		}
+	}
+	return false;
 }
 
 bool App::checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -1625,7 +1852,8 @@ bool App::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	const std::vector<const char*> &extensions = requiredDeviceExtensions();
+	std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
 	for (const auto& extension : availableExtensions) {
 		requiredExtensions.erase(extension.extensionName);
@@ -1696,23 +1924,33 @@ QueueFamilyIndices App::findQueueFamilies(VkPhysicalDevice device) {
 
 	uint32_t i = 0;
 	for (const auto& queueFamily : queueFamilies) {
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+		if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
 			indices.graphicsFamily = i;
 		}
 
+		//headless runs never present, the graphics family stands in so the rest of setup needn't care
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, Surface, &presentSupport);
+		if (Headless) {
+			presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+		} else {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, Surface, &presentSupport);
+		}
 
-		if (presentSupport) {
+		if (presentSupport && !indices.presentFamily.has_value()) {
 			indices.presentFamily = i;
 		}
 
-		if (indices.isComplete()) {
-			break;
+		//a transfer only family is usually backed by the copy engines and runs beside graphics
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+				&& !indices.transferFamily.has_value()) {
+			indices.transferFamily = i;
 		}
 
 		++i;
 	}
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
 	return indices;
 }
 
@@ -1754,10 +1992,14 @@ VkSurfaceFormatKHR App::chooseSwapSurfaceFormat(const std::vector<VkSurfaceForma
 
 VkPresentModeKHR App::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
     for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        if (availablePresentMode == PresentMode) {
             return availablePresentMode;
         }
     }
+	//the only mode every surface has to support
+	if (PresentMode != VK_PRESENT_MODE_FIFO_KHR) {
+		std::cout << "present mode " << FramePacer::presentModeName(PresentMode) << " unsupported, using fifo" << std::endl;
+	}
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -1779,15 +2021,3 @@ VkExtent2D App::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 		return actualExtent;
 	}
 }
-
-VkShaderModule App::createShaderModule(const std::vector<char>& code) {
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(SelectedDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create shader module!");
-	}
-	return shaderModule;
-}
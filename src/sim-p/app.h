@@ -1,12 +1,30 @@
 #pragma once
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 #include <vector>
 #include <optional>
+#include <mutex>
+#include <string>
+#include "agents.h"
+#include "asset_streamer.h"
+#include "bindless_textures.h"
+#include "command_cache.h"
+#include "frame_pacer.h"
+#include "frame_readback.h"
+#include "gpu_profiler.h"
+#include "gpu_cull.h"
+#include "mesh_simplify.h"
+#include "pipeline_cache.h"
+#include "pipeline_compiler.h"
+#include "scene.h"
+#include "shader_compiler.h"
 
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	//a transfer only family when the device has one, the graphics family otherwise
+	std::optional<uint32_t> transferFamily;
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -21,9 +39,24 @@ struct SwapChainSupportDetails {
 
 class App {
 public:
-	static const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+	static const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
 public:
 	App();
+	// agents drawn as instances of the model, set before run()
+	void setAgents(uint32_t count);
+	// before run(): render frames at width x height offscreen, with no window, surface or present queue.
+	// Every frame is read back and handed to the frame callback, or written to outputDir as PPM when there is none
+	void setHeadless(uint32_t width, uint32_t height, uint32_t frames, const std::string &outputDir);
+	// called on the readback thread with each headless frame
+	void setFrameCallback(ReadbackCallback callback);
+	// before run(): fewer frames in flight and mailbox (or immediate) cut latency, more frames in flight raise throughput.
+	// A present mode the surface lacks falls back to FIFO
+	void setFramePacing(uint32_t framesInFlight, VkPresentModeKHR presentMode);
+	// before run(): the GPU profiler also counts vertices, primitives and shader invocations per scope,
+	// where the device supports pipeline statistics queries. Timings are always taken
+	void setPipelineStatistics(bool enabled);
+	// records CPU zones from here on and writes them to path as a Chrome trace on exit, or when F12 is pressed
+	void setTrace(const std::string &path);
 	void initVulkan();
 	void run();
 	void cleanUp();
@@ -44,93 +77,168 @@ protected:
 	void createLogicalDevice();
 	void createSurface();
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	bool hasDeviceExtension(VkPhysicalDevice device, const char *name);
 	void querySwapChainSupport(VkPhysicalDevice device, SwapChainSupportDetails &scsd);
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 	void createSwapChain();
+	void createOffscreenTargets();
 	void createImageViews();
+	void createPipelineCompiler();
 	void createGraphicsPipeline();
 	void createRenderPass();
-	VkShaderModule createShaderModule(const std::vector<char>& code);
 	void createFrameBuffers();
 	void createCommandBuffers();
 	void createCommandPool();
-	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void createCommandCache();
+	void updateCommandTargets();
+	size_t sceneDrawCount(uint32_t frameSlot) const;
+	void recordScene(VkCommandBuffer commandBuffer, size_t begin, size_t end, uint32_t frameSlot);
+	bool recordAcquireBarriers(VkCommandBuffer commandBuffer);
 	void drawFrame();
+	void drawOffscreenFrame();
+	void renderOffscreen();
+	void createReadback();
+	const std::vector<const char*> &requiredDeviceExtensions() const;
 	void createSyncObjects();
 	void recreateSwapChain();
 	void cleanupSwapChain();
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-	void createVertexBuffer();
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-	void createIndexBuffer();
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, DeviceAllocation& bufferMemory);
 	void createDescriptorSetLayout();
 	void createUniformBuffers();
+	void createInstanceBuffers();
+	void updateInstances(uint32_t frameSlot, float time, const glm::vec3 &eye, const glm::mat4 &viewProj);
 	void createDescriptorSets();
 	void createDescriptorPool();
 	void updateUniformBuffer(uint32_t currentFrame);
 	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling
-			, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-	void createTextureImage();
-	VkCommandBuffer beginSingleTimeCommands();
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+			, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, DeviceAllocation& imageMemory);
 	void createTextureImageView();
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 	void createTextureSampler();
 	void createDepthResources();
 	bool hasStencilComponent(VkFormat format);
 	VkFormat findDepthFormat();
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
-	void loadModel();
-	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void createStreamer();
+	void requestAssets();
+	void collectStreamedAssets();
+	void collectPipelines();
+	//run on loader threads, must not touch any App state
+	static void loadModel(AssetPayload &payload);
+	static void loadTexture(AssetPayload &payload);
 protected:
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	void writeTrace();
 private:
 	GLFWwindow* Window;
 	VkInstance Instance;
 	VkDebugUtilsMessengerEXT DebugMessenger;
 	VkPhysicalDevice PhysicalDevice;
 	VkDevice SelectedDevice;
+	//optional device features the indirect draws use when present
+	bool DrawIndirectCount;
+	bool MultiDrawIndirect;
 	VkQueue GraphicsQueue;
 	VkSurfaceKHR Surface;
 	VkQueue PresentQueue;
+	VkQueue TransferQueue;
+	std::mutex QueueMutex;
 	VkSwapchainKHR SwapChain;
 	std::vector<VkImage> SwapChainImages;
 	VkFormat SwapChainImageFormat;
 	VkExtent2D SwapChainExtent;
 	std::vector<VkImageView> SwapChainImageViews;
+	//headless runs render into offscreen images standing in for the swap chain's, one per frame in flight
+	bool Headless;
+	uint32_t HeadlessFrames;
+	std::string FrameOutputDir;
+	ReadbackCallback FrameCallback;
+	std::vector<DeviceAllocation> OffscreenMemory;
+	FrameReadback Readback;
+	std::vector<VkCommandBuffer> ReadbackCommandBuffer;
+	uint64_t FrameNumber;
 	VkPipelineLayout PipelineLayout;
 	VkRenderPass RenderPass;
 	VkPipeline GraphicsPipeline;
+	//both kept across runs so a restart doesn't compile every shader and pipeline again
+	ShaderCompiler Shaders;
+	PipelineCache Pipelines;
+	PipelineCompiler Compiler;
+	//GraphicsPipeline stays null until this one has compiled
+	PipelineHandle ScenePipeline;
 	std::vector<VkFramebuffer> SwapChainFramebuffers;
 	VkCommandPool CommandPool;
+	//one time commands recorded per frame, only the queue ownership acquires for now
 	std::vector<VkCommandBuffer> CommandBuffer;
-	std::vector<VkSemaphore> ImageAvailableSemaphore;
-	std::vector<VkSemaphore> RenderFinishedSemaphore;
-	std::vector<VkFence> InFlightFence;
+	CommandCache Commands;
+	uint32_t SceneLayer;
+	uint32_t FramesInFlight;
+	VkPresentModeKHR PresentMode;
+	//VK_KHR_present_id and VK_KHR_present_wait are enabled, presents are timed until they are on screen
+	bool PresentWait;
+	FramePacer Pacer;
 	uint32_t CurrentFrame;
+	//per scope GPU timings, only initialized when hostQueryReset is there to reset the cached primaries' queries
+	GpuProfiler Profiler;
+	bool HostQueryReset;
+	//requested by setPipelineStatistics, cleared when the device lacks pipelineStatisticsQuery
+	bool PipelineStatistics;
+	//statistics queries can span secondaries
+	bool InheritedQueries;
+	uint32_t ReadbackScope;
+	//empty unless CPU zones are being recorded
+	std::string TracePath;
 	bool FramebufferResized;
 	VkBuffer VertexBuffer;
-	VkDeviceMemory VertexBufferMemory;
+	DeviceAllocation VertexBufferMemory;
 	VkBuffer IndexBuffer;
-	VkDeviceMemory IndexBufferMemory;
+	DeviceAllocation IndexBufferMemory;
 	VkDescriptorSetLayout DescriptorSetLayout;
 	std::vector<VkBuffer> UniformBuffers;
-	std::vector<VkDeviceMemory> UniformBuffersMemory;
+	std::vector<DeviceAllocation> UniformBuffersMemory;
 	std::vector<void*> UniformBuffersMapped;
+	//owns the per frame slot instance buffers, only what survives its culling is drawn
+	GpuCuller Culler;
+	uint32_t AgentCount;
+	AgentField Agents;
+	//the agents as objects, culled on the CPU before their instances are written
+	Scene World;
+	uint32_t AgentMesh;
+	std::vector<uint32_t> Visible;
+	//camera distance and clip planes grow with the agent field
+	float ViewScale;
 	VkDescriptorPool DescriptorPool;
 	std::vector<VkDescriptorSet> DescriptorSets;
 	VkImage TextureImage;
-	VkDeviceMemory TextureImageMemory;
+	DeviceAllocation TextureImageMemory;
 	VkImageView TextureImageView;
 	VkSampler TextureSampler;
+	//every texture, bound once as set 1 and picked per instance by its material
+	BindlessTextures Textures;
+	uint32_t TextureSlot;
 	VkImage DepthImage;
-	VkDeviceMemory DepthImageMemory;
+	DeviceAllocation DepthImageMemory;
 	VkImageView DepthImageView;
 	uint32_t MipLevels;
+	VkIndexType IndexType;
+	glm::mat4 ModelDequantize;
+	glm::vec3 ModelCenter;
+	float ModelRadius;
+	//every level of detail of the model, ranges of the one index buffer
+	std::vector<MeshLod> ModelLods;
+	DeviceAllocator Allocator;
+	AssetStreamer Streamer;
+	uint64_t ModelRequest;
+	uint64_t TextureRequest;
+	bool ModelResident;
+	bool TextureResident;
+	//acquire half of the queue family ownership transfers, recorded into the next frame
+	std::vector<VkBufferMemoryBarrier> PendingBufferAcquires;
+	std::vector<VkImageMemoryBarrier> PendingImageAcquires;
+	VkPipelineStageFlags PendingAcquireStages;
+	uint64_t PendingTimelineValue;
 
 };
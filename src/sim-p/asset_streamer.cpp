@@ -0,0 +1,276 @@
+#include "asset_streamer.h"
+#include "cpu_profiler.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+AssetStreamer::AssetStreamer() : Device(VK_NULL_HANDLE), TransferQueue(VK_NULL_HANDLE), TransferFamily(0), GraphicsFamily(0)
+	, QueueMutex(nullptr), Allocator(nullptr), Batcher(), Loaders(), UploadThread(), Mutex(), Wake(), Queued()
+	, Completed(), NextId(1), Outstanding(0), Stopping(false) {
+
+}
+
+AssetStreamer::~AssetStreamer() {
+	shutdown();
+}
+
+void AssetStreamer::init(VkDevice device, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily, std::mutex *queueMutex
+		, DeviceAllocator *allocator, size_t loaderThreads, VkDeviceSize stagingSize) {
+	Device = device;
+	TransferQueue = transferQueue;
+	TransferFamily = transferFamily;
+	GraphicsFamily = graphicsFamily;
+	QueueMutex = queueMutex;
+	Allocator = allocator;
+
+	Batcher.init(Device, TransferQueue, TransferFamily, QueueMutex, Allocator, stagingSize);
+
+	Stopping = false;
+	Loaders = std::make_unique<ThreadPool>(loaderThreads);
+	UploadThread = std::thread(&AssetStreamer::uploadLoop, this);
+}
+
+void AssetStreamer::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	//loaders first so everything they produce is queued before the upload thread drains
+	Loaders.reset();
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	Wake.notify_all();
+	if (UploadThread.joinable()) {
+		UploadThread.join();
+	}
+	for (auto &asset : Completed) {
+		destroyAsset(asset);
+	}
+	Completed.clear();
+	Batcher.shutdown();
+	Device = VK_NULL_HANDLE;
+}
+
+uint64_t AssetStreamer::request(LoadJob job) {
+	const uint64_t id = NextId.fetch_add(1);
+	++Outstanding;
+	Loaders->submit([this, id, job = std::move(job)]() {
+		PROFILE_ZONE("asset load");
+		Loaded loaded{id, AssetPayload{}, false, std::string()};
+		try {
+			job(loaded.payload);
+		} catch (const std::exception &e) {
+			loaded.failed = true;
+			loaded.error = e.what();
+			loaded.payload = AssetPayload{};
+		}
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Queued.push_back(std::move(loaded));
+		}
+		Wake.notify_one();
+	});
+	return id;
+}
+
+void AssetStreamer::collect(std::vector<StreamedAsset> &ready) {
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(Device, Batcher.timeline(), &completedValue);
+	std::lock_guard<std::mutex> lock(Mutex);
+	for (auto it = Completed.begin(); it != Completed.end();) {
+		if (it->failed || it->timelineValue <= completedValue) {
+			ready.push_back(std::move(*it));
+			it = Completed.erase(it);
+			--Outstanding;
+		} else {
+			++it;
+		}
+	}
+}
+
+void AssetStreamer::uploadLoop() {
+	PROFILE_THREAD("upload");
+	for (;;) {
+		std::deque<Loaded> work;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			auto hasWork = [this]() { return Stopping || !Queued.empty(); };
+			if (!Batcher.busy()) {
+				Wake.wait(lock, hasWork);
+			} else {
+				//wake up now and then to recycle staging space of finished batches
+				Wake.wait_for(lock, std::chrono::milliseconds(2), hasWork);
+			}
+			work.swap(Queued);
+			if (Stopping && work.empty()) {
+				break;
+			}
+		}
+		Batcher.retire(false);
+		if (work.empty()) {
+			continue;
+		}
+
+		//everything that finished loading since the last round goes out in one submit
+		PROFILE_ZONE("asset upload");
+		std::vector<StreamedAsset> staged;
+		staged.reserve(work.size());
+		for (auto &loaded : work) {
+			staged.push_back(upload(loaded));
+		}
+		uint64_t timelineValue = 0;
+		std::string error;
+		try {
+			timelineValue = Batcher.flush();
+		} catch (const std::exception &e) {
+			error = e.what();
+		}
+		for (auto &asset : staged) {
+			if (!error.empty() && !asset.failed) {
+				destroyAsset(asset);
+				asset.failed = true;
+				asset.error = error;
+			}
+			asset.timelineValue = timelineValue;
+		}
+		std::lock_guard<std::mutex> lock(Mutex);
+		for (auto &asset : staged) {
+			Completed.push_back(std::move(asset));
+		}
+	}
+	Batcher.retire(true);
+}
+
+StreamedAsset AssetStreamer::upload(Loaded &loaded) {
+	StreamedAsset asset{};
+	asset.id = loaded.id;
+	asset.failed = loaded.failed;
+	asset.error = loaded.error;
+	asset.metadata = std::move(loaded.payload.metadata);
+	if (asset.failed) {
+		return asset;
+	}
+	//all device objects are created before anything is queued so a failure can't leave
+	//copies into destroyed resources sitting in the batch
+	try {
+		createResources(loaded.payload, asset);
+	} catch (const std::exception &e) {
+		std::cerr << "asset " << asset.id << " upload failed: " << e.what() << std::endl;
+		destroyAsset(asset);
+		asset.failed = true;
+		asset.error = e.what();
+		return asset;
+	}
+	recordUpload(loaded.payload, asset);
+	//the source bytes are staged, let the loader's memory go
+	loaded.payload.storage.reset();
+	return asset;
+}
+
+void AssetStreamer::createResources(const AssetPayload &payload, StreamedAsset &asset) {
+	for (const auto &b : payload.buffers) {
+		VkBuffer buffer;
+		DeviceAllocation memory;
+		Allocator->createBuffer(b.size, b.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+		asset.buffers.push_back(buffer);
+		asset.bufferMemory.push_back(memory);
+		asset.bufferSizes.push_back(b.size);
+	}
+	for (const auto &i : payload.images) {
+		VkImage image;
+		DeviceAllocation memory;
+		const uint32_t mipLevels = static_cast<uint32_t>(i.levels.size());
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = i.width;
+		imageInfo.extent.height = i.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = i.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		Allocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+		asset.images.push_back(image);
+		asset.imageMemory.push_back(memory);
+		asset.imageMipLevels.push_back(mipLevels);
+	}
+}
+
+void AssetStreamer::recordUpload(AssetPayload &payload, StreamedAsset &asset) {
+	const bool transfer = ownershipTransfer();
+	const uint32_t srcFamily = transfer ? TransferFamily : VK_QUEUE_FAMILY_IGNORED;
+	const uint32_t dstFamily = transfer ? GraphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+	//release (or, on a shared family, the regular visibility barrier); a dedicated
+	//transfer queue can't name graphics stages so the release goes to bottom of pipe
+
+	for (size_t n = 0; n < payload.buffers.size(); ++n) {
+		const BufferUpload &b = payload.buffers[n];
+		Batcher.copyToBuffer(b.data, b.size, asset.buffers[n], 0);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = transfer ? 0 : b.dstAccess;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.buffer = asset.buffers[n];
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		Batcher.barrier(barrier, transfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : b.dstStage);
+
+		if (transfer) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = b.dstAccess;
+			asset.bufferAcquires.push_back(barrier);
+		}
+		asset.acquireStages |= b.dstStage;
+	}
+
+	for (size_t n = 0; n < payload.images.size(); ++n) {
+		const ImageUpload &i = payload.images[n];
+		Batcher.copyToImage(i.data, asset.images[n], i.levels);
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.image = asset.images[n];
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = asset.imageMipLevels[n];
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = transfer ? 0 : VK_ACCESS_SHADER_READ_BIT;
+		Batcher.barrier(barrier, transfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+		if (transfer) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			asset.imageAcquires.push_back(barrier);
+		}
+		asset.acquireStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+}
+
+void AssetStreamer::destroyAsset(StreamedAsset &asset) {
+	for (size_t i = 0; i < asset.buffers.size(); ++i) {
+		Allocator->destroyBuffer(asset.buffers[i], asset.bufferMemory[i]);
+	}
+	for (size_t i = 0; i < asset.images.size(); ++i) {
+		Allocator->destroyImage(asset.images[i], asset.imageMemory[i]);
+	}
+	asset.buffers.clear();
+	asset.bufferMemory.clear();
+	asset.images.clear();
+	asset.imageMemory.clear();
+}
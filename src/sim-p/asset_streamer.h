@@ -0,0 +1,122 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "device_allocator.h"
+#include "mip_chain.h"
+#include "thread_pool.h"
+#include "upload_batcher.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BufferUpload {
+	const void *data;
+	VkDeviceSize size;
+	VkBufferUsageFlags usage; // TRANSFER_DST is added by the streamer
+	VkPipelineStageFlags dstStage; // first stage on the graphics queue that reads it
+	VkAccessFlags dstAccess;
+};
+
+struct ImageUpload {
+	const void *data;
+	VkDeviceSize size;
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	std::vector<MipLevel> levels; // offsets relative to data
+};
+
+// Filled in by a load job on a loader thread. The data pointers only have to
+// stay valid until the bytes are staged, storage owns whatever backs them and
+// is released as soon as that happens. metadata is handed back untouched with
+// the StreamedAsset.
+struct AssetPayload {
+	std::vector<BufferUpload> buffers;
+	std::vector<ImageUpload> images;
+	std::shared_ptr<void> storage;
+	std::shared_ptr<void> metadata;
+};
+
+// An upload that finished on the transfer queue. Ownership of the Vulkan
+// objects passes to whoever collects it. If the transfer queue is a different
+// family the acquire half of the ownership transfer must be recorded on the
+// graphics queue, in a submit that waits on the streamer's timeline semaphore
+// for timelineValue, before the resources are used.
+struct StreamedAsset {
+	uint64_t id;
+	bool failed;
+	std::string error;
+	uint64_t timelineValue;
+	std::vector<VkBuffer> buffers;
+	std::vector<DeviceAllocation> bufferMemory;
+	std::vector<VkImage> images;
+	std::vector<DeviceAllocation> imageMemory;
+	std::vector<VkDeviceSize> bufferSizes;
+	std::vector<uint32_t> imageMipLevels;
+	std::vector<VkBufferMemoryBarrier> bufferAcquires;
+	std::vector<VkImageMemoryBarrier> imageAcquires;
+	VkPipelineStageFlags acquireStages;
+	std::shared_ptr<void> metadata;
+};
+
+// Streams assets in without blocking the render loop: load jobs (disk reads,
+// decoding) run on a small thread pool, a dedicated upload thread stages the
+// results through an UploadBatcher and submits everything that arrived since
+// the last round as one batch on the transfer queue, signalling a timeline
+// semaphore the render loop polls.
+class AssetStreamer {
+public:
+	using LoadJob = std::function<void(AssetPayload &payload)>;
+public:
+	AssetStreamer();
+	~AssetStreamer();
+	// every submit to transferQueue is made under queueMutex, the render loop holds it
+	// around its own submits when the queues are shared and around device idle waits
+	void init(VkDevice device, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily, std::mutex *queueMutex
+			, DeviceAllocator *allocator, size_t loaderThreads, VkDeviceSize stagingSize);
+	// waits for outstanding work and destroys anything that was never collected
+	void shutdown();
+	// job runs on a loader thread, any exception it throws marks the asset failed
+	uint64_t request(LoadJob job);
+	// moves every asset whose upload has completed into ready
+	void collect(std::vector<StreamedAsset> &ready);
+	VkSemaphore timeline() const { return Batcher.timeline(); }
+	size_t outstanding() const { return Outstanding.load(); }
+	bool ownershipTransfer() const { return TransferFamily != GraphicsFamily; }
+	UploadStats stats() const { return Batcher.stats(); }
+private:
+	struct Loaded {
+		uint64_t id;
+		AssetPayload payload;
+		bool failed;
+		std::string error;
+	};
+	void uploadLoop();
+	StreamedAsset upload(Loaded &loaded);
+	void createResources(const AssetPayload &payload, StreamedAsset &asset);
+	void recordUpload(AssetPayload &payload, StreamedAsset &asset);
+	void destroyAsset(StreamedAsset &asset);
+private:
+	VkDevice Device;
+	VkQueue TransferQueue;
+	uint32_t TransferFamily;
+	uint32_t GraphicsFamily;
+	std::mutex *QueueMutex;
+	DeviceAllocator *Allocator;
+	UploadBatcher Batcher;
+	std::unique_ptr<ThreadPool> Loaders;
+	std::thread UploadThread;
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::deque<Loaded> Queued;
+	std::vector<StreamedAsset> Completed;
+	std::atomic<uint64_t> NextId;
+	std::atomic<size_t> Outstanding;
+	bool Stopping;
+};
@@ -0,0 +1,25 @@
+#include "bench.h"
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+	CLI::App app{"sim-p micro benchmarks"};
+	app.require_subcommand(1);
+	registerDedupBench(app);
+	registerObjBench(app);
+	registerMeshBench(app);
+	registerRecordBench(app);
+	registerCullBench(app);
+	registerSceneBench(app);
+	registerReadBench(app);
+	registerInstanceBench(app);
+	registerProfilerBench(app);
+	registerBindlessBench(app);
+	try {
+		CLI11_PARSE(app, argc, argv);
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
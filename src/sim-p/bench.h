@@ -0,0 +1,25 @@
+#pragma once
+#include <CLI/CLI.hpp>
+#include <chrono>
+
+// Each benchmark registers itself as a sub command of sim-bench.
+void registerDedupBench(CLI::App &app);
+void registerObjBench(CLI::App &app);
+void registerMeshBench(CLI::App &app);
+void registerRecordBench(CLI::App &app);
+void registerCullBench(CLI::App &app);
+void registerSceneBench(CLI::App &app);
+void registerReadBench(CLI::App &app);
+void registerInstanceBench(CLI::App &app);
+void registerProfilerBench(CLI::App &app);
+void registerBindlessBench(CLI::App &app);
+
+class BenchTimer {
+public:
+	BenchTimer() : Start(std::chrono::steady_clock::now()) {}
+	double elapsedMs() const {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+	}
+private:
+	std::chrono::steady_clock::time_point Start;
+};
@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "bindless_slots.h"
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	// what the test expects each slot to be, checked against what BindlessSlots hands out
+	class SlotModel {
+	public:
+		explicit SlotModel(uint32_t capacity) : States(capacity, FREE), Retired(), Live(0), Failures(0) {}
+		uint32_t live() const { return Live; }
+		uint32_t failures() const { return Failures; }
+		uint32_t freeCount() const {
+			const size_t used = Live + Retired.size();
+			return used >= States.size() ? 0 : static_cast<uint32_t>(States.size() - used);
+		}
+
+		void fail(const std::string &what) {
+			if (Failures++ < 10) {
+				printf("  FAILED: %s\n", what.c_str());
+			}
+		}
+
+		// acquire() has to throw exactly when nothing is free, and hand out only free slots
+		bool acquire(BindlessSlots &slots, uint32_t &slot) {
+			const bool expectThrow = freeCount() == 0;
+			try {
+				slot = slots.acquire();
+			} catch (const std::runtime_error &) {
+				if (!expectThrow) {
+					fail("acquire threw with " + std::to_string(freeCount()) + " slots free");
+				}
+				return false;
+			}
+			if (expectThrow) {
+				fail("acquire handed out slot " + std::to_string(slot) + " with every slot in use or retiring");
+			}
+			if (slot >= States.size()) {
+				fail("acquire handed out slot " + std::to_string(slot) + " past the capacity");
+				return false;
+			}
+			if (States[slot] != FREE) {
+				fail(std::string("slot ") + std::to_string(slot) + (States[slot] == LIVE ? " handed out twice" : " handed out while retiring"));
+			}
+			States[slot] = LIVE;
+			++Live;
+			return true;
+		}
+
+		void release(BindlessSlots &slots, uint32_t slot, uint64_t value) {
+			slots.release(slot, value);
+			States[slot] = RETIRING;
+			Retired.push_back({slot, value});
+			--Live;
+		}
+
+		// only slots retired at or before completed come back, and the ones retired first come back first
+		void reclaim(BindlessSlots &slots, uint64_t completed) {
+			slots.reclaim(completed);
+			while (!Retired.empty() && Retired.front().value <= completed) {
+				States[Retired.front().slot] = FREE;
+				Retired.pop_front();
+			}
+			if (slots.retiring() != Retired.size()) {
+				fail(std::to_string(slots.retiring()) + " slots still retiring at " + std::to_string(completed) + ", expected "
+						+ std::to_string(Retired.size()));
+			}
+		}
+	private:
+		enum State : uint8_t { FREE, LIVE, RETIRING };
+		struct Retire {
+			uint32_t slot;
+			uint64_t value;
+		};
+		std::vector<State> States;
+		std::deque<Retire> Retired;
+		uint32_t Live;
+		uint32_t Failures;
+	};
+
+	// fills the table, one more is refused, then slots retired at increasing values come back one value at a time
+	void checkRetireOrder(uint32_t capacity, SlotModel &model) {
+		BindlessSlots slots;
+		slots.init(capacity);
+		std::vector<uint32_t> held;
+		uint32_t slot = 0;
+		while (model.acquire(slots, slot)) {
+			held.push_back(slot);
+		}
+		if (held.size() != capacity) {
+			model.fail("filled " + std::to_string(held.size()) + " of " + std::to_string(capacity) + " slots");
+		}
+		//three to a value, half of them, oldest values first
+		for (size_t i = 0; i < held.size() / 2; ++i) {
+			model.release(slots, held[i], 10 + i / 3);
+		}
+		for (uint64_t completed = 9; completed < 12 + held.size() / 6; ++completed) {
+			model.reclaim(slots, completed);
+			//everything reclaimed is handed out again, and nothing more
+			while (model.acquire(slots, slot)) {
+			}
+		}
+		if (slots.stats().resident != model.live() || slots.stats().peak != capacity) {
+			model.fail("stats say " + std::to_string(slots.stats().resident) + " resident and a peak of "
+					+ std::to_string(slots.stats().peak));
+		}
+	}
+
+	// frames in flight adding and removing textures at random, the timeline lagging behind by up to lag frames
+	double checkChurn(uint32_t capacity, uint32_t frames, uint32_t lag, uint32_t seed, SlotModel &model, uint64_t &ops) {
+		BindlessSlots slots;
+		slots.init(capacity);
+		std::mt19937 rng(seed);
+		std::vector<uint32_t> held;
+		ops = 0;
+		BenchTimer timer;
+		for (uint32_t frame = 1; frame <= frames; ++frame) {
+			const uint64_t completed = frame > lag ? frame - lag : 0;
+			model.reclaim(slots, completed);
+			//now and then more than fits, so the exhaustion path is taken as well
+			const uint32_t adds = std::uniform_int_distribution<uint32_t>(0, capacity / 8 + 1)(rng);
+			for (uint32_t i = 0; i < adds; ++i, ++ops) {
+				uint32_t slot = 0;
+				if (!model.acquire(slots, slot)) {
+					break;
+				}
+				held.push_back(slot);
+			}
+			const uint32_t removes = std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(held.size()) / 4)(rng);
+			for (uint32_t i = 0; i < removes; ++i, ++ops) {
+				const size_t pick = std::uniform_int_distribution<size_t>(0, held.size() - 1)(rng);
+				model.release(slots, held[pick], frame);
+				held[pick] = held.back();
+				held.pop_back();
+			}
+		}
+		return timer.elapsedMs();
+	}
+}
+
+void registerBindlessBench(CLI::App &app) {
+	struct Options {
+		uint32_t capacity = 4096;
+		uint32_t frames = 20000;
+		uint32_t lag = 3;
+		uint32_t seed = 1;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("bindless", "checks the bindless texture slot bookkeeping without a device: retire order, reuse and exhaustion");
+	cmd->add_option("--capacity", opts->capacity, "slots in the table");
+	cmd->add_option("--frames", opts->frames, "frames of random adds and removes");
+	cmd->add_option("--lag", opts->lag, "frames the completed timeline value trails the current one");
+	cmd->add_option("--seed", opts->seed, "for the random adds and removes");
+	cmd->callback([opts]() {
+		SlotModel ordered(opts->capacity);
+		checkRetireOrder(opts->capacity, ordered);
+		printf("retire order: %s\n", ordered.failures() == 0 ? "ok" : "FAILED");
+
+		SlotModel churn(opts->capacity);
+		uint64_t ops = 0;
+		const double ms = checkChurn(opts->capacity, opts->frames, opts->lag, opts->seed, churn, ops);
+		printf("churn: %s, %llu adds and removes over %u frames, %u live at the end, %.1f ns per operation (model included)\n"
+				, churn.failures() == 0 ? "ok" : "FAILED", static_cast<unsigned long long>(ops), opts->frames, churn.live()
+				, ops ? ms * 1e6 / static_cast<double>(ops) : 0.0);
+		if (ordered.failures() != 0 || churn.failures() != 0) {
+			throw std::runtime_error("failed to check the bindless slots!");
+		}
+	});
+}
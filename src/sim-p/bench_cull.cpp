@@ -0,0 +1,240 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "agents.h"
+#include "bench.h"
+#include "device_allocator.h"
+#include "frustum.h"
+#include "gpu_cull.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	const float AGENT_SPACING = 2.0f;
+	const float MESH_RADIUS = 0.5f;
+	const float FOV_Y = glm::radians(45.0f);
+	const float ASPECT = 4.0f / 3.0f;
+
+	// a queue that can run compute and nothing else set up, on a CPU implementation such as lavapipe when asked
+	class HeadlessCompute {
+	public:
+		explicit HeadlessCompute(bool preferCpu);
+		~HeadlessCompute();
+		// records into a fresh command buffer, submits and waits, returns the time that took in ms
+		double run(const std::function<void(VkCommandBuffer)> &record);
+		VkDevice device() const { return Device; }
+		DeviceAllocator &allocator() { return Allocator; }
+	private:
+		VkInstance Instance = VK_NULL_HANDLE;
+		VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;
+		VkDevice Device = VK_NULL_HANDLE;
+		VkQueue Queue = VK_NULL_HANDLE;
+		uint32_t QueueFamily = 0;
+		DeviceAllocator Allocator;
+		VkCommandPool CommandPool = VK_NULL_HANDLE;
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkFence Fence = VK_NULL_HANDLE;
+	};
+
+	HeadlessCompute::HeadlessCompute(bool preferCpu) {
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "sim-bench";
+		appInfo.apiVersion = VK_API_VERSION_1_2;
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+		if (vkCreateInstance(&createInfo, nullptr, &Instance) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create instance!");
+		}
+
+		uint32_t deviceCount = 0;
+		vkEnumeratePhysicalDevices(Instance, &deviceCount, nullptr);
+		std::vector<VkPhysicalDevice> devices(deviceCount);
+		vkEnumeratePhysicalDevices(Instance, &deviceCount, devices.data());
+		//the culler barriers against the draw stages, so the queue has to do graphics as well
+		for (VkPhysicalDevice device : devices) {
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(device, &properties);
+			const bool cpu = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+			if (PhysicalDevice != VK_NULL_HANDLE && cpu != preferCpu) {
+				continue;
+			}
+			uint32_t familyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> families(familyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+			for (uint32_t i = 0; i < familyCount; ++i) {
+				if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && (families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+					PhysicalDevice = device;
+					QueueFamily = i;
+					break;
+				}
+			}
+			if (PhysicalDevice == device && cpu == preferCpu) {
+				break;
+			}
+		}
+		if (PhysicalDevice == VK_NULL_HANDLE) {
+			throw std::runtime_error("failed to find a device with a graphics and compute queue!");
+		}
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &properties);
+		printf("culling on %s\n", properties.deviceName);
+
+		const float priority = 1.0f;
+		VkDeviceQueueCreateInfo queueInfo{};
+		queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo.queueFamilyIndex = QueueFamily;
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = &priority;
+		VkDeviceCreateInfo deviceInfo{};
+		deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.queueCreateInfoCount = 1;
+		deviceInfo.pQueueCreateInfos = &queueInfo;
+		if (vkCreateDevice(PhysicalDevice, &deviceInfo, nullptr, &Device) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create logical device!");
+		}
+		vkGetDeviceQueue(Device, QueueFamily, 0, &Queue);
+		Allocator.init(PhysicalDevice, Device);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = QueueFamily;
+		if (vkCreateCommandPool(Device, &poolInfo, nullptr, &CommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = CommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(Device, &allocInfo, &CommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(Device, &fenceInfo, nullptr, &Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create fence!");
+		}
+	}
+
+	HeadlessCompute::~HeadlessCompute() {
+		vkDestroyFence(Device, Fence, nullptr);
+		vkDestroyCommandPool(Device, CommandPool, nullptr);
+		Allocator.shutdown();
+		vkDestroyDevice(Device, nullptr);
+		vkDestroyInstance(Instance, nullptr);
+	}
+
+	double HeadlessCompute::run(const std::function<void(VkCommandBuffer)> &record) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(CommandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		record(CommandBuffer);
+		if (vkEndCommandBuffer(CommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &CommandBuffer;
+		BenchTimer timer;
+		if (vkQueueSubmit(Queue, 1, &submitInfo, Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit command buffer!");
+		}
+		vkWaitForFences(Device, 1, &Fence, VK_TRUE, UINT64_MAX);
+		const double ms = timer.elapsedMs();
+		vkResetFences(Device, 1, &Fence);
+		return ms;
+	}
+
+	// the renderer's camera, looking at the field from above one corner
+	Frustum fieldFrustum(const AgentField &field) {
+		const float viewScale = field.radius() / AGENT_SPACING;
+		const glm::vec3 eye = glm::vec3(2.0f, 2.0f, 2.0f) * viewScale;
+		glm::mat4 proj = glm::perspective(FOV_Y, ASPECT, 0.1f * viewScale, 10.0f * viewScale);
+		proj[1][1] *= -1;
+		return Frustum::fromViewProj(proj * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+	}
+}
+
+void registerCullBench(CLI::App &app) {
+	struct Options {
+		std::vector<uint32_t> agents = {10000, 100000, 1000000};
+		uint32_t iterations = 10;
+		std::string shaders = "shaders";
+		std::string shaderCache = "shader.cache";
+		bool cpu = false;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("cull", "GPU frustum culling of agent instances, checked against the CPU");
+	cmd->add_option("--agents", opts->agents, "agent counts");
+	cmd->add_option("--iterations", opts->iterations, "culls per agent count, the best is reported");
+	cmd->add_option("--shaders", opts->shaders, "directory holding cull.comp");
+	cmd->add_option("--shader-cache", opts->shaderCache, "compiled shaders, shared with sim-p");
+	cmd->add_flag("--cpu", opts->cpu, "prefer a CPU Vulkan implementation, e.g. lavapipe");
+	cmd->callback([opts]() {
+		HeadlessCompute headless(opts->cpu);
+		ShaderCompiler shaders;
+		shaders.init(opts->shaderCache);
+		std::vector<uint32_t> shaderCode;
+		std::string error;
+		if (!shaders.compile(opts->shaders + "/cull.comp", GpuCuller::shaderDefines(), shaderCode, error)) {
+			throw std::runtime_error("failed to compile " + opts->shaders + "/cull.comp: " + error);
+		}
+		//a single level, every agent lands in one batch
+		const std::vector<MeshLod> lods = {{0, 36, 0.0f}};
+		const glm::vec4 meshSphere(0.0f, 0.0f, 0.0f, MESH_RADIUS);
+		uint32_t mismatches = 0;
+		for (uint32_t agents : opts->agents) {
+			//no scene culling, the GPU sees every agent
+			Scene scene;
+			scene.init(1);
+			AgentField field;
+			field.init(agents, AGENT_SPACING, scene, scene.addMesh(meshSphere));
+			std::vector<uint32_t> all(agents);
+			std::iota(all.begin(), all.end(), 0u);
+			const Frustum frustum = fieldFrustum(field);
+			const LodView view{glm::vec3(0.0f), FOV_Y, 768.0f, 1.0f};
+			GpuCuller culler;
+			culler.init(headless.device(), &headless.allocator(), nullptr, 1, agents, shaderCode, false, false);
+			std::vector<InstanceBatch> batches;
+			double best = 0.0;
+			for (uint32_t i = 0; i < opts->iterations; ++i) {
+				field.animate(static_cast<float>(i) * 0.1f, scene);
+				field.writeInstances(scene, all, glm::vec3(0.0f), lods, view, culler.instances(0), batches);
+				culler.update(0, frustum, meshSphere, agents, lods, batches);
+				const double ms = headless.run([&culler](VkCommandBuffer commandBuffer) { culler.recordCull(commandBuffer, 0); });
+				best = (i == 0 || ms < best) ? ms : best;
+			}
+			//tallies the last cull
+			culler.update(0, frustum, meshSphere, 0, lods, {});
+			const CullStats stats = culler.stats();
+
+			uint32_t expected = 0;
+			const InstanceTransform *instances = culler.instances(0);
+			for (uint32_t i = 0; i < agents; ++i) {
+				expected += frustum.intersectsSphere(glm::vec3(instances[i].positionScale), MESH_RADIUS) ? 1u : 0u;
+			}
+			printf("%8u agents %8u drawn %8u culled  cpu %8u drawn%s  %8.3f ms %8.1f instances/us\n", agents, stats.lastDrawn
+					, agents - stats.lastDrawn, expected, expected == stats.lastDrawn ? "" : " (mismatch)", best
+					, static_cast<double>(agents) / (best * 1000.0));
+			mismatches += expected == stats.lastDrawn ? 0u : 1u;
+			culler.shutdown();
+		}
+		//the only check the GPU cull draws what the CPU says is visible
+		if (mismatches != 0) {
+			throw std::runtime_error("failed GPU cull check, " + std::to_string(mismatches) + " agent counts drew other than the CPU reference!");
+		}
+	});
+}
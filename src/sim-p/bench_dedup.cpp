@@ -0,0 +1,112 @@
+#define GLM_ENABLE_EXPERIMENTAL
+#include "bench.h"
+#include "mesh_dedup.h"
+#include "obj_loader.h"
+#include <glm/gtx/hash.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <memory>
+#include <unordered_map>
+
+namespace {
+	// the hash and loop loadModel used before the parallel deduplicator, kept as the reference
+	struct LegacyVertexHash {
+		size_t operator()(Vertex const& vertex) const {
+			return ((std::hash<glm::vec3>()(vertex.pos) ^
+				(std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+				(std::hash<glm::vec2>()(vertex.texCoord) << 1);
+		}
+	};
+
+	void legacyDedup(const std::vector<Vertex> &stream, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+		std::unordered_map<Vertex, uint32_t, LegacyVertexHash> uniqueVertices{};
+		for (const auto &vertex : stream) {
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+			}
+			indices.push_back(uniqueVertices[vertex]);
+		}
+	}
+
+	// a displaced grid, every interior corner is shared by six triangles
+	void syntheticStream(size_t triangles, std::vector<Vertex> &stream) {
+		const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(triangles) / 2.0)));
+		const float inv = 1.0f / static_cast<float>(side);
+		auto corner = [&](size_t x, size_t y) {
+			Vertex v{};
+			const float fx = static_cast<float>(x) * inv;
+			const float fy = static_cast<float>(y) * inv;
+			v.pos = {fx, fy, 0.05f * std::sin(fx * 40.0f) * std::cos(fy * 40.0f)};
+			v.color = {1.0f, 1.0f, 1.0f};
+			v.texCoord = {fx, 1.0f - fy};
+			return v;
+		};
+		stream.clear();
+		stream.reserve(side * side * 6);
+		for (size_t y = 0; y < side; ++y) {
+			for (size_t x = 0; x < side; ++x) {
+				stream.push_back(corner(x, y));
+				stream.push_back(corner(x + 1, y));
+				stream.push_back(corner(x + 1, y + 1));
+				stream.push_back(corner(x + 1, y + 1));
+				stream.push_back(corner(x, y + 1));
+				stream.push_back(corner(x, y));
+			}
+		}
+	}
+
+	void run(const char *name, const std::vector<Vertex> &stream, int iterations) {
+		std::vector<Vertex> refVertices, vertices;
+		std::vector<uint32_t> refIndices, indices;
+		double legacyMs = 1e30, parallelMs = 1e30;
+		for (int i = 0; i < iterations; ++i) {
+			refVertices.clear();
+			refIndices.clear();
+			BenchTimer t;
+			legacyDedup(stream, refVertices, refIndices);
+			legacyMs = std::min(legacyMs, t.elapsedMs());
+		}
+		for (int i = 0; i < iterations; ++i) {
+			vertices.clear();
+			indices.clear();
+			BenchTimer t;
+			dedupVertices(stream.data(), stream.size(), vertices, indices);
+			parallelMs = std::min(parallelMs, t.elapsedMs());
+		}
+		const bool identical = vertices == refVertices && indices == refIndices;
+		printf("%s: %zu corners -> %zu vertices\n", name, stream.size(), vertices.size());
+		printf("  legacy   %10.2f ms\n", legacyMs);
+		printf("  parallel %10.2f ms (%.2fx)\n", parallelMs, legacyMs / parallelMs);
+		printf("  output   %s\n", identical ? "identical" : "MISMATCH");
+		if (!identical) {
+			throw std::runtime_error("parallel dedup output differs from the reference path!");
+		}
+	}
+}
+
+void registerDedupBench(CLI::App &app) {
+	struct Options {
+		std::string obj = "models/viking_room.obj";
+		size_t triangles = 10000000;
+		int iterations = 3;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("dedup", "vertex deduplication, legacy unordered_map vs parallel open addressing");
+	cmd->add_option("--obj", opts->obj, "OBJ file to deduplicate");
+	cmd->add_option("--triangles", opts->triangles, "triangle count of the synthetic mesh");
+	cmd->add_option("--iterations", opts->iterations, "best of N runs");
+	cmd->callback([opts]() {
+		std::vector<Vertex> stream;
+		std::string err;
+		if (!loadObjVertexStream(opts->obj, stream, err)) {
+			throw std::runtime_error(err);
+		}
+		run(opts->obj.c_str(), stream, opts->iterations);
+
+		syntheticStream(opts->triangles, stream);
+		run("synthetic grid", stream, opts->iterations);
+	});
+}
@@ -0,0 +1,116 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "agents.h"
+#include "bench.h"
+#include "frustum.h"
+#include "parallel.h"
+#include "scene.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	const float AGENT_SPACING = 2.0f;
+	const float FOV_Y = glm::radians(45.0f);
+	const float ASPECT = 1024.0f / 768.0f;
+	const float VIEWPORT_HEIGHT = 768.0f;
+	const float MESH_RADIUS = 0.5f;
+	//a frame at 60 Hz, the whole per object path has to fit well inside it
+	const double TARGET_MS = 1000.0 / 60.0;
+	//made up levels coarsening with distance, so the counting sort into runs has work to do
+	const std::vector<MeshLod> LODS = {{0, 3000, 0.0f}, {3000, 1500, 0.4f}, {4500, 600, 0.75f}, {5100, 150, 1.1f}};
+
+	// the renderer's camera, from above one corner of the field, far enough out to see all of it
+	void fieldView(const AgentField &field, Frustum &frustum, LodView &view) {
+		const float viewScale = field.radius() / AGENT_SPACING;
+		const glm::vec3 eye = glm::vec3(2.0f, 2.0f, 2.0f) * viewScale;
+		glm::mat4 proj = glm::perspective(FOV_Y, ASPECT, 0.1f * viewScale, 10.0f * viewScale);
+		proj[1][1] *= -1;
+		frustum = Frustum::fromViewProj(proj * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		view = {eye, FOV_Y, VIEWPORT_HEIGHT, 1.0f};
+	}
+}
+
+void registerInstanceBench(CLI::App &app) {
+	struct Options {
+		std::vector<uint32_t> objects = {50000, 200000};
+		uint32_t maxThreads = workerCount();
+		uint32_t frames = 60;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("instances", "per object transforms: move, refit and cull, then write the instance buffer, scaling over threads");
+	cmd->add_option("--objects", opts->objects, "independently moving object counts");
+	cmd->add_option("--threads", opts->maxThreads, "most threads to try");
+	cmd->add_option("--frames", opts->frames, "frames per configuration, the mean and worst are reported");
+	cmd->callback([opts]() {
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t t = 1; t < opts->maxThreads; t *= 2) {
+			threadCounts.push_back(t);
+		}
+		threadCounts.push_back(opts->maxThreads);
+		uint32_t mismatches = 0;
+
+		for (uint32_t objects : opts->objects) {
+			printf("%u objects, %zu bytes each, target %.2f ms per frame\n", objects, sizeof(InstanceTransform), TARGET_MS);
+			//what a single thread wrote on the last frame, every other thread count has to match it byte for byte
+			std::vector<InstanceTransform> reference;
+			double singleFrame = 0.0;
+			for (uint32_t threads : threadCounts) {
+				Scene scene;
+				scene.init(threads);
+				AgentField field;
+				field.init(objects, AGENT_SPACING, scene, scene.addMesh(glm::vec4(0.0f, 0.0f, 0.0f, MESH_RADIUS)));
+				scene.build();
+				Frustum frustum;
+				LodView view;
+				fieldView(field, frustum, view);
+				//stands in for the persistently mapped instance buffer
+				std::vector<InstanceTransform> instances(objects);
+				std::vector<uint32_t> visible;
+				std::vector<InstanceBatch> batches;
+
+				double animate = 0.0, update = 0.0, write = 0.0, worst = 0.0;
+				for (uint32_t frame = 0; frame < opts->frames; ++frame) {
+					const float time = static_cast<float>(frame) / 60.0f;
+					BenchTimer animateTimer;
+					field.animate(time, scene);
+					const double animateMs = animateTimer.elapsedMs();
+					BenchTimer updateTimer;
+					scene.update();
+					scene.cull(frustum, visible);
+					const double updateMs = updateTimer.elapsedMs();
+					BenchTimer writeTimer;
+					field.writeInstances(scene, visible, glm::vec3(0.0f), LODS, view, instances.data(), batches);
+					const double writeMs = writeTimer.elapsedMs();
+					animate += animateMs;
+					update += updateMs;
+					write += writeMs;
+					worst = std::max(worst, animateMs + updateMs + writeMs);
+				}
+				const double frames = static_cast<double>(opts->frames);
+				const double frameMs = (animate + update + write) / frames;
+				if (threads == 1) {
+					singleFrame = frameMs;
+					reference.assign(instances.begin(), instances.begin() + static_cast<std::ptrdiff_t>(visible.size()));
+				}
+				const bool match = reference.size() == visible.size()
+					&& memcmp(reference.data(), instances.data(), reference.size() * sizeof(InstanceTransform)) == 0;
+				mismatches += match ? 0u : 1u;
+				printf("  %3u threads move %7.3f ms refit+cull %7.3f ms write %7.3f ms  frame %7.3f ms x%.2f worst %7.3f ms%s"
+						"  %8zu visible in %zu runs %6.1f MB/s written%s\n"
+						, threads, animate / frames, update / frames, write / frames, frameMs, singleFrame / frameMs, worst
+						, worst <= TARGET_MS ? "" : " (over)", visible.size(), batches.size()
+						, static_cast<double>(visible.size() * sizeof(InstanceTransform)) / (write / frames * 1000.0)
+						, match ? "" : " (mismatch)");
+				scene.shutdown();
+			}
+		}
+		if (mismatches != 0) {
+			throw std::runtime_error("failed instance check, " + std::to_string(mismatches) + " thread counts wrote other than a single thread!");
+		}
+	});
+}
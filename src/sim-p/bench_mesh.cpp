@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "obj_reader.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+namespace {
+	void report(const char *stage, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, double ms) {
+		const VertexCacheStats small = analyzeVertexCache(indices, vertices.size(), 16);
+		const VertexCacheStats large = analyzeVertexCache(indices, vertices.size(), 32);
+		printf("  %-10s ACMR %.3f/%.3f  ATVR %.3f/%.3f  %10.2f ms\n", stage, static_cast<double>(small.acmr)
+				, static_cast<double>(large.acmr), static_cast<double>(small.atvr), static_cast<double>(large.atvr), ms);
+	}
+
+	void run(const char *name, std::vector<Vertex> vertices, std::vector<uint32_t> indices) {
+		printf("%s: %zu vertices %zu triangles (cache 16/32)\n", name, vertices.size(), indices.size() / 3);
+		report("input", vertices, indices, 0.0);
+		BenchTimer cache;
+		optimizeVertexCache(indices, vertices.size());
+		report("cache", vertices, indices, cache.elapsedMs());
+		BenchTimer overdraw;
+		optimizeOverdraw(indices, vertices);
+		report("overdraw", vertices, indices, overdraw.elapsedMs());
+		BenchTimer fetch;
+		optimizeVertexFetch(vertices, indices);
+		report("fetch", vertices, indices, fetch.elapsedMs());
+		const size_t indexSize = fitsIndex16(vertices.size()) ? sizeof(uint16_t) : sizeof(uint32_t);
+		printf("  indices    %zu KB as 32 bit, %zu KB as picked\n", indices.size() * sizeof(uint32_t) / 1024, indices.size() * indexSize / 1024);
+		std::vector<MeshLod> lods;
+		BenchTimer simplify;
+		buildLodChain(vertices, indices, lods);
+		printf("  lod chain  %zu levels, %zu KB of indices  %10.2f ms\n", lods.size(), indices.size() * indexSize / 1024, simplify.elapsedMs());
+	}
+
+	// regular grid with its triangles shuffled, a worst case input
+	void shuffledGrid(uint32_t size, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+		vertices.clear();
+		indices.clear();
+		for (uint32_t y = 0; y <= size; ++y) {
+			for (uint32_t x = 0; x <= size; ++x) {
+				Vertex v{};
+				v.pos = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+				vertices.push_back(v);
+			}
+		}
+		std::vector<uint32_t> quads(size_t{size} * size);
+		for (uint32_t i = 0; i < quads.size(); ++i) {
+			quads[i] = i;
+		}
+		std::shuffle(quads.begin(), quads.end(), std::mt19937(1));
+		for (uint32_t q : quads) {
+			const uint32_t a = (q / size) * (size + 1) + q % size;
+			indices.insert(indices.end(), {a, a + 1, a + size + 1, a + 1, a + size + 2, a + size + 1});
+		}
+	}
+}
+
+void registerMeshBench(CLI::App &app) {
+	struct Options {
+		std::string obj = "models/viking_room.obj";
+		uint32_t grid = 512;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("mesh", "post load mesh optimization: vertex cache, overdraw, fetch order and lod chain");
+	cmd->add_option("--obj", opts->obj, "OBJ file to optimize");
+	cmd->add_option("--grid", opts->grid, "quads per side of the shuffled synthetic grid");
+	cmd->callback([opts]() {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::string err;
+		if (!readObj(opts->obj, vertices, indices, err)) {
+			throw std::runtime_error(err);
+		}
+		run(opts->obj.c_str(), vertices, indices);
+
+		shuffledGrid(opts->grid, vertices, indices);
+		run("shuffled grid", vertices, indices);
+	});
+}
@@ -0,0 +1,94 @@
+#include "bench.h"
+#include "mesh_dedup.h"
+#include "obj_loader.h"
+#include "obj_reader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+
+namespace {
+	long peakRssKb() {
+		struct rusage usage {};
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	void load(const std::string &path, const std::string &reader, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+		std::string err;
+		if (reader == "tinyobj") {
+			std::vector<Vertex> stream;
+			if (!loadObjVertexStream(path, stream, err)) {
+				throw std::runtime_error(err);
+			}
+			dedupVertices(stream.data(), stream.size(), vertices, indices);
+		} else if (!readObj(path, vertices, indices, err)) {
+			throw std::runtime_error(err);
+		}
+	}
+
+	//the two readers parse numbers differently, so allow for the last bit
+	bool nearlyEqual(float a, float b) {
+		return std::fabs(a - b) <= 1e-6f * std::fmax(1.0f, std::fmax(std::fabs(a), std::fabs(b)));
+	}
+
+	// the indices have to be identical and the vertices equal up to parsing, or one reader triangulates or dedups differently
+	size_t countMismatches(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices
+			, const std::vector<Vertex> &otherVertices, const std::vector<uint32_t> &otherIndices) {
+		if (vertices.size() != otherVertices.size() || indices.size() != otherIndices.size()) {
+			return std::max(vertices.size(), otherVertices.size()) + std::max(indices.size(), otherIndices.size());
+		}
+		size_t mismatches = 0;
+		for (size_t i = 0; i < indices.size(); ++i) {
+			mismatches += indices[i] != otherIndices[i];
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			const Vertex &a = vertices[i];
+			const Vertex &b = otherVertices[i];
+			mismatches += !(nearlyEqual(a.pos.x, b.pos.x) && nearlyEqual(a.pos.y, b.pos.y) && nearlyEqual(a.pos.z, b.pos.z)
+					&& nearlyEqual(a.texCoord.x, b.texCoord.x) && nearlyEqual(a.texCoord.y, b.texCoord.y) && a.color == b.color);
+		}
+		return mismatches;
+	}
+}
+
+void registerObjBench(CLI::App &app) {
+	struct Options {
+		std::string obj = "models/viking_room.obj";
+		std::string reader = "streaming";
+		bool check = false;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("obj", "OBJ load to deduplicated mesh; run each reader in its own process so peak RSS is meaningful");
+	cmd->add_option("--obj", opts->obj, "OBJ file to load");
+	cmd->add_option("--reader", opts->reader, "streaming | tinyobj")->check(CLI::IsMember({"streaming", "tinyobj"}));
+	cmd->add_flag("--check", opts->check, "after the timed load, load again with the other reader and fail unless the meshes match");
+	cmd->callback([opts]() {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		const long rssBefore = peakRssKb();
+		BenchTimer t;
+		load(opts->obj, opts->reader, vertices, indices);
+		const double ms = t.elapsedMs();
+		const double meshMb = static_cast<double>(vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t)) / (1024.0 * 1024.0);
+		printf("%s (%s): %zu vertices %zu indices\n", opts->obj.c_str(), opts->reader.c_str(), vertices.size(), indices.size());
+		printf("  load      %10.2f ms\n", ms);
+		printf("  mesh      %10.2f MB\n", meshMb);
+		printf("  peak rss  %10.2f MB (%.2f MB before load)\n", static_cast<double>(peakRssKb()) / 1024.0, static_cast<double>(rssBefore) / 1024.0);
+		if (opts->check) {
+			const std::string other = opts->reader == "tinyobj" ? "streaming" : "tinyobj";
+			std::vector<Vertex> otherVertices;
+			std::vector<uint32_t> otherIndices;
+			load(opts->obj, other, otherVertices, otherIndices);
+			const size_t mismatches = countMismatches(vertices, indices, otherVertices, otherIndices);
+			printf("  check     %s against %s: %zu vertices %zu indices, %zu mismatches\n", mismatches == 0 ? "ok" : "FAILED"
+					, other.c_str(), otherVertices.size(), otherIndices.size(), mismatches);
+			if (mismatches != 0) {
+				throw std::runtime_error("failed OBJ check, the " + opts->reader + " and " + other + " readers built different meshes!");
+			}
+		}
+	});
+}
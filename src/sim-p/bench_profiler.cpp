@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "cpu_profiler.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+	//what a zone may cost for it to stay in the render loop's hot paths
+	const double TARGET_NS = 20.0;
+
+	// zones empty zones in a row on the calling thread, ns per zone
+	double zoneLoop(uint32_t zones) {
+		BenchTimer timer;
+		for (uint32_t i = 0; i < zones; ++i) {
+			CpuZone zone("bench zone");
+		}
+		return timer.elapsedMs() * 1e6 / static_cast<double>(zones);
+	}
+
+	// ns per clock read, a zone takes two
+	double clockLoop(uint32_t reads) {
+		uint64_t sum = 0;
+		BenchTimer timer;
+		for (uint32_t i = 0; i < reads; ++i) {
+			sum += CpuProfiler::now();
+		}
+		const double ns = timer.elapsedMs() * 1e6 / static_cast<double>(reads);
+		//keeps the reads from being thrown away
+		return sum == 0 ? 0.0 : ns;
+	}
+}
+
+void registerProfilerBench(CLI::App &app) {
+	struct Options {
+		uint32_t zones = 500000;
+		uint32_t maxThreads = workerCount();
+		std::string trace = "profiler_bench.json";
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("profiler", "cost of a CPU profiler zone, disabled and recording, over threads, and of writing the trace");
+	cmd->add_option("--zones", opts->zones, "zones each thread records, at most the per thread limit");
+	cmd->add_option("--threads", opts->maxThreads, "most threads to try");
+	cmd->add_option("--trace", opts->trace, "where the trace of it all is written");
+	cmd->callback([opts]() {
+		const uint32_t zones = std::min(opts->zones, static_cast<uint32_t>(CpuProfiler::MAX_ZONES_PER_THREAD));
+		const double clockNs = clockLoop(zones);
+		printf("clock     %6.2f ns per read\n", clockNs);
+		//before enable(), a zone is one relaxed load and a branch
+		printf("disabled  %6.2f ns per zone\n", zoneLoop(zones));
+
+		CpuProfiler::enable();
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t t = 1; t < opts->maxThreads; t *= 2) {
+			threadCounts.push_back(t);
+		}
+		threadCounts.push_back(opts->maxThreads);
+		for (uint32_t threads : threadCounts) {
+			//fresh threads every time, each starts out with an empty buffer of its own. That includes
+			//faulting the buffer's pages in, once per page for the whole run
+			std::vector<double> nsPerZone(threads);
+			std::vector<std::thread> workers;
+			for (uint32_t t = 0; t < threads; ++t) {
+				workers.emplace_back([&nsPerZone, t, zones]() {
+					CpuProfiler::setThreadName("bench");
+					nsPerZone[t] = zoneLoop(zones);
+				});
+			}
+			double worst = 0.0, sum = 0.0;
+			for (uint32_t t = 0; t < threads; ++t) {
+				workers[t].join();
+				worst = std::max(worst, nsPerZone[t]);
+				sum += nsPerZone[t];
+			}
+			//what the zone adds beyond its two clock reads, which no recording scheme gets rid of
+			printf("%3u threads %6.2f ns per zone, %6.2f ns worst thread%s, %6.2f ns beyond the clock\n", threads, sum / threads, worst
+					, worst <= TARGET_NS ? "" : " (over)", sum / threads - 2.0 * clockNs);
+		}
+
+		const CpuProfilerStats stats = CpuProfiler::stats();
+		BenchTimer writeTimer;
+		if (!CpuProfiler::writeTrace(opts->trace)) {
+			printf("unable to write %s\n", opts->trace.c_str());
+			return;
+		}
+		const double writeMs = writeTimer.elapsedMs();
+		std::error_code error;
+		const uintmax_t bytes = std::filesystem::file_size(opts->trace, error);
+		printf("trace: %llu zones on %u threads, %llu dropped, %.1f MB written in %.1f ms, TSC at %.1f ticks per us\n"
+				, static_cast<unsigned long long>(stats.zones), stats.threads, static_cast<unsigned long long>(stats.dropped)
+				, static_cast<double>(error ? 0 : bytes) / (1024.0 * 1024.0), writeMs, stats.ticksPerUs);
+	});
+}
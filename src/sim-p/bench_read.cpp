@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	// what readWholeFile plus createShaderModule did, minus the 2 KB stack buffer it overflowed:
+	// an ifstream read into a vector, then a second copy for whoever consumes it
+	bool readStream(const std::string &path, std::vector<char> &bytes, std::vector<char> &consumed) {
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		const std::streamsize size = static_cast<std::streamsize>(file.tellg());
+		bytes.resize(static_cast<size_t>(size));
+		file.seekg(0);
+		file.read(bytes.data(), size);
+		consumed.assign(bytes.begin(), bytes.end());
+		return file.good();
+	}
+
+	// best of iterations, every path hashes the bytes so they are all actually read
+	template<typename Read>
+	double bestOf(uint32_t iterations, uint64_t &hash, Read read) {
+		double best = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i) {
+			BenchTimer timer;
+			hash = read();
+			const double ms = timer.elapsedMs();
+			best = (i == 0 || ms < best) ? ms : best;
+		}
+		return best;
+	}
+}
+
+void registerReadBench(CLI::App &app) {
+	struct Options {
+		std::vector<std::string> files = {"shaders/vert.spv", "shaders/frag.spv", "shaders/cull.spv", "models/viking_room.obj"
+			, "models/viking_room.mesh", "textures/viking_room.png", "textures/viking_room.stex"};
+		uint32_t iterations = 10;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("read", "whole file reads: ifstream and copy against MappedFile mapped and streamed with pread");
+	cmd->add_option("files", opts->files, "files to read, the page cache is warm after the first iteration");
+	cmd->add_option("--iterations", opts->iterations, "reads per file and path, the best is reported");
+	cmd->callback([opts]() {
+		uint32_t mismatches = 0;
+		for (const std::string &path : opts->files) {
+			MappedFile probe;
+			if (!probe.open(path)) {
+				printf("%s: missing, skipped\n", path.c_str());
+				continue;
+			}
+			const size_t size = probe.size();
+			probe.close();
+
+			uint64_t streamHash = 0, mapHash = 0, preadHash = 0;
+			std::vector<char> bytes, consumed;
+			const double stream = bestOf(opts->iterations, streamHash, [&path, &bytes, &consumed]() {
+				bytes.clear();
+				consumed.clear();
+				return readStream(path, bytes, consumed) ? hashBytes(consumed.data(), consumed.size()) : 0;
+			});
+			const double mapped = bestOf(opts->iterations, mapHash, [&path]() {
+				MappedFile file;
+				return file.open(path) ? hashBytes(file.data(), file.size()) : 0;
+			});
+			const double streamed = bestOf(opts->iterations, preadHash, [&path]() {
+				MappedFile file;
+				return file.read(path) ? hashBytes(file.data(), file.size()) : 0;
+			});
+			const double mb = static_cast<double>(size) / (1024.0 * 1024.0);
+			printf("%s: %zu KB\n", path.c_str(), size / 1024);
+			printf("  ifstream+copy %9.3f ms %8.1f MB/s\n", stream, mb / (stream / 1000.0));
+			printf("  mmap          %9.3f ms %8.1f MB/s  x%.2f%s\n", mapped, mb / (mapped / 1000.0), stream / mapped
+					, mapHash == streamHash ? "" : " (mismatch)");
+			printf("  pread         %9.3f ms %8.1f MB/s  x%.2f%s\n", streamed, mb / (streamed / 1000.0), stream / streamed
+					, preadHash == streamHash ? "" : " (mismatch)");
+			mismatches += mapHash == streamHash ? 0u : 1u;
+			mismatches += preadHash == streamHash ? 0u : 1u;
+		}
+		if (mismatches != 0) {
+			throw std::runtime_error("failed read check, " + std::to_string(mismatches) + " reads hashed other than ifstream!");
+		}
+	});
+}
@@ -0,0 +1,492 @@
+#include "bench.h"
+#include "bindless_textures.h"
+#include "device_allocator.h"
+#include "parallel.h"
+#include "parallel_recorder.h"
+#include "shader_compiler.h"
+#include "vertex_format.h"
+#include <glm/glm.hpp>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+	const VkFormat TARGET_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+	const uint32_t TARGET_SIZE = 64;
+	//distinct index ranges the draws cycle through, so consecutive draws don't look identical to the driver
+	const uint32_t MESH_COUNT = 64;
+	const uint32_t MESH_INDICES = 36;
+
+	// just enough of a device to record the same kind of commands the renderer does, nothing is ever submitted.
+	// on a CPU implementation such as lavapipe when asked, which still creates the bindless set 1 and its pipeline
+	class HeadlessRecorder {
+	public:
+		HeadlessRecorder(const std::string &shaderDir, const std::string &shaderCache, bool preferCpu);
+		~HeadlessRecorder();
+		void recordSlice(VkCommandBuffer commandBuffer, size_t begin, size_t end) const;
+		// primary running the render pass over the slices
+		void recordPrimary(const std::vector<VkCommandBuffer> &secondaries);
+		VkDevice device() const { return Device; }
+		uint32_t queueFamily() const { return QueueFamily; }
+		VkRenderPass renderPass() const { return RenderPass; }
+	private:
+		void createDevice(bool preferCpu);
+		void createTarget();
+		void createPipeline(const std::string &shaderDir);
+		VkShaderModule loadShader(const std::string &path);
+	private:
+		ShaderCompiler Shaders;
+		VkInstance Instance = VK_NULL_HANDLE;
+		VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;
+		VkDevice Device = VK_NULL_HANDLE;
+		uint32_t QueueFamily = 0;
+		DeviceAllocator Allocator;
+		VkImage Target = VK_NULL_HANDLE;
+		DeviceAllocation TargetMemory;
+		VkImageView TargetView = VK_NULL_HANDLE;
+		VkRenderPass RenderPass = VK_NULL_HANDLE;
+		VkFramebuffer Framebuffer = VK_NULL_HANDLE;
+		VkDescriptorSetLayout SetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool DescriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+		BindlessTextures Textures;
+		VkPipelineLayout PipelineLayout = VK_NULL_HANDLE;
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		VkBuffer VertexBuffer = VK_NULL_HANDLE;
+		DeviceAllocation VertexMemory;
+		VkBuffer IndexBuffer = VK_NULL_HANDLE;
+		DeviceAllocation IndexMemory;
+		VkCommandPool PrimaryPool = VK_NULL_HANDLE;
+		VkCommandBuffer Primary = VK_NULL_HANDLE;
+	};
+
+	HeadlessRecorder::HeadlessRecorder(const std::string &shaderDir, const std::string &shaderCache, bool preferCpu) {
+		Shaders.init(shaderCache);
+		createDevice(preferCpu);
+		Allocator.init(PhysicalDevice, Device);
+		createTarget();
+		createPipeline(shaderDir);
+		Allocator.createBuffer(sizeof(ModelVertex) * MESH_INDICES * MESH_COUNT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+				, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VertexBuffer, VertexMemory);
+		Allocator.createBuffer(sizeof(uint16_t) * MESH_INDICES * MESH_COUNT, VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+				, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, IndexBuffer, IndexMemory);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = QueueFamily;
+		if (vkCreateCommandPool(Device, &poolInfo, nullptr, &PrimaryPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = PrimaryPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(Device, &allocInfo, &Primary) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+	}
+
+	HeadlessRecorder::~HeadlessRecorder() {
+		vkDestroyCommandPool(Device, PrimaryPool, nullptr);
+		Allocator.destroyBuffer(IndexBuffer, IndexMemory);
+		Allocator.destroyBuffer(VertexBuffer, VertexMemory);
+		vkDestroyPipeline(Device, Pipeline, nullptr);
+		vkDestroyPipelineLayout(Device, PipelineLayout, nullptr);
+		vkDestroyDescriptorPool(Device, DescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(Device, SetLayout, nullptr);
+		Textures.shutdown();
+		vkDestroyFramebuffer(Device, Framebuffer, nullptr);
+		vkDestroyRenderPass(Device, RenderPass, nullptr);
+		vkDestroyImageView(Device, TargetView, nullptr);
+		Allocator.destroyImage(Target, TargetMemory);
+		Allocator.shutdown();
+		vkDestroyDevice(Device, nullptr);
+		vkDestroyInstance(Instance, nullptr);
+	}
+
+	void HeadlessRecorder::createDevice(bool preferCpu) {
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "sim-bench";
+		appInfo.apiVersion = VK_API_VERSION_1_2;
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+		if (vkCreateInstance(&createInfo, nullptr, &Instance) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create instance!");
+		}
+
+		uint32_t deviceCount = 0;
+		vkEnumeratePhysicalDevices(Instance, &deviceCount, nullptr);
+		std::vector<VkPhysicalDevice> devices(deviceCount);
+		vkEnumeratePhysicalDevices(Instance, &deviceCount, devices.data());
+		for (VkPhysicalDevice device : devices) {
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(device, &properties);
+			const bool cpu = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+			if (PhysicalDevice != VK_NULL_HANDLE && cpu != preferCpu) {
+				continue;
+			}
+			uint32_t familyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> families(familyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+			for (uint32_t i = 0; i < familyCount; ++i) {
+				if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+					PhysicalDevice = device;
+					QueueFamily = i;
+					break;
+				}
+			}
+			if (PhysicalDevice == device && cpu == preferCpu) {
+				break;
+			}
+		}
+		if (PhysicalDevice == VK_NULL_HANDLE) {
+			throw std::runtime_error("failed to find a device with a graphics queue!");
+		}
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &properties);
+		printf("recording on %s\n", properties.deviceName);
+
+		//the fragment shader samples the renderer's bindless texture table
+		VkPhysicalDeviceVulkan12Features supported12{};
+		supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &supported12;
+		vkGetPhysicalDeviceFeatures2(PhysicalDevice, &supportedFeatures);
+		if (!BindlessTextures::supported(supported12)) {
+			throw std::runtime_error("failed to find descriptor indexing on " + std::string(properties.deviceName) + "!");
+		}
+		VkPhysicalDeviceVulkan12Features vulkan12{};
+		vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		BindlessTextures::enableFeatures(vulkan12);
+
+		const float priority = 1.0f;
+		VkDeviceQueueCreateInfo queueInfo{};
+		queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo.queueFamilyIndex = QueueFamily;
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = &priority;
+		VkDeviceCreateInfo deviceInfo{};
+		deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.pNext = &vulkan12;
+		deviceInfo.queueCreateInfoCount = 1;
+		deviceInfo.pQueueCreateInfos = &queueInfo;
+		if (vkCreateDevice(PhysicalDevice, &deviceInfo, nullptr, &Device) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create logical device!");
+		}
+	}
+
+	void HeadlessRecorder::createTarget() {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = {TARGET_SIZE, TARGET_SIZE, 1};
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = TARGET_FORMAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		Allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Target, TargetMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = Target;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = TARGET_FORMAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(Device, &viewInfo, nullptr, &TargetView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image view!");
+		}
+
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = TARGET_FORMAT;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentReference colorRef{};
+		colorRef.attachment = 0;
+		colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorRef;
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &colorAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		if (vkCreateRenderPass(Device, &renderPassInfo, nullptr, &RenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = RenderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &TargetView;
+		framebufferInfo.width = TARGET_SIZE;
+		framebufferInfo.height = TARGET_SIZE;
+		framebufferInfo.layers = 1;
+		if (vkCreateFramebuffer(Device, &framebufferInfo, nullptr, &Framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+	}
+
+	VkShaderModule HeadlessRecorder::loadShader(const std::string &path) {
+		std::vector<uint32_t> code;
+		std::string error;
+		if (!Shaders.compile(path, {}, code, error)) {
+			throw std::runtime_error("failed to compile " + path + ": " + error);
+		}
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size() * sizeof(uint32_t);
+		createInfo.pCode = code.data();
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(Device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module!");
+		}
+		return shaderModule;
+	}
+
+	void HeadlessRecorder::createPipeline(const std::string &shaderDir) {
+		//same set layouts as the renderer, the sets are bound but never written since nothing executes
+		VkDescriptorSetLayoutBinding binding{};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+		if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &SetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSize.descriptorCount = 1;
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = 1;
+		if (vkCreateDescriptorPool(Device, &poolInfo, nullptr, &DescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = DescriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &SetLayout;
+		if (vkAllocateDescriptorSets(Device, &allocInfo, &DescriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+		Textures.init(PhysicalDevice, Device, MESH_COUNT);
+
+		//a per object transform, the usual thing pushed between draws
+		VkPushConstantRange pushRange{};
+		pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushRange.offset = 0;
+		pushRange.size = sizeof(glm::mat4);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		const VkDescriptorSetLayout setLayouts[] = {SetLayout, Textures.layout()};
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+		if (vkCreatePipelineLayout(Device, &pipelineLayoutInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkShaderModule vertModule = loadShader(shaderDir + "/shader.vert");
+		VkShaderModule fragModule = loadShader(shaderDir + "/shader.frag");
+		VkPipelineShaderStageCreateInfo stages[2]{};
+		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stages[0].module = vertModule;
+		stages[0].pName = "main";
+		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[1].module = fragModule;
+		stages[1].pName = "main";
+
+		//the renderer's vertex input, the instance binding is declared but every draw here is a single instance
+		const VkVertexInputBindingDescription bindingDescriptions[] = {ModelVertex::getBindingDescription()
+			, InstanceTransform::getBindingDescription()};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		for (const auto &a : ModelVertex::getAttributeDescriptions()) {
+			attributeDescriptions.push_back(a);
+		}
+		for (const auto &a : InstanceTransform::getAttributeDescriptions()) {
+			attributeDescriptions.push_back(a);
+		}
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = 2;
+		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+		VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = stages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = PipelineLayout;
+		pipelineInfo.renderPass = RenderPass;
+		pipelineInfo.subpass = 0;
+		const VkResult result = vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &Pipeline);
+		vkDestroyShaderModule(Device, fragModule, nullptr);
+		vkDestroyShaderModule(Device, vertModule, nullptr);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+	}
+
+	void HeadlessRecorder::recordSlice(VkCommandBuffer commandBuffer, size_t begin, size_t end) const {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+		VkViewport viewport{0.0f, 0.0f, static_cast<float>(TARGET_SIZE), static_cast<float>(TARGET_SIZE), 0.0f, 1.0f};
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor{{0, 0}, {TARGET_SIZE, TARGET_SIZE}};
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		const VkBuffer vertexBuffers[] = {VertexBuffer, VertexBuffer};
+		const VkDeviceSize offsets[] = {0, 0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, IndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+		const VkDescriptorSet sets[] = {DescriptorSet, Textures.set()};
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 2, sets, 0, nullptr);
+		glm::mat4 model(1.0f);
+		for (size_t i = begin; i < end; ++i) {
+			const uint32_t mesh = static_cast<uint32_t>(i % MESH_COUNT);
+			model[3][0] = static_cast<float>(i);
+			vkCmdPushConstants(commandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
+			vkCmdDrawIndexed(commandBuffer, MESH_INDICES, 1, mesh * MESH_INDICES, 0, 0);
+		}
+	}
+
+	void HeadlessRecorder::recordPrimary(const std::vector<VkCommandBuffer> &secondaries) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(Primary, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		VkClearValue clear{};
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = RenderPass;
+		renderPassInfo.framebuffer = Framebuffer;
+		renderPassInfo.renderArea.extent = {TARGET_SIZE, TARGET_SIZE};
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clear;
+		vkCmdBeginRenderPass(Primary, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(Primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+		vkCmdEndRenderPass(Primary);
+		if (vkEndCommandBuffer(Primary) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
+}
+
+void registerRecordBench(CLI::App &app) {
+	struct Options {
+		std::vector<size_t> draws = {10000, 100000, 1000000};
+		uint32_t maxThreads = workerCount();
+		uint32_t iterations = 5;
+		std::string shaders = "shaders";
+		std::string shaderCache = "shader.cache";
+		bool cpu = false;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("record", "parallel secondary command buffer recording, scaling over threads");
+	cmd->add_option("--draws", opts->draws, "draw list sizes");
+	cmd->add_option("--threads", opts->maxThreads, "most recording threads to try");
+	cmd->add_option("--iterations", opts->iterations, "recordings per configuration, the best is reported");
+	cmd->add_option("--shaders", opts->shaders, "directory holding shader.vert and shader.frag");
+	cmd->add_option("--shader-cache", opts->shaderCache, "compiled shaders, shared with sim-p");
+	cmd->add_flag("--cpu", opts->cpu, "prefer a CPU Vulkan implementation, e.g. lavapipe");
+	cmd->callback([opts]() {
+		HeadlessRecorder headless(opts->shaders, opts->shaderCache, opts->cpu);
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t t = 1; t < opts->maxThreads; t *= 2) {
+			threadCounts.push_back(t);
+		}
+		threadCounts.push_back(opts->maxThreads);
+
+		auto slice = [&headless](VkCommandBuffer commandBuffer, size_t begin, size_t end, uint32_t) {
+			headless.recordSlice(commandBuffer, begin, end);
+		};
+		std::vector<VkCommandBuffer> secondaries;
+		for (size_t draws : opts->draws) {
+			printf("%zu draws\n", draws);
+			double single = 0.0;
+			for (uint32_t threads : threadCounts) {
+				ParallelRecorder recorder;
+				recorder.init(headless.device(), headless.queueFamily(), 1, threads);
+				double best = 0.0;
+				for (uint32_t i = 0; i < opts->iterations; ++i) {
+					BenchTimer timer;
+					recorder.record(0, headless.renderPass(), 0, draws, slice, secondaries);
+					headless.recordPrimary(secondaries);
+					const double ms = timer.elapsedMs();
+					best = (i == 0 || ms < best) ? ms : best;
+				}
+				if (threads == 1) {
+					single = best;
+				}
+				printf("  %3u threads %4zu slices %10.3f ms %8.1f draws/us  x%.2f\n", threads, secondaries.size(), best
+						, static_cast<double>(draws) / (best * 1000.0), single / best);
+			}
+		}
+	});
+}
@@ -0,0 +1,155 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "bench.h"
+#include "frustum.h"
+#include "parallel.h"
+#include "scene.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	const float WORLD_SIZE = 1000.0f;
+	const float FOV_Y = glm::radians(60.0f);
+	const float ASPECT = 16.0f / 9.0f;
+	//the frame budget the cull has to fit in at a million objects
+	const double TARGET_MS = 1.0;
+
+	// camera in the middle of the world looking along x, sees roughly a tenth of it
+	Frustum worldFrustum() {
+		const glm::vec3 eye(WORLD_SIZE * 0.5f);
+		glm::mat4 proj = glm::perspective(FOV_Y, ASPECT, 0.1f, WORLD_SIZE * 0.5f);
+		proj[1][1] *= -1;
+		return Frustum::fromViewProj(proj * glm::lookAt(eye, eye + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+	}
+
+	// the plain per box test, what the hierarchy has to agree with
+	bool boxVisible(const Frustum &frustum, const Aabb &box) {
+		for (const glm::vec4 &plane : frustum.planes) {
+			const glm::vec3 furthest(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y
+				, plane.z >= 0.0f ? box.max.z : box.min.z);
+			if (glm::dot(glm::vec3(plane), furthest) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// visible has to hold every object whose box the plain test accepts, each once, and nothing else
+	bool sameVisible(const Frustum &frustum, const Scene &scene, const std::vector<uint32_t> &visible) {
+		std::vector<uint8_t> state(scene.size(), 0);
+		size_t expected = 0;
+		for (uint32_t o = 0; o < scene.size(); ++o) {
+			if (boxVisible(frustum, scene.bounds(o))) {
+				state[o] = 1;
+				++expected;
+			}
+		}
+		for (uint32_t o : visible) {
+			if (o >= state.size() || state[o] != 1) {
+				return false;
+			}
+			state[o] = 2;
+		}
+		return visible.size() == expected;
+	}
+}
+
+void registerSceneBench(CLI::App &app) {
+	struct Options {
+		std::vector<uint32_t> objects = {100000, 1000000};
+		uint32_t maxThreads = workerCount();
+		uint32_t iterations = 10;
+		float speed = 1.0f;
+	};
+	auto opts = std::make_shared<Options>();
+	CLI::App *cmd = app.add_subcommand("scene", "BVH build, update and frustum culling of moving objects, scaling over threads");
+	cmd->add_option("--objects", opts->objects, "object counts");
+	cmd->add_option("--threads", opts->maxThreads, "most threads to try");
+	cmd->add_option("--iterations", opts->iterations, "moves, updates and culls per configuration, the best is reported");
+	cmd->add_option("--speed", opts->speed, "how far objects move per iteration");
+	cmd->callback([opts]() {
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t t = 1; t < opts->maxThreads; t *= 2) {
+			threadCounts.push_back(t);
+		}
+		threadCounts.push_back(opts->maxThreads);
+		const Frustum frustum = worldFrustum();
+		uint32_t mismatches = 0;
+
+		for (uint32_t objects : opts->objects) {
+			printf("%u objects, target %.1f ms per cull\n", objects, TARGET_MS);
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> place(0.0f, WORLD_SIZE);
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+			std::uniform_real_distribution<float> size(0.5f, 2.0f);
+			std::vector<SceneObject> initial(objects);
+			std::vector<glm::vec3> velocities(objects);
+			for (uint32_t i = 0; i < objects; ++i) {
+				const glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random) + 2.0f));
+				initial[i] = {glm::vec3(place(random), place(random), place(random)), size(random)
+					, glm::angleAxis(unit(random) * glm::radians(180.0f), axis), 0, 0};
+				velocities[i] = glm::vec3(unit(random), unit(random), unit(random)) * opts->speed;
+			}
+
+			//the unit sphere mesh makes every object's box its position plus and minus its scale
+			BenchTimer bruteTimer;
+			uint32_t bruteVisible = 0;
+			for (const SceneObject &object : initial) {
+				const glm::vec3 radius(object.scale);
+				bruteVisible += boxVisible(frustum, {object.position - radius, object.position + radius}) ? 1u : 0u;
+			}
+			printf("  brute force %u visible %10.3f ms\n", bruteVisible, bruteTimer.elapsedMs());
+
+			double singleCull = 0.0;
+			for (uint32_t threads : threadCounts) {
+				Scene scene;
+				scene.init(threads);
+				scene.addMesh(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+				for (const SceneObject &object : initial) {
+					scene.addObject(object);
+				}
+				BenchTimer buildTimer;
+				scene.build();
+				const double build = buildTimer.elapsedMs();
+
+				std::vector<uint32_t> visible;
+				double bestUpdate = 0.0;
+				double bestCull = 0.0;
+				for (uint32_t i = 0; i < opts->iterations; ++i) {
+					for (uint32_t o = 0; o < objects; ++o) {
+						scene.object(o).position += velocities[o];
+					}
+					BenchTimer updateTimer;
+					scene.update();
+					const double update = updateTimer.elapsedMs();
+					BenchTimer cullTimer;
+					scene.cull(frustum, visible);
+					const double cull = cullTimer.elapsedMs();
+					bestUpdate = (i == 0 || update < bestUpdate) ? update : bestUpdate;
+					bestCull = (i == 0 || cull < bestCull) ? cull : bestCull;
+				}
+				if (threads == 1) {
+					singleCull = bestCull;
+				}
+
+				const bool same = sameVisible(frustum, scene, visible);
+				mismatches += same ? 0u : 1u;
+				const SceneStats stats = scene.stats();
+				printf("  %3u threads build %9.3f ms update %8.3f ms cull %8.3f ms x%.2f%s  %8zu visible%s  %llu full %llu subtree rebuilds\n"
+						, threads, build, bestUpdate, bestCull, singleCull / bestCull, bestCull <= TARGET_MS ? "" : " (over)"
+						, visible.size(), same ? "" : " (mismatch)"
+						, static_cast<unsigned long long>(stats.fullRebuilds - 1), static_cast<unsigned long long>(stats.subtreeRebuilds));
+				scene.shutdown();
+			}
+		}
+		if (mismatches != 0) {
+			throw std::runtime_error("failed scene check, " + std::to_string(mismatches) + " culls disagreed with the per box test!");
+		}
+	});
+}
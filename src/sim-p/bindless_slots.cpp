@@ -0,0 +1,46 @@
+#include "bindless_slots.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+BindlessSlots::BindlessSlots() : Capacity(0), NextSlot(0), FreeSlots(), RetiredSlots(), Stats() {
+
+}
+
+void BindlessSlots::init(uint32_t capacity) {
+	Capacity = capacity;
+	NextSlot = 0;
+	FreeSlots.clear();
+	RetiredSlots.clear();
+	Stats = BindlessStats{};
+	Stats.capacity = Capacity;
+}
+
+uint32_t BindlessSlots::acquire() {
+	uint32_t slot;
+	if (!FreeSlots.empty()) {
+		slot = FreeSlots.back();
+		FreeSlots.pop_back();
+	} else if (NextSlot < Capacity) {
+		slot = NextSlot++;
+	} else {
+		throw std::runtime_error("failed to add texture, all " + std::to_string(Capacity) + " slots are in use!");
+	}
+	++Stats.adds;
+	++Stats.resident;
+	Stats.peak = std::max(Stats.peak, Stats.resident);
+	return slot;
+}
+
+void BindlessSlots::release(uint32_t slot, uint64_t retireValue) {
+	RetiredSlots.push_back({slot, retireValue});
+	++Stats.removes;
+	--Stats.resident;
+}
+
+void BindlessSlots::reclaim(uint64_t completedValue) {
+	while (!RetiredSlots.empty() && RetiredSlots.front().value <= completedValue) {
+		FreeSlots.push_back(RetiredSlots.front().slot);
+		RetiredSlots.pop_front();
+	}
+}
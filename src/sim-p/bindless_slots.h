@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct BindlessStats {
+	uint32_t capacity;
+	uint32_t resident;
+	//most slots in use at once
+	uint32_t peak;
+	uint64_t adds;
+	uint64_t removes;
+};
+
+// Which slots of BindlessTextures' table are in use, apart from the
+// descriptors themselves so it runs without a device. Slots are handed out
+// from the free list first and then from the ones never used. A released
+// slot waits for the frame timeline value it was retired at, retired slots
+// come back in the order they were released, which is the order their
+// values are reached.
+class BindlessSlots {
+public:
+	BindlessSlots();
+	void init(uint32_t capacity);
+	// a slot nothing uses, throws when all of them are in use or still retiring
+	uint32_t acquire();
+	// slot is free again once the frame timeline has reached retireValue
+	void release(uint32_t slot, uint64_t retireValue);
+	// returns the slots retired by completedValue to the free list
+	void reclaim(uint64_t completedValue);
+	uint32_t capacity() const { return Capacity; }
+	// released and still waiting for their value
+	size_t retiring() const { return RetiredSlots.size(); }
+	BindlessStats stats() const { return Stats; }
+private:
+	struct Retired {
+		uint32_t slot;
+		uint64_t value;
+	};
+private:
+	uint32_t Capacity;
+	//slots below this have been handed out at least once
+	uint32_t NextSlot;
+	std::vector<uint32_t> FreeSlots;
+	//in the order they were released, so in the order their values are reached
+	std::deque<Retired> RetiredSlots;
+	BindlessStats Stats;
+};
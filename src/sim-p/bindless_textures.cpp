@@ -0,0 +1,128 @@
+#include "bindless_textures.h"
+#include <algorithm>
+#include <stdexcept>
+
+BindlessTextures::BindlessTextures() : Device(VK_NULL_HANDLE), Layout(VK_NULL_HANDLE), Pool(VK_NULL_HANDLE), Set(VK_NULL_HANDLE)
+	, Slots() {
+
+}
+
+BindlessTextures::~BindlessTextures() {
+	shutdown();
+}
+
+bool BindlessTextures::supported(const VkPhysicalDeviceVulkan12Features &features) {
+	return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound
+		&& features.descriptorBindingSampledImageUpdateAfterBind && features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+void BindlessTextures::enableFeatures(VkPhysicalDeviceVulkan12Features &features) {
+	features.runtimeDescriptorArray = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	//instances in one draw sample different textures
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+}
+
+void BindlessTextures::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t maxTextures) {
+	Device = device;
+
+	//a combined image sampler counts against both the sampler and the sampled image limits
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+	const uint32_t capacity = std::min({maxTextures, properties12.maxPerStageDescriptorUpdateAfterBindSamplers
+		, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSamplers
+		, properties12.maxDescriptorSetUpdateAfterBindSampledImages});
+	if (capacity == 0) {
+		throw std::runtime_error("failed to create texture table, the device has no update after bind samplers!");
+	}
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = capacity;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	binding.pImmutableSamplers = nullptr;
+	const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flagsInfo.bindingCount = 1;
+	flagsInfo.pBindingFlags = &bindingFlags;
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+	if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &Layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture table set layout!");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = capacity;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+	if (vkCreateDescriptorPool(Device, &poolInfo, nullptr, &Pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture table pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = Pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &Layout;
+	if (vkAllocateDescriptorSets(Device, &allocInfo, &Set) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate texture table!");
+	}
+
+	Slots.init(capacity);
+}
+
+void BindlessTextures::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	//frees the set with it
+	vkDestroyDescriptorPool(Device, Pool, nullptr);
+	vkDestroyDescriptorSetLayout(Device, Layout, nullptr);
+	Pool = VK_NULL_HANDLE;
+	Layout = VK_NULL_HANDLE;
+	Set = VK_NULL_HANDLE;
+	Device = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTextures::add(VkImageView view, VkSampler sampler) {
+	const uint32_t slot = Slots.acquire();
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = view;
+	imageInfo.sampler = sampler;
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = Set;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = slot;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+	//no frame in flight samples a slot that is free, so rewriting it under them is fine
+	vkUpdateDescriptorSets(Device, 1, &descriptorWrite, 0, nullptr);
+	return slot;
+}
+
+void BindlessTextures::remove(uint32_t slot, uint64_t retireValue) {
+	Slots.release(slot, retireValue);
+}
+
+void BindlessTextures::reclaim(uint64_t completedValue) {
+	Slots.reclaim(completedValue);
+}
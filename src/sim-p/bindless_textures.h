@@ -0,0 +1,46 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "bindless_slots.h"
+#include <cstdint>
+
+// Every texture the renderer samples, in one big array of combined image
+// samplers in a descriptor set of its own. The set is bound once per
+// command buffer and shaders pick a texture by its slot, which instances
+// carry as their material, so drawing with another texture never needs
+// another set or bind. The binding is update after bind and partially
+// bound: slots are written while command buffers that bind the set are
+// pending, and slots nothing has written stay unused. A removed slot is only
+// handed out again once every frame that could still sample it has
+// completed, BindlessSlots keeps track of that. Not thread safe, it belongs
+// to the render loop.
+class BindlessTextures {
+public:
+	static const uint32_t MAX_TEXTURES = 4096;
+public:
+	BindlessTextures();
+	~BindlessTextures();
+	// whether device supports what the table needs, all of it core Vulkan 1.2 descriptor indexing
+	static bool supported(const VkPhysicalDeviceVulkan12Features &features);
+	// turns those features on, for the device create info
+	static void enableFeatures(VkPhysicalDeviceVulkan12Features &features);
+	// room for up to maxTextures, fewer where the device's update after bind limits are lower
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t maxTextures);
+	void shutdown();
+	// the slot now holding view sampled through sampler, view in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	uint32_t add(VkImageView view, VkSampler sampler);
+	// slot is free again once the frame timeline has reached retireValue, the last frame that may sample it
+	void remove(uint32_t slot, uint64_t retireValue);
+	// returns the slots retired by completedValue to the free list
+	void reclaim(uint64_t completedValue);
+	VkDescriptorSetLayout layout() const { return Layout; }
+	VkDescriptorSet set() const { return Set; }
+	uint32_t capacity() const { return Slots.capacity(); }
+	BindlessStats stats() const { return Slots.stats(); }
+private:
+	VkDevice Device;
+	VkDescriptorSetLayout Layout;
+	VkDescriptorPool Pool;
+	VkDescriptorSet Set;
+	BindlessSlots Slots;
+};
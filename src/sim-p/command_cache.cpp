@@ -0,0 +1,239 @@
+#include "command_cache.h"
+#include "cpu_profiler.h"
+#include <stdexcept>
+
+CommandCache::CommandCache() : Device(VK_NULL_HANDLE), CommandPool(VK_NULL_HANDLE), QueueFamily(0), FrameSlots(0)
+	, RecordWorkers(1), RenderPass(VK_NULL_HANDLE)
+	, Framebuffers(), Extent(), ClearValues(), PrePasses(), Layers(), Profiler(nullptr), FrameScope(0), RenderPassScope(0)
+	, Primaries(), Generation(1), Stats() {
+
+}
+
+CommandCache::~CommandCache() {
+	shutdown();
+}
+
+void CommandCache::init(VkDevice device, uint32_t queueFamily, uint32_t frameSlots, uint32_t recordWorkers) {
+	Device = device;
+	QueueFamily = queueFamily;
+	FrameSlots = frameSlots;
+	RecordWorkers = recordWorkers;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if (vkCreateCommandPool(Device, &poolInfo, nullptr, &CommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cached command pool!");
+	}
+}
+
+void CommandCache::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	//parallel layers own their pools, everything else is freed along with ours
+	Layers.clear();
+	vkDestroyCommandPool(Device, CommandPool, nullptr);
+	CommandPool = VK_NULL_HANDLE;
+	Primaries.clear();
+	Device = VK_NULL_HANDLE;
+}
+
+void CommandCache::allocate(VkCommandBufferLevel level, uint32_t count, VkCommandBuffer *commandBuffers) {
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = CommandPool;
+	allocInfo.level = level;
+	allocInfo.commandBufferCount = count;
+	if (vkAllocateCommandBuffers(Device, &allocInfo, commandBuffers) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate cached command buffers!");
+	}
+}
+
+uint32_t CommandCache::addLayer(RecordLayer record) {
+	Layer layer;
+	layer.record = record;
+	layer.secondaries.resize(FrameSlots);
+	layer.executed.resize(FrameSlots);
+	layer.dirty.assign(FrameSlots, 1);
+	allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY, FrameSlots, layer.secondaries.data());
+	for (uint32_t slot = 0; slot < FrameSlots; ++slot) {
+		layer.executed[slot].push_back(layer.secondaries[slot]);
+	}
+	Layers.push_back(std::move(layer));
+	++Generation;
+	return static_cast<uint32_t>(Layers.size() - 1);
+}
+
+uint32_t CommandCache::addParallelLayer(std::function<size_t(uint32_t frameSlot)> drawCount, ParallelRecorder::RecordSlice recordSlice) {
+	Layer layer;
+	layer.drawCount = drawCount;
+	layer.recordSlice = recordSlice;
+	layer.recorder = std::make_unique<ParallelRecorder>();
+	layer.recorder->init(Device, QueueFamily, FrameSlots, RecordWorkers);
+	layer.executed.resize(FrameSlots);
+	layer.dirty.assign(FrameSlots, 1);
+	Layers.push_back(std::move(layer));
+	++Generation;
+	return static_cast<uint32_t>(Layers.size() - 1);
+}
+
+void CommandCache::addPrePass(const std::string &name, RecordLayer record) {
+	//pre-passes are compute and draw work of their own, not nested in anything collecting statistics
+	PrePasses.push_back({name, record, Profiler ? Profiler->addScope(name, true) : 0});
+	++Generation;
+}
+
+void CommandCache::setProfiler(GpuProfiler *profiler) {
+	Profiler = profiler;
+	if (Profiler) {
+		FrameScope = Profiler->addScope("frame", false);
+		//statistics around the render pass count what its secondaries do, which they have to inherit
+		RenderPassScope = Profiler->addScope("render pass", Profiler->inheritedStatistics() != 0);
+		for (auto &prePass : PrePasses) {
+			prePass.scope = Profiler->addScope(prePass.name, true);
+		}
+	}
+	//the secondaries' inheritance changes with it
+	for (auto &layer : Layers) {
+		layer.dirty.assign(FrameSlots, 1);
+	}
+	++Generation;
+}
+
+void CommandCache::markDirty(uint32_t layer) {
+	Layers[layer].dirty.assign(FrameSlots, 1);
+	++Generation;
+}
+
+void CommandCache::freePrimaries() {
+	for (const auto &p : Primaries) {
+		vkFreeCommandBuffers(Device, CommandPool, 1, &p.commandBuffer);
+	}
+	Primaries.clear();
+}
+
+void CommandCache::setTargets(VkRenderPass renderPass, const std::vector<VkFramebuffer> &framebuffers, VkExtent2D extent
+		, const std::vector<VkClearValue> &clearValues) {
+	RenderPass = renderPass;
+	Framebuffers = framebuffers;
+	Extent = extent;
+	ClearValues = clearValues;
+
+	const size_t count = Framebuffers.size() * FrameSlots;
+	if (Primaries.size() != count) {
+		freePrimaries();
+		std::vector<VkCommandBuffer> commandBuffers(count);
+		allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(count), commandBuffers.data());
+		for (VkCommandBuffer cb : commandBuffers) {
+			Primaries.push_back({cb, 0});
+		}
+	}
+	//the layers set viewport and scissor from the extent
+	for (auto &layer : Layers) {
+		layer.dirty.assign(FrameSlots, 1);
+	}
+	++Generation;
+}
+
+void CommandCache::recordLayer(Layer &layer, uint32_t frameSlot) {
+	if (layer.recorder) {
+		//the slices are re-recorded in place, the Generation bump from markDirty takes care of the primaries
+		layer.recorder->record(frameSlot, RenderPass, Profiler ? Profiler->inheritedStatistics() : 0, layer.drawCount(frameSlot)
+				, layer.recordSlice, layer.executed[frameSlot]);
+		layer.dirty[frameSlot] = 0;
+		Stats.secondariesRecorded += layer.executed[frameSlot].size();
+		return;
+	}
+	VkCommandBuffer commandBuffer = layer.secondaries[frameSlot];
+	//no framebuffer, the same secondary runs against every swapchain image
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = RenderPass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = VK_NULL_HANDLE;
+	inheritance.pipelineStatistics = Profiler ? Profiler->inheritedStatistics() : 0;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording layer command buffer!");
+	}
+	layer.record(commandBuffer, frameSlot);
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record layer command buffer!");
+	}
+	layer.dirty[frameSlot] = 0;
+	++Stats.secondariesRecorded;
+}
+
+void CommandCache::recordPrimary(Primary &primary, uint32_t imageIndex, uint32_t frameSlot) {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	if (vkBeginCommandBuffer(primary.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+	if (Profiler) {
+		Profiler->begin(primary.commandBuffer, frameSlot, FrameScope);
+	}
+	for (const auto &prePass : PrePasses) {
+		if (Profiler) {
+			Profiler->begin(primary.commandBuffer, frameSlot, prePass.scope);
+		}
+		prePass.record(primary.commandBuffer, frameSlot);
+		if (Profiler) {
+			Profiler->end(primary.commandBuffer, frameSlot, prePass.scope);
+		}
+	}
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = RenderPass;
+	renderPassInfo.framebuffer = Framebuffers[imageIndex];
+	renderPassInfo.renderArea.offset = {0, 0};
+	renderPassInfo.renderArea.extent = Extent;
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(ClearValues.size());
+	renderPassInfo.pClearValues = ClearValues.data();
+	//queries can't begin inside the render pass and end outside it, so the scope goes around it
+	if (Profiler) {
+		Profiler->begin(primary.commandBuffer, frameSlot, RenderPassScope);
+	}
+	vkCmdBeginRenderPass(primary.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	std::vector<VkCommandBuffer> secondaries;
+	for (const auto &layer : Layers) {
+		secondaries.insert(secondaries.end(), layer.executed[frameSlot].begin(), layer.executed[frameSlot].end());
+	}
+	if (!secondaries.empty()) {
+		vkCmdExecuteCommands(primary.commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+	}
+
+	vkCmdEndRenderPass(primary.commandBuffer);
+	if (Profiler) {
+		Profiler->end(primary.commandBuffer, frameSlot, RenderPassScope);
+		Profiler->end(primary.commandBuffer, frameSlot, FrameScope);
+	}
+	if (vkEndCommandBuffer(primary.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+	primary.generation = Generation;
+	++Stats.primariesRecorded;
+}
+
+VkCommandBuffer CommandCache::acquire(uint32_t imageIndex, uint32_t frameSlot) {
+	PROFILE_ZONE("record");
+	++Stats.frames;
+	for (auto &layer : Layers) {
+		if (layer.dirty[frameSlot]) {
+			recordLayer(layer, frameSlot);
+		}
+	}
+	Primary &primary = Primaries[imageIndex * FrameSlots + frameSlot];
+	if (primary.generation != Generation) {
+		recordPrimary(primary, imageIndex, frameSlot);
+	}
+	return primary.commandBuffer;
+}
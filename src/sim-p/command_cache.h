@@ -0,0 +1,105 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "gpu_profiler.h"
+#include "parallel_recorder.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CommandCacheStats {
+	uint64_t frames;
+	uint64_t primariesRecorded;
+	uint64_t secondariesRecorded;
+};
+
+// Keeps the frame's command buffers around and replays them until something
+// they reference changes. Scene content lives in layers: one secondary
+// command buffer per frame slot, recorded inside the render pass by the
+// layer's callback and only re-recorded after markDirty(). Parallel layers
+// split their draw list over the recording threads instead, one secondary
+// per slice, executed in draw order. The primaries (one per swapchain image
+// and frame slot) run the pre-passes, then the render pass executing the
+// layers, they are re-recorded whenever a layer or the targets change. A
+// command buffer is only ever re-recorded from acquire() for its own frame
+// slot, so once the frame pacer has handed that slot out again nothing touched is
+// still pending. With a profiler set the primaries time the whole frame, each
+// pre-pass and the render pass as named GPU scopes.
+class CommandCache {
+public:
+	// records a layer's commands for frameSlot, viewport and scissor must be set here,
+	// dynamic state isn't inherited from the primary
+	typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t frameSlot)> RecordLayer;
+public:
+	CommandCache();
+	~CommandCache();
+	// recordWorkers is how many threads, the caller included, record each parallel layer
+	void init(VkDevice device, uint32_t queueFamily, uint32_t frameSlots, uint32_t recordWorkers);
+	void shutdown();
+	// layers are executed in the order they were added
+	uint32_t addLayer(RecordLayer record);
+	// drawCount is asked for the size of the frame slot's draw list every time the layer is recorded
+	uint32_t addParallelLayer(std::function<size_t(uint32_t frameSlot)> drawCount, ParallelRecorder::RecordSlice recordSlice);
+	// recorded straight into the primaries ahead of the render pass, for work the layers consume such as
+	// compute passes. Whatever it records has to stay valid for as long as the primaries are replayed.
+	// name is the pass's profiler scope
+	void addPrePass(const std::string &name, RecordLayer record);
+	// profiler has to be initialized for the same frame slots and outlive the cache, nullptr stops timing
+	void setProfiler(GpuProfiler *profiler);
+	void markDirty(uint32_t layer);
+	// everything is re-recorded, e.g. after the swapchain was recreated. The device must be idle.
+	void setTargets(VkRenderPass renderPass, const std::vector<VkFramebuffer> &framebuffers, VkExtent2D extent
+			, const std::vector<VkClearValue> &clearValues);
+	// the primary for imageIndex in frameSlot, re-recording whatever went stale
+	VkCommandBuffer acquire(uint32_t imageIndex, uint32_t frameSlot);
+	CommandCacheStats stats() const { return Stats; }
+private:
+	struct Layer {
+		RecordLayer record;
+		std::vector<VkCommandBuffer> secondaries;
+		//set for parallel layers only
+		std::function<size_t(uint32_t frameSlot)> drawCount;
+		ParallelRecorder::RecordSlice recordSlice;
+		std::unique_ptr<ParallelRecorder> recorder;
+		//what the primaries execute, per frame slot
+		std::vector<std::vector<VkCommandBuffer>> executed;
+		std::vector<uint8_t> dirty;
+	};
+	struct PrePass {
+		std::string name;
+		RecordLayer record;
+		//the profiler's, when one is set
+		uint32_t scope;
+	};
+	struct Primary {
+		VkCommandBuffer commandBuffer;
+		//Generation it was recorded at
+		uint64_t generation;
+	};
+	void allocate(VkCommandBufferLevel level, uint32_t count, VkCommandBuffer *commandBuffers);
+	void recordLayer(Layer &layer, uint32_t frameSlot);
+	void recordPrimary(Primary &primary, uint32_t imageIndex, uint32_t frameSlot);
+	void freePrimaries();
+private:
+	VkDevice Device;
+	VkCommandPool CommandPool;
+	uint32_t QueueFamily;
+	uint32_t FrameSlots;
+	uint32_t RecordWorkers;
+	VkRenderPass RenderPass;
+	std::vector<VkFramebuffer> Framebuffers;
+	VkExtent2D Extent;
+	std::vector<VkClearValue> ClearValues;
+	std::vector<PrePass> PrePasses;
+	std::vector<Layer> Layers;
+	GpuProfiler *Profiler;
+	uint32_t FrameScope;
+	uint32_t RenderPassScope;
+	//indexed by imageIndex * FrameSlots + frameSlot
+	std::vector<Primary> Primaries;
+	//bumped on every change that makes the recorded primaries stale
+	uint64_t Generation;
+	CommandCacheStats Stats;
+};
@@ -0,0 +1,174 @@
+#include "cpu_profiler.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+	struct Chunk {
+		//zones below it are written, the owning thread publishes it after each one
+		std::atomic<size_t> count{0};
+		std::atomic<Chunk *> next{nullptr};
+		CpuProfilerZone zones[CpuProfiler::ZONES_PER_CHUNK];
+	};
+
+	struct ThreadBuffer {
+		uint32_t id = 0;
+		std::atomic<const char *> name{nullptr};
+		std::atomic<Chunk *> head{nullptr};
+		//only the owning thread touches these two
+		Chunk *tail = nullptr;
+		size_t chunks = 0;
+		std::atomic<uint64_t> dropped{0};
+
+		~ThreadBuffer() {
+			Chunk *chunk = head.load(std::memory_order_relaxed);
+			while (chunk) {
+				Chunk *next = chunk->next.load(std::memory_order_relaxed);
+				delete chunk;
+				chunk = next;
+			}
+		}
+	};
+
+	//buffers outlive their threads, whatever a thread recorded before it exited is still written out
+	std::mutex RegistryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> Buffers;
+	thread_local ThreadBuffer *LocalBuffer = nullptr;
+	//when enable() was called, on both clocks
+	uint64_t OriginTicks = 0;
+	std::chrono::steady_clock::time_point OriginTime;
+	//the shortest span the TSC is calibrated over
+	const double MIN_CALIBRATION_US = 10000.0;
+
+	ThreadBuffer *localBuffer() {
+		if (!LocalBuffer) {
+			auto buffer = std::make_unique<ThreadBuffer>();
+			std::lock_guard<std::mutex> lock(RegistryMutex);
+			buffer->id = static_cast<uint32_t>(Buffers.size());
+			LocalBuffer = buffer.get();
+			Buffers.push_back(std::move(buffer));
+		}
+		return LocalBuffer;
+	}
+
+	//the first is allocated on the first zone, so threads that never record one cost next to nothing
+	Chunk *addChunk(ThreadBuffer &buffer) {
+		if (buffer.chunks * CpuProfiler::ZONES_PER_CHUNK >= CpuProfiler::MAX_ZONES_PER_THREAD) {
+			return nullptr;
+		}
+		Chunk *chunk = new Chunk;
+		if (!buffer.tail) {
+			buffer.head.store(chunk, std::memory_order_release);
+		} else {
+			buffer.tail->next.store(chunk, std::memory_order_release);
+		}
+		buffer.tail = chunk;
+		++buffer.chunks;
+		return chunk;
+	}
+
+	void writeString(FILE *file, const char *s) {
+		fputc('"', file);
+		for (; *s; ++s) {
+			if (*s == '"' || *s == '\\') {
+				fputc('\\', file);
+			}
+			fputc(*s, file);
+		}
+		fputc('"', file);
+	}
+}
+
+std::atomic<bool> CpuProfiler::Enabled(false);
+
+void CpuProfiler::enable() {
+	OriginTime = std::chrono::steady_clock::now();
+	OriginTicks = now();
+	Enabled.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::setThreadName(const char *name) {
+	localBuffer()->name.store(name, std::memory_order_relaxed);
+}
+
+//the calling thread's chunk is full, or it has none yet
+void CpuProfiler::recordInNewChunk(const char *name, uint64_t begin, uint64_t end) {
+	ThreadBuffer *buffer = localBuffer();
+	Chunk *chunk = addChunk(*buffer);
+	if (!chunk) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	chunk->zones[0] = {name, begin, end};
+	chunk->count.store(1, std::memory_order_release);
+	Local = Cursor{chunk->zones + 1, chunk->zones + ZONES_PER_CHUNK, chunk->zones, &chunk->count};
+}
+
+bool CpuProfiler::writeTrace(const std::string &path) {
+	if (!enabled()) {
+		return false;
+	}
+	//ticks per microsecond over everything since enable(), given a span long enough to be meaningful
+	double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - OriginTime).count();
+	if (elapsedUs < MIN_CALIBRATION_US) {
+		std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(MIN_CALIBRATION_US - elapsedUs));
+	}
+	const uint64_t ticks = now() - OriginTicks;
+	elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - OriginTime).count();
+	const double ticksPerUs = static_cast<double>(ticks) / elapsedUs;
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+	bool first = true;
+	std::lock_guard<std::mutex> lock(RegistryMutex);
+	for (const auto &buffer : Buffers) {
+		const char *threadName = buffer->name.load(std::memory_order_relaxed);
+		if (threadName) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n"
+					, buffer->id);
+			writeString(file, threadName);
+			fputs("}}", file);
+			first = false;
+		}
+		//the owner only ever appends, what is published up to here stays as it is
+		const Chunk *chunk = buffer->head.load(std::memory_order_acquire);
+		for (; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+			const size_t count = chunk->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i) {
+				const CpuProfilerZone &zone = chunk->zones[i];
+				//zones begun before enable() was called on another thread would go negative
+				const double begin = static_cast<double>(static_cast<int64_t>(zone.begin - OriginTicks)) / ticksPerUs;
+				const double duration = static_cast<double>(zone.end - zone.begin) / ticksPerUs;
+				fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+				writeString(file, zone.name);
+				fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->id, begin, duration);
+				first = false;
+			}
+		}
+	}
+	fputs("\n]}\n", file);
+	return fclose(file) == 0;
+}
+
+CpuProfilerStats CpuProfiler::stats() {
+	CpuProfilerStats stats{};
+	std::lock_guard<std::mutex> lock(RegistryMutex);
+	stats.threads = static_cast<uint32_t>(Buffers.size());
+	for (const auto &buffer : Buffers) {
+		const Chunk *chunk = buffer->head.load(std::memory_order_acquire);
+		for (; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+			stats.zones += chunk->count.load(std::memory_order_acquire);
+		}
+		stats.dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	if (enabled()) {
+		const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - OriginTime).count();
+		stats.ticksPerUs = elapsedUs > 0.0 ? static_cast<double>(now() - OriginTicks) / elapsedUs : 0.0;
+	}
+	return stats;
+}
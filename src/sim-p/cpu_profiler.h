@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_TSC
+#endif
+
+struct CpuProfilerZone {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+struct CpuProfilerStats {
+	//threads that recorded a zone or were named
+	uint32_t threads;
+	uint64_t zones;
+	//recorded once a thread's buffer was full, left out of the trace
+	uint64_t dropped;
+	double ticksPerUs;
+};
+
+// Scoped CPU zones for the render loop and the threads around it, written
+// out as a Chrome trace, JSON which Perfetto opens as well. Each thread
+// appends to a buffer of its own found through a thread_local, so
+// recording a zone takes no lock and touches nothing another thread
+// writes: the buffer is a list of fixed size chunks the owning thread fills
+// and publishes a count for, writeTrace() only reads up to that count and
+// can run while the threads carry on. Zones are timed with the TSC where
+// there is one (steady_clock elsewhere), calibrated against steady_clock when
+// the trace is written. Nothing is recorded until enable(), and without
+// SIM_PROFILER the PROFILE_ macros compile to nothing at all.
+class CpuProfiler {
+public:
+	static const size_t ZONES_PER_CHUNK = 4096;
+	//past this a thread's zones are dropped and counted
+	static const size_t MAX_ZONES_PER_THREAD = 1 << 20;
+public:
+	static uint64_t now();
+	static bool enabled() { return Enabled.load(std::memory_order_relaxed); }
+	// whether this build has the zones in it at all
+	static bool compiledIn();
+	// starts recording, the trace's time 0
+	static void enable();
+	// the calling thread's track in the trace, name has to be a literal
+	static void setThreadName(const char *name);
+	// name has to be a literal, it's only read when the trace is written. Inline down to
+	// the end of a chunk, then a call to take the next one
+	static void record(const char *name, uint64_t begin, uint64_t end);
+	// every zone recorded so far, from any thread and while others keep recording
+	static bool writeTrace(const std::string &path);
+	static CpuProfilerStats stats();
+private:
+	//where the calling thread's next zone goes in the chunk it is filling, next == end until it has one
+	struct Cursor {
+		CpuProfilerZone *next;
+		CpuProfilerZone *end;
+		CpuProfilerZone *first;
+		std::atomic<size_t> *count;
+	};
+	static void recordInNewChunk(const char *name, uint64_t begin, uint64_t end);
+private:
+	static std::atomic<bool> Enabled;
+	//constant initialized, so the inline record() reaches it without a TLS wrapper call
+	static inline thread_local Cursor Local{nullptr, nullptr, nullptr, nullptr};
+};
+
+// Records its own lifetime as a zone, if the profiler was enabled when it began.
+class CpuZone {
+public:
+	explicit CpuZone(const char *name) : Name(name), Begin(CpuProfiler::enabled() ? CpuProfiler::now() : 0) {}
+	~CpuZone() {
+		if (Begin != 0) {
+			CpuProfiler::record(Name, Begin, CpuProfiler::now());
+		}
+	}
+	CpuZone(const CpuZone &) = delete;
+	CpuZone &operator=(const CpuZone &) = delete;
+private:
+	const char *Name;
+	//0 when not recording
+	uint64_t Begin;
+};
+
+inline uint64_t CpuProfiler::now() {
+#ifdef CPU_PROFILER_TSC
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+inline void CpuProfiler::record(const char *name, uint64_t begin, uint64_t end) {
+	CpuProfilerZone *zone = Local.next;
+	if (zone == Local.end) {
+		recordInNewChunk(name, begin, end);
+		return;
+	}
+	*zone = {name, begin, end};
+	Local.next = zone + 1;
+	//publishes the zone to writeTrace()
+	Local.count->store(static_cast<size_t>(Local.next - Local.first), std::memory_order_release);
+}
+
+inline bool CpuProfiler::compiledIn() {
+#ifdef SIM_PROFILER
+	return true;
+#else
+	return false;
+#endif
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef SIM_PROFILER
+//times the rest of the enclosing block, name has to be a literal
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD(name) CpuProfiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,14 @@
+#include "cull_defines.h"
+#include "mesh_simplify.h"
+#include "vertex_format.h"
+#include <string>
+
+//the cull pass copies the instances it keeps a word at a time
+static_assert(sizeof(InstanceTransform) % sizeof(uint32_t) == 0);
+//the first MAX_DRAWS invocations of a group clear its per draw counters, there have to be that many
+static_assert(MESH_MAX_LODS <= CULL_GROUP_SIZE);
+
+std::vector<ShaderDefine> cullShaderDefines() {
+	return {{"MAX_DRAWS", std::to_string(MESH_MAX_LODS)}, {"GROUP_SIZE", std::to_string(CULL_GROUP_SIZE)}
+		, {"INSTANCE_WORDS", std::to_string(sizeof(InstanceTransform) / sizeof(uint32_t))}};
+}
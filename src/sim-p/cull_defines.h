@@ -0,0 +1,12 @@
+#pragma once
+#include "shader_compiler.h"
+#include <cstdint>
+#include <vector>
+
+//instances per cull.comp work group
+const uint32_t CULL_GROUP_SIZE = 64;
+
+// What shaders/cull.comp has to be compiled with to match GpuCuller's
+// layout. Apart from GpuCuller so shader-bake can bake the same
+// permutation without linking anything that needs a device.
+std::vector<ShaderDefine> cullShaderDefines();
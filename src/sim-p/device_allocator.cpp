@@ -0,0 +1,301 @@
+#include "device_allocator.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+DeviceAllocator::DeviceAllocator() : Device(VK_NULL_HANDLE), MemoryProperties(), BufferImageGranularity(1), MaxAllocationCount(0)
+	, AllocationCount(0), Pools(), DedicatedBytes(), DedicatedCount(), Mutex() {
+
+}
+
+DeviceAllocator::~DeviceAllocator() {
+	shutdown();
+}
+
+void DeviceAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+	Device = device;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &MemoryProperties);
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	BufferImageGranularity = properties.limits.bufferImageGranularity;
+	MaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+	DedicatedBytes.assign(MemoryProperties.memoryTypeCount, 0);
+	DedicatedCount.assign(MemoryProperties.memoryTypeCount, 0);
+}
+
+void DeviceAllocator::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	for (auto &p : Pools) {
+		for (auto &block : p.blocks) {
+			if (block->tlsf.allocationCount() != 0) {
+				printf("device allocator: %u allocations leaked in memory type %u\n", block->tlsf.allocationCount(), p.memoryType);
+			}
+			vkFreeMemory(Device, block->memory, nullptr);
+		}
+	}
+	Pools.clear();
+	Device = VK_NULL_HANDLE;
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < MemoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1u << i)) && (MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool DeviceAllocator::hostVisible(uint32_t memoryType) const {
+	return (MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+VkDeviceSize DeviceAllocator::blockSize(uint32_t memoryType) const {
+	//small heaps (BAR windows, integrated carve outs) get proportionally smaller blocks
+	const VkDeviceSize heapSize = MemoryProperties.memoryHeaps[MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+	return heapSize / 8 < DEFAULT_BLOCK_SIZE ? heapSize / 8 : DEFAULT_BLOCK_SIZE;
+}
+
+DeviceAllocator::Pool &DeviceAllocator::pool(uint32_t memoryType, bool optimal) {
+	//with a granularity of 1 linear and optimal resources can share blocks freely
+	optimal = optimal && BufferImageGranularity > 1;
+	for (auto &p : Pools) {
+		if (p.memoryType == memoryType && p.optimal == optimal) {
+			return p;
+		}
+	}
+	Pools.push_back({memoryType, optimal, {}});
+	return Pools.back();
+}
+
+VkDeviceMemory DeviceAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, VkBuffer buffer, VkImage image) {
+	if (AllocationCount >= MaxAllocationCount) {
+		throw std::runtime_error("out of device memory allocations (maxMemoryAllocationCount)!");
+	}
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.buffer = buffer;
+	dedicatedInfo.image = image;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE) ? &dedicatedInfo : nullptr;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(Device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+	++AllocationCount;
+	return memory;
+}
+
+DeviceAllocation DeviceAllocator::allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType
+		, VkBuffer buffer, VkImage image) {
+	DeviceAllocation allocation{};
+	allocation.memory = allocateMemory(requirements.size, memoryType, buffer, image);
+	allocation.offset = 0;
+	allocation.size = requirements.size;
+	allocation.memoryType = memoryType;
+	allocation.block = nullptr;
+	allocation.handle = TlsfAllocator::NIL;
+	allocation.mapped = nullptr;
+	if (hostVisible(memoryType)) {
+		vkMapMemory(Device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+	}
+	DedicatedBytes[memoryType] += requirements.size;
+	++DedicatedCount[memoryType];
+	return allocation;
+}
+
+DeviceAllocation DeviceAllocator::allocate(const VkMemoryRequirements &requirements, bool dedicatedPreferred, bool optimal
+		, VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image) {
+	const uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	std::lock_guard<std::mutex> lock(Mutex);
+	const VkDeviceSize size = blockSize(memoryType);
+	if (dedicatedPreferred || requirements.size > size / 2) {
+		return allocateDedicated(requirements, memoryType, buffer, image);
+	}
+
+	Pool &p = pool(memoryType, optimal);
+	DeviceAllocation allocation{};
+	allocation.memoryType = memoryType;
+	allocation.size = requirements.size;
+	for (auto &block : p.blocks) {
+		uint32_t handle = block->tlsf.allocate(requirements.size, requirements.alignment, allocation.offset);
+		if (handle != TlsfAllocator::NIL) {
+			allocation.memory = block->memory;
+			allocation.block = block.get();
+			allocation.handle = handle;
+			allocation.mapped = block->mapped ? block->mapped + allocation.offset : nullptr;
+			return allocation;
+		}
+	}
+
+	auto block = std::make_unique<Block>();
+	block->memory = allocateMemory(size, memoryType, VK_NULL_HANDLE, VK_NULL_HANDLE);
+	block->mapped = nullptr;
+	if (hostVisible(memoryType)) {
+		void *mapped;
+		vkMapMemory(Device, block->memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		block->mapped = static_cast<uint8_t *>(mapped);
+	}
+	block->tlsf.init(size);
+	allocation.handle = block->tlsf.allocate(requirements.size, requirements.alignment, allocation.offset);
+	allocation.memory = block->memory;
+	allocation.block = block.get();
+	allocation.mapped = block->mapped ? block->mapped + allocation.offset : nullptr;
+	p.blocks.push_back(std::move(block));
+	return allocation;
+}
+
+void DeviceAllocator::free(DeviceAllocation &allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (allocation.block == nullptr) {
+		vkFreeMemory(Device, allocation.memory, nullptr);
+		--AllocationCount;
+		DedicatedBytes[allocation.memoryType] -= allocation.size;
+		--DedicatedCount[allocation.memoryType];
+	} else {
+		Block *block = static_cast<Block *>(allocation.block);
+		block->tlsf.free(allocation.handle);
+		if (block->tlsf.allocationCount() == 0) {
+			//keep one empty block per pool around so a load/unload cycle doesn't thrash vkAllocateMemory
+			for (auto &p : Pools) {
+				auto it = std::find_if(p.blocks.begin(), p.blocks.end(), [block](const auto &b) { return b.get() == block; });
+				if (it != p.blocks.end()) {
+					const bool otherEmpty = std::any_of(p.blocks.begin(), p.blocks.end(), [block](const auto &b) {
+						return b.get() != block && b->tlsf.allocationCount() == 0;
+					});
+					if (otherEmpty) {
+						vkFreeMemory(Device, block->memory, nullptr);
+						--AllocationCount;
+						p.blocks.erase(it);
+					}
+					break;
+				}
+			}
+		}
+	}
+	allocation = DeviceAllocation{};
+}
+
+void DeviceAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties
+		, VkBuffer &buffer, DeviceAllocation &allocation) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create buffer!");
+	}
+
+	VkMemoryDedicatedRequirements dedicated{};
+	dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicated;
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+	vkGetBufferMemoryRequirements2(Device, &requirementsInfo, &requirements);
+
+	try {
+		allocation = allocate(requirements.memoryRequirements, dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation
+				, false, properties, buffer, VK_NULL_HANDLE);
+	} catch (...) {
+		vkDestroyBuffer(Device, buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
+		throw;
+	}
+	vkBindBufferMemory(Device, buffer, allocation.memory, allocation.offset);
+}
+
+void DeviceAllocator::createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties
+		, VkImage &image, DeviceAllocation &allocation) {
+	if (vkCreateImage(Device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create image!");
+	}
+
+	VkMemoryDedicatedRequirements dedicated{};
+	dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicated;
+	VkImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+	vkGetImageMemoryRequirements2(Device, &requirementsInfo, &requirements);
+
+	//render targets are what drivers usually want dedicated, they also ask for it through the requirements
+	const bool attachment = (imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+	try {
+		allocation = allocate(requirements.memoryRequirements
+				, attachment || dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation
+				, imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL, properties, VK_NULL_HANDLE, image);
+	} catch (...) {
+		vkDestroyImage(Device, image, nullptr);
+		image = VK_NULL_HANDLE;
+		throw;
+	}
+	vkBindImageMemory(Device, image, allocation.memory, allocation.offset);
+}
+
+void DeviceAllocator::destroyBuffer(VkBuffer buffer, DeviceAllocation &allocation) {
+	vkDestroyBuffer(Device, buffer, nullptr);
+	free(allocation);
+}
+
+void DeviceAllocator::destroyImage(VkImage image, DeviceAllocation &allocation) {
+	vkDestroyImage(Device, image, nullptr);
+	free(allocation);
+}
+
+std::vector<HeapStats> DeviceAllocator::stats() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	std::vector<HeapStats> heaps(MemoryProperties.memoryHeapCount, HeapStats{});
+	for (uint32_t i = 0; i < MemoryProperties.memoryHeapCount; ++i) {
+		heaps[i].heapSize = MemoryProperties.memoryHeaps[i].size;
+	}
+	for (uint32_t type = 0; type < MemoryProperties.memoryTypeCount; ++type) {
+		HeapStats &h = heaps[MemoryProperties.memoryTypes[type].heapIndex];
+		h.blockBytes += DedicatedBytes[type];
+		h.usedBytes += DedicatedBytes[type];
+		h.dedicated += DedicatedCount[type];
+		h.allocations += DedicatedCount[type];
+	}
+	for (const auto &p : Pools) {
+		HeapStats &h = heaps[MemoryProperties.memoryTypes[p.memoryType].heapIndex];
+		for (const auto &block : p.blocks) {
+			h.blockBytes += block->tlsf.size();
+			h.usedBytes += block->tlsf.size() - block->tlsf.freeBytes();
+			h.freeBytes += block->tlsf.freeBytes();
+			h.largestFree = std::max(h.largestFree, block->tlsf.largestFree());
+			h.allocations += block->tlsf.allocationCount();
+			++h.blocks;
+		}
+	}
+	for (auto &h : heaps) {
+		h.fragmentation = h.freeBytes ? 1.0f - static_cast<float>(h.largestFree) / static_cast<float>(h.freeBytes) : 0.0f;
+	}
+	return heaps;
+}
+
+void DeviceAllocator::logStats() const {
+	std::vector<HeapStats> heaps = stats();
+	for (size_t i = 0; i < heaps.size(); ++i) {
+		const HeapStats &h = heaps[i];
+		printf("heap %zu: %llu/%llu MB reserved, %llu KB used, %u blocks, %u dedicated, %u allocations, fragmentation %.2f\n"
+				, i, static_cast<unsigned long long>(h.blockBytes >> 20), static_cast<unsigned long long>(h.heapSize >> 20)
+				, static_cast<unsigned long long>(h.usedBytes >> 10), h.blocks, h.dedicated, h.allocations
+				, static_cast<double>(h.fragmentation));
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "tlsf.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct DeviceAllocation {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	// set for host visible memory, already offset to the start of the allocation
+	void *mapped;
+	uint32_t memoryType;
+	// owning block, nullptr for dedicated allocations
+	void *block;
+	uint32_t handle;
+};
+
+struct HeapStats {
+	VkDeviceSize heapSize;
+	VkDeviceSize blockBytes; // everything allocated from Vulkan, blocks and dedicated
+	VkDeviceSize usedBytes;
+	VkDeviceSize freeBytes; // free space inside blocks
+	VkDeviceSize largestFree;
+	uint32_t blocks;
+	uint32_t dedicated;
+	uint32_t allocations;
+	// 0 when the free space is one contiguous range, towards 1 the more it is split up
+	float fragmentation;
+};
+
+// Sub-allocates buffers and images out of large per memory type blocks, each
+// carved up by a TLSF allocator, so resource count isn't bounded by
+// maxMemoryAllocationCount. Large resources, and ones the driver asks to have
+// their own memory, get a dedicated allocation. Linear and optimal resources
+// come from separate blocks when bufferImageGranularity would otherwise have
+// to be honoured between neighbours. Host visible blocks stay mapped for
+// their lifetime. Thread safe.
+class DeviceAllocator {
+public:
+	static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+public:
+	DeviceAllocator();
+	~DeviceAllocator();
+	void init(VkPhysicalDevice physicalDevice, VkDevice device);
+	// frees every block, all allocations must have been released
+	void shutdown();
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties
+			, VkBuffer &buffer, DeviceAllocation &allocation);
+	void createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties
+			, VkImage &image, DeviceAllocation &allocation);
+	void destroyBuffer(VkBuffer buffer, DeviceAllocation &allocation);
+	void destroyImage(VkImage image, DeviceAllocation &allocation);
+	void free(DeviceAllocation &allocation);
+	std::vector<HeapStats> stats() const;
+	void logStats() const;
+	const VkPhysicalDeviceMemoryProperties &memoryProperties() const { return MemoryProperties; }
+private:
+	struct Block {
+		VkDeviceMemory memory;
+		uint8_t *mapped;
+		TlsfAllocator tlsf;
+	};
+	struct Pool {
+		uint32_t memoryType;
+		bool optimal;
+		std::vector<std::unique_ptr<Block>> blocks;
+	};
+	DeviceAllocation allocate(const VkMemoryRequirements &requirements, bool dedicatedPreferred, bool optimal
+			, VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image);
+	DeviceAllocation allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType
+			, VkBuffer buffer, VkImage image);
+	VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, VkBuffer buffer, VkImage image);
+	Pool &pool(uint32_t memoryType, bool optimal);
+	VkDeviceSize blockSize(uint32_t memoryType) const;
+	bool hostVisible(uint32_t memoryType) const;
+private:
+	VkDevice Device;
+	VkPhysicalDeviceMemoryProperties MemoryProperties;
+	VkDeviceSize BufferImageGranularity;
+	uint32_t MaxAllocationCount;
+	uint32_t AllocationCount;
+	std::vector<Pool> Pools;
+	std::vector<VkDeviceSize> DedicatedBytes;
+	std::vector<uint32_t> DedicatedCount;
+	mutable std::mutex Mutex;
+};
@@ -0,0 +1,256 @@
+#include "frame_pacer.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+	//a present not seen by then is given up on, a minimized window or a lost swap chain shouldn't hang drain()
+	const auto PRESENT_WAIT_LIMIT = std::chrono::seconds(1);
+	//between polls of a present, the swap chain can't be held for longer without holding up the next present
+	const auto PRESENT_POLL_INTERVAL = std::chrono::microseconds(250);
+
+	double msSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	struct PresentModeName {
+		VkPresentModeKHR mode;
+		const char *name;
+	};
+
+	const PresentModeName PRESENT_MODES[] = {
+		{VK_PRESENT_MODE_FIFO_KHR, "fifo"},
+		{VK_PRESENT_MODE_FIFO_RELAXED_KHR, "fifo-relaxed"},
+		{VK_PRESENT_MODE_MAILBOX_KHR, "mailbox"},
+		{VK_PRESENT_MODE_IMMEDIATE_KHR, "immediate"},
+	};
+}
+
+FramePacer::FramePacer() : Device(VK_NULL_HANDLE), Timeline(VK_NULL_HANDLE), Slots(), CurrentSlot(0), Submitted(0), SubmitTime()
+	, PresentWait(nullptr), QueueMutex(nullptr), TimingThread(), Mutex(), Wake(), Idle(), Pending(), Busy(false), Stopping(false)
+	, Latencies(), NextLatency(0), LatencySumMs(0.0), Stats() {
+
+}
+
+FramePacer::~FramePacer() {
+	shutdown();
+}
+
+void FramePacer::init(VkDevice device, uint32_t framesInFlight, PFN_vkWaitForPresentKHR presentWait, std::mutex *queueMutex) {
+	Device = device;
+	PresentWait = presentWait;
+	QueueMutex = queueMutex;
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+	if (vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &Timeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create frame timeline semaphore!");
+	}
+
+	VkSemaphoreCreateInfo binaryInfo{};
+	binaryInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	Slots.resize(clampFramesInFlight(framesInFlight));
+	for (Slot &slot : Slots) {
+		if (vkCreateSemaphore(Device, &binaryInfo, nullptr, &slot.imageAvailable) != VK_SUCCESS ||
+				vkCreateSemaphore(Device, &binaryInfo, nullptr, &slot.renderFinished) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create semaphores!");
+		}
+		slot.value = 0;
+	}
+	//the first beginFrame() moves on to slot 0
+	CurrentSlot = static_cast<uint32_t>(Slots.size()) - 1;
+	Submitted = 0;
+	Latencies.clear();
+	Latencies.reserve(LATENCY_WINDOW);
+	NextLatency = 0;
+	LatencySumMs = 0.0;
+	Stats = FramePacingStats{};
+	Stats.presentWait = PresentWait != nullptr;
+	Stopping = false;
+	TimingThread = std::thread(&FramePacer::timeLoop, this);
+}
+
+void FramePacer::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	Wake.notify_all();
+	if (TimingThread.joinable()) {
+		TimingThread.join();
+	}
+	for (Slot &slot : Slots) {
+		vkDestroySemaphore(Device, slot.imageAvailable, nullptr);
+		vkDestroySemaphore(Device, slot.renderFinished, nullptr);
+	}
+	Slots.clear();
+	vkDestroySemaphore(Device, Timeline, nullptr);
+	Timeline = VK_NULL_HANDLE;
+	Device = VK_NULL_HANDLE;
+}
+
+uint32_t FramePacer::beginFrame() {
+	CurrentSlot = (CurrentSlot + 1) % static_cast<uint32_t>(Slots.size());
+	const uint64_t value = Slots[CurrentSlot].value;
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(Device, Timeline, &completedValue);
+	if (completedValue < value) {
+		PROFILE_ZONE("fence wait");
+		const auto start = std::chrono::steady_clock::now();
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &Timeline;
+		waitInfo.pValues = &value;
+		vkWaitSemaphores(Device, &waitInfo, UINT64_MAX);
+		std::lock_guard<std::mutex> lock(Mutex);
+		++Stats.waits;
+		Stats.waitMs += msSince(start);
+	}
+	return CurrentSlot;
+}
+
+uint64_t FramePacer::submitting() {
+	Slots[CurrentSlot].value = ++Submitted;
+	SubmitTime = std::chrono::steady_clock::now();
+	return Submitted;
+}
+
+uint64_t FramePacer::completed() const {
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(Device, Timeline, &value);
+	return value;
+}
+
+void FramePacer::endFrame(VkSwapchainKHR swapChain) {
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Pending.push_back({Submitted, swapChain, swapChain != VK_NULL_HANDLE ? presentId() : 0, SubmitTime});
+		++Stats.frames;
+	}
+	Wake.notify_one();
+}
+
+void FramePacer::drain() {
+	std::unique_lock<std::mutex> lock(Mutex);
+	Idle.wait(lock, [this]() { return Pending.empty() && !Busy; });
+}
+
+FramePacingStats FramePacer::stats() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	FramePacingStats stats = Stats;
+	if (stats.latencySamples != 0) {
+		stats.latencyMeanMs = LatencySumMs / static_cast<double>(stats.latencySamples);
+		std::vector<float> sorted = Latencies;
+		std::sort(sorted.begin(), sorted.end());
+		stats.latencyP50Ms = sorted[sorted.size() / 2];
+		stats.latencyP99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+	}
+	return stats;
+}
+
+uint32_t FramePacer::clampFramesInFlight(uint32_t framesInFlight) {
+	if (framesInFlight == 0) {
+		return 1;
+	}
+	return framesInFlight < MAX_FRAMES_IN_FLIGHT ? framesInFlight : MAX_FRAMES_IN_FLIGHT;
+}
+
+bool FramePacer::presentMode(const std::string &name, VkPresentModeKHR &mode) {
+	for (const PresentModeName &known : PRESENT_MODES) {
+		if (name == known.name) {
+			mode = known.mode;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *FramePacer::presentModeName(VkPresentModeKHR mode) {
+	for (const PresentModeName &known : PRESENT_MODES) {
+		if (mode == known.mode) {
+			return known.name;
+		}
+	}
+	return "unknown";
+}
+
+void FramePacer::timeLoop() {
+	PROFILE_THREAD("frame timing");
+	for (;;) {
+		PendingFrame frame;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Wake.wait(lock, [this]() { return Stopping || !Pending.empty(); });
+			if (Stopping) {
+				Pending.clear();
+				Idle.notify_all();
+				break;
+			}
+			frame = Pending.front();
+			Pending.pop_front();
+			Busy = true;
+		}
+		bool seen = false;
+		if (frame.presentId != 0) {
+			seen = waitForPresent(frame);
+		} else {
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &Timeline;
+			waitInfo.pValues = &frame.value;
+			seen = vkWaitSemaphores(Device, &waitInfo, UINT64_MAX) == VK_SUCCESS;
+		}
+		const double ms = msSince(frame.submitTime);
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (seen) {
+				addSample(ms);
+			}
+			Busy = false;
+		}
+		Idle.notify_all();
+	}
+}
+
+bool FramePacer::waitForPresent(const PendingFrame &frame) {
+	const auto start = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - start < PRESENT_WAIT_LIMIT) {
+		VkResult result;
+		{
+			std::lock_guard<std::mutex> lock(*QueueMutex);
+			result = PresentWait(Device, frame.swapChain, frame.presentId, 0);
+		}
+		if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+			return true;
+		}
+		//out of date or lost, the frame was never going to be seen
+		if (result != VK_TIMEOUT) {
+			return false;
+		}
+		std::this_thread::sleep_for(PRESENT_POLL_INTERVAL);
+	}
+	return false;
+}
+
+//called with Mutex held
+void FramePacer::addSample(double ms) {
+	++Stats.latencySamples;
+	LatencySumMs += ms;
+	Stats.latencyMaxMs = std::max(Stats.latencyMaxMs, ms);
+	if (Latencies.size() < LATENCY_WINDOW) {
+		Latencies.push_back(static_cast<float>(ms));
+	} else {
+		Latencies[NextLatency] = static_cast<float>(ms);
+		NextLatency = (NextLatency + 1) % LATENCY_WINDOW;
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FramePacingStats {
+	uint64_t frames;
+	//beginFrame() found the slot's last frame still on the GPU
+	uint64_t waits;
+	double waitMs;
+	//from each submit until the frame was on screen, or until the GPU finished it where that can't be seen
+	uint64_t latencySamples;
+	double latencyMeanMs;
+	double latencyMaxMs;
+	//over the most recent samples only
+	double latencyP50Ms;
+	double latencyP99Ms;
+	bool presentWait;
+};
+
+// Paces the render loop against the GPU. Every frame's submit signals the
+// next value of one timeline semaphore and a slot is only reused once the
+// frame that last used it has reached its value, so how many frames are in
+// flight is a runtime choice and there is no fence per frame to reset.
+// Acquire and present can't take a timeline semaphore, so each slot keeps a
+// binary pair for those.
+// A thread of its own times each frame from its submit until it was presented
+// when the device has VK_KHR_present_wait, or until the GPU finished it when
+// it doesn't (and when headless, where nothing is presented).
+class FramePacer {
+public:
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+	//recent latencies the percentiles are taken over
+	static const size_t LATENCY_WINDOW = 1024;
+public:
+	FramePacer();
+	~FramePacer();
+	// presentWait is the device's vkWaitForPresentKHR, nullptr without VK_KHR_present_wait.
+	// Waiting on a present uses the swap chain, so it happens under queueMutex like the presents themselves
+	void init(VkDevice device, uint32_t framesInFlight, PFN_vkWaitForPresentKHR presentWait, std::mutex *queueMutex);
+	void shutdown();
+	uint32_t framesInFlight() const { return static_cast<uint32_t>(Slots.size()); }
+	// the slot for the next frame, once the frame that last used it is done on the GPU
+	uint32_t beginFrame();
+	VkSemaphore imageAvailable(uint32_t slot) const { return Slots[slot].imageAvailable; }
+	VkSemaphore renderFinished(uint32_t slot) const { return Slots[slot].renderFinished; }
+	VkSemaphore timeline() const { return Timeline; }
+	// right before the frame's submit, which has to signal timeline() with the value returned.
+	// A frame begun and dropped before submitting (an out of date swap chain) never calls it
+	uint64_t submitting();
+	// the value the last submitted frame signals, anything that frame used is free once completed() reaches it
+	uint64_t submitted() const { return Submitted; }
+	// the value of the last frame the GPU has finished
+	uint64_t completed() const;
+	// the id to present the frame with in a VkPresentIdKHR, 0 for none
+	uint64_t presentId() const { return PresentWait ? Submitted : 0; }
+	// after the frame's present, or after its submit with VK_NULL_HANDLE when nothing is presented
+	void endFrame(VkSwapchainKHR swapChain);
+	// waits until every frame ended has been timed, before the swap chain they were presented to goes away
+	void drain();
+	FramePacingStats stats() const;
+	// between 1 and MAX_FRAMES_IN_FLIGHT
+	static uint32_t clampFramesInFlight(uint32_t framesInFlight);
+	// names as given on the command line: fifo, fifo-relaxed, mailbox, immediate
+	static bool presentMode(const std::string &name, VkPresentModeKHR &mode);
+	static const char *presentModeName(VkPresentModeKHR mode);
+private:
+	struct Slot {
+		VkSemaphore imageAvailable;
+		VkSemaphore renderFinished;
+		//signalled by the last frame submitted from this slot
+		uint64_t value;
+	};
+	struct PendingFrame {
+		uint64_t value;
+		VkSwapchainKHR swapChain;
+		uint64_t presentId;
+		std::chrono::steady_clock::time_point submitTime;
+	};
+	void timeLoop();
+	bool waitForPresent(const PendingFrame &frame);
+	void addSample(double ms);
+private:
+	VkDevice Device;
+	VkSemaphore Timeline;
+	std::vector<Slot> Slots;
+	uint32_t CurrentSlot;
+	uint64_t Submitted;
+	std::chrono::steady_clock::time_point SubmitTime;
+	PFN_vkWaitForPresentKHR PresentWait;
+	std::mutex *QueueMutex;
+	std::thread TimingThread;
+	mutable std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Idle;
+	std::deque<PendingFrame> Pending;
+	bool Busy;
+	bool Stopping;
+	std::vector<float> Latencies;
+	size_t NextLatency;
+	double LatencySumMs;
+	FramePacingStats Stats;
+};
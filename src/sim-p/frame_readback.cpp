@@ -0,0 +1,213 @@
+#include "frame_readback.h"
+#include "cpu_profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+	const uint32_t BYTES_PER_PIXEL = 4;
+
+	double msSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//cached memory makes the CPU's reads of the frame fast, not every device has it host coherent
+	VkMemoryPropertyFlags readbackMemory(const DeviceAllocator &allocator) {
+		const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			| VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		const VkPhysicalDeviceMemoryProperties &properties = allocator.memoryProperties();
+		for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+			if ((properties.memoryTypes[i].propertyFlags & cached) == cached) {
+				return cached;
+			}
+		}
+		return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+}
+
+FrameReadback::FrameReadback() : Device(VK_NULL_HANDLE), Allocator(nullptr), Extent(), Format(VK_FORMAT_UNDEFINED), FrameSize(0)
+	, Timeline(VK_NULL_HANDLE), Callback(), Slots(), NextSlot(0), NextValue(0), DeliveryThread(), Mutex(), Wake(), Delivered()
+	, Submitted(), Stopping(false), Stats() {
+
+}
+
+FrameReadback::~FrameReadback() {
+	shutdown();
+}
+
+void FrameReadback::init(VkDevice device, DeviceAllocator *allocator, VkExtent2D extent, VkFormat format, uint32_t slots
+		, ReadbackCallback callback) {
+	Device = device;
+	Allocator = allocator;
+	Extent = extent;
+	Format = format;
+	FrameSize = VkDeviceSize{extent.width} * extent.height * BYTES_PER_PIXEL;
+	Callback = std::move(callback);
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+	if (vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &Timeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create readback timeline semaphore!");
+	}
+
+	const VkMemoryPropertyFlags properties = readbackMemory(*Allocator);
+	Slots.resize(slots);
+	for (Slot &slot : Slots) {
+		Allocator->createBuffer(FrameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
+		slot.value = 0;
+		slot.busy = false;
+	}
+	NextSlot = 0;
+	NextValue = 0;
+	Stopping = false;
+	DeliveryThread = std::thread(&FrameReadback::deliverLoop, this);
+}
+
+void FrameReadback::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	Wake.notify_all();
+	if (DeliveryThread.joinable()) {
+		DeliveryThread.join();
+	}
+	for (Slot &slot : Slots) {
+		Allocator->destroyBuffer(slot.buffer, slot.memory);
+	}
+	Slots.clear();
+	vkDestroySemaphore(Device, Timeline, nullptr);
+	Timeline = VK_NULL_HANDLE;
+	Device = VK_NULL_HANDLE;
+}
+
+uint32_t FrameReadback::acquire() {
+	const uint32_t index = NextSlot;
+	NextSlot = (NextSlot + 1) % static_cast<uint32_t>(Slots.size());
+	std::unique_lock<std::mutex> lock(Mutex);
+	if (Slots[index].busy) {
+		const auto start = std::chrono::steady_clock::now();
+		Delivered.wait(lock, [this, index]() { return !Slots[index].busy; });
+		++Stats.stalls;
+		Stats.stallMs += msSince(start);
+	}
+	Slots[index].busy = true;
+	Slots[index].value = ++NextValue;
+	return index;
+}
+
+void FrameReadback::recordCopy(VkCommandBuffer commandBuffer, VkImage image, uint32_t slot) const {
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	//0 packs the rows tightly
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {Extent.width, Extent.height, 1};
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Slots[slot].buffer, 1, &region);
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = Slots[slot].buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier
+			, 0, nullptr);
+}
+
+void FrameReadback::submitted(uint32_t slot) {
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Submitted.push_back(slot);
+	}
+	Wake.notify_one();
+}
+
+void FrameReadback::flush() {
+	std::unique_lock<std::mutex> lock(Mutex);
+	Delivered.wait(lock, [this]() { return Submitted.empty(); });
+}
+
+ReadbackStats FrameReadback::stats() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Stats;
+}
+
+void FrameReadback::deliverLoop() {
+	PROFILE_THREAD("readback");
+	for (;;) {
+		uint32_t index;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Wake.wait(lock, [this]() { return Stopping || !Submitted.empty(); });
+			//drains what was submitted before stopping, every slot's value gets signalled eventually
+			if (Submitted.empty()) {
+				break;
+			}
+			index = Submitted.front();
+		}
+		const Slot &slot = Slots[index];
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &Timeline;
+		waitInfo.pValues = &slot.value;
+		const bool copied = vkWaitSemaphores(Device, &waitInfo, UINT64_MAX) == VK_SUCCESS;
+
+		PROFILE_ZONE("deliver frame");
+		const auto start = std::chrono::steady_clock::now();
+		if (copied && Callback) {
+			const ReadbackFrame frame{slot.value - 1, Extent.width, Extent.height, Format, static_cast<const uint8_t *>(slot.memory.mapped)
+				, FrameSize};
+			Callback(frame);
+		}
+		const double deliverMs = msSince(start);
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Submitted.pop_front();
+			Slots[index].busy = false;
+			if (copied) {
+				++Stats.frames;
+				Stats.bytes += FrameSize;
+				Stats.deliverMs += deliverMs;
+			}
+		}
+		Delivered.notify_all();
+	}
+}
+
+bool writePpm(const std::string &path, const ReadbackFrame &frame) {
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	const bool bgra = frame.format == VK_FORMAT_B8G8R8A8_SRGB || frame.format == VK_FORMAT_B8G8R8A8_UNORM;
+	std::vector<uint8_t> row(size_t{frame.width} * 3);
+	bool ok = fprintf(file, "P6\n%u %u\n255\n", frame.width, frame.height) > 0;
+	for (uint32_t y = 0; ok && y < frame.height; ++y) {
+		const uint8_t *src = frame.pixels + size_t{y} * frame.width * BYTES_PER_PIXEL;
+		for (uint32_t x = 0; x < frame.width; ++x, src += BYTES_PER_PIXEL) {
+			row[x * 3] = bgra ? src[2] : src[0];
+			row[x * 3 + 1] = src[1];
+			row[x * 3 + 2] = bgra ? src[0] : src[2];
+		}
+		ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+	return (fclose(file) == 0) && ok;
+}
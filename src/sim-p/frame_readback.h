@@ -0,0 +1,91 @@
+#pragma once
+#include "device_allocator.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One rendered frame as read back, 4 bytes per pixel with tightly packed rows.
+// pixels is only valid during the callback it is handed to.
+struct ReadbackFrame {
+	uint64_t frame;
+	uint32_t width;
+	uint32_t height;
+	VkFormat format;
+	const uint8_t *pixels;
+	size_t size;
+};
+
+using ReadbackCallback = std::function<void(const ReadbackFrame &)>;
+
+struct ReadbackStats {
+	uint64_t frames;
+	uint64_t bytes;
+	//acquire() found the next slot still being delivered
+	uint64_t stalls;
+	double stallMs;
+	//in the callback, on the delivery thread
+	double deliverMs;
+};
+
+// Copies rendered frames into a ring of host visible buffers and hands them
+// to a callback on a thread of its own. Each frame's submit signals the
+// ring's timeline semaphore once its copy is done; the delivery thread
+// waits for that and runs the callback while the render loop is already
+// recording and submitting the frames after it. The render loop only waits
+// when every slot is still queued for delivery.
+class FrameReadback {
+public:
+	FrameReadback();
+	~FrameReadback();
+	// format has to be 4 bytes per pixel
+	void init(VkDevice device, DeviceAllocator *allocator, VkExtent2D extent, VkFormat format, uint32_t slots
+			, ReadbackCallback callback);
+	// delivers everything submitted, then frees the ring
+	void shutdown();
+	// the slot the next frame is copied into, waits while it is still being delivered
+	uint32_t acquire();
+	// after the render pass, with image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and its writes made available to transfers
+	void recordCopy(VkCommandBuffer commandBuffer, VkImage image, uint32_t slot) const;
+	// what the submit holding slot's copy signals
+	VkSemaphore timeline() const { return Timeline; }
+	uint64_t signalValue(uint32_t slot) const { return Slots[slot].value; }
+	// once the submit signalling slot's value is on the queue
+	void submitted(uint32_t slot);
+	// waits until everything submitted has been delivered
+	void flush();
+	ReadbackStats stats() const;
+private:
+	struct Slot {
+		VkBuffer buffer;
+		DeviceAllocation memory;
+		uint64_t value;
+		bool busy;
+	};
+	void deliverLoop();
+private:
+	VkDevice Device;
+	DeviceAllocator *Allocator;
+	VkExtent2D Extent;
+	VkFormat Format;
+	VkDeviceSize FrameSize;
+	VkSemaphore Timeline;
+	ReadbackCallback Callback;
+	std::vector<Slot> Slots;
+	uint32_t NextSlot;
+	uint64_t NextValue;
+	std::thread DeliveryThread;
+	mutable std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Delivered;
+	std::deque<uint32_t> Submitted;
+	bool Stopping;
+	ReadbackStats Stats;
+};
+
+// binary PPM, the alpha channel is dropped and BGRA is swizzled to RGB
+bool writePpm(const std::string &path, const ReadbackFrame &frame);
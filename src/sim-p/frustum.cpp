@@ -0,0 +1,30 @@
+#include "frustum.h"
+
+Frustum Frustum::fromViewProj(const glm::mat4 &viewProj) {
+	//glm is column major, these are the rows of the matrix
+	const glm::vec4 r0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+	const glm::vec4 r1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+	const glm::vec4 r2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+	const glm::vec4 r3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+	Frustum f;
+	f.planes[LEFT_PLANE] = r3 + r0;
+	f.planes[RIGHT_PLANE] = r3 - r0;
+	f.planes[BOTTOM_PLANE] = r3 + r1;
+	f.planes[TOP_PLANE] = r3 - r1;
+	f.planes[NEAR_PLANE] = r2;
+	f.planes[FAR_PLANE] = r3 - r2;
+	for (glm::vec4 &p : f.planes) {
+		p /= glm::length(glm::vec3(p));
+	}
+	return f;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const {
+	for (const glm::vec4 &p : planes) {
+		if (glm::dot(glm::vec3(p), center) + p.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// The six planes of a view frustum, normals pointing inwards and normalized
+// so plane distances are in world units. Planes are stored as (normal, d)
+// with dot(normal, p) + d >= 0 inside.
+struct Frustum {
+	enum Plane { LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	// from a projection * view matrix with a [0, 1] depth range
+	static Frustum fromViewProj(const glm::mat4 &viewProj);
+	// conservative, spheres straddling a corner outside every plane still count as visible
+	bool intersectsSphere(const glm::vec3 &center, float radius) const;
+};
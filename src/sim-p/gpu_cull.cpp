@@ -0,0 +1,222 @@
+#include "gpu_cull.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+GpuCuller::GpuCuller() : Device(VK_NULL_HANDLE), Allocator(nullptr), MaxInstances(0), DrawIndirectCount(false)
+	, MultiDrawIndirect(false), SetLayout(VK_NULL_HANDLE), DescriptorPool(VK_NULL_HANDLE), PipelineLayout(VK_NULL_HANDLE)
+	, Pipeline(VK_NULL_HANDLE), Slots(), Stats() {
+
+}
+
+GpuCuller::~GpuCuller() {
+	shutdown();
+}
+
+void GpuCuller::init(VkDevice device, DeviceAllocator *allocator, PipelineCache *pipelineCache, uint32_t frameSlots, uint32_t maxInstances
+		, const std::vector<uint32_t> &shaderCode, bool drawIndirectCount, bool multiDrawIndirect) {
+	Device = device;
+	Allocator = allocator;
+	MaxInstances = maxInstances;
+	DrawIndirectCount = drawIndirectCount;
+	MultiDrawIndirect = multiDrawIndirect;
+	createPipeline(shaderCode, pipelineCache);
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 3 * frameSlots;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = frameSlots;
+	if (vkCreateDescriptorPool(Device, &poolInfo, nullptr, &DescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull descriptor pool!");
+	}
+
+	const VkDeviceSize instanceBytes = sizeof(InstanceTransform) * VkDeviceSize{maxInstances};
+	Slots.resize(frameSlots);
+	for (Slot &slot : Slots) {
+		Allocator->createBuffer(instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.instances, slot.instancesMemory);
+		Allocator->createBuffer(instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+				, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.visible, slot.visibleMemory);
+		//tiny, and the CPU reads the counts back, so it stays host visible
+		Allocator->createBuffer(sizeof(CullControl), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.control, slot.controlMemory);
+		//nothing to cull or draw until the first update
+		memset(slot.controlMemory.mapped, 0, sizeof(CullControl));
+		slot.submitted = false;
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = DescriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &SetLayout;
+		if (vkAllocateDescriptorSets(Device, &allocInfo, &slot.descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate cull descriptor sets!");
+		}
+		const VkDescriptorBufferInfo bufferInfos[] = {{slot.control, 0, VK_WHOLE_SIZE}, {slot.instances, 0, VK_WHOLE_SIZE}
+			, {slot.visible, 0, VK_WHOLE_SIZE}};
+		VkWriteDescriptorSet writes[3]{};
+		for (uint32_t i = 0; i < 3; ++i) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = slot.descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(Device, 3, writes, 0, nullptr);
+	}
+}
+
+void GpuCuller::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	for (Slot &slot : Slots) {
+		Allocator->destroyBuffer(slot.control, slot.controlMemory);
+		Allocator->destroyBuffer(slot.visible, slot.visibleMemory);
+		Allocator->destroyBuffer(slot.instances, slot.instancesMemory);
+	}
+	Slots.clear();
+	vkDestroyDescriptorPool(Device, DescriptorPool, nullptr);
+	vkDestroyPipeline(Device, Pipeline, nullptr);
+	vkDestroyPipelineLayout(Device, PipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(Device, SetLayout, nullptr);
+	Device = VK_NULL_HANDLE;
+}
+
+std::vector<ShaderDefine> GpuCuller::shaderDefines() {
+	return cullShaderDefines();
+}
+
+void GpuCuller::createPipeline(const std::vector<uint32_t> &shaderCode, PipelineCache *pipelineCache) {
+	//control, instances, visible instances
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	for (uint32_t i = 0; i < 3; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &SetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull descriptor set layout!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &SetLayout;
+	if (vkCreatePipelineLayout(Device, &pipelineLayoutInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline layout!");
+	}
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+	moduleInfo.pCode = shaderCode.data();
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(Device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shader module!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = PipelineLayout;
+	PipelineFeedback feedback(1);
+	pipelineInfo.pNext = pipelineCache ? &feedback.info : nullptr;
+	const VkResult result = vkCreateComputePipelines(Device, pipelineCache ? pipelineCache->handle() : VK_NULL_HANDLE, 1, &pipelineInfo
+			, nullptr, &Pipeline);
+	vkDestroyShaderModule(Device, shaderModule, nullptr);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline!");
+	}
+	if (pipelineCache) {
+		pipelineCache->record("cull", feedback);
+	}
+}
+
+CullControl *GpuCuller::control(uint32_t frameSlot) const {
+	return static_cast<CullControl *>(Slots[frameSlot].controlMemory.mapped);
+}
+
+InstanceTransform *GpuCuller::instances(uint32_t frameSlot) const {
+	return static_cast<InstanceTransform *>(Slots[frameSlot].instancesMemory.mapped);
+}
+
+void GpuCuller::update(uint32_t frameSlot, const Frustum &frustum, const glm::vec4 &meshSphere, uint32_t instanceCount
+		, const std::vector<MeshLod> &lods, const std::vector<InstanceBatch> &batches) {
+	CullControl *c = control(frameSlot);
+	if (Slots[frameSlot].submitted) {
+		uint32_t drawn = 0;
+		for (uint32_t i = 0; i < c->drawCount; ++i) {
+			drawn += c->draws[i].instanceCount;
+		}
+		++Stats.frames;
+		Stats.instances += c->instanceCount;
+		Stats.drawn += drawn;
+		Stats.lastInstances = c->instanceCount;
+		Stats.lastDrawn = drawn;
+	}
+
+	memcpy(c->planes, frustum.planes, sizeof(c->planes));
+	c->meshSphere = meshSphere;
+	c->instanceCount = std::min(instanceCount, MaxInstances);
+	c->drawCount = static_cast<uint32_t>(std::min<size_t>(batches.size(), MESH_MAX_LODS));
+	//draws past drawCount stay empty, they still run when there is no draw count support
+	memset(c->draws, 0, sizeof(c->draws));
+	for (uint32_t i = 0; i < c->drawCount; ++i) {
+		const InstanceBatch &batch = batches[i];
+		c->batches[i] = glm::uvec4(batch.firstInstance, batch.instanceCount, 0, 0);
+		c->draws[i].indexCount = lods[batch.lod].indexCount;
+		c->draws[i].instanceCount = 0;
+		c->draws[i].firstIndex = lods[batch.lod].firstIndex;
+		c->draws[i].vertexOffset = 0;
+		c->draws[i].firstInstance = batch.firstInstance;
+	}
+	Slots[frameSlot].submitted = true;
+}
+
+void GpuCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t frameSlot) const {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, PipelineLayout, 0, 1
+			, &Slots[frameSlot].descriptorSet, 0, nullptr);
+	//sized for every instance, the shader skips the ones past this frame's count
+	vkCmdDispatch(commandBuffer, (MaxInstances + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+	//the draws read the counts and visible instances, the host reads the counts after the fence
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT
+			, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCuller::recordDraws(VkCommandBuffer commandBuffer, uint32_t frameSlot) const {
+	const VkBuffer control = Slots[frameSlot].control;
+	const VkDeviceSize drawsOffset = offsetof(CullControl, draws);
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (DrawIndirectCount) {
+		vkCmdDrawIndexedIndirectCount(commandBuffer, control, drawsOffset, control, offsetof(CullControl, drawCount)
+				, MESH_MAX_LODS, stride);
+	} else if (MultiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(commandBuffer, control, drawsOffset, MESH_MAX_LODS, stride);
+	} else {
+		for (uint32_t i = 0; i < MESH_MAX_LODS; ++i) {
+			vkCmdDrawIndexedIndirect(commandBuffer, control, drawsOffset + VkDeviceSize{stride} * i, 1, stride);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "agents.h"
+#include "cull_defines.h"
+#include "device_allocator.h"
+#include "frustum.h"
+#include "mesh_simplify.h"
+#include "pipeline_cache.h"
+#include "shader_compiler.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CullStats {
+	uint64_t frames;
+	uint64_t instances;
+	uint64_t drawn;
+	//the most recent frame tallied
+	uint32_t lastInstances;
+	uint32_t lastDrawn;
+};
+
+// Mirrors the CullControl block in shaders/cull.comp. The CPU writes
+// everything but the draws' instance counts, which the cull dispatch
+// accumulates, and the draws are consumed straight from here.
+struct CullControl {
+	glm::vec4 planes[Frustum::PLANE_COUNT];
+	glm::vec4 meshSphere;
+	uint32_t instanceCount;
+	uint32_t drawCount;
+	uint32_t reserved[2];
+	glm::uvec4 batches[MESH_MAX_LODS];
+	VkDrawIndexedIndirectCommand draws[MESH_MAX_LODS];
+};
+
+static_assert(offsetof(CullControl, batches) == 128 && offsetof(CullControl, draws) == 256);
+
+// GPU driven frustum culling for the instanced agents. Every frame slot has
+// the CPU written instances, sorted into one batch per level of detail, a
+// device local copy holding only the visible ones and a control block with
+// the frustum, batches and indirect draws. A compute pass tests each
+// instance's bounding sphere, compacts the survivors to the front of their
+// batch and counts them into the batch's draw. Both the dispatch and the
+// draws read everything that changes per frame from buffers, so the command
+// buffers recording them never have to change. Drawn counts are read back
+// once the slot's last frame has completed.
+class GpuCuller {
+public:
+	static const uint32_t GROUP_SIZE = CULL_GROUP_SIZE;
+public:
+	GpuCuller();
+	~GpuCuller();
+	// drawIndirectCount and multiDrawIndirect are whether those features were enabled on device,
+	// pipelineCache may be null
+	void init(VkDevice device, DeviceAllocator *allocator, PipelineCache *pipelineCache, uint32_t frameSlots, uint32_t maxInstances
+			, const std::vector<uint32_t> &shaderCode, bool drawIndirectCount, bool multiDrawIndirect);
+	// what shaders/cull.comp has to be compiled with to match this side's layout, see cullShaderDefines()
+	static std::vector<ShaderDefine> shaderDefines();
+	void shutdown();
+	// frameSlot's instances, written by the CPU before update()
+	InstanceTransform *instances(uint32_t frameSlot) const;
+	// once frameSlot's last frame has completed: tallies what its last cull drew and sets up the next one.
+	// meshSphere is the mesh's bounding sphere in model space, batches index lods
+	void update(uint32_t frameSlot, const Frustum &frustum, const glm::vec4 &meshSphere, uint32_t instanceCount
+			, const std::vector<MeshLod> &lods, const std::vector<InstanceBatch> &batches);
+	// outside a render pass, ahead of recordDraws
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t frameSlot) const;
+	// inside the render pass, with the mesh bound and visibleInstances() bound as the instance binding
+	void recordDraws(VkCommandBuffer commandBuffer, uint32_t frameSlot) const;
+	VkBuffer visibleInstances(uint32_t frameSlot) const { return Slots[frameSlot].visible; }
+	CullStats stats() const { return Stats; }
+private:
+	struct Slot {
+		VkBuffer instances;
+		DeviceAllocation instancesMemory;
+		VkBuffer visible;
+		DeviceAllocation visibleMemory;
+		VkBuffer control;
+		DeviceAllocation controlMemory;
+		VkDescriptorSet descriptorSet;
+		//set once the slot has been handed out for a frame, its counts are worth reading
+		bool submitted;
+	};
+	void createPipeline(const std::vector<uint32_t> &shaderCode, PipelineCache *pipelineCache);
+	CullControl *control(uint32_t frameSlot) const;
+private:
+	VkDevice Device;
+	DeviceAllocator *Allocator;
+	uint32_t MaxInstances;
+	bool DrawIndirectCount;
+	bool MultiDrawIndirect;
+	VkDescriptorSetLayout SetLayout;
+	VkDescriptorPool DescriptorPool;
+	VkPipelineLayout PipelineLayout;
+	VkPipeline Pipeline;
+	std::vector<Slot> Slots;
+	CullStats Stats;
+};
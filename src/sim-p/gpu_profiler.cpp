@@ -0,0 +1,233 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+	//counters per pipeline statistics query, one per bit of PIPELINE_STATISTICS
+	const uint32_t STATISTIC_COUNT = 6;
+}
+
+GpuProfiler::GpuProfiler() : Device(VK_NULL_HANDLE), Slots(), TimestampPeriod(1.0), TimestampMask(0), PipelineStatistics(false)
+	, InheritedQueries(false), BeginLabel(nullptr), EndLabel(nullptr), Scopes(), Results(), Mutex() {
+
+}
+
+GpuProfiler::~GpuProfiler() {
+	shutdown();
+}
+
+void GpuProfiler::init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameSlots
+		, bool pipelineStatistics, bool inheritedQueries) {
+	Device = device;
+	PipelineStatistics = pipelineStatistics;
+	InheritedQueries = inheritedQueries;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	TimestampPeriod = static_cast<double>(properties.limits.timestampPeriod);
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+	const uint32_t validBits = families[queueFamily].timestampValidBits;
+	TimestampMask = validBits == 0 ? 0 : validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+
+	//only there when VK_EXT_debug_utils is enabled on instance
+	BeginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+	EndLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+	if (!BeginLabel || !EndLabel) {
+		BeginLabel = nullptr;
+		EndLabel = nullptr;
+	}
+
+	Slots.resize(frameSlots);
+	for (Slot &slot : Slots) {
+		slot.timestamps = VK_NULL_HANDLE;
+		slot.statistics = VK_NULL_HANDLE;
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		if (TimestampMask != 0) {
+			poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			poolInfo.queryCount = MAX_SCOPES * 2;
+			if (vkCreateQueryPool(Device, &poolInfo, nullptr, &slot.timestamps) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timestamp query pool!");
+			}
+		}
+		if (PipelineStatistics) {
+			poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			poolInfo.queryCount = MAX_SCOPES;
+			poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+			if (vkCreateQueryPool(Device, &poolInfo, nullptr, &slot.statistics) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create pipeline statistics query pool!");
+			}
+		}
+		//queries have to be reset before their first use
+		reset(slot);
+	}
+	//begin() and end() read the scopes on the recording thread without the lock, they never move
+	Scopes.reserve(MAX_SCOPES);
+}
+
+void GpuProfiler::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	for (Slot &slot : Slots) {
+		vkDestroyQueryPool(Device, slot.timestamps, nullptr);
+		vkDestroyQueryPool(Device, slot.statistics, nullptr);
+	}
+	Slots.clear();
+	Device = VK_NULL_HANDLE;
+}
+
+uint32_t GpuProfiler::addScope(const std::string &name, bool statistics) {
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (Scopes.size() == MAX_SCOPES) {
+		throw std::runtime_error("failed to add GPU scope " + name + ", all " + std::to_string(MAX_SCOPES) + " are in use!");
+	}
+	Scope scope{};
+	scope.name = name;
+	scope.statistics = statistics && PipelineStatistics;
+	scope.recent.reserve(WINDOW);
+	Scopes.push_back(std::move(scope));
+	return static_cast<uint32_t>(Scopes.size() - 1);
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::inheritedStatistics() const {
+	return PipelineStatistics && InheritedQueries ? PIPELINE_STATISTICS : 0;
+}
+
+void GpuProfiler::reset(const Slot &slot) const {
+	if (slot.timestamps != VK_NULL_HANDLE) {
+		vkResetQueryPool(Device, slot.timestamps, 0, MAX_SCOPES * 2);
+	}
+	if (slot.statistics != VK_NULL_HANDLE) {
+		vkResetQueryPool(Device, slot.statistics, 0, MAX_SCOPES);
+	}
+}
+
+void GpuProfiler::beginFrame(uint32_t frameSlot) {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	const Slot &slot = Slots[frameSlot];
+	std::lock_guard<std::mutex> lock(Mutex);
+	const uint32_t scopes = static_cast<uint32_t>(Scopes.size());
+	//no wait flag, the frame is done; a query the frame never wrote (a dropped frame, a scope it skipped) isn't
+	//available and is left out, which is what VK_NOT_READY reports
+	const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+	if (slot.timestamps != VK_NULL_HANDLE && scopes != 0) {
+		//begin, its availability, end, its availability
+		Results.resize(size_t{scopes} * 4);
+		const VkResult result = vkGetQueryPoolResults(Device, slot.timestamps, 0, scopes * 2, Results.size() * sizeof(uint64_t)
+				, Results.data(), 2 * sizeof(uint64_t), flags);
+		if (result == VK_SUCCESS || result == VK_NOT_READY) {
+			for (uint32_t i = 0; i < scopes; ++i) {
+				const uint64_t *query = &Results[size_t{i} * 4];
+				if (query[1] != 0 && query[3] != 0) {
+					const uint64_t ticks = (query[2] - query[0]) & TimestampMask;
+					addSample(Scopes[i], static_cast<double>(ticks) * TimestampPeriod / 1e6);
+				}
+			}
+		}
+	}
+	if (slot.statistics != VK_NULL_HANDLE && scopes != 0) {
+		const size_t stride = STATISTIC_COUNT + 1;
+		Results.resize(scopes * stride);
+		const VkResult result = vkGetQueryPoolResults(Device, slot.statistics, 0, scopes, Results.size() * sizeof(uint64_t)
+				, Results.data(), stride * sizeof(uint64_t), flags);
+		if (result == VK_SUCCESS || result == VK_NOT_READY) {
+			for (uint32_t i = 0; i < scopes; ++i) {
+				const uint64_t *query = &Results[i * stride];
+				if (Scopes[i].statistics && query[STATISTIC_COUNT] != 0) {
+					//in the order of the bits
+					Scopes[i].pipeline = {query[0], query[1], query[2], query[3], query[4], query[5]};
+				}
+			}
+		}
+	}
+	reset(slot);
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope) const {
+	if (BeginLabel) {
+		VkDebugUtilsLabelEXT label{};
+		label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+		label.pLabelName = Scopes[scope].name.c_str();
+		BeginLabel(commandBuffer, &label);
+	}
+	const Slot &slot = Slots[frameSlot];
+	if (slot.timestamps != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.timestamps, scope * 2);
+	}
+	if (Scopes[scope].statistics) {
+		vkCmdBeginQuery(commandBuffer, slot.statistics, scope, 0);
+	}
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope) const {
+	const Slot &slot = Slots[frameSlot];
+	if (Scopes[scope].statistics) {
+		vkCmdEndQuery(commandBuffer, slot.statistics, scope);
+	}
+	if (slot.timestamps != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.timestamps, scope * 2 + 1);
+	}
+	if (EndLabel) {
+		EndLabel(commandBuffer);
+	}
+}
+
+std::vector<GpuScopeStats> GpuProfiler::stats() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	std::vector<GpuScopeStats> stats;
+	for (const Scope &scope : Scopes) {
+		if (!scope.seen) {
+			continue;
+		}
+		GpuScopeStats s{};
+		s.name = scope.name;
+		s.samples = scope.samples;
+		s.lastMs = scope.lastMs;
+		s.meanMs = scope.recentSumMs / static_cast<double>(scope.recent.size());
+		std::vector<float> sorted = scope.recent;
+		std::sort(sorted.begin(), sorted.end());
+		s.p50Ms = sorted[sorted.size() / 2];
+		s.p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+		s.maxMs = sorted.back();
+		s.histogram = scope.histogram;
+		s.statistics = scope.statistics;
+		s.pipeline = scope.pipeline;
+		stats.push_back(std::move(s));
+	}
+	return stats;
+}
+
+uint32_t GpuProfiler::bucket(double ms) {
+	uint32_t i = 0;
+	for (double limitUs = 1.0; i + 1 < GpuScopeStats::HISTOGRAM_BUCKETS && ms * 1000.0 >= limitUs; limitUs *= 2.0) {
+		++i;
+	}
+	return i;
+}
+
+//called with Mutex held
+void GpuProfiler::addSample(Scope &scope, double ms) {
+	scope.seen = true;
+	++scope.samples;
+	scope.lastMs = ms;
+	//the rolling window: the sample dropping out of it leaves its bucket too.
+	//sum and bucket are taken from the float kept in the window, so removing it undoes exactly what adding it did
+	const float stored = static_cast<float>(ms);
+	if (scope.recent.size() < WINDOW) {
+		scope.recent.push_back(stored);
+	} else {
+		const float dropped = scope.recent[scope.nextRecent];
+		--scope.histogram[bucket(static_cast<double>(dropped))];
+		scope.recentSumMs -= static_cast<double>(dropped);
+		scope.recent[scope.nextRecent] = stored;
+		scope.nextRecent = (scope.nextRecent + 1) % WINDOW;
+	}
+	scope.recentSumMs += static_cast<double>(stored);
+	++scope.histogram[bucket(static_cast<double>(stored))];
+}
@@ -0,0 +1,118 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Counters a pipeline statistics query collects over one scope
+struct GpuPipelineStats {
+	uint64_t inputVertices;
+	uint64_t inputPrimitives;
+	uint64_t vertexInvocations;
+	//what made it through clipping, the rasterizer's input
+	uint64_t clippedPrimitives;
+	uint64_t fragmentInvocations;
+	uint64_t computeInvocations;
+};
+
+struct GpuScopeStats {
+	static const uint32_t HISTOGRAM_BUCKETS = 24;
+
+	std::string name;
+	//every frame the scope was read back for
+	uint64_t samples;
+	double lastMs;
+	//over the most recent samples only
+	double meanMs;
+	double p50Ms;
+	double p99Ms;
+	double maxMs;
+	// recent samples by duration, bucket 0 under 1 us and bucket i from 2^(i-1) us up to 2^i us,
+	// the last bucket holds everything longer
+	std::array<uint32_t, HISTOGRAM_BUCKETS> histogram;
+	bool statistics;
+	//the most recent frame's counters, when statistics is set
+	GpuPipelineStats pipeline;
+};
+
+// GPU timings for named scopes of the frame's command buffers. Every frame
+// slot has its own timestamp query pool, with two queries per scope, and
+// optionally a pipeline statistics pool with one. begin() and end() write
+// the queries and a VK_EXT_debug_utils label around the scope, so
+// captures show the same names. The render loop calls beginFrame() once
+// the frame pacer has handed a slot out again: the slot's last frame is
+// known to be done then, so its results are read without waiting, which
+// leaves them as many frames late as there are frames in flight. The queries
+// are then reset from the host, which lets cached command buffers write the
+// same queries every time they are replayed. Each scope keeps its recent
+// durations as a rolling histogram for stats().
+class GpuProfiler {
+public:
+	static const uint32_t MAX_SCOPES = 32;
+	//recent samples per scope the percentiles and histogram are taken over
+	static const size_t WINDOW = 256;
+	static const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+public:
+	GpuProfiler();
+	~GpuProfiler();
+	// queueFamily is the one the scopes are recorded for. device needs hostQueryReset enabled, and
+	// pipelineStatisticsQuery when pipelineStatistics is set. inheritedQueries is whether that feature is
+	// enabled too, statistics can only span secondaries with it. instance is only used for the debug labels
+	void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameSlots
+			, bool pipelineStatistics, bool inheritedQueries);
+	void shutdown();
+	// any time before the scope is recorded, statistics is ignored without pipeline statistics.
+	// Scopes collecting statistics may not nest within each other, timings may
+	uint32_t addScope(const std::string &name, bool statistics);
+	// what secondaries executed inside a scope collecting statistics have to inherit, 0 when they can't
+	VkQueryPipelineStatisticFlags inheritedStatistics() const;
+	bool timestamps() const { return TimestampMask != 0; }
+	// once frameSlot's last frame has completed: reads back what it recorded and resets its queries
+	void beginFrame(uint32_t frameSlot);
+	void begin(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope) const;
+	void end(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope) const;
+	// safe from any thread
+	std::vector<GpuScopeStats> stats() const;
+private:
+	struct Scope {
+		std::string name;
+		bool statistics;
+		//was in a frame that has been read back, only those scopes are reported
+		bool seen;
+		uint64_t samples;
+		double lastMs;
+		std::vector<float> recent;
+		size_t nextRecent;
+		double recentSumMs;
+		std::array<uint32_t, GpuScopeStats::HISTOGRAM_BUCKETS> histogram;
+		GpuPipelineStats pipeline;
+	};
+	struct Slot {
+		VkQueryPool timestamps;
+		VkQueryPool statistics;
+	};
+	static uint32_t bucket(double ms);
+	void addSample(Scope &scope, double ms);
+	void reset(const Slot &slot) const;
+private:
+	VkDevice Device;
+	std::vector<Slot> Slots;
+	//nanoseconds per timestamp tick
+	double TimestampPeriod;
+	//0 when the queue family has no timestamps
+	uint64_t TimestampMask;
+	bool PipelineStatistics;
+	bool InheritedQueries;
+	PFN_vkCmdBeginDebugUtilsLabelEXT BeginLabel;
+	PFN_vkCmdEndDebugUtilsLabelEXT EndLabel;
+	std::vector<Scope> Scopes;
+	//readback scratch, timestamps then statistics, each followed by its availability word
+	std::vector<uint64_t> Results;
+	mutable std::mutex Mutex;
+};
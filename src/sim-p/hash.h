@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// XXH64 over an arbitrary byte range. Used for content hashes of source assets
+// and anywhere we need a well distributed 64 bit key.
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
@@ -15,12 +15,46 @@ int main([[maybe_unused]] int argc, [[maybe_unused]]  char *argv[]) {
       CLI::App app{ fmt::format("{} version {}", SimulationPlayground::cmake::project_name, SimulationPlayground::cmake::project_version) };
       bool show_version = false;
       app.add_flag("--version", show_version, "Show version information");
+      uint32_t agents = 1;
+      app.add_option("--agents", agents, "Number of agents, drawn as instances of the model");
+      bool headless = false;
+      app.add_flag("--headless", headless, "Render offscreen without a window and read every frame back");
+      uint32_t frames = 300;
+      app.add_option("--frames", frames, "Frames to render when headless");
+      uint32_t width = 1024, height = 768;
+      app.add_option("--width", width, "Offscreen target width when headless");
+      app.add_option("--height", height, "Offscreen target height when headless");
+      std::string output;
+      app.add_option("--output", output, "Directory to write headless frames to as PPM, none are written without it");
+      uint32_t framesInFlight = App::DEFAULT_FRAMES_IN_FLIGHT;
+      app.add_option("--frames-in-flight", framesInFlight, "Frames the CPU may run ahead of the GPU, 1 for the lowest latency, up to 4 for throughput")
+         ->check(CLI::Range(1u, FramePacer::MAX_FRAMES_IN_FLIGHT));
+      std::string presentMode = "mailbox";
+      app.add_option("--present-mode", presentMode, "fifo, fifo-relaxed, mailbox or immediate, unsupported modes fall back to fifo");
+      bool pipelineStats = false;
+      app.add_flag("--pipeline-stats", pipelineStats, "Count vertices, primitives and shader invocations per GPU scope, not just time them");
+      std::string trace;
+      app.add_option("--trace", trace, "Record CPU zones and write them to this file as a Chrome trace on exit or F12, Perfetto opens it too");
       CLI11_PARSE(app, argc, argv);
 
       if (show_version) {
          fmt::print("{}\n", SimulationPlayground::cmake::project_version);
          return EXIT_SUCCESS;
       }
+      VkPresentModeKHR mode;
+      if (!FramePacer::presentMode(presentMode, mode)) {
+         std::cerr << "unknown present mode " << presentMode << std::endl;
+         return EXIT_FAILURE;
+      }
+        MyApp.setAgents(agents);
+        MyApp.setFramePacing(framesInFlight, mode);
+        MyApp.setPipelineStatistics(pipelineStats);
+        if (!trace.empty()) {
+           MyApp.setTrace(trace);
+        }
+        if (headless) {
+           MyApp.setHeadless(width, height, frames, output);
+        }
         MyApp.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -0,0 +1,203 @@
+#include "mapped_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	//mappings are page aligned, the fallback buffer only promises this much
+	const size_t BUFFER_ALIGNMENT = 16;
+	//first buffer when the size isn't known up front (pipes, /proc)
+	const size_t UNKNOWN_SIZE_CHUNK = 64 * 1024;
+	//below this setting up the mapping and taking its page faults costs more than the copy (shaders, small headers)
+	const size_t MIN_MAPPED_SIZE = 16 * 1024;
+
+	uint8_t *allocate(size_t size) {
+		return static_cast<uint8_t *>(::operator new(size, std::align_val_t{BUFFER_ALIGNMENT}));
+	}
+
+	void deallocate(uint8_t *data) {
+		::operator delete(data, std::align_val_t{BUFFER_ALIGNMENT});
+	}
+}
+
+MappedFile::MappedFile() : Data(nullptr), Size(0), Owned(false) {
+
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept : Data(std::exchange(other.Data, nullptr)), Size(std::exchange(other.Size, 0))
+	, Owned(std::exchange(other.Owned, false)) {
+
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+	if (this != &other) {
+		close();
+		Data = std::exchange(other.Data, nullptr);
+		Size = std::exchange(other.Size, 0);
+		Owned = std::exchange(other.Owned, false);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string &path, Access access) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st {};
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	//virtual files report no size and pipes can't be mapped at all
+	if (!S_ISREG(st.st_mode) || st.st_size <= 0) {
+		const bool ok = readFd(fd, 0);
+		::close(fd);
+		return ok;
+	}
+	const size_t size = static_cast<size_t>(st.st_size);
+	if (size < MIN_MAPPED_SIZE) {
+		const bool ok = readFd(fd, size);
+		::close(fd);
+		return ok;
+	}
+	void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		const bool ok = readFd(fd, size);
+		::close(fd);
+		return ok;
+	}
+	//the mapping keeps its own reference to the file
+	::close(fd);
+	Data = static_cast<uint8_t *>(p);
+	Size = size;
+	if (access == SEQUENTIAL) {
+		//everything is about to be read front to back, start the readahead now rather than on the first fault
+		madvise(Data, Size, MADV_SEQUENTIAL);
+		madvise(Data, Size, MADV_WILLNEED);
+	} else {
+		madvise(Data, Size, MADV_RANDOM);
+	}
+	return true;
+}
+
+bool MappedFile::read(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st {};
+	const size_t sizeHint = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 ? static_cast<size_t>(st.st_size) : 0;
+	const bool ok = readFd(fd, sizeHint);
+	::close(fd);
+	return ok;
+}
+
+bool MappedFile::readFd(int fd, size_t sizeHint) {
+	if (sizeHint) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	size_t capacity = sizeHint ? sizeHint : UNKNOWN_SIZE_CHUNK;
+	uint8_t *buffer = allocate(capacity);
+	size_t size = 0;
+	bool seekable = true;
+	//pread at size where the fd allows it, a plain read on pipes, -1 on errors
+	auto readMore = [fd, &size, &seekable](uint8_t *dst, size_t count) -> ssize_t {
+		for (;;) {
+			ssize_t got = seekable ? pread(fd, dst, count, static_cast<off_t>(size)) : ::read(fd, dst, count);
+			if (got < 0 && errno == ESPIPE && seekable) {
+				seekable = false;
+				continue;
+			}
+			if (got < 0 && errno == EINTR) {
+				continue;
+			}
+			return got;
+		}
+	};
+	for (;;) {
+		if (size == capacity) {
+			//full, which for a known size is normally the end: a byte on the stack tells, so the buffer
+			//only grows (and gets copied) when the file really has more than the hint, or no hint was given
+			uint8_t probe;
+			const ssize_t got = readMore(&probe, 1);
+			if (got < 0) {
+				deallocate(buffer);
+				return false;
+			}
+			if (got == 0) {
+				break;
+			}
+			uint8_t *grown = allocate(capacity * 2);
+			memcpy(grown, buffer, size);
+			deallocate(buffer);
+			buffer = grown;
+			capacity *= 2;
+			buffer[size++] = probe;
+			continue;
+		}
+		const ssize_t got = readMore(buffer + size, capacity - size);
+		if (got < 0) {
+			deallocate(buffer);
+			return false;
+		}
+		if (got == 0) {
+			break;
+		}
+		size += static_cast<size_t>(got);
+	}
+	if (size == 0) {
+		deallocate(buffer);
+		return false;
+	}
+	Data = buffer;
+	Size = size;
+	Owned = true;
+	return true;
+}
+
+void MappedFile::close() {
+	if (Data) {
+		if (Owned) {
+			deallocate(Data);
+		} else {
+			munmap(Data, Size);
+		}
+		Data = nullptr;
+		Size = 0;
+		Owned = false;
+	}
+}
+
+const uint32_t *MappedFile::words() const {
+	if (!Data || Size % sizeof(uint32_t) != 0) {
+		return nullptr;
+	}
+	return reinterpret_cast<const uint32_t *>(Data);
+}
+
+void MappedFile::release(size_t offset, size_t length) const {
+	//only mapped pages can be dropped and read back from the file
+	if (!Data || Owned || offset >= Size) {
+		return;
+	}
+	//madvise wants page aligned ranges, only whole pages inside the range are dropped
+	const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t begin = (offset + page - 1) & ~(page - 1);
+	const size_t end = std::min(offset + length, Size) & ~(page - 1);
+	if (end > begin) {
+		madvise(Data + begin, end - begin, MADV_DONTNEED);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read only view of a whole file. Normally a memory mapping that lives until
+// close() or destruction, so callers can hand pointers into it straight to
+// memcpy, a parser or Vulkan without an intermediate copy. Files that can't
+// be mapped (pipes, some network and virtual file systems) or are too small
+// for it to pay off are streamed into an owned buffer with pread instead;
+// callers can't tell the difference. Either way data() is at least 16 byte
+// aligned.
+class MappedFile {
+public:
+	// how the contents will be read, passed on to the kernel as a hint
+	enum Access {
+		SEQUENTIAL,
+		RANDOM
+	};
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	MappedFile(MappedFile &&other) noexcept;
+	MappedFile &operator=(MappedFile &&other) noexcept;
+
+	// fails on missing and empty files
+	bool open(const std::string &path, Access access = SEQUENTIAL);
+	// like open() but never maps, what open() falls back to
+	bool read(const std::string &path);
+	void close();
+	bool isOpen() const { return Data != nullptr; }
+	bool isMapped() const { return Data != nullptr && !Owned; }
+	const uint8_t *data() const { return Data; }
+	size_t size() const { return Size; }
+	// SPIR-V as VkShaderModuleCreateInfo::pCode wants it, null unless the size is a whole number of words
+	const uint32_t *words() const;
+	// tells the kernel a range won't be read again so its pages can leave our RSS
+	void release(size_t offset, size_t length) const;
+private:
+	bool readFd(int fd, size_t sizeHint);
+private:
+	uint8_t *Data;
+	size_t Size;
+	//Data came from readFd rather than mmap
+	bool Owned;
+};
@@ -0,0 +1,197 @@
+#include "mesh_cache.h"
+#include "hash.h"
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	const uint64_t SECTION_ALIGNMENT = 16;
+
+	uint64_t alignUp(uint64_t v, uint64_t a) {
+		return (v + a - 1) & ~(a - 1);
+	}
+
+	bool statSource(const std::string &path, uint64_t &size, int64_t &mtime) {
+		struct stat st {};
+		if (stat(path.c_str(), &st) != 0) {
+			return false;
+		}
+		size = static_cast<uint64_t>(st.st_size);
+		mtime = st.st_mtime;
+		return true;
+	}
+
+	bool hashSource(const std::string &path, uint64_t &hash) {
+		MappedFile source;
+		if (!source.open(path)) {
+			return false;
+		}
+		hash = hashBytes(source.data(), source.size());
+		return true;
+	}
+
+	//writes through a file of this process's next to path, then renames it over path: readers, in other
+	//processes too, see the old file or the new one whole, and nothing anyone has mapped is written into
+	template<typename Write>
+	bool replaceFile(const std::string &path, Write write) {
+		const std::string tmpPath = path + "." + std::to_string(getpid()) + ".tmp";
+		FILE *file = fopen(tmpPath.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		bool ok = write(file);
+		ok = (fclose(file) == 0) && ok;
+		if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	//a copy of cache with the new timestamp, so a touched but unchanged source is hashed once rather than on every open
+	bool writeSourceMTime(const std::string &cachePath, const MappedFile &cache, int64_t mtime) {
+		MeshCacheHeader header;
+		memcpy(&header, cache.data(), sizeof(header));
+		header.sourceMTime = mtime;
+		const size_t rest = cache.size() - sizeof(header);
+		return replaceFile(cachePath, [&](FILE *file) {
+			return fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(cache.data() + sizeof(header), 1, rest, file) == rest;
+		});
+	}
+}
+
+MeshCache::MeshCache() : File(), Header(nullptr) {
+
+}
+
+bool MeshCache::open(const std::string &cachePath, const std::string &sourcePath) {
+	close();
+	if (!File.open(cachePath) || File.size() < sizeof(MeshCacheHeader)) {
+		File.close();
+		return false;
+	}
+	const MeshCacheHeader *h = reinterpret_cast<const MeshCacheHeader *>(File.data());
+	if (!validHeader(*h, File.size())) {
+		std::cout << "mesh cache " << cachePath << " is invalid, rebaking" << std::endl;
+		File.close();
+		return false;
+	}
+
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	//a baked mesh shipped without its source is still usable
+	if (statSource(sourcePath, size, mtime)) {
+		if (size != h->sourceSize) {
+			File.close();
+			return false;
+		}
+		//only pay for hashing the source when the timestamp says it may have changed
+		if (mtime != h->sourceMTime) {
+			uint64_t hash = 0;
+			if (!hashSource(sourcePath, hash) || hash != h->sourceHash) {
+				File.close();
+				return false;
+			}
+			//a read only cache still works, it just gets hashed again next time. The mapping stays on the old file
+			if (!writeSourceMTime(cachePath, File, mtime)) {
+				std::cout << "unable to update the timestamp in mesh cache " << cachePath << std::endl;
+			}
+		}
+	}
+	Header = h;
+	return true;
+}
+
+bool MeshCache::validHeader(const MeshCacheHeader &h, uint64_t fileSize) {
+	if (h.magic != MAGIC || h.version != VERSION || h.vertexStride != sizeof(ModelVertex)
+			|| h.vertexLayout != ModelVertex::LAYOUT_ID || (h.indexSize != sizeof(uint16_t) && h.indexSize != sizeof(uint32_t))
+			|| h.vertexCount > std::numeric_limits<uint32_t>::max()
+			|| h.lodCount == 0 || h.lodCount > MESH_MAX_LODS) {
+		return false;
+	}
+	//offsets first and counts against what is left after them, offset + count * stride can wrap around
+	if (h.vertexOffset < sizeof(MeshCacheHeader) || h.vertexOffset > fileSize || h.indexOffset > fileSize
+			|| h.vertexCount > (fileSize - h.vertexOffset) / sizeof(ModelVertex)
+			|| h.indexCount > (fileSize - h.indexOffset) / h.indexSize) {
+		return false;
+	}
+	for (uint32_t i = 0; i < h.lodCount; ++i) {
+		if (static_cast<uint64_t>(h.lods[i].firstIndex) + h.lods[i].indexCount > h.indexCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void MeshCache::close() {
+	Header = nullptr;
+	File.close();
+}
+
+const ModelVertex *MeshCache::vertices() const {
+	return reinterpret_cast<const ModelVertex *>(File.data() + Header->vertexOffset);
+}
+
+const void *MeshCache::indices() const {
+	return File.data() + Header->indexOffset;
+}
+
+MeshBounds MeshCache::computeBounds(const std::vector<Vertex> &vertices) {
+	MeshBounds bounds{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+	if (vertices.empty()) {
+		return MeshBounds{glm::vec3(0.0f), glm::vec3(0.0f)};
+	}
+	for (const auto &v : vertices) {
+		bounds.min = glm::min(bounds.min, v.pos);
+		bounds.max = glm::max(bounds.max, v.pos);
+	}
+	return bounds;
+}
+
+bool MeshCache::bake(const std::string &cachePath, const std::string &sourcePath
+		, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const std::vector<MeshLod> &lods) {
+	if (lods.empty() || lods.size() > MESH_MAX_LODS) {
+		return false;
+	}
+	MeshCacheHeader header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.vertexStride = sizeof(ModelVertex);
+	header.indexSize = fitsIndex16(vertices.size()) ? sizeof(uint16_t) : sizeof(uint32_t);
+	header.vertexLayout = ModelVertex::LAYOUT_ID;
+	header.vertexCount = vertices.size();
+	header.indexCount = indices.size();
+	header.vertexOffset = alignUp(sizeof(MeshCacheHeader), SECTION_ALIGNMENT);
+	header.indexOffset = alignUp(header.vertexOffset + vertices.size() * sizeof(ModelVertex), SECTION_ALIGNMENT);
+	header.bounds = computeBounds(vertices);
+	header.lodCount = static_cast<uint32_t>(lods.size());
+	std::copy(lods.begin(), lods.end(), header.lods);
+	std::vector<ModelVertex> packed;
+	ModelVertex::pack(vertices.data(), vertices.size(), header.bounds, packed);
+	std::vector<uint16_t> narrow;
+	if (header.indexSize == sizeof(uint16_t)) {
+		narrowIndices(indices, narrow);
+	}
+	const void *indexData = narrow.empty() ? static_cast<const void *>(indices.data()) : narrow.data();
+	if (!statSource(sourcePath, header.sourceSize, header.sourceMTime) || !hashSource(sourcePath, header.sourceHash)) {
+		return false;
+	}
+
+	//a crash never leaves a torn cache behind
+	const char zeros[SECTION_ALIGNMENT] = {0};
+	return replaceFile(cachePath, [&](FILE *file) {
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && fwrite(zeros, 1, header.vertexOffset - sizeof(header), file) == header.vertexOffset - sizeof(header);
+		ok = ok && (packed.empty() || fwrite(packed.data(), sizeof(ModelVertex), packed.size(), file) == packed.size());
+		const uint64_t pad = header.indexOffset - (header.vertexOffset + packed.size() * sizeof(ModelVertex));
+		ok = ok && fwrite(zeros, 1, pad, file) == pad;
+		return ok && (indices.empty() || fwrite(indexData, header.indexSize, indices.size(), file) == indices.size());
+	});
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "mesh_simplify.h"
+#include "vertex_format.h"
+#include "mapped_file.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// On disk layout of a baked mesh. The header is followed by the final
+// (deduplicated) vertex array, already packed as ModelVertex, and then the
+// index array, each starting on a 16 byte boundary so they can be memcpy'd
+// straight out of the mapping. Indices are 16 bit whenever the vertex count
+// allows it. The index array holds every level of detail back to back, all
+// of them indexing the one vertex array.
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t indexSize;
+	uint32_t vertexLayout;
+	uint32_t reserved;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	MeshBounds bounds;
+	uint32_t lodCount;
+	uint32_t reserved2;
+	MeshLod lods[MESH_MAX_LODS];
+	uint64_t sourceSize;
+	int64_t sourceMTime;
+	uint64_t sourceHash;
+};
+
+class MeshCache {
+public:
+	static const uint32_t MAGIC = 0x434D5053; // 'SPMC'
+	static const uint32_t VERSION = 4;
+public:
+	MeshCache();
+	// maps cachePath and validates it against sourcePath. Returns false if the
+	// cache is missing, from an older version or the source has changed.
+	bool open(const std::string &cachePath, const std::string &sourcePath);
+	void close();
+	bool isOpen() const { return Header != nullptr; }
+	const MeshCacheHeader &header() const { return *Header; }
+	const ModelVertex *vertices() const;
+	// indexSize() bytes per index
+	const void *indices() const;
+	uint32_t indexSize() const { return Header->indexSize; }
+	uint32_t vertexCount() const { return static_cast<uint32_t>(Header->vertexCount); }
+	uint32_t indexCount() const { return static_cast<uint32_t>(Header->indexCount); }
+	const MeshBounds &bounds() const { return Header->bounds; }
+	std::vector<MeshLod> lods() const { return std::vector<MeshLod>(Header->lods, Header->lods + Header->lodCount); }
+public:
+	// packs vertices against their bounds and writes a new cache for sourcePath,
+	// returns false if it couldn't be written
+	static bool bake(const std::string &cachePath, const std::string &sourcePath
+			, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const std::vector<MeshLod> &lods);
+	static MeshBounds computeBounds(const std::vector<Vertex> &vertices);
+	// whether a header read from a fileSize byte cache describes sections that lie within it
+	static bool validHeader(const MeshCacheHeader &header, uint64_t fileSize);
+private:
+	MappedFile File;
+	const MeshCacheHeader *Header;
+};
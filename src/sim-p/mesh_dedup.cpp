@@ -0,0 +1,123 @@
+#include "mesh_dedup.h"
+#include "hash.h"
+#include "parallel.h"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+	const size_t MIN_CHUNK_SIZE = 1 << 16;
+	const uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+	size_t tableSizeFor(size_t count) {
+		size_t size = 16;
+		while (size < count * 2) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	// open addressing with linear probing, slots hold indices into uniques
+	// and the full 64 bit hash is kept alongside so mismatches rarely touch the vertex
+	uint32_t findOrInsert(std::vector<uint32_t> &slots, std::vector<Vertex> &uniques, std::vector<uint64_t> &hashes
+			, const Vertex &v, uint64_t hash) {
+		const size_t mask = slots.size() - 1;
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+			uint32_t id = slots[slot];
+			if (id == EMPTY_SLOT) {
+				id = static_cast<uint32_t>(uniques.size());
+				slots[slot] = id;
+				uniques.push_back(v);
+				hashes.push_back(hash);
+				return id;
+			}
+			if (hashes[id] == hash && uniques[id] == v) {
+				return id;
+			}
+		}
+	}
+}
+
+uint64_t VertexDeduplicator::hashVertex(const Vertex &v) {
+	//adding +0.0f folds -0.0f into +0.0f so the byte hash agrees with operator==
+	float canonical[8] = {v.pos.x + 0.0f, v.pos.y + 0.0f, v.pos.z + 0.0f
+		, v.color.x + 0.0f, v.color.y + 0.0f, v.color.z + 0.0f
+		, v.texCoord.x + 0.0f, v.texCoord.y + 0.0f};
+	return hashBytes(canonical, sizeof(canonical));
+}
+
+VertexDeduplicator::VertexDeduplicator(size_t chunkCount) : Chunks(chunkCount) {
+
+}
+
+void VertexDeduplicator::addChunk(size_t chunk, const Vertex *stream, size_t count) {
+	if (count >= std::numeric_limits<uint32_t>::max()) {
+		throw std::runtime_error("vertex stream chunk too large to index!");
+	}
+	Chunk &c = Chunks[chunk];
+	c.uniques.clear();
+	c.hashes.clear();
+	c.indices.resize(count);
+	std::vector<uint32_t> slots(tableSizeFor(count), EMPTY_SLOT);
+	for (size_t i = 0; i < count; ++i) {
+		c.indices[i] = findOrInsert(slots, c.uniques, c.hashes, stream[i], hashVertex(stream[i]));
+	}
+}
+
+void VertexDeduplicator::finish(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+	size_t totalUniques = 0;
+	size_t totalIndices = 0;
+	std::vector<size_t> firstIndex(Chunks.size());
+	for (size_t i = 0; i < Chunks.size(); ++i) {
+		firstIndex[i] = totalIndices;
+		totalUniques += Chunks[i].uniques.size();
+		totalIndices += Chunks[i].indices.size();
+	}
+	if (totalIndices > std::numeric_limits<uint32_t>::max()) {
+		throw std::runtime_error("vertex stream too large for 32 bit indices!");
+	}
+
+	//walking chunks in order reproduces first-appearance numbering; each chunk's
+	//local ids are translated through a remap table filled here
+	std::vector<std::vector<uint32_t>> remap(Chunks.size());
+	std::vector<uint32_t> slots(tableSizeFor(totalUniques), EMPTY_SLOT);
+	std::vector<uint64_t> hashes;
+	vertices.clear();
+	vertices.reserve(totalUniques);
+	hashes.reserve(totalUniques);
+	for (size_t i = 0; i < Chunks.size(); ++i) {
+		Chunk &c = Chunks[i];
+		remap[i].resize(c.uniques.size());
+		for (size_t u = 0; u < c.uniques.size(); ++u) {
+			remap[i][u] = findOrInsert(slots, vertices, hashes, c.uniques[u], c.hashes[u]);
+		}
+		std::vector<Vertex>().swap(c.uniques);
+		std::vector<uint64_t>().swap(c.hashes);
+	}
+	vertices.shrink_to_fit();
+
+	const size_t base = indices.size();
+	indices.resize(base + totalIndices);
+	parallelFor(Chunks.size(), [&](size_t i) {
+		const std::vector<uint32_t> &local = Chunks[i].indices;
+		const std::vector<uint32_t> &map = remap[i];
+		uint32_t *out = indices.data() + base + firstIndex[i];
+		for (size_t j = 0; j < local.size(); ++j) {
+			out[j] = map[local[j]];
+		}
+	});
+	Chunks.clear();
+}
+
+void dedupVertices(const Vertex *stream, size_t count, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+	const size_t maxChunks = static_cast<size_t>(workerCount()) * 4;
+	const size_t chunkCount = std::max<size_t>(1, std::min(maxChunks, count / MIN_CHUNK_SIZE));
+	const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	VertexDeduplicator dedup(chunkCount);
+	parallelFor(chunkCount, [&](size_t i) {
+		const size_t begin = i * chunkSize;
+		const size_t end = std::min(count, begin + chunkSize);
+		dedup.addChunk(i, stream + begin, end > begin ? end - begin : 0);
+	});
+	dedup.finish(vertices, indices);
+}
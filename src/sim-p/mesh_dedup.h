@@ -0,0 +1,28 @@
+#pragma once
+#include "vertex.h"
+#include <cstdint>
+#include <vector>
+
+// Collapses a stream of (possibly repeated) vertices into a unique vertex
+// array plus an index per input vertex. The stream is split into chunks that
+// can be deduplicated on different threads; finish() merges the per chunk
+// tables in chunk order so the result is identical to a single threaded pass
+// that numbers vertices in order of first appearance.
+class VertexDeduplicator {
+public:
+	explicit VertexDeduplicator(size_t chunkCount);
+	// thread safe as long as each chunk index is only added once
+	void addChunk(size_t chunk, const Vertex *stream, size_t count);
+	void finish(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+	static uint64_t hashVertex(const Vertex &v);
+private:
+	struct Chunk {
+		std::vector<Vertex> uniques;
+		std::vector<uint64_t> hashes;
+		std::vector<uint32_t> indices;
+	};
+	std::vector<Chunk> Chunks;
+};
+
+// convenience wrapper that splits an in memory stream across all cores
+void dedupVertices(const Vertex *stream, size_t count, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
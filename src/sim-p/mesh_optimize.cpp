@@ -0,0 +1,264 @@
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace {
+	//cache the triangle order is optimized for, bigger than any real post transform cache
+	//so the result degrades gracefully on smaller ones
+	const uint32_t OPTIMIZE_CACHE_SIZE = 32;
+	//cache the stats and overdraw clustering simulate, a conservative hardware size
+	const uint32_t SIMULATE_CACHE_SIZE = 16;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+	const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+	float vertexScore(uint32_t cachePosition, uint32_t remaining) {
+		if (remaining == 0) {
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition < 3) {
+			//the last triangle's vertices get a fixed score so its neighbours aren't favoured over its own strip
+			score = LAST_TRIANGLE_SCORE;
+		} else if (cachePosition < OPTIMIZE_CACHE_SIZE) {
+			const float scale = 1.0f / static_cast<float>(OPTIMIZE_CACHE_SIZE - 3);
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+		//finish off vertices with few triangles left so they don't get stranded
+		return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining), -VALENCE_BOOST_POWER);
+	}
+
+	glm::vec3 triangleCross(const std::vector<Vertex> &vertices, const uint32_t *tri) {
+		const glm::vec3 &a = vertices[tri[0]].pos;
+		return glm::cross(vertices[tri[1]].pos - a, vertices[tri[2]].pos - a);
+	}
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+	//a vertex is still cached while fewer than cacheSize misses happened since it was loaded
+	std::vector<uint32_t> loadedAt(vertexCount, 0);
+	uint32_t misses = cacheSize + 1;
+	const uint32_t start = misses;
+	for (uint32_t v : indices) {
+		if (misses - loadedAt[v] > cacheSize) {
+			loadedAt[v] = misses++;
+		}
+	}
+	misses -= start;
+	VertexCacheStats stats{};
+	const size_t triangles = indices.size() / 3;
+	stats.acmr = triangles ? static_cast<float>(misses) / static_cast<float>(triangles) : 0.0f;
+	stats.atvr = vertexCount ? static_cast<float>(misses) / static_cast<float>(vertexCount) : 0.0f;
+	return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0) {
+		return;
+	}
+	//per vertex list of triangles not emitted yet, the first remaining[v] entries of its adjacency range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t v : indices) {
+		++remaining[v];
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t t = 0; t < triangleCount; ++t) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+			}
+		}
+	}
+
+	std::vector<uint32_t> cachePosition(vertexCount, NONE);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		score[v] = vertexScore(NONE, remaining[v]);
+	}
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(OPTIMIZE_CACHE_SIZE + 3);
+	nextCache.reserve(OPTIMIZE_CACHE_SIZE + 3);
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t best = NONE;
+	uint32_t scan = 0;
+	for (uint32_t n = 0; n < triangleCount; ++n) {
+		if (best == NONE) {
+			//nothing left around the cache, restart from the next triangle in input order
+			while (emitted[scan]) {
+				++scan;
+			}
+			best = scan;
+		}
+		emitted[best] = 1;
+		nextCache.clear();
+		for (uint32_t k = 0; k < 3; ++k) {
+			const uint32_t v = indices[best * 3 + k];
+			result.push_back(v);
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+				nextCache.push_back(v);
+			}
+			uint32_t *list = adjacency.data() + offsets[v];
+			const uint32_t count = remaining[v];
+			for (uint32_t i = 0; i < count; ++i) {
+				if (list[i] == best) {
+					list[i] = list[count - 1];
+					break;
+				}
+			}
+			--remaining[v];
+		}
+		const auto fresh = static_cast<std::ptrdiff_t>(nextCache.size());
+		for (uint32_t v : cache) {
+			if (std::find(nextCache.begin(), nextCache.begin() + fresh, v) == nextCache.begin() + fresh) {
+				nextCache.push_back(v);
+			}
+		}
+		//everything that moved in the cache, including what just fell out of it, needs rescoring
+		for (uint32_t i = 0; i < nextCache.size(); ++i) {
+			const uint32_t v = nextCache[i];
+			cachePosition[v] = i < OPTIMIZE_CACHE_SIZE ? i : NONE;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+		best = NONE;
+		float bestScore = -1.0f;
+		for (uint32_t v : nextCache) {
+			const uint32_t *list = adjacency.data() + offsets[v];
+			for (uint32_t i = 0; i < remaining[v]; ++i) {
+				const uint32_t t = list[i];
+				const float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (s > bestScore) {
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+		if (nextCache.size() > OPTIMIZE_CACHE_SIZE) {
+			nextCache.resize(OPTIMIZE_CACHE_SIZE);
+		}
+		cache.swap(nextCache);
+	}
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices) {
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount < 2) {
+		return;
+	}
+	struct Cluster {
+		uint32_t begin;
+		uint32_t end;
+		float key;
+	};
+	//a cluster starts wherever all three vertices miss the cache, reordering at those points costs nothing
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> loadedAt(vertices.size(), 0);
+	uint32_t misses = SIMULATE_CACHE_SIZE + 1;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		uint32_t triangleMisses = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			const uint32_t v = indices[t * 3 + k];
+			if (misses - loadedAt[v] > SIMULATE_CACHE_SIZE) {
+				loadedAt[v] = misses++;
+				++triangleMisses;
+			}
+		}
+		if (t == 0 || triangleMisses == 3) {
+			if (!clusters.empty()) {
+				clusters.back().end = t;
+			}
+			clusters.push_back({t, triangleCount, 0.0f});
+		}
+	}
+	if (clusters.size() < 2) {
+		return;
+	}
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		const uint32_t *tri = indices.data() + t * 3;
+		const float area = glm::length(triangleCross(vertices, tri));
+		meshCentroid += (vertices[tri[0]].pos + vertices[tri[1]].pos + vertices[tri[2]].pos) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid = meshCentroid / meshArea;
+	}
+
+	//clusters facing away from the middle of the mesh are the ones likely to occlude the rest, draw them first
+	for (auto &c : clusters) {
+		glm::vec3 normal(0.0f);
+		glm::vec3 centroid(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = c.begin; t < c.end; ++t) {
+			const uint32_t *tri = indices.data() + t * 3;
+			const glm::vec3 cross = triangleCross(vertices, tri);
+			const float a = glm::length(cross);
+			normal += cross;
+			centroid += (vertices[tri[0]].pos + vertices[tri[1]].pos + vertices[tri[2]].pos) * (a / 3.0f);
+			area += a;
+		}
+		const float normalLength = glm::length(normal);
+		if (area > 0.0f && normalLength > 0.0f) {
+			c.key = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+		}
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.key > b.key; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const auto &c : clusters) {
+		result.insert(result.end(), indices.begin() + c.begin * 3, indices.begin() + c.end * 3);
+	}
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+	std::vector<uint32_t> remap(vertices.size(), NONE);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+	for (auto &index : indices) {
+		if (remap[index] == NONE) {
+			remap[index] = static_cast<uint32_t>(ordered.size());
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+void narrowIndices(const std::vector<uint32_t> &indices, std::vector<uint16_t> &narrow) {
+	narrow.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		narrow[i] = static_cast<uint16_t>(indices[i]);
+	}
+}
+
+void optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+	const auto start = std::chrono::steady_clock::now();
+	const VertexCacheStats before = analyzeVertexCache(indices, vertices.size(), SIMULATE_CACHE_SIZE);
+	optimizeVertexCache(indices, vertices.size());
+	optimizeOverdraw(indices, vertices);
+	optimizeVertexFetch(vertices, indices);
+	const VertexCacheStats after = analyzeVertexCache(indices, vertices.size(), SIMULATE_CACHE_SIZE);
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("mesh optimize: %zu triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %s indices, %.2f ms\n"
+			, indices.size() / 3, static_cast<double>(before.acmr), static_cast<double>(after.acmr)
+			, static_cast<double>(before.atvr), static_cast<double>(after.atvr)
+			, fitsIndex16(vertices.size()) ? "16 bit" : "32 bit", ms);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "vertex.h"
+#include <cstdint>
+#include <vector>
+
+// Post transform cache efficiency of an index buffer, simulated on a FIFO
+// cache. acmr is vertex shader invocations per triangle (0.5 is the ideal for
+// a regular grid, 3 the worst case), atvr is invocations per unique vertex (1
+// is ideal).
+struct VertexCacheStats {
+	float acmr;
+	float atvr;
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize);
+
+// Reorders triangles for post transform cache locality (Forsyth's linear
+// speed optimizer), independent of the exact cache size of the hardware.
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+// Reorders clusters of a cache optimized index buffer so outward facing ones
+// draw first and occlude what is behind them. Clusters are split where the
+// cache would be cold anyway, so cache efficiency is kept.
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices);
+
+// Renumbers vertices in the order the index buffer first touches them so
+// vertex fetch walks the buffer linearly. Unreferenced vertices are dropped.
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+// Every index fits in 16 bits (primitive restart is never enabled, so 0xffff is usable)
+inline bool fitsIndex16(size_t vertexCount) {
+	return vertexCount <= 65536;
+}
+
+void narrowIndices(const std::vector<uint32_t> &indices, std::vector<uint16_t> &narrow);
+
+// Runs cache, overdraw and fetch optimization in that order on a deduplicated
+// mesh and logs ACMR/ATVR before and after.
+void optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
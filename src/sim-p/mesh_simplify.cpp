@@ -0,0 +1,356 @@
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+
+namespace {
+	enum class VertexKind : uint8_t {
+		Manifold, // one wedge, interior
+		Seam,     // two wedges (texture seam), collapses along the seam as a pair
+		Border,   // on an open edge, kept to preserve the outline
+		Locked    // anything more complicated
+	};
+
+	const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+	//each level aims for this fraction of the previous one's triangles
+	const float LOD_REDUCTION = 0.5f;
+	//stop once a level removes less than this fraction, or errs by more than this fraction of the mesh size
+	const float LOD_MIN_PROGRESS = 0.1f;
+	const float LOD_MAX_RELATIVE_ERROR = 0.05f;
+	const size_t LOD_MIN_TRIANGLES = 32;
+
+	uint64_t edgeKey(uint32_t a, uint32_t b) {
+		return (uint64_t{a} << 32) | b;
+	}
+
+	// plane distance quadric, weighted by triangle area so small slivers don't dominate
+	struct Quadric {
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, weight;
+
+		void addPlane(const glm::vec3 &n, float d, double w) {
+			const double x = n.x, y = n.y, z = n.z, dd = d;
+			a2 += w * x * x; ab += w * x * y; ac += w * x * z; ad += w * x * dd;
+			b2 += w * y * y; bc += w * y * z; bd += w * y * dd;
+			c2 += w * z * z; cd += w * z * dd;
+			d2 += w * dd * dd;
+			weight += w;
+		}
+		void add(const Quadric &o) {
+			a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+			b2 += o.b2; bc += o.bc; bd += o.bd;
+			c2 += o.c2; cd += o.cd;
+			d2 += o.d2;
+			weight += o.weight;
+		}
+		// mean squared distance of p to the accumulated planes
+		double error(const glm::vec3 &p) const {
+			const double x = p.x, y = p.y, z = p.z;
+			const double e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+				+ 2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+			return weight > 0.0 ? std::fabs(e) / weight : 0.0;
+		}
+	};
+
+	// vertices that share a position: remap points at the first of them, wedge links them in a ring
+	void buildPositionRemap(const std::vector<Vertex> &vertices, std::vector<uint32_t> &remap, std::vector<uint32_t> &wedge) {
+		std::vector<uint32_t> order(vertices.size());
+		std::iota(order.begin(), order.end(), 0u);
+		auto less = [&vertices](uint32_t a, uint32_t b) {
+			const glm::vec3 &pa = vertices[a].pos, &pb = vertices[b].pos;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+		remap.assign(vertices.size(), NONE);
+		wedge.assign(vertices.size(), NONE);
+		for (size_t i = 0; i < order.size();) {
+			size_t j = i + 1;
+			while (j < order.size() && vertices[order[j]].pos == vertices[order[i]].pos) {
+				++j;
+			}
+			for (size_t k = i; k < j; ++k) {
+				remap[order[k]] = order[i];
+				wedge[order[k]] = order[k + 1 < j ? k + 1 : i];
+			}
+			i = j;
+		}
+	}
+
+	class Simplifier {
+	public:
+		struct Candidate {
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+	public:
+		Simplifier(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+			: Vertices(vertices), Indices(indices), Remap(), Wedge(), Kind(), Quadrics(), Edges()
+			, Offsets(), Adjacency() {
+			buildPositionRemap(Vertices, Remap, Wedge);
+			Quadrics.assign(Vertices.size(), Quadric{});
+			for (size_t t = 0; t < Indices.size(); t += 3) {
+				const glm::vec3 &p0 = Vertices[Indices[t]].pos, &p1 = Vertices[Indices[t + 1]].pos, &p2 = Vertices[Indices[t + 2]].pos;
+				const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+				const float length = glm::length(cross);
+				if (length <= 0.0f) {
+					continue;
+				}
+				const glm::vec3 n = cross / length;
+				const float d = -glm::dot(n, p0);
+				for (uint32_t k = 0; k < 3; ++k) {
+					Quadrics[Remap[Indices[t + k]]].addPlane(n, d, static_cast<double>(length) * 0.5);
+				}
+			}
+		}
+
+		std::vector<uint32_t> run(size_t targetIndexCount, float maxError, float &error) {
+			const double maxCost = static_cast<double>(maxError) * static_cast<double>(maxError);
+			double worst = 0.0;
+			std::vector<uint32_t> collapse(Vertices.size());
+			std::vector<uint8_t> touched(Vertices.size());
+			std::vector<Candidate> candidates;
+			while (Indices.size() > targetIndexCount) {
+				//collapses change which edges are seams or borders, so this is redone every pass
+				classify();
+				buildAdjacency();
+				candidates.clear();
+				for (size_t t = 0; t < Indices.size(); t += 3) {
+					for (uint32_t k = 0; k < 3; ++k) {
+						const uint32_t a = Indices[t + k], b = Indices[t + (k + 1) % 3];
+						addCandidate(a, b, candidates);
+						addCandidate(b, a, candidates);
+					}
+				}
+				for (auto &c : candidates) {
+					c.cost = Quadrics[Remap[c.from]].error(Vertices[c.to].pos);
+				}
+				std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.cost < b.cost; });
+
+				//every collapse removes about two triangles, leave later passes to finish off the rest
+				const size_t goal = std::max<size_t>(1, (Indices.size() - targetIndexCount) / 6);
+				std::iota(collapse.begin(), collapse.end(), 0u);
+				std::fill(touched.begin(), touched.end(), 0);
+				size_t collapsed = 0;
+				for (const auto &c : candidates) {
+					if (collapsed >= goal || c.cost > maxCost) {
+						break;
+					}
+					const uint32_t pu = Remap[c.from], pv = Remap[c.to];
+					if (touched[pu] || touched[pv] || pu == pv) {
+						continue;
+					}
+					uint32_t sibling = NONE, siblingTarget = NONE;
+					if (Kind[c.from] == VertexKind::Seam) {
+						sibling = Wedge[c.from];
+						siblingTarget = seamPartner(sibling, c.to);
+						if (siblingTarget == NONE) {
+							continue;
+						}
+					}
+					if (flips(pu, pv, Vertices[c.to].pos)) {
+						continue;
+					}
+					collapse[c.from] = c.to;
+					if (sibling != NONE) {
+						collapse[sibling] = siblingTarget;
+					}
+					//keep everything around the collapse fixed for the rest of the pass so flip checks stay valid
+					for (uint32_t i = Offsets[pu]; i < Offsets[pu + 1]; ++i) {
+						const uint32_t t = Adjacency[i];
+						for (uint32_t k = 0; k < 3; ++k) {
+							touched[Remap[Indices[t * 3 + k]]] = 1;
+						}
+					}
+					touched[pv] = 1;
+					Quadrics[pv].add(Quadrics[pu]);
+					worst = std::max(worst, c.cost);
+					++collapsed;
+				}
+				if (collapsed == 0) {
+					break;
+				}
+				size_t out = 0;
+				for (size_t t = 0; t < Indices.size(); t += 3) {
+					const uint32_t a = collapse[Indices[t]], b = collapse[Indices[t + 1]], c = collapse[Indices[t + 2]];
+					if (Remap[a] == Remap[b] || Remap[b] == Remap[c] || Remap[a] == Remap[c]) {
+						continue;
+					}
+					Indices[out++] = a;
+					Indices[out++] = b;
+					Indices[out++] = c;
+				}
+				Indices.resize(out);
+			}
+			error = static_cast<float>(std::sqrt(worst));
+			return Indices;
+		}
+	private:
+		void classify() {
+			std::unordered_set<uint64_t> positionEdges;
+			Edges.clear();
+			positionEdges.reserve(Indices.size());
+			Edges.reserve(Indices.size());
+			for (size_t t = 0; t < Indices.size(); t += 3) {
+				for (uint32_t k = 0; k < 3; ++k) {
+					const uint32_t a = Indices[t + k], b = Indices[t + (k + 1) % 3];
+					Edges.insert(edgeKey(a, b));
+					positionEdges.insert(edgeKey(Remap[a], Remap[b]));
+				}
+			}
+			std::vector<uint8_t> border(Vertices.size(), 0), seam(Vertices.size(), 0);
+			for (size_t t = 0; t < Indices.size(); t += 3) {
+				for (uint32_t k = 0; k < 3; ++k) {
+					const uint32_t a = Indices[t + k], b = Indices[t + (k + 1) % 3];
+					if (!positionEdges.count(edgeKey(Remap[b], Remap[a]))) {
+						border[Remap[a]] = border[Remap[b]] = 1;
+					} else if (!Edges.count(edgeKey(b, a))) {
+						seam[a] = seam[b] = 1;
+					}
+				}
+			}
+			Kind.assign(Vertices.size(), VertexKind::Locked);
+			for (uint32_t v = 0; v < Vertices.size(); ++v) {
+				const bool single = Wedge[v] == v;
+				const bool pair = !single && Wedge[Wedge[v]] == v;
+				if (border[Remap[v]]) {
+					Kind[v] = VertexKind::Border;
+				} else if (single && !seam[v]) {
+					Kind[v] = VertexKind::Manifold;
+				} else if (pair && seam[v] && seam[Wedge[v]]) {
+					Kind[v] = VertexKind::Seam;
+				}
+			}
+		}
+
+		void buildAdjacency() {
+			Offsets.assign(Vertices.size() + 1, 0);
+			for (uint32_t v : Indices) {
+				++Offsets[Remap[v] + 1];
+			}
+			for (size_t i = 1; i < Offsets.size(); ++i) {
+				Offsets[i] += Offsets[i - 1];
+			}
+			Adjacency.resize(Indices.size());
+			std::vector<uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < Indices.size(); ++i) {
+				Adjacency[fill[Remap[Indices[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		void addCandidate(uint32_t from, uint32_t to, std::vector<Candidate> &candidates) const {
+			const VertexKind kind = Kind[from];
+			if (kind == VertexKind::Manifold) {
+				candidates.push_back({from, to, 0.0});
+			} else if (kind == VertexKind::Seam && (Kind[to] == VertexKind::Seam || Kind[to] == VertexKind::Locked)
+					&& !Edges.count(edgeKey(to, from))) {
+				//only along the seam itself, moving across it would tear the texture mapping
+				candidates.push_back({from, to, 0.0});
+			}
+		}
+
+		// the wedge of to's position that sibling shares an edge with, NONE if the seam doesn't continue
+		uint32_t seamPartner(uint32_t sibling, uint32_t to) const {
+			uint32_t w = to;
+			do {
+				w = Wedge[w];
+				if (w != to && (Edges.count(edgeKey(sibling, w)) || Edges.count(edgeKey(w, sibling)))) {
+					return w;
+				}
+			} while (w != to);
+			return NONE;
+		}
+
+		// would moving position pu onto target turn any surviving triangle around it over
+		bool flips(uint32_t pu, uint32_t pv, const glm::vec3 &target) const {
+			for (uint32_t i = Offsets[pu]; i < Offsets[pu + 1]; ++i) {
+				const uint32_t *tri = Indices.data() + Adjacency[i] * 3;
+				if (Remap[tri[0]] == pv || Remap[tri[1]] == pv || Remap[tri[2]] == pv) {
+					continue;
+				}
+				glm::vec3 p[3] = {Vertices[tri[0]].pos, Vertices[tri[1]].pos, Vertices[tri[2]].pos};
+				const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (uint32_t k = 0; k < 3; ++k) {
+					if (Remap[tri[k]] == pu) {
+						p[k] = target;
+					}
+				}
+				const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				if (glm::dot(before, after) <= 0.0f) {
+					return true;
+				}
+			}
+			return false;
+		}
+	private:
+		const std::vector<Vertex> &Vertices;
+		std::vector<uint32_t> Indices;
+		std::vector<uint32_t> Remap;
+		std::vector<uint32_t> Wedge;
+		std::vector<VertexKind> Kind;
+		std::vector<Quadric> Quadrics;
+		std::unordered_set<uint64_t> Edges;
+		// triangles around each position, rebuilt every pass
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Adjacency;
+	};
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices
+		, size_t targetIndexCount, float maxError, float &error) {
+	Simplifier simplifier(vertices, indices);
+	return simplifier.run(targetIndexCount, maxError, error);
+}
+
+void buildLodChain(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, std::vector<MeshLod> &lods) {
+	lods.clear();
+	lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+	if (vertices.empty()) {
+		return;
+	}
+	MeshBounds bounds{vertices[0].pos, vertices[0].pos};
+	for (const auto &v : vertices) {
+		bounds.min = glm::min(bounds.min, v.pos);
+		bounds.max = glm::max(bounds.max, v.pos);
+	}
+	const float maxError = glm::length(bounds.max - bounds.min) * LOD_MAX_RELATIVE_ERROR;
+
+	std::vector<uint32_t> level(indices);
+	float error = 0.0f;
+	while (lods.size() < MESH_MAX_LODS && level.size() / 3 > LOD_MIN_TRIANGLES) {
+		const size_t target = static_cast<size_t>(static_cast<float>(level.size() / 3) * LOD_REDUCTION) * 3;
+		float levelError = 0.0f;
+		std::vector<uint32_t> next = simplifyMesh(vertices, level, target, maxError - error, levelError);
+		if (static_cast<float>(next.size()) > static_cast<float>(level.size()) * (1.0f - LOD_MIN_PROGRESS)) {
+			break;
+		}
+		//errors add up since each level is simplified from the one before
+		error += levelError;
+		optimizeVertexCache(next, vertices.size());
+		lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(next.size()), error});
+		indices.insert(indices.end(), next.begin(), next.end());
+		level.swap(next);
+	}
+	for (size_t i = 0; i < lods.size(); ++i) {
+		printf("lod %zu: %u triangles, error %g\n", i, lods[i].indexCount / 3, static_cast<double>(lods[i].error));
+	}
+}
+
+uint32_t selectLod(const std::vector<MeshLod> &lods, float distance, float fovY, float viewportHeight, float pixelError) {
+	//pixels per model space unit at that distance
+	const float scale = viewportHeight / (2.0f * std::tan(fovY * 0.5f) * std::max(distance, 1e-4f));
+	uint32_t lod = 0;
+	for (uint32_t i = 1; i < lods.size(); ++i) {
+		if (lods[i].error * scale > pixelError) {
+			break;
+		}
+		lod = i;
+	}
+	return lod;
+}
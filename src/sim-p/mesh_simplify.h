@@ -0,0 +1,33 @@
+#pragma once
+#include "vertex.h"
+#include <cstdint>
+#include <vector>
+
+// One level of detail: a range of the shared index buffer plus how far (in
+// model space units) its surface can be from the full resolution mesh.
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+const uint32_t MESH_MAX_LODS = 8;
+
+// Quadric error edge collapse simplification. Vertices only ever collapse
+// onto existing vertices, so every level indexes the same vertex buffer.
+// Texture seams collapse as pairs along the seam, open borders are kept in
+// place. Returns the new index buffer with at most targetIndexCount indices
+// (fewer if no collapse stays under maxError) and sets error to the largest
+// collapse distance taken.
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices
+		, size_t targetIndexCount, float maxError, float &error);
+
+// Appends coarser levels to indices, each roughly half the triangles of the
+// one before, until simplification stalls or the error gets too large
+// relative to the mesh size. lods[0] is the input mesh.
+void buildLodChain(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, std::vector<MeshLod> &lods);
+
+// Coarsest level whose error, projected at distance with the given vertical
+// field of view onto a viewport viewportHeight pixels tall, stays under
+// pixelError pixels.
+uint32_t selectLod(const std::vector<MeshLod> &lods, float distance, float fovY, float viewportHeight, float pixelError);
@@ -0,0 +1,202 @@
+#include "mip_chain.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIP_CHAIN_SSE
+#endif
+
+namespace {
+	const uint64_t LEVEL_ALIGNMENT = 16;
+	const int LINEAR_TO_SRGB_BITS = 14;
+	const int LINEAR_TO_SRGB_SIZE = 1 << LINEAR_TO_SRGB_BITS;
+
+	struct Tables {
+		std::array<float, 256> srgbToLinear;
+		std::array<uint8_t, LINEAR_TO_SRGB_SIZE + 1> linearToSrgb;
+
+		Tables() : srgbToLinear(), linearToSrgb() {
+			for (size_t i = 0; i < srgbToLinear.size(); ++i) {
+				const float c = static_cast<float>(i) / 255.0f;
+				srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (size_t i = 0; i < linearToSrgb.size(); ++i) {
+				const float l = static_cast<float>(i) / static_cast<float>(LINEAR_TO_SRGB_SIZE);
+				const float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				linearToSrgb[i] = static_cast<uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+			}
+		}
+	};
+
+	const Tables &tables() {
+		static const Tables t;
+		return t;
+	}
+
+	uint64_t alignUp(uint64_t v, uint64_t a) {
+		return (v + a - 1) & ~(a - 1);
+	}
+
+	// the source texels one destination texel covers along an axis and how much of each
+	struct Taps {
+		uint32_t first;
+		uint32_t count;
+		float weights[3];
+	};
+
+	// even sizes halve exactly, 2 taps. An odd size n = 2 * dstSize + 1 gives each destination texel a
+	// footprint n / dstSize source texels wide, which touches 3 of them with the outer two partly covered
+	Taps taps(uint32_t d, uint32_t srcSize, uint32_t dstSize) {
+		if (srcSize == 1) {
+			return Taps{0, 1, {1.0f, 0.0f, 0.0f}};
+		}
+		if (srcSize % 2 == 0) {
+			return Taps{d * 2, 2, {0.5f, 0.5f, 0.0f}};
+		}
+		const float n = static_cast<float>(srcSize);
+		return Taps{d * 2, 3, {static_cast<float>(dstSize - d) / n, static_cast<float>(dstSize) / n, static_cast<float>(d + 1) / n}};
+	}
+
+	// box filters each destination texel's footprint, a plain 2x2 average when both sides are even and
+	// weighted 3 taps along an odd side so no source row or column is dropped
+	void downsample(const float *src, uint32_t srcW, uint32_t srcH, float *dst, uint32_t dstW, uint32_t dstH) {
+		if (srcW % 2 == 0 && srcH % 2 == 0) {
+			for (uint32_t y = 0; y < dstH; ++y) {
+				const float *row0 = src + static_cast<size_t>(y * 2) * srcW * 4;
+				const float *row1 = row0 + static_cast<size_t>(srcW) * 4;
+				float *out = dst + static_cast<size_t>(y) * dstW * 4;
+				for (uint32_t x = 0; x < dstW; ++x) {
+					const size_t x0 = static_cast<size_t>(x) * 8;
+					const size_t x1 = x0 + 4;
+#ifdef MIP_CHAIN_SSE
+					__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1))
+							, _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+					_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+					for (size_t c = 0; c < 4; ++c) {
+						out[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+					}
+#endif
+				}
+			}
+			return;
+		}
+		std::vector<Taps> columns(dstW);
+		for (uint32_t x = 0; x < dstW; ++x) {
+			columns[x] = taps(x, srcW, dstW);
+		}
+		for (uint32_t y = 0; y < dstH; ++y) {
+			const Taps rows = taps(y, srcH, dstH);
+			float *out = dst + static_cast<size_t>(y) * dstW * 4;
+			for (uint32_t x = 0; x < dstW; ++x) {
+				const Taps &cols = columns[x];
+#ifdef MIP_CHAIN_SSE
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t j = 0; j < rows.count; ++j) {
+					const float *row = src + static_cast<size_t>(rows.first + j) * srcW * 4;
+					__m128 rowSum = _mm_setzero_ps();
+					for (uint32_t i = 0; i < cols.count; ++i) {
+						rowSum = _mm_add_ps(rowSum, _mm_mul_ps(_mm_loadu_ps(row + static_cast<size_t>(cols.first + i) * 4)
+								, _mm_set1_ps(cols.weights[i])));
+					}
+					sum = _mm_add_ps(sum, _mm_mul_ps(rowSum, _mm_set1_ps(rows.weights[j])));
+				}
+				_mm_storeu_ps(out + x * 4, sum);
+#else
+				for (size_t c = 0; c < 4; ++c) {
+					float sum = 0.0f;
+					for (uint32_t j = 0; j < rows.count; ++j) {
+						const float *row = src + static_cast<size_t>(rows.first + j) * srcW * 4;
+						float rowSum = 0.0f;
+						for (uint32_t i = 0; i < cols.count; ++i) {
+							rowSum += row[static_cast<size_t>(cols.first + i) * 4 + c] * cols.weights[i];
+						}
+						sum += rowSum * rows.weights[j];
+					}
+					out[x * 4 + c] = sum;
+				}
+#endif
+			}
+		}
+	}
+
+	void toLinear(const uint8_t *pixels, size_t count, float *out) {
+		const Tables &t = tables();
+		for (size_t i = 0; i < count; ++i) {
+			out[i * 4 + 0] = t.srgbToLinear[pixels[i * 4 + 0]];
+			out[i * 4 + 1] = t.srgbToLinear[pixels[i * 4 + 1]];
+			out[i * 4 + 2] = t.srgbToLinear[pixels[i * 4 + 2]];
+			out[i * 4 + 3] = static_cast<float>(pixels[i * 4 + 3]) * (1.0f / 255.0f);
+		}
+	}
+
+	void toSrgb(const float *linear, size_t count, uint8_t *out) {
+		const Tables &t = tables();
+#ifdef MIP_CHAIN_SSE
+		const __m128 scale = _mm_set_ps(255.0f, static_cast<float>(LINEAR_TO_SRGB_SIZE), static_cast<float>(LINEAR_TO_SRGB_SIZE)
+				, static_cast<float>(LINEAR_TO_SRGB_SIZE));
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maxv = _mm_set_ps(255.0f, static_cast<float>(LINEAR_TO_SRGB_SIZE), static_cast<float>(LINEAR_TO_SRGB_SIZE)
+				, static_cast<float>(LINEAR_TO_SRGB_SIZE));
+		for (size_t i = 0; i < count; ++i) {
+			__m128 v = _mm_mul_ps(_mm_loadu_ps(linear + i * 4), scale);
+			v = _mm_min_ps(_mm_max_ps(_mm_add_ps(v, half), zero), maxv);
+			alignas(16) int32_t idx[4];
+			_mm_store_si128(reinterpret_cast<__m128i *>(idx), _mm_cvttps_epi32(v));
+			out[i * 4 + 0] = t.linearToSrgb[static_cast<size_t>(idx[0])];
+			out[i * 4 + 1] = t.linearToSrgb[static_cast<size_t>(idx[1])];
+			out[i * 4 + 2] = t.linearToSrgb[static_cast<size_t>(idx[2])];
+			out[i * 4 + 3] = static_cast<uint8_t>(idx[3]);
+		}
+#else
+		const float scale = static_cast<float>(LINEAR_TO_SRGB_SIZE);
+		for (size_t i = 0; i < count; ++i) {
+			for (size_t c = 0; c < 3; ++c) {
+				const float l = std::clamp(linear[i * 4 + c] * scale + 0.5f, 0.0f, scale);
+				out[i * 4 + c] = t.linearToSrgb[static_cast<size_t>(l)];
+			}
+			out[i * 4 + 3] = static_cast<uint8_t>(std::clamp(linear[i * 4 + 3] * 255.0f + 0.5f, 0.0f, 255.0f));
+		}
+#endif
+	}
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		++levels;
+	}
+	return levels;
+}
+
+void buildMipChain(const uint8_t *pixels, uint32_t width, uint32_t height
+		, std::vector<uint8_t> &data, std::vector<MipLevel> &levels) {
+	const uint32_t count = mipLevelCount(width, height);
+	levels.resize(count);
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		MipLevel &level = levels[i];
+		level.width = std::max(1u, width >> i);
+		level.height = std::max(1u, height >> i);
+		level.offset = total;
+		level.size = static_cast<uint64_t>(level.width) * level.height * 4;
+		total = alignUp(total + level.size, LEVEL_ALIGNMENT);
+	}
+	data.assign(total, 0);
+	memcpy(data.data(), pixels, levels[0].size);
+
+	std::vector<float> current(static_cast<size_t>(width) * height * 4);
+	std::vector<float> next;
+	toLinear(pixels, static_cast<size_t>(width) * height, current.data());
+	for (uint32_t i = 1; i < count; ++i) {
+		const MipLevel &src = levels[i - 1];
+		const MipLevel &dst = levels[i];
+		next.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+		downsample(current.data(), src.width, src.height, next.data(), dst.width, dst.height);
+		toSrgb(next.data(), static_cast<size_t>(dst.width) * dst.height, data.data() + dst.offset);
+		current.swap(next);
+	}
+}
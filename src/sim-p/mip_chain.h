@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct MipLevel {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+// Builds a full mip chain for an 8 bit sRGB RGBA image. Filtering is a box
+// over each texel's footprint done in linear space (alpha stays linear), 2x2
+// for even sizes and 3 weighted taps along an odd side, each level is derived from
+// the previous level's linear values so rounding doesn't accumulate.
+// Levels are packed back to back into data, every level starts on a 16 byte
+// boundary, level 0 is a copy of pixels.
+void buildMipChain(const uint8_t *pixels, uint32_t width, uint32_t height
+		, std::vector<uint8_t> &data, std::vector<MipLevel> &levels);
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
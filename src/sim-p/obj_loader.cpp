@@ -0,0 +1,50 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "obj_loader.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wdouble-promotion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wfloat-conversion"
+#include <tiny_obj_loader.h>
+#pragma GCC diagnostic pop
+
+bool loadObjVertexStream(const std::string &path, std::vector<Vertex> &stream, std::string &error) {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+		error = warn + err;
+		return false;
+	}
+
+	size_t corners = 0;
+	for (const auto& shape : shapes) {
+		corners += shape.mesh.indices.size();
+	}
+	stream.reserve(stream.size() + corners);
+
+	for (const auto& shape : shapes) {
+		for (const auto& index : shape.mesh.indices) {
+			Vertex vertex{};
+
+			vertex.pos = {
+				attrib.vertices[static_cast<std::vector<float>::size_type>(3 * index.vertex_index + 0)],
+				attrib.vertices[static_cast<std::vector<float>::size_type>(3 * index.vertex_index + 1)],
+				attrib.vertices[static_cast<std::vector<float>::size_type>(3 * index.vertex_index + 2)]
+			};
+
+			vertex.texCoord = {
+				attrib.texcoords[static_cast<std::vector<float>::size_type>(2 * index.texcoord_index + 0)],
+				1.0f - attrib.texcoords[static_cast<std::vector<float>::size_type>(2 * index.texcoord_index + 1)]
+			};
+
+			vertex.color = {1.0f, 1.0f, 1.0f};
+
+			stream.push_back(vertex);
+		}
+	}
+	return true;
+}
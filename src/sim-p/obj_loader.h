@@ -0,0 +1,8 @@
+#pragma once
+#include "vertex.h"
+#include <string>
+#include <vector>
+
+// Parses an OBJ file and appends one Vertex per face corner, in file order,
+// to stream. Returns false and fills error if the file could not be parsed.
+bool loadObjVertexStream(const std::string &path, std::vector<Vertex> &stream, std::string &error);
@@ -0,0 +1,237 @@
+#include "obj_reader.h"
+#include "mapped_file.h"
+#include "mesh_dedup.h"
+#include "parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	const size_t MIN_CHUNK_SIZE = 64 * 1024;
+	const size_t MAX_CHUNK_SIZE = 4 * 1024 * 1024;
+
+	struct Chunk {
+		const char *begin;
+		const char *end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		size_t positionBase;
+		size_t texCoordBase;
+	};
+
+	class ParseError : public std::runtime_error {
+	public:
+		explicit ParseError(const std::string &what) : std::runtime_error(what) {}
+	};
+
+	inline bool isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char *skipBlanks(const char *p, const char *end) {
+		while (p < end && isBlank(*p)) ++p;
+		return p;
+	}
+
+	inline const char *nextLine(const char *p, const char *end) {
+		const void *nl = memchr(p, '\n', static_cast<size_t>(end - p));
+		return nl ? static_cast<const char *>(nl) + 1 : end;
+	}
+
+	inline const char *parseFloat(const char *p, const char *end, float &out) {
+		p = skipBlanks(p, end);
+		if (p < end && *p == '+') ++p;
+		auto result = std::from_chars(p, end, out);
+		if (result.ec != std::errc()) {
+			throw ParseError("malformed number in OBJ");
+		}
+		return result.ptr;
+	}
+
+	inline const char *parseInt(const char *p, const char *end, long &out) {
+		if (p < end && *p == '+') ++p;
+		auto result = std::from_chars(p, end, out);
+		if (result.ec != std::errc()) {
+			throw ParseError("malformed index in OBJ");
+		}
+		return result.ptr;
+	}
+
+	// OBJ indices are 1 based, negative ones count back from the latest definition
+	inline size_t resolveIndex(long idx, size_t defined, const char *what) {
+		long long resolved = idx > 0 ? idx - 1 : static_cast<long long>(defined) + idx;
+		if (idx == 0 || resolved < 0 || static_cast<unsigned long long>(resolved) >= defined) {
+			throw ParseError(std::string("OBJ face references undefined ") + what);
+		}
+		return static_cast<size_t>(resolved);
+	}
+
+	void splitChunks(const char *data, size_t size, std::vector<Chunk> &chunks) {
+		const size_t target = std::clamp(size / (static_cast<size_t>(workerCount()) * 4), MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+		const char *end = data + size;
+		for (const char *p = data; p < end;) {
+			const char *chunkEnd = static_cast<size_t>(end - p) <= target ? end : nextLine(p + target, end);
+			Chunk c{};
+			c.begin = p;
+			c.end = chunkEnd;
+			chunks.push_back(std::move(c));
+			p = chunkEnd;
+		}
+	}
+
+	void parseAttributes(Chunk &c) {
+		for (const char *line = c.begin; line < c.end; line = nextLine(line, c.end)) {
+			const char *p = skipBlanks(line, c.end);
+			if (c.end - p < 2 || *p != 'v') {
+				continue;
+			}
+			if (isBlank(p[1])) {
+				glm::vec3 v;
+				p = parseFloat(p + 1, c.end, v.x);
+				p = parseFloat(p, c.end, v.y);
+				parseFloat(p, c.end, v.z);
+				c.positions.push_back(v);
+			} else if (p[1] == 't' && c.end - p > 2 && isBlank(p[2])) {
+				glm::vec2 vt;
+				p = parseFloat(p + 2, c.end, vt.x);
+				p = skipBlanks(p, c.end);
+				//a 1D texture coordinate is allowed, v defaults to 0
+				if (p < c.end && *p != '\n') {
+					parseFloat(p, c.end, vt.y);
+				} else {
+					vt.y = 0.0f;
+				}
+				c.texCoords.push_back(vt);
+			}
+		}
+	}
+
+	// triangulated the way tinyobjloader does it so both readers give the same mesh: quads are split along
+	// their shorter diagonal, other polygons are fanned (0, i-1, i)
+	void emitPolygon(const std::vector<Vertex> &polygon, std::vector<Vertex> &stream) {
+		if (polygon.size() == 4) {
+			const glm::vec3 d02 = polygon[2].pos - polygon[0].pos;
+			const glm::vec3 d13 = polygon[3].pos - polygon[1].pos;
+			const float sqr02 = d02.x * d02.x + d02.y * d02.y + d02.z * d02.z;
+			const float sqr13 = d13.x * d13.x + d13.y * d13.y + d13.z * d13.z;
+			static const size_t SPLIT02[6] = {0, 1, 2, 0, 2, 3};
+			static const size_t SPLIT13[6] = {0, 1, 3, 1, 2, 3};
+			for (size_t corner : sqr02 < sqr13 ? SPLIT02 : SPLIT13) {
+				stream.push_back(polygon[corner]);
+			}
+			return;
+		}
+		for (size_t i = 2; i < polygon.size(); ++i) {
+			stream.push_back(polygon[0]);
+			stream.push_back(polygon[i - 1]);
+			stream.push_back(polygon[i]);
+		}
+	}
+
+	void emitFaces(const Chunk &c, const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords
+			, std::vector<Vertex> &stream) {
+		size_t positionsDefined = c.positionBase;
+		size_t texCoordsDefined = c.texCoordBase;
+		std::vector<Vertex> polygon;
+		for (const char *line = c.begin; line < c.end; line = nextLine(line, c.end)) {
+			const char *p = skipBlanks(line, c.end);
+			if (c.end - p < 2 || !isBlank(p[1])) {
+				if (c.end - p > 2 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) ++texCoordsDefined;
+				continue;
+			}
+			if (*p == 'v') {
+				++positionsDefined;
+				continue;
+			}
+			if (*p != 'f') {
+				continue;
+			}
+			++p;
+			polygon.clear();
+			for (;;) {
+				p = skipBlanks(p, c.end);
+				if (p >= c.end || *p == '\n' || *p == '#') {
+					break;
+				}
+				long vi = 0, ti = 0;
+				bool hasTexCoord = false;
+				p = parseInt(p, c.end, vi);
+				if (p < c.end && *p == '/') {
+					++p;
+					if (p < c.end && *p != '/') {
+						p = parseInt(p, c.end, ti);
+						hasTexCoord = true;
+					}
+					//normals are not part of our vertex format
+					if (p < c.end && *p == '/') {
+						++p;
+						long ni = 0;
+						p = parseInt(p, c.end, ni);
+					}
+				}
+
+				Vertex vertex{};
+				vertex.pos = positions[resolveIndex(vi, positionsDefined, "position")];
+				if (hasTexCoord) {
+					const glm::vec2 &vt = texCoords[resolveIndex(ti, texCoordsDefined, "texture coordinate")];
+					vertex.texCoord = {vt.x, 1.0f - vt.y};
+				} else {
+					vertex.texCoord = {0.0f, 1.0f};
+				}
+				vertex.color = {1.0f, 1.0f, 1.0f};
+				polygon.push_back(vertex);
+			}
+			emitPolygon(polygon, stream);
+		}
+	}
+}
+
+bool readObj(const std::string &path, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, std::string &error) {
+	MappedFile file;
+	if (!file.open(path)) {
+		error = "failed to open " + path;
+		return false;
+	}
+	const char *data = reinterpret_cast<const char *>(file.data());
+
+	std::vector<Chunk> chunks;
+	splitChunks(data, file.size(), chunks);
+
+	try {
+		parallelFor(chunks.size(), [&](size_t i) {
+			parseAttributes(chunks[i]);
+		});
+
+		size_t positionCount = 0, texCoordCount = 0;
+		for (auto &c : chunks) {
+			c.positionBase = positionCount;
+			c.texCoordBase = texCoordCount;
+			positionCount += c.positions.size();
+			texCoordCount += c.texCoords.size();
+		}
+		std::vector<glm::vec3> positions(positionCount);
+		std::vector<glm::vec2> texCoords(texCoordCount);
+		parallelFor(chunks.size(), [&](size_t i) {
+			Chunk &c = chunks[i];
+			std::copy(c.positions.begin(), c.positions.end(), positions.begin() + static_cast<std::ptrdiff_t>(c.positionBase));
+			std::copy(c.texCoords.begin(), c.texCoords.end(), texCoords.begin() + static_cast<std::ptrdiff_t>(c.texCoordBase));
+			std::vector<glm::vec3>().swap(c.positions);
+			std::vector<glm::vec2>().swap(c.texCoords);
+		});
+
+		VertexDeduplicator dedup(chunks.size());
+		parallelFor(chunks.size(), [&](size_t i) {
+			std::vector<Vertex> stream;
+			emitFaces(chunks[i], positions, texCoords, stream);
+			dedup.addChunk(i, stream.data(), stream.size());
+			//this chunk's text is no longer needed, let the kernel drop it from our RSS
+			file.release(static_cast<size_t>(chunks[i].begin - data), static_cast<size_t>(chunks[i].end - chunks[i].begin));
+		});
+		dedup.finish(vertices, indices);
+	} catch (const std::exception &e) {
+		error = path + ": " + e.what();
+		return false;
+	}
+	return true;
+}
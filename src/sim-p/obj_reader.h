@@ -0,0 +1,14 @@
+#pragma once
+#include "vertex.h"
+#include <string>
+#include <vector>
+
+// In tree OBJ reader. The file is memory mapped and cut into chunks on line
+// boundaries; positions and texture coordinates are parsed on all cores, then
+// each chunk's faces are turned into vertices and fed straight into the
+// VertexDeduplicator, so only one chunk's worth of corners is ever live per
+// thread. Only v, vt and f records are used. Quads are split along their
+// shorter diagonal and larger polygons fan triangulated, which matches
+// tinyobjloader for triangles and quads.
+// Appends to vertices/indices, returns false and fills error on failure.
+bool readObj(const std::string &path, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, std::string &error);
@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline unsigned workerCount() {
+	unsigned n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+// Calls fn(i) for every i in [0, count) spread over the available cores.
+// Work is handed out one index at a time so uneven items balance out.
+// The first exception thrown by any worker is rethrown on the calling thread.
+template<typename Fn>
+void parallelFor(size_t count, Fn &&fn) {
+	const size_t threads = std::min<size_t>(workerCount(), count);
+	if (threads <= 1) {
+		for (size_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next{0};
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	auto worker = [&]() {
+		for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+			try {
+				fn(i);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	pool.reserve(threads - 1);
+	for (size_t t = 1; t < threads; ++t) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto &t : pool) {
+		t.join();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
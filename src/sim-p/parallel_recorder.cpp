@@ -0,0 +1,131 @@
+#include "parallel_recorder.h"
+#include "cpu_profiler.h"
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+ParallelRecorder::ParallelRecorder() : Device(VK_NULL_HANDLE), FrameSlots(0), Workers(0), Pools(), Threads() {
+
+}
+
+ParallelRecorder::~ParallelRecorder() {
+	shutdown();
+}
+
+void ParallelRecorder::init(VkDevice device, uint32_t queueFamily, uint32_t frameSlots, uint32_t workers) {
+	Device = device;
+	FrameSlots = frameSlots;
+	Workers = workers == 0 ? 1 : workers;
+
+	//transient, the buffers are reset with their pool every time they are recorded
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	Pools.resize(size_t{Workers} * FrameSlots);
+	for (auto &pool : Pools) {
+		if (vkCreateCommandPool(Device, &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create recording command pool!");
+		}
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(Device, &allocInfo, &pool.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate recording command buffer!");
+		}
+	}
+	if (Workers > 1) {
+		Threads = std::make_unique<ThreadPool>(Workers - 1);
+	}
+}
+
+void ParallelRecorder::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	Threads.reset();
+	for (auto &pool : Pools) {
+		vkDestroyCommandPool(Device, pool.commandPool, nullptr);
+	}
+	Pools.clear();
+	Device = VK_NULL_HANDLE;
+}
+
+void ParallelRecorder::recordOne(WorkerPool &pool, VkRenderPass renderPass, VkQueryPipelineStatisticFlags pipelineStatistics
+		, size_t begin, size_t end, uint32_t frameSlot, const RecordSlice &recordSlice) {
+	PROFILE_ZONE("record slice");
+	if (vkResetCommandPool(Device, pool.commandPool, 0) != VK_SUCCESS) {
+		throw std::runtime_error("failed to reset recording command pool!");
+	}
+
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = renderPass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = VK_NULL_HANDLE;
+	inheritance.pipelineStatistics = pipelineStatistics;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+	if (vkBeginCommandBuffer(pool.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording slice command buffer!");
+	}
+	recordSlice(pool.commandBuffer, begin, end, frameSlot);
+	if (vkEndCommandBuffer(pool.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record slice command buffer!");
+	}
+}
+
+void ParallelRecorder::record(uint32_t frameSlot, VkRenderPass renderPass, VkQueryPipelineStatisticFlags pipelineStatistics
+		, size_t drawCount, const RecordSlice &recordSlice, std::vector<VkCommandBuffer> &secondaries) {
+	size_t slices = (drawCount + MIN_DRAWS_PER_SLICE - 1) / MIN_DRAWS_PER_SLICE;
+	if (slices > Workers) {
+		slices = Workers;
+	}
+	//even an empty draw list gets a slice, whatever state it sets is still recorded
+	if (slices == 0) {
+		slices = 1;
+	}
+	secondaries.resize(slices);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	for (size_t s = 0; s < slices; ++s) {
+		WorkerPool &pool = Pools[s * FrameSlots + frameSlot];
+		secondaries[s] = pool.commandBuffer;
+		const size_t begin = drawCount * s / slices;
+		const size_t end = drawCount * (s + 1) / slices;
+		if (s == 0) {
+			continue;
+		}
+		Threads->submit([this, &pool, &recordSlice, &error, &errorMutex, renderPass, pipelineStatistics, begin, end
+				, frameSlot]() {
+			try {
+				recordOne(pool, renderPass, pipelineStatistics, begin, end, frameSlot, recordSlice);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		});
+	}
+	//the first slice on this thread while the workers get going
+	try {
+		recordOne(Pools[frameSlot], renderPass, pipelineStatistics, 0, drawCount / slices, frameSlot, recordSlice);
+	} catch (...) {
+		if (Threads) {
+			Threads->wait();
+		}
+		throw;
+	}
+	if (Threads) {
+		Threads->wait();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
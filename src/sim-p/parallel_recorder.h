@@ -0,0 +1,49 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "thread_pool.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Records a draw list into secondary command buffers on several threads.
+// Every worker owns one command pool per frame slot, so a pool is never
+// touched by two threads at once and a slot's pools are reset wholesale
+// once its fence has been waited on. Slices are contiguous ranges of the
+// draw list and come back in draw order, so what the primary executes
+// doesn't depend on which thread finished first.
+class ParallelRecorder {
+public:
+	// records draws [begin, end) into a secondary continuing the render pass,
+	// dynamic state has to be set again in every slice
+	typedef std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end, uint32_t frameSlot)> RecordSlice;
+	//below this a slice isn't worth a thread hop
+	static const size_t MIN_DRAWS_PER_SLICE = 256;
+public:
+	ParallelRecorder();
+	~ParallelRecorder();
+	// workers includes the calling thread, which records the first slice itself
+	void init(VkDevice device, uint32_t queueFamily, uint32_t frameSlots, uint32_t workers);
+	void shutdown();
+	// resets frameSlot's pools and records drawCount draws as up to workers()
+	// secondaries, replacing the contents of secondaries. pipelineStatistics is what
+	// a statistics query active in the primary around them collects, 0 for none
+	void record(uint32_t frameSlot, VkRenderPass renderPass, VkQueryPipelineStatisticFlags pipelineStatistics, size_t drawCount
+			, const RecordSlice &recordSlice, std::vector<VkCommandBuffer> &secondaries);
+	uint32_t workers() const { return Workers; }
+private:
+	struct WorkerPool {
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+	};
+	void recordOne(WorkerPool &pool, VkRenderPass renderPass, VkQueryPipelineStatisticFlags pipelineStatistics, size_t begin
+			, size_t end, uint32_t frameSlot, const RecordSlice &recordSlice);
+private:
+	VkDevice Device;
+	uint32_t FrameSlots;
+	uint32_t Workers;
+	//indexed by worker * FrameSlots + frameSlot
+	std::vector<WorkerPool> Pools;
+	std::unique_ptr<ThreadPool> Threads;
+};
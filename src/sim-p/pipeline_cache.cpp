@@ -0,0 +1,188 @@
+#include "pipeline_cache.h"
+#include "hash.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	double msSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+PipelineFeedback::PipelineFeedback(uint32_t stageCount) : pipeline(), stages(), info() {
+	if (stageCount > MAX_STAGES) {
+		throw std::runtime_error("too many pipeline stages for creation feedback!");
+	}
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+	info.pPipelineCreationFeedback = &pipeline;
+	info.pipelineStageCreationFeedbackCount = stageCount;
+	info.pPipelineStageCreationFeedbacks = stages;
+}
+
+PipelineCache::PipelineCache() : Device(VK_NULL_HANDLE), Properties(), Path(), Cache(VK_NULL_HANDLE), LoadedHash(0), LoadedSize(0)
+	, StatsMutex(), Stats() {
+
+}
+
+void PipelineCache::init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string &path) {
+	Device = device;
+	Path = path;
+	vkGetPhysicalDeviceProperties(physicalDevice, &Properties);
+
+	const auto start = std::chrono::steady_clock::now();
+	MappedFile file;
+	const bool valid = file.open(Path) && validate(file);
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (valid) {
+		//straight out of the mapping, the driver copies what it keeps
+		const PipelineCacheHeader *header = reinterpret_cast<const PipelineCacheHeader *>(file.data());
+		createInfo.initialDataSize = header->dataSize;
+		createInfo.pInitialData = file.data() + sizeof(PipelineCacheHeader);
+		LoadedHash = header->dataHash;
+		LoadedSize = createInfo.initialDataSize;
+	}
+	if (vkCreatePipelineCache(Device, &createInfo, nullptr, &Cache) != VK_SUCCESS) {
+		//the driver has the last word on its own data, start over without it
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		LoadedHash = 0;
+		LoadedSize = 0;
+		if (vkCreatePipelineCache(Device, &createInfo, nullptr, &Cache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+	const double ms = msSince(start);
+	{
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		Stats.loadedBytes = LoadedSize;
+		Stats.loadMs = ms;
+	}
+	std::cout << "pipeline cache: " << (LoadedSize ? "loaded " : "starting empty, ") << LoadedSize / 1024 << " KB from " << Path
+		<< " in " << ms << " ms" << std::endl;
+}
+
+bool PipelineCache::validate(const MappedFile &file) const {
+	const char *reason = nullptr;
+	PipelineCacheHeader header{};
+	VkPipelineCacheHeaderVersionOne driverHeader{};
+	if (file.size() < sizeof(header) + sizeof(driverHeader)) {
+		reason = "is truncated";
+	} else {
+		memcpy(&header, file.data(), sizeof(header));
+		memcpy(&driverHeader, file.data() + sizeof(header), sizeof(driverHeader));
+		if (header.magic != MAGIC || header.version != VERSION) {
+			reason = "is from another version";
+		} else if (header.dataSize != file.size() - sizeof(header)) {
+			reason = "is truncated";
+		} else if (header.vendorID != Properties.vendorID || header.deviceID != Properties.deviceID
+				|| memcmp(header.pipelineCacheUUID, Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			reason = "is for another device";
+		} else if (header.driverVersion != Properties.driverVersion) {
+			reason = "is for another driver version";
+		} else if (header.headerVersion != VK_HEADER_VERSION) {
+			reason = "was written against other Vulkan headers";
+		} else if (driverHeader.headerSize < sizeof(driverHeader) || driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+				|| driverHeader.vendorID != Properties.vendorID || driverHeader.deviceID != Properties.deviceID
+				|| memcmp(driverHeader.pipelineCacheUUID, Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			reason = "holds driver data for another device";
+		} else if (hashBytes(file.data() + sizeof(header), header.dataSize) != header.dataHash) {
+			reason = "is corrupt";
+		}
+	}
+	if (reason) {
+		std::cout << "pipeline cache " << Path << " " << reason << ", ignoring it" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool PipelineCache::save() {
+	if (Cache == VK_NULL_HANDLE) {
+		return false;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	size_t size = 0;
+	if (vkGetPipelineCacheData(Device, Cache, &size, nullptr) != VK_SUCCESS) {
+		return false;
+	}
+	std::vector<char> data(size);
+	//VK_INCOMPLETE if the cache grew in between, which nothing here does
+	if (size == 0 || vkGetPipelineCacheData(Device, Cache, &size, data.data()) != VK_SUCCESS) {
+		return false;
+	}
+	const uint64_t hash = hashBytes(data.data(), size);
+	if (hash == LoadedHash && size == LoadedSize) {
+		std::cout << "pipeline cache: unchanged, not written" << std::endl;
+		return true;
+	}
+
+	PipelineCacheHeader header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.vendorID = Properties.vendorID;
+	header.deviceID = Properties.deviceID;
+	header.driverVersion = Properties.driverVersion;
+	header.headerVersion = VK_HEADER_VERSION;
+	memcpy(header.pipelineCacheUUID, Properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = size;
+	header.dataHash = hash;
+
+	//write next to the destination and rename so a crash never leaves a torn cache behind
+	const std::string tmpPath = Path + ".tmp";
+	FILE *file = fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(data.data(), 1, size, file) == size;
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || std::rename(tmpPath.c_str(), Path.c_str()) != 0) {
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	LoadedHash = hash;
+	LoadedSize = size;
+	const double ms = msSince(start);
+	{
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		Stats.savedBytes = size;
+		Stats.saveMs = ms;
+	}
+	std::cout << "pipeline cache: saved " << size / 1024 << " KB to " << Path << " in " << ms << " ms" << std::endl;
+	return true;
+}
+
+void PipelineCache::shutdown() {
+	if (Cache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(Device, Cache, nullptr);
+		Cache = VK_NULL_HANDLE;
+	}
+}
+
+PipelineCacheStats PipelineCache::stats() const {
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	return Stats;
+}
+
+void PipelineCache::record(const char *name, const PipelineFeedback &feedback) {
+	const VkPipelineCreationFeedback &pipeline = feedback.pipeline;
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	const char *result = "compiled";
+	if (!(pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT)) {
+		++Stats.unreported;
+		result = "created";
+	} else if (pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) {
+		++Stats.hits;
+		result = "cache hit";
+	} else {
+		++Stats.misses;
+	}
+	const double ms = static_cast<double>(pipeline.duration) / 1e6;
+	Stats.compileMs += ms;
+	std::cout << "pipeline " << name << ": " << result << " in " << ms << " ms" << std::endl;
+}
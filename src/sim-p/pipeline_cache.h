@@ -0,0 +1,81 @@
+#pragma once
+#include "mapped_file.h"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// On disk layout: this header, then the data vkGetPipelineCacheData returned.
+// The device fields repeat what the driver puts in its own header so a cache
+// from another GPU or driver is thrown away before the driver ever sees it.
+struct PipelineCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint32_t headerVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
+
+struct PipelineCacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	//drivers don't have to say whether the cache was used
+	uint64_t unreported;
+	double compileMs;
+	size_t loadedBytes;
+	double loadMs;
+	size_t savedBytes;
+	double saveMs;
+};
+
+// Creation feedback chained into one pipeline's create info, handed to
+// PipelineCache::record once the pipeline exists. Points into itself, so it
+// stays where it was made.
+struct PipelineFeedback {
+	static const uint32_t MAX_STAGES = 4;
+
+	explicit PipelineFeedback(uint32_t stageCount);
+	PipelineFeedback(const PipelineFeedback &) = delete;
+	PipelineFeedback &operator=(const PipelineFeedback &) = delete;
+
+	VkPipelineCreationFeedback pipeline;
+	VkPipelineCreationFeedback stages[MAX_STAGES];
+	VkPipelineCreationFeedbackCreateInfo info;
+};
+
+// A VkPipelineCache that lives across runs. init() loads it from disk when
+// it was written for the same device, driver and Vulkan headers, and starts
+// empty otherwise; save() writes it back next to the old one and renames it
+// over, so a crash never leaves a torn cache behind.
+class PipelineCache {
+public:
+	static const uint32_t MAGIC = 0x43505053; // 'SPPC'
+	static const uint32_t VERSION = 1;
+public:
+	PipelineCache();
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string &path);
+	// returns false if the cache couldn't be written
+	bool save();
+	void shutdown();
+	VkPipelineCache handle() const { return Cache; }
+	// counts and logs how the pipeline named name was created, from any thread
+	void record(const char *name, const PipelineFeedback &feedback);
+	PipelineCacheStats stats() const;
+private:
+	// logs why file can't be handed to the driver
+	bool validate(const MappedFile &file) const;
+private:
+	VkDevice Device;
+	VkPhysicalDeviceProperties Properties;
+	std::string Path;
+	VkPipelineCache Cache;
+	//what was loaded, to skip the write when nothing new was compiled
+	uint64_t LoadedHash;
+	size_t LoadedSize;
+	mutable std::mutex StatsMutex;
+	PipelineCacheStats Stats;
+};
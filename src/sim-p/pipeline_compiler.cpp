@@ -0,0 +1,298 @@
+#include "pipeline_compiler.h"
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	double msSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template<typename T>
+	void append(std::vector<uint8_t> &key, const T &value) {
+		const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+		key.insert(key.end(), bytes, bytes + sizeof(T));
+	}
+
+	void append(std::vector<uint8_t> &key, const std::string &value) {
+		append(key, value.size());
+		key.insert(key.end(), value.begin(), value.end());
+	}
+}
+
+uint64_t GraphicsPipelineDesc::hash() const {
+	//field by field, the Vulkan structs involved have no padding
+	std::vector<uint8_t> key;
+	append(key, stages.size());
+	for (const ShaderStageDesc &stage : stages) {
+		append(key, stage.stage);
+		append(key, stage.path);
+		append(key, stage.defines.size());
+		for (const ShaderDefine &define : stage.defines) {
+			append(key, define.name);
+			append(key, define.value);
+		}
+	}
+	append(key, bindings.size());
+	for (const auto &binding : bindings) {
+		append(key, binding);
+	}
+	append(key, attributes.size());
+	for (const auto &attribute : attributes) {
+		append(key, attribute);
+	}
+	append(key, topology);
+	append(key, polygonMode);
+	append(key, cullMode);
+	append(key, frontFace);
+	append(key, depthTest);
+	append(key, depthWrite);
+	append(key, depthCompare);
+	append(key, blend);
+	append(key, layout);
+	append(key, renderPass);
+	append(key, subpass);
+	return hashBytes(key.data(), key.size());
+}
+
+PipelineCompiler::PipelineCompiler() : Device(VK_NULL_HANDLE), Cache(nullptr), Shaders(nullptr), Workers(), Mutex(), Entries(), ByHash(), Finished()
+	, Outstanding(0), Stats() {
+
+}
+
+PipelineCompiler::~PipelineCompiler() {
+	shutdown();
+}
+
+void PipelineCompiler::init(VkDevice device, PipelineCache *pipelineCache, ShaderCompiler *shaders, size_t threads) {
+	Device = device;
+	Cache = pipelineCache;
+	Shaders = shaders;
+	Workers = std::make_unique<ThreadPool>(std::max<size_t>(1, threads));
+}
+
+void PipelineCompiler::shutdown() {
+	if (Workers) {
+		Workers->wait();
+		Workers.reset();
+	}
+	for (Entry &entry : Entries) {
+		if (entry.pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(Device, entry.pipeline, nullptr);
+		}
+	}
+	Entries.clear();
+	ByHash.clear();
+	Finished.clear();
+	Outstanding = 0;
+}
+
+PipelineHandle PipelineCompiler::request(const GraphicsPipelineDesc &desc) {
+	const uint64_t hash = desc.hash();
+	PipelineHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		++Stats.requests;
+		auto it = ByHash.find(hash);
+		if (it != ByHash.end()) {
+			++Stats.coalesced;
+			return it->second;
+		}
+		handle = static_cast<PipelineHandle>(Entries.size());
+		Entries.push_back({desc, std::chrono::steady_clock::now(), VK_NULL_HANDLE, false, false});
+		ByHash.emplace(hash, handle);
+		++Outstanding;
+	}
+	Workers->submit([this, handle]() { compile(handle); });
+	return handle;
+}
+
+VkPipeline PipelineCompiler::pipeline(PipelineHandle handle) const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Entries[handle].pipeline;
+}
+
+bool PipelineCompiler::failed(PipelineHandle handle) const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Entries[handle].failed;
+}
+
+void PipelineCompiler::collect(std::vector<PipelineHandle> &done) {
+	std::lock_guard<std::mutex> lock(Mutex);
+	done.insert(done.end(), Finished.begin(), Finished.end());
+	Finished.clear();
+}
+
+size_t PipelineCompiler::outstanding() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Outstanding;
+}
+
+PipelineCompilerStats PipelineCompiler::stats() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Stats;
+}
+
+void PipelineCompiler::compile(PipelineHandle handle) {
+	Entry *entry;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		entry = &Entries[handle];
+	}
+	//the description is never written once requested, no lock needed to read it
+	const auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	std::string error;
+	try {
+		pipeline = create(entry->desc);
+	} catch (const std::exception &e) {
+		error = e.what();
+	}
+	const double compileMs = msSince(start);
+	const double latencyMs = msSince(entry->requested);
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	entry->pipeline = pipeline;
+	entry->finished = true;
+	entry->failed = pipeline == VK_NULL_HANDLE;
+	Finished.push_back(handle);
+	--Outstanding;
+	if (entry->failed) {
+		++Stats.failed;
+		std::cout << "pipeline " << entry->desc.name << " failed: " << error << std::endl;
+		return;
+	}
+	++Stats.compiled;
+	Stats.compileMs += compileMs;
+	Stats.latencyMs += latencyMs;
+	Stats.maxLatencyMs = std::max(Stats.maxLatencyMs, latencyMs);
+	std::cout << "pipeline " << entry->desc.name << ": ready " << latencyMs << " ms after its request, "
+		<< compileMs << " ms of that compiling" << std::endl;
+}
+
+VkPipeline PipelineCompiler::create(const GraphicsPipelineDesc &desc) {
+	if (desc.stages.size() > PipelineFeedback::MAX_STAGES) {
+		throw std::runtime_error("too many shader stages!");
+	}
+	VkShaderModule modules[PipelineFeedback::MAX_STAGES] = {};
+	VkPipelineShaderStageCreateInfo stages[PipelineFeedback::MAX_STAGES] = {};
+	const uint32_t stageCount = static_cast<uint32_t>(desc.stages.size());
+	auto destroyModules = [this, &modules, stageCount]() {
+		for (uint32_t i = 0; i < stageCount; ++i) {
+			if (modules[i] != VK_NULL_HANDLE) {
+				vkDestroyShaderModule(Device, modules[i], nullptr);
+			}
+		}
+	};
+	for (uint32_t i = 0; i < stageCount; ++i) {
+		std::vector<uint32_t> code;
+		std::string error;
+		if (!Shaders->compile(desc.stages[i].path, desc.stages[i].defines, code, error)) {
+			destroyModules();
+			throw std::runtime_error("failed to compile " + desc.stages[i].path + ": " + error);
+		}
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size() * sizeof(uint32_t);
+		moduleInfo.pCode = code.data();
+		if (vkCreateShaderModule(Device, &moduleInfo, nullptr, &modules[i]) != VK_SUCCESS) {
+			destroyModules();
+			throw std::runtime_error("failed to create shader module!");
+		}
+		stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[i].stage = desc.stages[i].stage;
+		stages[i].module = modules[i];
+		stages[i].pName = "main";
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = desc.bindings.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = desc.polygonMode;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = desc.blend ? VK_TRUE : VK_FALSE;
+	//straight alpha
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = desc.depthCompare;
+	depthStencil.minDepthBounds = 0.0f;
+	depthStencil.maxDepthBounds = 1.0f;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = stageCount;
+	pipelineInfo.pStages = stages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = desc.layout;
+	pipelineInfo.renderPass = desc.renderPass;
+	pipelineInfo.subpass = desc.subpass;
+	PipelineFeedback feedback(stageCount);
+	pipelineInfo.pNext = Cache ? &feedback.info : nullptr;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	const VkResult result = vkCreateGraphicsPipelines(Device, Cache ? Cache->handle() : VK_NULL_HANDLE, 1, &pipelineInfo, nullptr
+			, &pipeline);
+	destroyModules();
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+	if (Cache) {
+		Cache->record(desc.name.c_str(), feedback);
+	}
+	return pipeline;
+}
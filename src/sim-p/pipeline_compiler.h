@@ -0,0 +1,103 @@
+#pragma once
+#include "pipeline_cache.h"
+#include "shader_compiler.h"
+#include "thread_pool.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderStageDesc {
+	VkShaderStageFlagBits stage;
+	// GLSL, compiled or fetched from the shader cache on the compile thread
+	std::string path;
+	std::vector<ShaderDefine> defines;
+};
+
+// The state that tells the renderer's graphics pipelines apart. Viewport and
+// scissor are always dynamic, there is one color attachment and no
+// multisampling. Two descriptions with the same hash() are the same pipeline.
+struct GraphicsPipelineDesc {
+	// for the logs, not part of the hash
+	std::string name;
+	std::vector<ShaderStageDesc> stages;
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	VkPrimitiveTopology topology;
+	VkPolygonMode polygonMode;
+	VkCullModeFlags cullMode;
+	VkFrontFace frontFace;
+	bool depthTest;
+	bool depthWrite;
+	VkCompareOp depthCompare;
+	bool blend;
+	VkPipelineLayout layout;
+	VkRenderPass renderPass;
+	uint32_t subpass;
+
+	uint64_t hash() const;
+};
+
+using PipelineHandle = uint32_t;
+
+struct PipelineCompilerStats {
+	uint64_t requests;
+	uint64_t coalesced;
+	uint64_t compiled;
+	uint64_t failed;
+	//summed over pipelines: time on a compile thread and time from request to ready
+	double compileMs;
+	double latencyMs;
+	double maxLatencyMs;
+};
+
+// Compiles graphics pipelines on worker threads. request() returns at once
+// with a handle, a description already requested hands back the first
+// request's handle. Until collect() has reported a handle, pipeline() is
+// VK_NULL_HANDLE and draws using it have to be skipped or fall back to
+// something already compiled. Every pipeline goes through the persistent
+// PipelineCache and lives until shutdown().
+class PipelineCompiler {
+public:
+	PipelineCompiler();
+	~PipelineCompiler();
+	// pipelineCache may be null
+	void init(VkDevice device, PipelineCache *pipelineCache, ShaderCompiler *shaders, size_t threads);
+	// waits for the compiles in flight and destroys every pipeline
+	void shutdown();
+	PipelineHandle request(const GraphicsPipelineDesc &desc);
+	VkPipeline pipeline(PipelineHandle handle) const;
+	bool failed(PipelineHandle handle) const;
+	// moves every handle that finished, compiled or failed, since the last call into done
+	void collect(std::vector<PipelineHandle> &done);
+	size_t outstanding() const;
+	PipelineCompilerStats stats() const;
+private:
+	struct Entry {
+		GraphicsPipelineDesc desc;
+		std::chrono::steady_clock::time_point requested;
+		VkPipeline pipeline;
+		bool finished;
+		bool failed;
+	};
+	// on a worker thread, never throws
+	void compile(PipelineHandle handle);
+	VkPipeline create(const GraphicsPipelineDesc &desc);
+private:
+	VkDevice Device;
+	PipelineCache *Cache;
+	ShaderCompiler *Shaders;
+	std::unique_ptr<ThreadPool> Workers;
+	mutable std::mutex Mutex;
+	//a deque so workers can hold on to an entry while requests add more
+	std::deque<Entry> Entries;
+	std::unordered_map<uint64_t, PipelineHandle> ByHash;
+	std::vector<PipelineHandle> Finished;
+	size_t Outstanding;
+	PipelineCompilerStats Stats;
+};
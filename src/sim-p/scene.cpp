@@ -0,0 +1,400 @@
+#include "scene.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCENE_SSE 1
+#endif
+
+namespace {
+	const uint32_t MAX_STACK = 256;
+
+	float area(const Aabb &box) {
+		const glm::vec3 d = glm::max(box.max - box.min, glm::vec3(0.0f));
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	Aabb merge(const Aabb &a, const Aabb &b) {
+		return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+	}
+
+	void setLane(BvhNode &node, uint32_t i, const Aabb &box) {
+		for (int axis = 0; axis < 3; ++axis) {
+			node.bounds[axis][i] = box.min[axis];
+			node.bounds[axis + 3][i] = box.max[axis];
+		}
+	}
+
+	Aabb lane(const BvhNode &node, uint32_t i) {
+		return {glm::vec3(node.bounds[0][i], node.bounds[1][i], node.bounds[2][i])
+			, glm::vec3(node.bounds[3][i], node.bounds[4][i], node.bounds[5][i])};
+	}
+
+	Aabb nodeBounds(const BvhNode &node) {
+		Aabb box = lane(node, 0);
+		for (uint32_t i = 1; i < node.childCount; ++i) {
+			box = merge(box, lane(node, i));
+		}
+		return box;
+	}
+
+	// per plane, which of the node's bound rows hold the vertex furthest along
+	// the normal (positive) and furthest against it (negative)
+	struct PlaneTest {
+		float normal[3];
+		float d;
+		int positive[3];
+		int negative[3];
+	};
+
+	void preparePlanes(const Frustum &frustum, PlaneTest *tests) {
+		for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+			const glm::vec4 &plane = frustum.planes[p];
+			tests[p].d = plane.w;
+			for (int axis = 0; axis < 3; ++axis) {
+				tests[p].normal[axis] = plane[axis];
+				tests[p].positive[axis] = plane[axis] >= 0.0f ? axis + 3 : axis;
+				tests[p].negative[axis] = plane[axis] >= 0.0f ? axis : axis + 3;
+			}
+		}
+	}
+
+	// bit i of outside is set when child i is outside some plane, bit i of inside when it is inside all of them
+	void testChildren(const BvhNode &node, const PlaneTest *tests, uint32_t &outside, uint32_t &inside) {
+#ifdef SCENE_SSE
+		__m128 out = _mm_setzero_ps();
+		__m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		const __m128 zero = _mm_setzero_ps();
+		for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+			const PlaneTest &t = tests[p];
+			const __m128 nx = _mm_set1_ps(t.normal[0]);
+			const __m128 ny = _mm_set1_ps(t.normal[1]);
+			const __m128 nz = _mm_set1_ps(t.normal[2]);
+			const __m128 d = _mm_set1_ps(t.d);
+			const __m128 farDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(node.bounds[t.positive[0]]))
+					, _mm_mul_ps(ny, _mm_load_ps(node.bounds[t.positive[1]])))
+					, _mm_add_ps(_mm_mul_ps(nz, _mm_load_ps(node.bounds[t.positive[2]])), d));
+			const __m128 nearDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(node.bounds[t.negative[0]]))
+					, _mm_mul_ps(ny, _mm_load_ps(node.bounds[t.negative[1]])))
+					, _mm_add_ps(_mm_mul_ps(nz, _mm_load_ps(node.bounds[t.negative[2]])), d));
+			out = _mm_or_ps(out, _mm_cmplt_ps(farDist, zero));
+			in = _mm_and_ps(in, _mm_cmpge_ps(nearDist, zero));
+		}
+		outside = static_cast<uint32_t>(_mm_movemask_ps(out));
+		inside = static_cast<uint32_t>(_mm_movemask_ps(in));
+#else
+		outside = 0;
+		inside = (1u << BvhNode::WIDTH) - 1;
+		for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+			const PlaneTest &t = tests[p];
+			for (uint32_t i = 0; i < BvhNode::WIDTH; ++i) {
+				const float farDist = t.normal[0] * node.bounds[t.positive[0]][i] + t.normal[1] * node.bounds[t.positive[1]][i]
+					+ (t.normal[2] * node.bounds[t.positive[2]][i] + t.d);
+				const float nearDist = t.normal[0] * node.bounds[t.negative[0]][i] + t.normal[1] * node.bounds[t.negative[1]][i]
+					+ (t.normal[2] * node.bounds[t.negative[2]][i] + t.d);
+				outside |= farDist < 0.0f ? 1u << i : 0u;
+				inside &= nearDist >= 0.0f ? ~0u : ~(1u << i);
+			}
+		}
+#endif
+		const uint32_t used = (1u << node.childCount) - 1;
+		outside &= used;
+		inside &= used & ~outside;
+	}
+}
+
+Scene::Scene() : Workers(1), Threads(), MeshSpheres(), Objects(), Bounds(), Centroids(), Order(), Subtrees(), BuiltTopCost(0.0f)
+	, Dirty(true), Stats() {
+
+}
+
+void Scene::init(uint32_t workers) {
+	Workers = std::max(1u, workers);
+	Threads.reset();
+	if (Workers > 1) {
+		Threads = std::make_unique<ThreadPool>(Workers - 1);
+	}
+}
+
+void Scene::shutdown() {
+	Threads.reset();
+	Subtrees.clear();
+	Order.clear();
+	Centroids.clear();
+	Bounds.clear();
+	Objects.clear();
+	MeshSpheres.clear();
+	Dirty = true;
+}
+
+void Scene::forEach(size_t count, const std::function<void(size_t)> &fn) const {
+	std::atomic<size_t> next{0};
+	auto worker = [&next, &fn, count]() {
+		for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+			fn(i);
+		}
+	};
+	const size_t helpers = Threads ? std::min(Threads->size(), count > 0 ? count - 1 : 0) : 0;
+	for (size_t t = 0; t < helpers; ++t) {
+		Threads->submit(worker);
+	}
+	worker();
+	if (helpers) {
+		Threads->wait();
+	}
+}
+
+uint32_t Scene::addMesh(const glm::vec4 &sphere) {
+	MeshSpheres.push_back(sphere);
+	return static_cast<uint32_t>(MeshSpheres.size() - 1);
+}
+
+void Scene::setMeshSphere(uint32_t mesh, const glm::vec4 &sphere) {
+	MeshSpheres[mesh] = sphere;
+	//every object showing it changes size, a refit would leave the split badly off
+	Dirty = true;
+}
+
+uint32_t Scene::addObject(const SceneObject &object) {
+	Objects.push_back(object);
+	Dirty = true;
+	return static_cast<uint32_t>(Objects.size() - 1);
+}
+
+Aabb Scene::objectBounds(const SceneObject &object) const {
+	const glm::vec4 &sphere = MeshSpheres[object.mesh];
+	const glm::vec3 center = object.position + object.rotation * (glm::vec3(sphere) * object.scale);
+	const glm::vec3 radius(sphere.w * object.scale);
+	return {center - radius, center + radius};
+}
+
+uint32_t Scene::medianSplit(uint32_t first, uint32_t count) {
+	glm::vec3 lo(std::numeric_limits<float>::max());
+	glm::vec3 hi(-std::numeric_limits<float>::max());
+	for (uint32_t i = first; i < first + count; ++i) {
+		lo = glm::min(lo, Centroids[Order[i]]);
+		hi = glm::max(hi, Centroids[Order[i]]);
+	}
+	const glm::vec3 extent = hi - lo;
+	const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	const uint32_t half = count / 2;
+	auto begin = Order.begin() + first;
+	std::nth_element(begin, begin + half, begin + count, [this, axis](uint32_t a, uint32_t b) {
+		return Centroids[a][axis] < Centroids[b][axis];
+	});
+	return half;
+}
+
+void Scene::split(uint32_t first, uint32_t count) {
+	if (count <= SUBTREE_OBJECTS) {
+		Subtree subtree{};
+		subtree.first = first;
+		subtree.count = count;
+		Subtrees.push_back(std::move(subtree));
+		return;
+	}
+	const uint32_t half = medianSplit(first, count);
+	split(first, half);
+	split(first + half, count - half);
+}
+
+uint32_t Scene::buildNode(Subtree &subtree, uint32_t first, uint32_t count) {
+	const uint32_t index = static_cast<uint32_t>(subtree.nodes.size());
+	subtree.nodes.emplace_back();
+	uint32_t ranges[BvhNode::WIDTH][2];
+	uint32_t rangeCount = 0;
+	if (count <= BvhNode::WIDTH) {
+		for (uint32_t i = 0; i < count; ++i) {
+			ranges[rangeCount][0] = first + i;
+			ranges[rangeCount][1] = 1;
+			++rangeCount;
+		}
+	} else {
+		//two levels of median splits, so four children of about the same size
+		const uint32_t half = medianSplit(first, count);
+		const uint32_t lower = medianSplit(first, half);
+		const uint32_t upper = medianSplit(first + half, count - half);
+		const uint32_t quarters[BvhNode::WIDTH][2] = {{first, lower}, {first + lower, half - lower}
+			, {first + half, upper}, {first + half + upper, count - half - upper}};
+		for (const auto &q : quarters) {
+			ranges[rangeCount][0] = q[0];
+			ranges[rangeCount][1] = q[1];
+			++rangeCount;
+		}
+	}
+
+	BvhNode node{};
+	node.first = first;
+	node.count = count;
+	node.childCount = rangeCount;
+	for (uint32_t i = 0; i < rangeCount; ++i) {
+		if (ranges[i][1] == 1) {
+			const uint32_t object = Order[ranges[i][0]];
+			node.child[i] = ~static_cast<int32_t>(object);
+			setLane(node, i, Bounds[object]);
+		} else {
+			const uint32_t child = buildNode(subtree, ranges[i][0], ranges[i][1]);
+			node.child[i] = static_cast<int32_t>(child);
+			setLane(node, i, nodeBounds(subtree.nodes[child]));
+		}
+	}
+	subtree.nodes[index] = node;
+	return index;
+}
+
+void Scene::buildSubtree(Subtree &subtree) {
+	for (uint32_t i = subtree.first; i < subtree.first + subtree.count; ++i) {
+		const Aabb &box = Bounds[Order[i]];
+		Centroids[Order[i]] = (box.min + box.max) * 0.5f;
+	}
+	subtree.nodes.clear();
+	subtree.nodes.reserve(subtree.count / 3 + 1);
+	buildNode(subtree, subtree.first, subtree.count);
+	float cost = 0.0f;
+	for (const BvhNode &node : subtree.nodes) {
+		for (uint32_t i = 0; i < node.childCount; ++i) {
+			cost += area(lane(node, i));
+		}
+	}
+	subtree.builtCost = cost;
+	subtree.cost = cost;
+}
+
+void Scene::updateBounds() {
+	//in object order and chunks, going through Order would miss the cache on every object
+	const uint32_t count = size();
+	const size_t chunks = (count + SUBTREE_OBJECTS - 1) / SUBTREE_OBJECTS;
+	forEach(chunks, [this, count](size_t chunk) {
+		const uint32_t first = static_cast<uint32_t>(chunk) * SUBTREE_OBJECTS;
+		const uint32_t last = std::min(count, first + SUBTREE_OBJECTS);
+		for (uint32_t i = first; i < last; ++i) {
+			Bounds[i] = objectBounds(Objects[i]);
+		}
+	});
+}
+
+void Scene::refitSubtree(Subtree &subtree) {
+	//children always come after their parent
+	float cost = 0.0f;
+	for (size_t n = subtree.nodes.size(); n-- > 0;) {
+		BvhNode &node = subtree.nodes[n];
+		for (uint32_t i = 0; i < node.childCount; ++i) {
+			const int32_t child = node.child[i];
+			const Aabb box = child >= 0 ? nodeBounds(subtree.nodes[static_cast<size_t>(child)]) : Bounds[static_cast<uint32_t>(~child)];
+			setLane(node, i, box);
+			cost += area(box);
+		}
+	}
+	subtree.cost = cost;
+}
+
+void Scene::cullSubtree(Subtree &subtree, const Frustum &frustum) {
+	PlaneTest tests[Frustum::PLANE_COUNT];
+	preparePlanes(frustum, tests);
+	subtree.visible.clear();
+	//median splits keep the depth near log4 of SUBTREE_OBJECTS, so this never gets close to full
+	uint32_t stack[MAX_STACK];
+	uint32_t depth = 0;
+	stack[depth++] = 0;
+	while (depth) {
+		const BvhNode &node = subtree.nodes[stack[--depth]];
+		uint32_t outside, inside;
+		testChildren(node, tests, outside, inside);
+		for (uint32_t i = 0; i < node.childCount; ++i) {
+			const uint32_t bit = 1u << i;
+			if (outside & bit) {
+				continue;
+			}
+			const int32_t child = node.child[i];
+			if (child < 0) {
+				subtree.visible.push_back(static_cast<uint32_t>(~child));
+			} else if (inside & bit) {
+				const BvhNode &accepted = subtree.nodes[static_cast<size_t>(child)];
+				subtree.visible.insert(subtree.visible.end(), Order.begin() + accepted.first
+						, Order.begin() + accepted.first + accepted.count);
+			} else {
+				stack[depth++] = static_cast<uint32_t>(child);
+			}
+		}
+	}
+}
+
+float Scene::topCost() const {
+	float cost = 0.0f;
+	for (const Subtree &subtree : Subtrees) {
+		cost += area(nodeBounds(subtree.nodes[0]));
+	}
+	return cost;
+}
+
+void Scene::build() {
+	const uint32_t count = size();
+	Order.resize(count);
+	Bounds.resize(count);
+	Centroids.resize(count);
+	updateBounds();
+	for (uint32_t i = 0; i < count; ++i) {
+		Order[i] = i;
+		Centroids[i] = (Bounds[i].min + Bounds[i].max) * 0.5f;
+	}
+	Subtrees.clear();
+	if (count != 0) {
+		split(0, count);
+	}
+	forEach(Subtrees.size(), [this](size_t i) { buildSubtree(Subtrees[i]); });
+	BuiltTopCost = topCost();
+	Dirty = false;
+	++Stats.fullRebuilds;
+}
+
+void Scene::update() {
+	++Stats.updates;
+	if (Dirty) {
+		build();
+		return;
+	}
+	updateBounds();
+	forEach(Subtrees.size(), [this](size_t i) { refitSubtree(Subtrees[i]); });
+	//objects drifted out of their subtree's region, the split itself needs redoing
+	if (topCost() > FULL_REBUILD_RATIO * BuiltTopCost) {
+		build();
+		return;
+	}
+	//the worst few, at most one per worker so an update stays about as cheap as a refit
+	std::vector<std::pair<float, uint32_t>> degraded;
+	for (uint32_t i = 0; i < Subtrees.size(); ++i) {
+		if (Subtrees[i].cost > REBUILD_RATIO * Subtrees[i].builtCost) {
+			degraded.push_back({Subtrees[i].cost / std::max(Subtrees[i].builtCost, std::numeric_limits<float>::min()), i});
+		}
+	}
+	if (degraded.empty()) {
+		return;
+	}
+	const size_t rebuilds = std::min<size_t>(degraded.size(), Workers);
+	std::partial_sort(degraded.begin(), degraded.begin() + static_cast<std::ptrdiff_t>(rebuilds), degraded.end()
+			, [](const auto &a, const auto &b) { return a.first > b.first; });
+	forEach(rebuilds, [this, &degraded](size_t i) { buildSubtree(Subtrees[degraded[i].second]); });
+	Stats.subtreeRebuilds += rebuilds;
+}
+
+void Scene::cull(const Frustum &frustum, std::vector<uint32_t> &visible) {
+	++Stats.culls;
+	forEach(Subtrees.size(), [this, &frustum](size_t i) { cullSubtree(Subtrees[i], frustum); });
+	//compact the per subtree lists into one, also in parallel since with most of a big scene visible it's megabytes
+	std::vector<size_t> offsets(Subtrees.size());
+	size_t total = 0;
+	for (size_t i = 0; i < Subtrees.size(); ++i) {
+		offsets[i] = total;
+		total += Subtrees[i].visible.size();
+	}
+	visible.resize(total);
+	forEach(Subtrees.size(), [this, &offsets, &visible](size_t i) {
+		if (!Subtrees[i].visible.empty()) {
+			memcpy(visible.data() + offsets[i], Subtrees[i].visible.data(), Subtrees[i].visible.size() * sizeof(uint32_t));
+		}
+	});
+	Stats.visible += total;
+}
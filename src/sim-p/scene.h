@@ -0,0 +1,123 @@
+#pragma once
+#include "frustum.h"
+#include "thread_pool.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct Aabb {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// One drawable thing: a mesh placed in the world with a uniform scale,
+// drawn with the texture in its material's bindless slot.
+struct SceneObject {
+	glm::vec3 position;
+	float scale;
+	glm::quat rotation;
+	uint32_t mesh;
+	uint32_t material;
+};
+
+struct SceneStats {
+	uint64_t updates;
+	uint64_t subtreeRebuilds;
+	uint64_t fullRebuilds;
+	uint64_t culls;
+	uint64_t visible;
+};
+
+// Four children tested at once, their bounds stored SoA: bounds[axis][lane]
+// holds the minimums for axis 0-2 and the maximums for 3-5. A child is
+// either another node (>= 0) or a single object (~objectIndex). Every node
+// also knows the range of Scene order its subtree covers, so a node found to
+// be fully inside the frustum is accepted without visiting it.
+struct alignas(64) BvhNode {
+	static const uint32_t WIDTH = 4;
+
+	float bounds[6][WIDTH];
+	int32_t child[WIDTH];
+	uint32_t first;
+	uint32_t count;
+	uint32_t childCount;
+	uint32_t reserved;
+};
+
+// Objects with world bounds and a bounding volume hierarchy to cull them
+// against a frustum. The hierarchy is two levels: objects are split
+// spatially into subtrees of roughly SUBTREE_OBJECTS each, and every
+// subtree is its own four wide BVH. Subtrees are what gets built, refit,
+// rebuilt and culled in parallel. update() refits everything after objects
+// moved, then rebuilds the subtrees whose bounds degraded the most, or
+// everything once the split into subtrees itself no longer fits. Bounds are
+// boxes around each mesh's bounding sphere.
+class Scene {
+public:
+	static const uint32_t SUBTREE_OBJECTS = 4096;
+	//node surface area over what it was when built before a subtree is rebuilt
+	static constexpr float REBUILD_RATIO = 1.5f;
+	//same for the subtree roots before everything is rebuilt
+	static constexpr float FULL_REBUILD_RATIO = 2.0f;
+public:
+	Scene();
+	// workers includes the calling thread
+	void init(uint32_t workers);
+	void shutdown();
+	// local bounding sphere, center in xyz and radius in w
+	uint32_t addMesh(const glm::vec4 &sphere);
+	void setMeshSphere(uint32_t mesh, const glm::vec4 &sphere);
+	// objects added after build() only take part once the next update() rebuilt the hierarchy
+	uint32_t addObject(const SceneObject &object);
+	uint32_t size() const { return static_cast<uint32_t>(Objects.size()); }
+	SceneObject &object(uint32_t index) { return Objects[index]; }
+	const SceneObject &object(uint32_t index) const { return Objects[index]; }
+	const Aabb &bounds(uint32_t index) const { return Bounds[index]; }
+	void build();
+	// after objects moved: refit, then rebuild what degraded
+	void update();
+	// replaces visible with the indices of the objects whose bounds intersect frustum, grouped by subtree
+	void cull(const Frustum &frustum, std::vector<uint32_t> &visible);
+	uint32_t workers() const { return Workers; }
+	// calls fn(i) for every i in [0, count) on the calling thread and the scene's workers
+	void forEach(size_t count, const std::function<void(size_t)> &fn) const;
+	SceneStats stats() const { return Stats; }
+private:
+	struct Subtree {
+		uint32_t first;
+		uint32_t count;
+		std::vector<BvhNode> nodes;
+		//summed child surface area, a stand in for traversal cost
+		float builtCost;
+		float cost;
+		std::vector<uint32_t> visible;
+	};
+	Aabb objectBounds(const SceneObject &object) const;
+	// partitions Order[first, first + count) around the median centroid along the longest axis, returns the lower half's size
+	uint32_t medianSplit(uint32_t first, uint32_t count);
+	// median splits until the pieces are subtree sized
+	void split(uint32_t first, uint32_t count);
+	// every object's world bounds from its current placement
+	void updateBounds();
+	uint32_t buildNode(Subtree &subtree, uint32_t first, uint32_t count);
+	void buildSubtree(Subtree &subtree);
+	void refitSubtree(Subtree &subtree);
+	void cullSubtree(Subtree &subtree, const Frustum &frustum);
+	float topCost() const;
+private:
+	uint32_t Workers;
+	std::unique_ptr<ThreadPool> Threads;
+	std::vector<glm::vec4> MeshSpheres;
+	std::vector<SceneObject> Objects;
+	std::vector<Aabb> Bounds;
+	std::vector<glm::vec3> Centroids;
+	//object indices, each subtree covers a contiguous range
+	std::vector<uint32_t> Order;
+	std::vector<Subtree> Subtrees;
+	float BuiltTopCost;
+	bool Dirty;
+	SceneStats Stats;
+};
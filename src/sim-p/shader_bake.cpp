@@ -0,0 +1,84 @@
+#include "cull_defines.h"
+#include "shader_compiler.h"
+#include <CLI/CLI.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+// Offline shader baker: compiles every permutation listed in a manifest into
+// the shader cache, so sim-p finds all of them there on its first run.
+// A define written @name stands for the define set sim-p itself computes
+// under that name, so those never have to be copied into the manifest.
+int main(int argc, char *argv[]) {
+	const std::map<std::string, std::function<std::vector<ShaderDefine>()>> generated = {
+		{"@cull", cullShaderDefines}
+	};
+
+	CLI::App app{"precompiles sim-p's shader permutations into its shader cache"};
+	std::string manifest, cacheDir;
+	app.add_option("manifest", manifest, "permutation list, one shader and its defines per line")->required();
+	app.add_option("cache", cacheDir, "shader cache directory")->required();
+	CLI11_PARSE(app, argc, argv);
+
+	std::ifstream file(manifest);
+	if (!file.is_open()) {
+		std::cerr << "failed to open " << manifest << std::endl;
+		return EXIT_FAILURE;
+	}
+	const size_t slash = manifest.find_last_of('/');
+	const std::string shaderDir = slash == std::string::npos ? std::string() : manifest.substr(0, slash + 1);
+
+	ShaderCompiler compiler;
+	compiler.init(cacheDir);
+	auto start = std::chrono::steady_clock::now();
+	uint32_t permutations = 0;
+	bool ok = true;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string shader, token;
+		if (!(fields >> shader) || shader[0] == '#') {
+			continue;
+		}
+		std::vector<ShaderDefine> defines;
+		bool known = true;
+		while (fields >> token) {
+			if (token[0] == '@') {
+				auto set = generated.find(token);
+				if (set == generated.end()) {
+					known = false;
+					break;
+				}
+				const std::vector<ShaderDefine> expanded = set->second();
+				defines.insert(defines.end(), expanded.begin(), expanded.end());
+				continue;
+			}
+			const size_t equals = token.find('=');
+			defines.push_back({token.substr(0, equals), equals == std::string::npos ? std::string() : token.substr(equals + 1)});
+		}
+		if (!known) {
+			std::cerr << line << ": unknown define set " << token << std::endl;
+			ok = false;
+			continue;
+		}
+		std::vector<uint32_t> spirv;
+		std::string error;
+		if (!compiler.compile(shaderDir + shader, defines, spirv, error)) {
+			std::cerr << line << ": " << error << std::endl;
+			ok = false;
+			continue;
+		}
+		++permutations;
+		std::cout << line << ": " << spirv.size() * sizeof(uint32_t) << " bytes" << std::endl;
+	}
+	const ShaderCompilerStats stats = compiler.stats();
+	auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << manifest << " -> " << cacheDir << ": " << permutations << " permutations, " << stats.misses << " compiled, "
+		<< stats.hits << " already cached, " << stats.failed << " failed in " << ms << " ms" << std::endl;
+	compiler.shutdown();
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
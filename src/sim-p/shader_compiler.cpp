@@ -0,0 +1,311 @@
+#include "shader_compiler.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include <shaderc/shaderc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+//the shaderc and glslang commits, set by Dependencies.cmake
+#ifndef SHADER_COMPILER_REVISION
+#define SHADER_COMPILER_REVISION "unknown"
+#endif
+
+namespace {
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+
+	double msSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// by extension, the same names glslang goes by
+	bool shaderKind(const std::string &path, shaderc_shader_kind &kind) {
+		const size_t dot = path.rfind('.');
+		const std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+		if (extension == "vert") {
+			kind = shaderc_vertex_shader;
+		} else if (extension == "frag") {
+			kind = shaderc_fragment_shader;
+		} else if (extension == "comp") {
+			kind = shaderc_compute_shader;
+		} else if (extension == "geom") {
+			kind = shaderc_geometry_shader;
+		} else if (extension == "tesc") {
+			kind = shaderc_tess_control_shader;
+		} else if (extension == "tese") {
+			kind = shaderc_tess_evaluation_shader;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	// includes are looked up next to the file asking for them, there are no include directories
+	std::string resolveInclude(const std::string &requesting, const std::string &requested) {
+		const size_t slash = requesting.find_last_of('/');
+		return slash == std::string::npos ? requested : requesting.substr(0, slash + 1) + requested;
+	}
+
+	bool readText(const std::string &path, std::string &text) {
+		MappedFile file;
+		if (!file.open(path)) {
+			return false;
+		}
+		text.assign(reinterpret_cast<const char *>(file.data()), file.size());
+		return true;
+	}
+
+	// the name in a #include "name" or #include <name> line, empty for any other line
+	std::string includeName(const std::string &text, size_t begin, size_t end) {
+		size_t i = text.find_first_not_of(" \t", begin);
+		if (i >= end || text[i] != '#') {
+			return std::string();
+		}
+		i = text.find_first_not_of(" \t", i + 1);
+		if (i >= end || text.compare(i, 7, "include") != 0) {
+			return std::string();
+		}
+		i = text.find_first_not_of(" \t", i + 7);
+		if (i >= end || (text[i] != '"' && text[i] != '<')) {
+			return std::string();
+		}
+		const char close = text[i] == '"' ? '"' : '>';
+		const size_t last = text.find(close, i + 1);
+		return last >= end ? std::string() : text.substr(i + 1, last - i - 1);
+	}
+
+	// appends path and, depth first, everything it includes to key; a file reached twice counts once.
+	// Conditional includes count whether or not they are taken, that only ever costs a recompile
+	bool appendSources(const std::string &path, std::vector<std::string> &visited, std::string &key) {
+		if (std::find(visited.begin(), visited.end(), path) != visited.end()) {
+			return true;
+		}
+		visited.push_back(path);
+		std::string text;
+		if (!readText(path, text)) {
+			return false;
+		}
+		const uint64_t size = text.size();
+		key.append(reinterpret_cast<const char *>(&size), sizeof(size));
+		key.append(text);
+		for (size_t begin = 0; begin < text.size();) {
+			size_t end = text.find('\n', begin);
+			end = end == std::string::npos ? text.size() : end;
+			const std::string name = includeName(text, begin, end);
+			if (!name.empty() && !appendSources(resolveInclude(path, name), visited, key)) {
+				return false;
+			}
+			begin = end + 1;
+		}
+		return true;
+	}
+
+	struct IncludedFile {
+		std::string name;
+		std::string content;
+	};
+
+	shaderc_include_result *resolveIncludeCallback(void *, const char *requested, int, const char *requesting, size_t) {
+		auto included = std::make_unique<IncludedFile>();
+		included->name = resolveInclude(requesting, requested);
+		if (!readText(included->name, included->content)) {
+			//an empty name tells shaderc the include failed, the content is the message
+			included->content = "can't read " + included->name;
+			included->name.clear();
+		}
+		shaderc_include_result *result = new shaderc_include_result();
+		result->source_name = included->name.c_str();
+		result->source_name_length = included->name.size();
+		result->content = included->content.c_str();
+		result->content_length = included->content.size();
+		result->user_data = included.release();
+		return result;
+	}
+
+	void releaseIncludeCallback(void *, shaderc_include_result *result) {
+		delete static_cast<IncludedFile *>(result->user_data);
+		delete result;
+	}
+}
+
+ShaderCompiler::ShaderCompiler() : Compiler(nullptr), CacheDir(), StatsMutex(), Stats() {
+
+}
+
+ShaderCompiler::~ShaderCompiler() {
+	shutdown();
+}
+
+void ShaderCompiler::init(const std::string &cacheDir) {
+	Compiler = shaderc_compiler_initialize();
+	if (!Compiler) {
+		throw std::runtime_error("failed to initialize shaderc!");
+	}
+	CacheDir = cacheDir;
+	std::error_code ec;
+	if (!CacheDir.empty() && !std::filesystem::create_directories(CacheDir, ec) && ec) {
+		std::cout << "shader cache " << CacheDir << " unavailable, compiling every shader: " << ec.message() << std::endl;
+		CacheDir.clear();
+	}
+}
+
+void ShaderCompiler::shutdown() {
+	if (Compiler) {
+		shaderc_compiler_release(Compiler);
+		Compiler = nullptr;
+	}
+}
+
+uint64_t ShaderCompiler::key(const std::string &path, const std::vector<ShaderDefine> &defines) const {
+	shaderc_shader_kind kind;
+	if (!shaderKind(path, kind)) {
+		return 0;
+	}
+	std::string key;
+	const uint32_t header[] = {VERSION, static_cast<uint32_t>(kind)};
+	key.append(reinterpret_cast<const char *>(header), sizeof(header));
+	//a different compiler build may well emit different SPIR-V for the same source
+	key.append(SHADER_COMPILER_REVISION).push_back('\n');
+	//order doesn't change what the shader sees, so it doesn't change the key either
+	std::vector<ShaderDefine> sorted = defines;
+	std::sort(sorted.begin(), sorted.end(), [](const ShaderDefine &a, const ShaderDefine &b) { return a.name < b.name; });
+	for (const ShaderDefine &define : sorted) {
+		key.append(define.name).push_back('=');
+		key.append(define.value).push_back('\n');
+	}
+	std::vector<std::string> visited;
+	if (!appendSources(path, visited, key)) {
+		return 0;
+	}
+	//0 is reserved for unreadable sources
+	return std::max<uint64_t>(1, hashBytes(key.data(), key.size()));
+}
+
+bool ShaderCompiler::compile(const std::string &path, const std::vector<ShaderDefine> &defines, std::vector<uint32_t> &spirv
+		, std::string &error) {
+	const auto start = std::chrono::steady_clock::now();
+	const uint64_t cacheKey = key(path, defines);
+	if (cacheKey == 0) {
+		error = "failed to read " + path + " or one of its includes, or its stage is unknown";
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		++Stats.failed;
+		return false;
+	}
+	if (load(cacheKey, spirv)) {
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		++Stats.hits;
+		Stats.hitMs += msSince(start);
+		return true;
+	}
+
+	shaderc_shader_kind kind = shaderc_glsl_infer_from_source;
+	shaderKind(path, kind);
+	std::string source;
+	if (!readText(path, source)) {
+		error = "failed to read " + path;
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		++Stats.failed;
+		return false;
+	}
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+	for (const ShaderDefine &define : defines) {
+		shaderc_compile_options_add_macro_definition(options, define.name.c_str(), define.name.size(), define.value.c_str()
+				, define.value.size());
+	}
+	shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+	shaderc_compile_options_set_include_callbacks(options, resolveIncludeCallback, releaseIncludeCallback, nullptr);
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(Compiler, source.c_str(), source.size(), kind, path.c_str()
+			, "main", options);
+	shaderc_compile_options_release(options);
+	const bool ok = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+	if (ok) {
+		const size_t size = shaderc_result_get_length(result);
+		spirv.resize(size / sizeof(uint32_t));
+		memcpy(spirv.data(), shaderc_result_get_bytes(result), spirv.size() * sizeof(uint32_t));
+	} else {
+		error = shaderc_result_get_error_message(result);
+	}
+	shaderc_result_release(result);
+	if (ok && !store(cacheKey, spirv)) {
+		std::cout << "shader " << path << " compiled but couldn't be cached" << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	if (!ok) {
+		++Stats.failed;
+		return false;
+	}
+	++Stats.misses;
+	Stats.compileMs += msSince(start);
+	return true;
+}
+
+ShaderCompilerStats ShaderCompiler::stats() const {
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	return Stats;
+}
+
+std::string ShaderCompiler::entryPath(uint64_t key) const {
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.spv", static_cast<unsigned long long>(key));
+	return CacheDir + name;
+}
+
+bool ShaderCompiler::load(uint64_t key, std::vector<uint32_t> &spirv) const {
+	if (CacheDir.empty()) {
+		return false;
+	}
+	MappedFile file;
+	if (!file.open(entryPath(key)) || file.size() < sizeof(ShaderCacheHeader)) {
+		return false;
+	}
+	ShaderCacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	const uint8_t *code = file.data() + sizeof(header);
+	//a torn or foreign entry is just a miss, the compile writes a good one over it
+	if (header.magic != MAGIC || header.version != VERSION || header.key != key || header.codeSize == 0
+			|| header.codeSize % sizeof(uint32_t) != 0 || header.codeSize != file.size() - sizeof(header)
+			|| hashBytes(code, file.size() - sizeof(header)) != header.codeHash) {
+		return false;
+	}
+	spirv.resize(header.codeSize / sizeof(uint32_t));
+	memcpy(spirv.data(), code, spirv.size() * sizeof(uint32_t));
+	return spirv[0] == SPIRV_MAGIC;
+}
+
+bool ShaderCompiler::store(uint64_t key, const std::vector<uint32_t> &spirv) const {
+	if (CacheDir.empty()) {
+		return true;
+	}
+	ShaderCacheHeader header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.key = key;
+	header.codeSize = spirv.size() * sizeof(uint32_t);
+	header.codeHash = hashBytes(spirv.data(), spirv.size() * sizeof(uint32_t));
+
+	//write next to the destination and rename so a crash never leaves a torn entry behind,
+	//per thread since two pipelines sharing a stage can miss on it at the same time
+	const std::string path = entryPath(key);
+	const std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	FILE *file = fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(spirv.data(), sizeof(uint32_t), spirv.size(), file) == spirv.size();
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
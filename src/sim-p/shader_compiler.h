@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct shaderc_compiler;
+
+struct ShaderDefine {
+	std::string name;
+	//empty defines the name without a value
+	std::string value;
+};
+
+// On disk layout of one cache entry: this header, then the SPIR-V words.
+struct ShaderCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t codeSize;
+	uint64_t codeHash;
+};
+
+struct ShaderCompilerStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t failed;
+	//summed over shaders: cache hits from key to words, misses from key to words written back
+	double hitMs;
+	double compileMs;
+};
+
+// GLSL to SPIR-V at runtime through shaderc. The stage comes from the file
+// extension like glslang's (.vert, .frag, .comp, ...), #include "..." is
+// resolved next to the including file. Results are cached on disk under a
+// key over the source, every file it includes, the defines and the compiler,
+// so a shader nothing touched is a hash and a small read away. compile() may
+// be called from any thread.
+class ShaderCompiler {
+public:
+	static const uint32_t MAGIC = 0x48535053; // 'SPSH'
+	//bump when the compile options change, the shaderc and glslang commits are part of the key already
+	static const uint32_t VERSION = 1;
+public:
+	ShaderCompiler();
+	~ShaderCompiler();
+	ShaderCompiler(const ShaderCompiler &) = delete;
+	ShaderCompiler &operator=(const ShaderCompiler &) = delete;
+	// cacheDir is created if missing, empty compiles every time
+	void init(const std::string &cacheDir);
+	void shutdown();
+	// returns false and says why in error when path can't be read or doesn't compile
+	bool compile(const std::string &path, const std::vector<ShaderDefine> &defines, std::vector<uint32_t> &spirv
+			, std::string &error);
+	// the cache key, 0 when path or one of its includes can't be read
+	uint64_t key(const std::string &path, const std::vector<ShaderDefine> &defines) const;
+	ShaderCompilerStats stats() const;
+private:
+	bool load(uint64_t key, std::vector<uint32_t> &spirv) const;
+	bool store(uint64_t key, const std::vector<uint32_t> &spirv) const;
+	std::string entryPath(uint64_t key) const;
+private:
+	shaderc_compiler *Compiler;
+	std::string CacheDir;
+	mutable std::mutex StatsMutex;
+	ShaderCompilerStats Stats;
+};
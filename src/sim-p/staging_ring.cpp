@@ -0,0 +1,65 @@
+#include "staging_ring.h"
+
+StagingRing::StagingRing() : Capacity(0), Head(0), Tail(0), Used(0), OpenBytes(0), Pending() {
+
+}
+
+void StagingRing::init(uint64_t capacity) {
+	Capacity = capacity;
+	Head = Tail = Used = OpenBytes = 0;
+	Pending.clear();
+}
+
+void StagingRing::consume(uint64_t bytes, uint64_t newHead) {
+	Used += bytes;
+	OpenBytes += bytes;
+	Head = newHead;
+}
+
+bool StagingRing::allocate(uint64_t size, uint64_t alignment, uint64_t &offset) {
+	if (size > Capacity) {
+		return false;
+	}
+	if (Used == 0) {
+		Head = Tail = 0;
+	}
+	const uint64_t start = (Head + alignment - 1) & ~(alignment - 1);
+	if (Head > Tail || Used == 0) {
+		//free space is [Head, Capacity) followed by [0, Tail)
+		if (start + size <= Capacity) {
+			offset = start;
+			consume(start + size - Head, start + size);
+			return true;
+		}
+		if (size <= Tail) {
+			//the tail end of the buffer is wasted until the ring wraps past it again
+			offset = 0;
+			consume(Capacity - Head + size, size);
+			return true;
+		}
+		return false;
+	}
+	//Head < Tail, or Head == Tail with the ring full
+	if (Head < Tail && start + size <= Tail) {
+		offset = start;
+		consume(start + size - Head, start + size);
+		return true;
+	}
+	return false;
+}
+
+void StagingRing::close(uint64_t timelineValue) {
+	if (OpenBytes == 0) {
+		return;
+	}
+	Pending.push_back({timelineValue, OpenBytes, Head});
+	OpenBytes = 0;
+}
+
+void StagingRing::retire(uint64_t completedValue) {
+	while (!Pending.empty() && Pending.front().timelineValue <= completedValue) {
+		Used -= Pending.front().bytes;
+		Tail = Pending.front().end;
+		Pending.pop_front();
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+
+// Offset allocator for a persistently mapped staging buffer used as a ring.
+// Allocations are handed out in submission order; close() tags everything
+// allocated since the last close with the timeline value of the submit that
+// reads it, retire() gives the space back once that value has been reached.
+class StagingRing {
+public:
+	StagingRing();
+	void init(uint64_t capacity);
+	// false when there isn't room until older submissions retire
+	bool allocate(uint64_t size, uint64_t alignment, uint64_t &offset);
+	void close(uint64_t timelineValue);
+	void retire(uint64_t completedValue);
+	// timeline value to wait on to get space back, 0 if nothing is pending
+	uint64_t oldestPending() const { return Pending.empty() ? 0 : Pending.front().timelineValue; }
+	uint64_t capacity() const { return Capacity; }
+	uint64_t used() const { return Used; }
+private:
+	struct Region {
+		uint64_t timelineValue;
+		uint64_t bytes;
+		uint64_t end;
+	};
+	void consume(uint64_t bytes, uint64_t newHead);
+private:
+	uint64_t Capacity;
+	uint64_t Head;
+	uint64_t Tail;
+	uint64_t Used;
+	uint64_t OpenBytes;
+	std::deque<Region> Pending;
+};
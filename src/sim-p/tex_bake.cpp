@@ -0,0 +1,57 @@
+#include "mapped_file.h"
+#include "mip_chain.h"
+#include "texture_container.h"
+#include <CLI/CLI.hpp>
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wduplicated-branches"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wdouble-promotion"
+#include <stb_image.h>
+#pragma GCC diagnostic pop
+
+// Offline texture baker: decodes an image and writes a TextureContainer with
+// a full sRGB correct mip chain that sim-p can upload without decoding.
+int main(int argc, char *argv[]) {
+	CLI::App app{"bakes textures into sim-p's mip mapped container format"};
+	std::string input, output;
+	app.add_option("input", input, "source image (png, jpg, ...)")->required();
+	app.add_option("output", output, "container to write (.stex)")->required();
+	CLI11_PARSE(app, argc, argv);
+
+	auto start = std::chrono::steady_clock::now();
+	int width, height, channels;
+	MappedFile encoded;
+	if (!encoded.open(input)) {
+		std::cerr << "failed to open " << input << std::endl;
+		return EXIT_FAILURE;
+	}
+	stbi_uc *pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cerr << "failed to load " << input << ": " << stbi_failure_reason() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint8_t> data;
+	std::vector<MipLevel> levels;
+	buildMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), data, levels);
+	stbi_image_free(pixels);
+
+	if (!TextureContainer::write(output, input, VK_FORMAT_R8G8B8A8_SRGB, static_cast<uint32_t>(width), static_cast<uint32_t>(height), data, levels)) {
+		std::cerr << "failed to write " << output << std::endl;
+		return EXIT_FAILURE;
+	}
+	auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << input << " -> " << output << ": " << width << "x" << height << ", " << levels.size() << " levels, "
+		<< data.size() << " bytes in " << ms << " ms" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include "texture_container.h"
+#include <cstdio>
+#include <sys/stat.h>
+
+namespace {
+	const uint64_t DATA_ALIGNMENT = 16;
+
+	bool statSource(const std::string &path, uint64_t &size, int64_t &mtime) {
+		struct stat st {};
+		if (stat(path.c_str(), &st) != 0) {
+			return false;
+		}
+		size = static_cast<uint64_t>(st.st_size);
+		mtime = st.st_mtime;
+		return true;
+	}
+}
+
+TextureContainer::TextureContainer() : File(), Header(nullptr) {
+
+}
+
+bool TextureContainer::open(const std::string &path, const std::string &sourcePath) {
+	close();
+	if (!File.open(path) || File.size() < sizeof(TextureContainerHeader)) {
+		File.close();
+		return false;
+	}
+	const TextureContainerHeader *h = reinterpret_cast<const TextureContainerHeader *>(File.data());
+	bool valid = h->magic == MAGIC && h->version == VERSION && h->mipLevels > 0
+		&& h->mipLevels <= TextureContainerHeader::MAX_LEVELS && h->dataOffset + h->dataSize <= File.size();
+	for (uint32_t i = 0; valid && i < h->mipLevels; ++i) {
+		valid = h->levels[i].offset + h->levels[i].size <= h->dataSize;
+	}
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	if (valid && statSource(sourcePath, size, mtime)) {
+		valid = size == h->sourceSize && mtime == h->sourceMTime;
+	}
+	if (!valid) {
+		File.close();
+		return false;
+	}
+	Header = h;
+	return true;
+}
+
+void TextureContainer::close() {
+	Header = nullptr;
+	File.close();
+}
+
+bool TextureContainer::write(const std::string &path, const std::string &sourcePath, uint32_t format, uint32_t width, uint32_t height
+		, const std::vector<uint8_t> &data, const std::vector<MipLevel> &levels) {
+	if (levels.empty() || levels.size() > TextureContainerHeader::MAX_LEVELS) {
+		return false;
+	}
+	TextureContainerHeader header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.format = format;
+	header.width = width;
+	header.height = height;
+	header.mipLevels = static_cast<uint32_t>(levels.size());
+	header.dataOffset = (sizeof(header) + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+	header.dataSize = data.size();
+	for (size_t i = 0; i < levels.size(); ++i) {
+		header.levels[i] = levels[i];
+	}
+	if (!statSource(sourcePath, header.sourceSize, header.sourceMTime)) {
+		return false;
+	}
+
+	const std::string tmpPath = path + ".tmp";
+	FILE *file = fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	const char zeros[DATA_ALIGNMENT] = {0};
+	const size_t pad = header.dataOffset - sizeof(header);
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(zeros, 1, pad, file) == pad;
+	ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "mapped_file.h"
+#include "mip_chain.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Baked texture: header followed by every mip level packed back to back, so
+// the whole data block can go into one staging buffer and one
+// vkCmdCopyBufferToImage with a region per level.
+struct TextureContainerHeader {
+	static const uint32_t MAX_LEVELS = 16;
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format; // VkFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+	uint64_t sourceSize;
+	int64_t sourceMTime;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+	MipLevel levels[MAX_LEVELS]; // offsets are relative to dataOffset
+};
+
+class TextureContainer {
+public:
+	static const uint32_t MAGIC = 0x58545053; // 'SPTX'
+	//2: odd sized levels filtered with 3 taps instead of dropping their last row and column
+	static const uint32_t VERSION = 2;
+public:
+	TextureContainer();
+	// maps path; if sourcePath exists it must match the size and mtime the container was baked from
+	bool open(const std::string &path, const std::string &sourcePath);
+	void close();
+	bool isOpen() const { return Header != nullptr; }
+	const TextureContainerHeader &header() const { return *Header; }
+	const uint8_t *data() const { return File.data() + Header->dataOffset; }
+public:
+	static bool write(const std::string &path, const std::string &sourcePath, uint32_t format, uint32_t width, uint32_t height
+			, const std::vector<uint8_t> &data, const std::vector<MipLevel> &levels);
+private:
+	MappedFile File;
+	const TextureContainerHeader *Header;
+};
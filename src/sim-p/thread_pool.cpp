@@ -0,0 +1,61 @@
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+
+ThreadPool::ThreadPool(size_t threads) : Workers(), Jobs(), Mutex(), JobAvailable(), Idle(), Running(0), Stopping(false) {
+	if (threads == 0) {
+		threads = 1;
+	}
+	Workers.reserve(threads);
+	for (size_t i = 0; i < threads; ++i) {
+		Workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	JobAvailable.notify_all();
+	for (auto &t : Workers) {
+		t.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Jobs.push_back(std::move(job));
+	}
+	JobAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(Mutex);
+	Idle.wait(lock, [this]() { return Jobs.empty() && Running == 0; });
+}
+
+void ThreadPool::workerLoop() {
+	PROFILE_THREAD("worker");
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			JobAvailable.wait(lock, [this]() { return Stopping || !Jobs.empty(); });
+			if (Jobs.empty()) {
+				return;
+			}
+			job = std::move(Jobs.front());
+			Jobs.pop_front();
+			++Running;
+		}
+		job();
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			--Running;
+			if (Jobs.empty() && Running == 0) {
+				Idle.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off a FIFO. Jobs must not throw;
+// anything that can fail reports through its own result object.
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t threads);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	void submit(std::function<void()> job);
+	// blocks until every queued and running job has finished
+	void wait();
+	size_t size() const { return Workers.size(); }
+private:
+	void workerLoop();
+private:
+	std::vector<std::thread> Workers;
+	std::deque<std::function<void()>> Jobs;
+	std::mutex Mutex;
+	std::condition_variable JobAvailable;
+	std::condition_variable Idle;
+	size_t Running;
+	bool Stopping;
+};
@@ -0,0 +1,207 @@
+#include "tlsf.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+	//remainders smaller than this stay attached to the allocation instead of becoming a free range
+	const uint64_t MIN_SPLIT = 16;
+}
+
+TlsfAllocator::TlsfAllocator() : Size(0), FreeBytes(0), Allocations(0), FlBitmap(0), SlBitmap(), Heads(), Nodes(), SpareNodes() {
+
+}
+
+void TlsfAllocator::init(uint64_t size) {
+	Size = size;
+	FreeBytes = 0;
+	Allocations = 0;
+	FlBitmap = 0;
+	std::fill(std::begin(SlBitmap), std::end(SlBitmap), 0u);
+	for (auto &row : Heads) {
+		for (auto &head : row) {
+			head = NIL;
+		}
+	}
+	Nodes.clear();
+	SpareNodes.clear();
+	uint32_t node = newNode(0, size);
+	insertFree(node);
+	FreeBytes = size;
+}
+
+void TlsfAllocator::mapping(uint64_t size, uint32_t &fl, uint32_t &sl) {
+	if (size < SL_COUNT) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+		return;
+	}
+	const uint32_t log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+	fl = log2 - SL_BITS + 1;
+	sl = static_cast<uint32_t>(size >> (log2 - SL_BITS)) - SL_COUNT;
+}
+
+uint32_t TlsfAllocator::newNode(uint64_t offset, uint64_t size) {
+	Node n{offset, size, NIL, NIL, NIL, NIL, false};
+	if (!SpareNodes.empty()) {
+		uint32_t index = SpareNodes.back();
+		SpareNodes.pop_back();
+		Nodes[index] = n;
+		return index;
+	}
+	Nodes.push_back(n);
+	return static_cast<uint32_t>(Nodes.size() - 1);
+}
+
+void TlsfAllocator::insertFree(uint32_t node) {
+	uint32_t fl, sl;
+	mapping(Nodes[node].size, fl, sl);
+	Node &n = Nodes[node];
+	n.free = true;
+	n.prevFree = NIL;
+	n.nextFree = Heads[fl][sl];
+	if (n.nextFree != NIL) {
+		Nodes[n.nextFree].prevFree = node;
+	}
+	Heads[fl][sl] = node;
+	FlBitmap |= 1ull << fl;
+	SlBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t node) {
+	uint32_t fl, sl;
+	mapping(Nodes[node].size, fl, sl);
+	Node &n = Nodes[node];
+	if (n.prevFree != NIL) {
+		Nodes[n.prevFree].nextFree = n.nextFree;
+	} else {
+		Heads[fl][sl] = n.nextFree;
+	}
+	if (n.nextFree != NIL) {
+		Nodes[n.nextFree].prevFree = n.prevFree;
+	}
+	if (Heads[fl][sl] == NIL) {
+		SlBitmap[fl] &= ~(1u << sl);
+		if (SlBitmap[fl] == 0) {
+			FlBitmap &= ~(1ull << fl);
+		}
+	}
+	n.free = false;
+}
+
+uint32_t TlsfAllocator::findFree(uint64_t size) {
+	//round up to the next bin boundary so anything in the bin found is big enough
+	if (size >= SL_COUNT) {
+		const uint32_t log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+		size += (1ull << (log2 - SL_BITS)) - 1;
+	}
+	uint32_t fl, sl;
+	mapping(size, fl, sl);
+	if (fl >= FL_COUNT) {
+		return NIL;
+	}
+	uint32_t slMap = SlBitmap[fl] & (~0u << sl);
+	if (slMap == 0) {
+		const uint64_t flMap = fl + 1 < FL_COUNT ? FlBitmap & (~0ull << (fl + 1)) : 0;
+		if (flMap == 0) {
+			return NIL;
+		}
+		fl = static_cast<uint32_t>(std::countr_zero(flMap));
+		slMap = SlBitmap[fl];
+	}
+	sl = static_cast<uint32_t>(std::countr_zero(slMap));
+	return Heads[fl][sl];
+}
+
+void TlsfAllocator::split(uint32_t node, uint64_t size) {
+	if (Nodes[node].size - size < MIN_SPLIT) {
+		return;
+	}
+	uint32_t rest = newNode(Nodes[node].offset + size, Nodes[node].size - size);
+	Node &n = Nodes[node];
+	Node &r = Nodes[rest];
+	r.prevPhys = node;
+	r.nextPhys = n.nextPhys;
+	if (n.nextPhys != NIL) {
+		Nodes[n.nextPhys].prevPhys = rest;
+	}
+	n.nextPhys = rest;
+	n.size = size;
+	insertFree(rest);
+}
+
+uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t &offset) {
+	size = std::max<uint64_t>(size, 1);
+	alignment = std::max<uint64_t>(alignment, 1);
+	uint32_t node = findFree(size + alignment - 1);
+	if (node == NIL) {
+		return NIL;
+	}
+	removeFree(node);
+
+	const uint64_t aligned = (Nodes[node].offset + alignment - 1) & ~(alignment - 1);
+	const uint64_t pad = aligned - Nodes[node].offset;
+	if (pad > 0) {
+		//the range in front can't merge backwards, a free neighbour would already have been coalesced
+		uint32_t front = newNode(Nodes[node].offset, pad);
+		Node &n = Nodes[node];
+		Node &f = Nodes[front];
+		f.prevPhys = n.prevPhys;
+		f.nextPhys = node;
+		if (n.prevPhys != NIL) {
+			Nodes[n.prevPhys].nextPhys = front;
+		}
+		n.prevPhys = front;
+		n.offset = aligned;
+		n.size -= pad;
+		insertFree(front);
+	}
+	split(node, size);
+
+	FreeBytes -= Nodes[node].size;
+	++Allocations;
+	offset = Nodes[node].offset;
+	return node;
+}
+
+void TlsfAllocator::free(uint32_t handle) {
+	uint32_t node = handle;
+	FreeBytes += Nodes[node].size;
+	--Allocations;
+
+	const uint32_t prev = Nodes[node].prevPhys;
+	if (prev != NIL && Nodes[prev].free) {
+		removeFree(prev);
+		Nodes[prev].size += Nodes[node].size;
+		Nodes[prev].nextPhys = Nodes[node].nextPhys;
+		if (Nodes[node].nextPhys != NIL) {
+			Nodes[Nodes[node].nextPhys].prevPhys = prev;
+		}
+		SpareNodes.push_back(node);
+		node = prev;
+	}
+	const uint32_t next = Nodes[node].nextPhys;
+	if (next != NIL && Nodes[next].free) {
+		removeFree(next);
+		Nodes[node].size += Nodes[next].size;
+		Nodes[node].nextPhys = Nodes[next].nextPhys;
+		if (Nodes[next].nextPhys != NIL) {
+			Nodes[Nodes[next].nextPhys].prevPhys = node;
+		}
+		SpareNodes.push_back(next);
+	}
+	insertFree(node);
+}
+
+uint64_t TlsfAllocator::largestFree() const {
+	if (FlBitmap == 0) {
+		return 0;
+	}
+	//every range in the highest non-empty bin is at least as big as anything below it
+	const uint32_t fl = static_cast<uint32_t>(std::bit_width(FlBitmap)) - 1;
+	const uint32_t sl = 31u - static_cast<uint32_t>(std::countl_zero(SlBitmap[fl]));
+	uint64_t largest = 0;
+	for (uint32_t node = Heads[fl][sl]; node != NIL; node = Nodes[node].nextFree) {
+		largest = std::max(largest, Nodes[node].size);
+	}
+	return largest;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Two level segregated fit offset allocator. Manages a range of size bytes
+// without touching any memory, so it can sit on top of a VkDeviceMemory
+// block. Allocation and free are O(1): the first level splits sizes by power
+// of two, the second level splits each power of two into SL_COUNT linear
+// bins, and bitmaps find the first non-empty bin that is big enough.
+class TlsfAllocator {
+public:
+	static const uint32_t NIL = UINT32_MAX;
+public:
+	TlsfAllocator();
+	void init(uint64_t size);
+	// returns NIL when no free range can hold size bytes at the requested alignment (a power of two)
+	uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t &offset);
+	void free(uint32_t handle);
+	uint64_t size() const { return Size; }
+	uint64_t freeBytes() const { return FreeBytes; }
+	uint64_t largestFree() const;
+	uint32_t allocationCount() const { return Allocations; }
+private:
+	static const uint32_t SL_BITS = 4;
+	static const uint32_t SL_COUNT = 1 << SL_BITS;
+	static const uint32_t FL_COUNT = 64;
+	struct Node {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prevPhys;
+		uint32_t nextPhys;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+	static void mapping(uint64_t size, uint32_t &fl, uint32_t &sl);
+	uint32_t newNode(uint64_t offset, uint64_t size);
+	void insertFree(uint32_t node);
+	void removeFree(uint32_t node);
+	uint32_t findFree(uint64_t size);
+	void split(uint32_t node, uint64_t size);
+private:
+	uint64_t Size;
+	uint64_t FreeBytes;
+	uint32_t Allocations;
+	uint64_t FlBitmap;
+	uint32_t SlBitmap[FL_COUNT];
+	uint32_t Heads[FL_COUNT][SL_COUNT];
+	std::vector<Node> Nodes;
+	std::vector<uint32_t> SpareNodes;
+};
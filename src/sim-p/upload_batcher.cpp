@@ -0,0 +1,311 @@
+#include "upload_batcher.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	//covers texel size and optimalBufferCopyOffsetAlignment on everything we run on
+	const VkDeviceSize STAGING_ALIGNMENT = 16;
+}
+
+UploadBatcher::UploadBatcher() : Device(VK_NULL_HANDLE), Queue(VK_NULL_HANDLE), QueueMutex(nullptr), Allocator(nullptr)
+	, CommandPool(VK_NULL_HANDLE), Timeline(VK_NULL_HANDLE), LastSignaled(0), RingBuffer(VK_NULL_HANDLE)
+	, RingMemory(), RingData(nullptr), Ring(), PreBarriers(), BufferCopies(), ImageCopies()
+	, PostBufferBarriers(), PostImageBarriers(), PostStages(0), BatchBytes(0), BatchOversize(), BatchOversizeMemory()
+	, Submissions(), FreeCommandBuffers(), StatsMutex(), Stats() {
+
+}
+
+UploadBatcher::~UploadBatcher() {
+	shutdown();
+}
+
+void UploadBatcher::init(VkDevice device, VkQueue queue, uint32_t queueFamily, std::mutex *queueMutex
+		, DeviceAllocator *allocator, VkDeviceSize ringSize) {
+	Device = device;
+	Queue = queue;
+	QueueMutex = queueMutex;
+	Allocator = allocator;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if (vkCreateCommandPool(Device, &poolInfo, nullptr, &CommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+	if (vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &Timeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload timeline semaphore!");
+	}
+
+	Allocator->createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			, RingBuffer, RingMemory);
+	RingData = static_cast<uint8_t *>(RingMemory.mapped);
+	Ring.init(ringSize);
+}
+
+void UploadBatcher::shutdown() {
+	if (Device == VK_NULL_HANDLE) {
+		return;
+	}
+	flush();
+	retire(true);
+	Allocator->destroyBuffer(RingBuffer, RingMemory);
+	vkDestroyCommandPool(Device, CommandPool, nullptr);
+	vkDestroySemaphore(Device, Timeline, nullptr);
+	RingData = nullptr;
+	Device = VK_NULL_HANDLE;
+}
+
+VkBuffer UploadBatcher::stage(const void *data, VkDeviceSize size, VkDeviceSize &offset) {
+	if (size > Ring.capacity()) {
+		VkBuffer buffer;
+		DeviceAllocation memory;
+		Allocator->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				, buffer, memory);
+		memcpy(memory.mapped, data, size);
+		BatchOversize.push_back(buffer);
+		BatchOversizeMemory.push_back(memory);
+		BatchBytes += size;
+		offset = 0;
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		++Stats.oversize;
+		return buffer;
+	}
+
+	if (!Ring.allocate(size, STAGING_ALIGNMENT, offset)) {
+		//out of ring space, get what's queued moving then wait for the oldest flush
+		flush();
+		retire(false);
+		while (!Ring.allocate(size, STAGING_ALIGNMENT, offset)) {
+			auto start = std::chrono::high_resolution_clock::now();
+			uint64_t value = Ring.oldestPending();
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &Timeline;
+			waitInfo.pValues = &value;
+			vkWaitSemaphores(Device, &waitInfo, UINT64_MAX);
+			retire(false);
+			std::chrono::duration<double, std::milli> waited = std::chrono::high_resolution_clock::now() - start;
+			std::lock_guard<std::mutex> lock(StatsMutex);
+			++Stats.stalls;
+			Stats.stallMs += waited.count();
+		}
+	}
+	memcpy(RingData + offset, data, size);
+	BatchBytes += size;
+	return RingBuffer;
+}
+
+void UploadBatcher::copyToBuffer(const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset) {
+	VkDeviceSize offset;
+	VkBuffer src = stage(data, size, offset);
+	VkBufferCopy region{};
+	region.srcOffset = offset;
+	region.dstOffset = dstOffset;
+	region.size = size;
+	BufferCopies.push_back({src, dst, region});
+}
+
+void UploadBatcher::copyToImage(const void *data, VkImage image, const std::vector<MipLevel> &levels) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = static_cast<uint32_t>(levels.size());
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	PreBarriers.push_back(barrier);
+
+	//staged a level at a time so a large image can span flushes instead of needing a ring its size
+	for (size_t i = 0; i < levels.size(); ++i) {
+		VkDeviceSize offset;
+		VkBuffer src = stage(static_cast<const uint8_t *>(data) + levels[i].offset, levels[i].size, offset);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {levels[i].width, levels[i].height, 1};
+
+		if (ImageCopies.empty() || ImageCopies.back().dst != image || ImageCopies.back().src != src) {
+			ImageCopies.push_back({src, image, {}});
+		}
+		ImageCopies.back().regions.push_back(region);
+	}
+}
+
+void UploadBatcher::barrier(const VkBufferMemoryBarrier &b, VkPipelineStageFlags dstStage) {
+	PostBufferBarriers.push_back(b);
+	PostStages |= dstStage;
+}
+
+void UploadBatcher::barrier(const VkImageMemoryBarrier &b, VkPipelineStageFlags dstStage) {
+	PostImageBarriers.push_back(b);
+	PostStages |= dstStage;
+}
+
+bool UploadBatcher::empty() const {
+	return PreBarriers.empty() && BufferCopies.empty() && ImageCopies.empty()
+		&& PostBufferBarriers.empty() && PostImageBarriers.empty();
+}
+
+VkCommandBuffer UploadBatcher::acquireCommandBuffer() {
+	if (!FreeCommandBuffers.empty()) {
+		VkCommandBuffer commandBuffer = FreeCommandBuffers.back();
+		FreeCommandBuffers.pop_back();
+		return commandBuffer;
+	}
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = CommandPool;
+	allocInfo.commandBufferCount = 1;
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(Device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffer!");
+	}
+	return commandBuffer;
+}
+
+uint64_t UploadBatcher::flush() {
+	if (empty()) {
+		return LastSignaled;
+	}
+	VkCommandBuffer commandBuffer = acquireCommandBuffer();
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+
+	if (!PreBarriers.empty()) {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr
+				, static_cast<uint32_t>(PreBarriers.size()), PreBarriers.data());
+	}
+
+	//runs of copies between the same pair of buffers go out as one command
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < BufferCopies.size(); ++i) {
+		regions.push_back(BufferCopies[i].region);
+		if (i + 1 == BufferCopies.size() || BufferCopies[i + 1].src != BufferCopies[i].src || BufferCopies[i + 1].dst != BufferCopies[i].dst) {
+			vkCmdCopyBuffer(commandBuffer, BufferCopies[i].src, BufferCopies[i].dst, static_cast<uint32_t>(regions.size()), regions.data());
+			regions.clear();
+		}
+	}
+	for (const auto &copy : ImageCopies) {
+		vkCmdCopyBufferToImage(commandBuffer, copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+				, static_cast<uint32_t>(copy.regions.size()), copy.regions.data());
+	}
+
+	if (!PostBufferBarriers.empty() || !PostImageBarriers.empty()) {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, PostStages, 0, 0, nullptr
+				, static_cast<uint32_t>(PostBufferBarriers.size()), PostBufferBarriers.data()
+				, static_cast<uint32_t>(PostImageBarriers.size()), PostImageBarriers.data());
+	}
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload batch!");
+	}
+
+	const uint64_t value = LastSignaled + 1;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &value;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &Timeline;
+
+	VkResult result;
+	if (QueueMutex) {
+		std::lock_guard<std::mutex> lock(*QueueMutex);
+		result = vkQueueSubmit(Queue, 1, &submitInfo, VK_NULL_HANDLE);
+	} else {
+		result = vkQueueSubmit(Queue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+	LastSignaled = value;
+	Ring.close(value);
+	Submissions.push_back({value, commandBuffer, std::move(BatchOversize), std::move(BatchOversizeMemory)});
+	{
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		++Stats.flushes;
+		Stats.bytes += BatchBytes;
+		Stats.maxFlushBytes = std::max(Stats.maxFlushBytes, BatchBytes);
+		Stats.copies += BufferCopies.size();
+		for (const auto &copy : ImageCopies) {
+			Stats.copies += copy.regions.size();
+		}
+	}
+
+	PreBarriers.clear();
+	BufferCopies.clear();
+	ImageCopies.clear();
+	PostBufferBarriers.clear();
+	PostImageBarriers.clear();
+	PostStages = 0;
+	BatchBytes = 0;
+	BatchOversize.clear();
+	BatchOversizeMemory.clear();
+	return value;
+}
+
+void UploadBatcher::retire(bool waitAll) {
+	if (Submissions.empty()) {
+		return;
+	}
+	if (waitAll) {
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &Timeline;
+		waitInfo.pValues = &LastSignaled;
+		vkWaitSemaphores(Device, &waitInfo, UINT64_MAX);
+	}
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(Device, Timeline, &completedValue);
+	while (!Submissions.empty() && Submissions.front().timelineValue <= completedValue) {
+		Submission &done = Submissions.front();
+		FreeCommandBuffers.push_back(done.commandBuffer);
+		for (size_t i = 0; i < done.oversize.size(); ++i) {
+			Allocator->destroyBuffer(done.oversize[i], done.oversizeMemory[i]);
+		}
+		Submissions.pop_front();
+	}
+	Ring.retire(completedValue);
+}
+
+UploadStats UploadBatcher::stats() const {
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	return Stats;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "device_allocator.h"
+#include "mip_chain.h"
+#include "staging_ring.h"
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct UploadStats {
+	uint64_t flushes;
+	uint64_t bytes;
+	uint64_t maxFlushBytes;
+	uint64_t copies;
+	// times the ring was full and the batcher had to wait on the GPU
+	uint64_t stalls;
+	double stallMs;
+	// pieces bigger than the whole ring, staged through a buffer of their own
+	uint64_t oversize;
+};
+
+// Collects buffer and image uploads, with their barriers, into one command
+// buffer per flush. Source bytes are copied into a persistently mapped
+// staging ring straight away so callers can free them as soon as the call
+// returns. Each flush is a single submit that signals the batcher's timeline
+// semaphore. Not thread safe, meant to be driven from one upload thread.
+class UploadBatcher {
+public:
+	UploadBatcher();
+	~UploadBatcher();
+	void init(VkDevice device, VkQueue queue, uint32_t queueFamily, std::mutex *queueMutex
+			, DeviceAllocator *allocator, VkDeviceSize ringSize);
+	void shutdown();
+	void copyToBuffer(const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+	// moves every level of image to TRANSFER_DST before copying, levels offsets are relative to data
+	void copyToImage(const void *data, VkImage image, const std::vector<MipLevel> &levels);
+	// recorded after all copies of the flush they end up in
+	void barrier(const VkBufferMemoryBarrier &b, VkPipelineStageFlags dstStage);
+	void barrier(const VkImageMemoryBarrier &b, VkPipelineStageFlags dstStage);
+	// submits everything queued so far, returns the timeline value that signals its completion
+	// (the last submitted value if there was nothing to do)
+	uint64_t flush();
+	// recycles staging space and command buffers of finished flushes
+	void retire(bool waitAll);
+	bool busy() const { return !Submissions.empty(); }
+	VkSemaphore timeline() const { return Timeline; }
+	UploadStats stats() const;
+private:
+	struct BufferCopy {
+		VkBuffer src;
+		VkBuffer dst;
+		VkBufferCopy region;
+	};
+	struct ImageCopy {
+		VkBuffer src;
+		VkImage dst;
+		std::vector<VkBufferImageCopy> regions;
+	};
+	struct Submission {
+		uint64_t timelineValue;
+		VkCommandBuffer commandBuffer;
+		std::vector<VkBuffer> oversize;
+		std::vector<DeviceAllocation> oversizeMemory;
+	};
+	// staging space for size bytes, flushing and waiting on the GPU when the ring is full
+	VkBuffer stage(const void *data, VkDeviceSize size, VkDeviceSize &offset);
+	VkCommandBuffer acquireCommandBuffer();
+	bool empty() const;
+private:
+	VkDevice Device;
+	VkQueue Queue;
+	std::mutex *QueueMutex;
+	DeviceAllocator *Allocator;
+	VkCommandPool CommandPool;
+	VkSemaphore Timeline;
+	uint64_t LastSignaled;
+	VkBuffer RingBuffer;
+	DeviceAllocation RingMemory;
+	uint8_t *RingData;
+	StagingRing Ring;
+	//the batch being built
+	std::vector<VkImageMemoryBarrier> PreBarriers;
+	std::vector<BufferCopy> BufferCopies;
+	std::vector<ImageCopy> ImageCopies;
+	std::vector<VkBufferMemoryBarrier> PostBufferBarriers;
+	std::vector<VkImageMemoryBarrier> PostImageBarriers;
+	VkPipelineStageFlags PostStages;
+	VkDeviceSize BatchBytes;
+	std::vector<VkBuffer> BatchOversize;
+	std::vector<DeviceAllocation> BatchOversizeMemory;
+	std::deque<Submission> Submissions;
+	std::vector<VkCommandBuffer> FreeCommandBuffers;
+	mutable std::mutex StatsMutex;
+	UploadStats Stats;
+};
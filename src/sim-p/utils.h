@@ -1,5 +0,0 @@
-#pragma once
-#include <string>
-#include <vector>
-
-bool readWholeFile(const std::string &file, std::vector<char> &fileBuffer);
@@ -0,0 +1,19 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Full precision vertex the loaders, dedup and mesh tools work with. What
+// ends up in GPU memory is a packed layout from vertex_format.h.
+struct Vertex {
+	glm::vec3 pos;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+
+	bool operator==(const Vertex& other) const {
+		return pos == other.pos && color == other.color && texCoord == other.texCoord;
+	}
+};
+
+struct MeshBounds {
+	glm::vec3 min;
+	glm::vec3 max;
+};
@@ -0,0 +1,103 @@
+#include "vertex_format.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+uint16_t floatToHalf(float v) {
+	const uint32_t bits = std::bit_cast<uint32_t>(v);
+	const uint32_t sign = (bits >> 16) & 0x8000u;
+	const uint32_t exponent = (bits >> 23) & 0xffu;
+	uint32_t mantissa = bits & 0x7fffffu;
+	if (exponent == 0xffu) {
+		//inf stays inf, nan keeps a mantissa bit set
+		return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+	}
+	const int32_t e = static_cast<int32_t>(exponent) - 127 + 15;
+	if (e >= 31) {
+		return static_cast<uint16_t>(sign | 0x7c00u);
+	}
+	if (e <= 0) {
+		//subnormal half, or zero once the shift runs out of bits
+		if (e < -10) {
+			return static_cast<uint16_t>(sign);
+		}
+		mantissa |= 0x800000u;
+		const uint32_t shift = static_cast<uint32_t>(14 - e);
+		uint32_t half = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1u))) {
+			++half;
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+	uint32_t half = (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+	const uint32_t rest = mantissa & 0x1fffu;
+	//round to nearest even, a carry into the exponent is still the right answer
+	if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+		++half;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
+
+uint16_t toUnorm16(float v) {
+	return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+uint8_t toUnorm8(float v) {
+	return static_cast<uint8_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+
+int16_t toSnorm16(float v) {
+	return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+glm::vec3 quantizationExtent(const MeshBounds &bounds) {
+	glm::vec3 extent = bounds.max - bounds.min;
+	for (int i = 0; i < 3; ++i) {
+		if (extent[i] <= 0.0f) {
+			extent[i] = 1.0f;
+		}
+	}
+	return extent;
+}
+
+glm::mat4 dequantizeMatrix(const MeshBounds &bounds) {
+	const glm::vec3 extent = quantizationExtent(bounds);
+	glm::mat4 m(1.0f);
+	m[0][0] = extent.x;
+	m[1][1] = extent.y;
+	m[2][2] = extent.z;
+	m[3] = glm::vec4(bounds.min, 1.0f);
+	return m;
+}
+
+const char *glslInput(VertexSemantic semantic) {
+	switch (semantic) {
+	case VertexSemantic::Position:
+		return "layout(location = 0) in vec3 inPosition;\n";
+	case VertexSemantic::Color:
+		return "layout(location = 1) in vec3 inColor;\n";
+	case VertexSemantic::TexCoord:
+		return "layout(location = 2) in vec2 inTexCoord;\n";
+	}
+	return "";
+}
+
+InstanceTransform InstanceTransform::make(const glm::vec3 &position, float scale, const glm::quat &rotation, uint32_t material) {
+	InstanceTransform t;
+	t.positionScale = glm::vec4(position, scale);
+	t.rotation[0] = toSnorm16(rotation.x);
+	t.rotation[1] = toSnorm16(rotation.y);
+	t.rotation[2] = toSnorm16(rotation.z);
+	t.rotation[3] = toSnorm16(rotation.w);
+	t.material = material;
+	return t;
+}
+
+std::string InstanceTransform::glslInputs() {
+	//the rotation is renormalized in the shader, snorm16 rounding leaves it slightly off unit length
+	return "layout(location = 3) in vec4 inInstancePositionScale;\n"
+		"layout(location = 4) in vec4 inInstanceRotation;\n"
+		"layout(location = 5) in uint inInstanceMaterial;\n";
+}
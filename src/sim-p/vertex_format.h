@@ -0,0 +1,247 @@
+#pragma once
+#include "vertex.h"
+#include <glm/gtc/quaternion.hpp>
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The semantic doubles as the shader location, so every layout binds against
+// the same vertex shader.
+enum class VertexSemantic : uint32_t {
+	Position = 0,
+	Color = 1,
+	TexCoord = 2
+};
+
+uint16_t floatToHalf(float v);
+uint16_t toUnorm16(float v);
+uint8_t toUnorm8(float v);
+int16_t toSnorm16(float v);
+// bounds size with empty axes widened to 1 so flat meshes don't divide by zero
+glm::vec3 quantizationExtent(const MeshBounds &bounds);
+// model space transform that undoes position quantization against bounds
+glm::mat4 dequantizeMatrix(const MeshBounds &bounds);
+const char *glslInput(VertexSemantic semantic);
+
+constexpr uint32_t vertexLayoutId(std::initializer_list<uint32_t> words) {
+	uint32_t hash = 2166136261u;
+	for (uint32_t w : words) {
+		hash = (hash ^ w) * 16777619u;
+	}
+	return hash;
+}
+
+// Attribute encodings. Sizes are multiples of 4 so every offset in a packed
+// vertex stays 4 byte aligned.
+struct PositionFloat {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::Position;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+	static constexpr uint32_t SIZE = 12;
+	static constexpr bool QUANTIZED = false;
+	static void pack(const Vertex &v, const MeshBounds &, uint8_t *dst) {
+		memcpy(dst, &v.pos, SIZE);
+	}
+};
+
+// 16 bits per axis relative to the mesh bounds, the model matrix carries the
+// dequantization. 3 component 16 bit formats are rarely supported for vertex
+// input so w is padding.
+struct PositionUnorm16 {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::Position;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R16G16B16A16_UNORM;
+	static constexpr uint32_t SIZE = 8;
+	static constexpr bool QUANTIZED = true;
+	static void pack(const Vertex &v, const MeshBounds &bounds, uint8_t *dst) {
+		const glm::vec3 p = (v.pos - bounds.min) / quantizationExtent(bounds);
+		const uint16_t q[4] = {toUnorm16(p.x), toUnorm16(p.y), toUnorm16(p.z), 0};
+		memcpy(dst, q, SIZE);
+	}
+};
+
+struct TexCoordFloat {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::TexCoord;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R32G32_SFLOAT;
+	static constexpr uint32_t SIZE = 8;
+	static constexpr bool QUANTIZED = false;
+	static void pack(const Vertex &v, const MeshBounds &, uint8_t *dst) {
+		memcpy(dst, &v.texCoord, SIZE);
+	}
+};
+
+// keeps tiling UVs (outside 0..1) working, ~3 significant digits
+struct TexCoordHalf {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::TexCoord;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R16G16_SFLOAT;
+	static constexpr uint32_t SIZE = 4;
+	static constexpr bool QUANTIZED = false;
+	static void pack(const Vertex &v, const MeshBounds &, uint8_t *dst) {
+		const uint16_t h[2] = {floatToHalf(v.texCoord.x), floatToHalf(v.texCoord.y)};
+		memcpy(dst, h, SIZE);
+	}
+};
+
+// uniform precision across the texture, UVs are clamped to 0..1
+struct TexCoordUnorm16 {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::TexCoord;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R16G16_UNORM;
+	static constexpr uint32_t SIZE = 4;
+	static constexpr bool QUANTIZED = false;
+	static void pack(const Vertex &v, const MeshBounds &, uint8_t *dst) {
+		const uint16_t q[2] = {toUnorm16(v.texCoord.x), toUnorm16(v.texCoord.y)};
+		memcpy(dst, q, SIZE);
+	}
+};
+
+struct ColorFloat {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::Color;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+	static constexpr uint32_t SIZE = 12;
+	static constexpr bool QUANTIZED = false;
+	static void pack(const Vertex &v, const MeshBounds &, uint8_t *dst) {
+		memcpy(dst, &v.color, SIZE);
+	}
+};
+
+struct ColorUnorm8 {
+	static constexpr VertexSemantic SEMANTIC = VertexSemantic::Color;
+	static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+	static constexpr uint32_t SIZE = 4;
+	static constexpr bool QUANTIZED = false;
+	static void pack(const Vertex &v, const MeshBounds &, uint8_t *dst) {
+		const uint8_t q[4] = {toUnorm8(v.color.x), toUnorm8(v.color.y), toUnorm8(v.color.z), 255};
+		memcpy(dst, q, SIZE);
+	}
+};
+
+// GPU vertex built from a list of attribute encodings at compile time. The
+// binding/attribute descriptions, the GLSL inputs and the packing code all
+// come from the same list, so they can't drift apart. Leaving out a color
+// attribute drops it from the vertex, the shader then sees VERTEX_HAS_COLOR
+// undefined.
+template<typename... Attributes>
+struct PackedVertex {
+	static constexpr uint32_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+	static constexpr uint32_t STRIDE = (Attributes::SIZE + ...);
+	static constexpr bool QUANTIZED_POSITION = (Attributes::QUANTIZED || ...);
+	static constexpr bool HAS_COLOR = ((Attributes::SEMANTIC == VertexSemantic::Color) || ...);
+	// stored in baked meshes so a layout change invalidates them
+	static constexpr uint32_t LAYOUT_ID = vertexLayoutId({(static_cast<uint32_t>(Attributes::SEMANTIC) << 16
+			| static_cast<uint32_t>(Attributes::FORMAT))...});
+	static_assert(((Attributes::SIZE % 4 == 0) && ...), "attribute sizes must keep offsets 4 byte aligned");
+	static_assert(((Attributes::SEMANTIC == VertexSemantic::Position) || ...), "a vertex layout needs a position");
+
+	alignas(4) uint8_t bytes[STRIDE];
+
+	static constexpr std::array<uint32_t, ATTRIBUTE_COUNT> offsets() {
+		const uint32_t sizes[] = {Attributes::SIZE...};
+		std::array<uint32_t, ATTRIBUTE_COUNT> result{};
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+			result[i] = offset;
+			offset += sizes[i];
+		}
+		return result;
+	}
+	static constexpr VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = STRIDE;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+	static constexpr std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> getAttributeDescriptions() {
+		const std::array<uint32_t, ATTRIBUTE_COUNT> attributeOffsets = offsets();
+		const VkFormat formats[] = {Attributes::FORMAT...};
+		const VertexSemantic semantics[] = {Attributes::SEMANTIC...};
+		std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescriptions{};
+		for (uint32_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+			attributeDescriptions[i].binding = 0;
+			attributeDescriptions[i].location = static_cast<uint32_t>(semantics[i]);
+			attributeDescriptions[i].format = formats[i];
+			attributeDescriptions[i].offset = attributeOffsets[i];
+		}
+		return attributeDescriptions;
+	}
+	static PackedVertex pack(const Vertex &v, const MeshBounds &bounds) {
+		constexpr std::array<uint32_t, ATTRIBUTE_COUNT> attributeOffsets = offsets();
+		PackedVertex packed;
+		uint32_t i = 0;
+		(Attributes::pack(v, bounds, packed.bytes + attributeOffsets[i++]), ...);
+		return packed;
+	}
+	static void pack(const Vertex *vertices, size_t count, const MeshBounds &bounds, std::vector<PackedVertex> &packed) {
+		packed.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			packed[i] = pack(vertices[i], bounds);
+		}
+	}
+	// identity unless positions are quantized, fold it into the model matrix
+	static glm::mat4 dequantize(const MeshBounds &bounds) {
+		return QUANTIZED_POSITION ? dequantizeMatrix(bounds) : glm::mat4(1.0f);
+	}
+	static std::string glslInputs() {
+		const VertexSemantic semantics[] = {Attributes::SEMANTIC...};
+		std::string glsl;
+		for (VertexSemantic semantic : semantics) {
+			glsl += glslInput(semantic);
+		}
+		if (HAS_COLOR) {
+			glsl += "#define VERTEX_HAS_COLOR\n";
+		}
+		return glsl;
+	}
+};
+
+// What sim-p bakes, uploads and draws with: 12 bytes against the 32 of a full
+// Vertex. The viking room only samples its texture, so color is left out.
+// After changing it rebuild the shader inputs (--target shader-inputs) and
+// the shaders; baked meshes notice the new LAYOUT_ID and rebake themselves.
+using ModelVertex = PackedVertex<PositionUnorm16, TexCoordHalf>;
+static_assert(sizeof(ModelVertex) == ModelVertex::STRIDE);
+
+// Per instance transform, streamed from its own binding at
+// VK_VERTEX_INPUT_RATE_INSTANCE: position and uniform scale as floats, the
+// rotation a unit quaternion (xyzw) in snorm16, then the instance's material,
+// its texture's slot in the BindlessTextures table. 28 bytes against the 64
+// of a matrix. The shader applies it after the mesh's own model matrix.
+struct InstanceTransform {
+	static constexpr uint32_t BINDING = 1;
+	//right after the vertex semantics
+	static constexpr uint32_t FIRST_LOCATION = 3;
+	static constexpr uint32_t ATTRIBUTE_COUNT = 3;
+
+	glm::vec4 positionScale;
+	int16_t rotation[4];
+	uint32_t material;
+
+	static InstanceTransform make(const glm::vec3 &position, float scale, const glm::quat &rotation, uint32_t material);
+	static constexpr VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = BINDING;
+		bindingDescription.stride = sizeof(InstanceTransform);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		return bindingDescription;
+	}
+	static constexpr std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescriptions{};
+		attributeDescriptions[0].binding = BINDING;
+		attributeDescriptions[0].location = FIRST_LOCATION;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(InstanceTransform, positionScale);
+		attributeDescriptions[1].binding = BINDING;
+		attributeDescriptions[1].location = FIRST_LOCATION + 1;
+		attributeDescriptions[1].format = VK_FORMAT_R16G16B16A16_SNORM;
+		attributeDescriptions[1].offset = offsetof(InstanceTransform, rotation);
+		attributeDescriptions[2].binding = BINDING;
+		attributeDescriptions[2].location = FIRST_LOCATION + 2;
+		attributeDescriptions[2].format = VK_FORMAT_R32_UINT;
+		attributeDescriptions[2].offset = offsetof(InstanceTransform, material);
+		return attributeDescriptions;
+	}
+	static std::string glslInputs();
+};
+static_assert(sizeof(InstanceTransform) == 28);
@@ -0,0 +1,25 @@
+#include "vertex_format.h"
+#include <CLI/CLI.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// Writes the vertex shader inputs for ModelVertex and InstanceTransform,
+// shader.vert includes the result so the shader always agrees with the
+// pipeline's vertex input state.
+int main(int argc, char *argv[]) {
+	CLI::App app{"generates the GLSL vertex inputs for sim-p's vertex layout"};
+	std::string output;
+	app.add_option("output", output, "GLSL include to write")->required();
+	CLI11_PARSE(app, argc, argv);
+
+	std::ofstream file(output, std::ios::trunc);
+	file << "// generated by vertex-inputs from ModelVertex and InstanceTransform (vertex_format.h), do not edit\n"
+		<< ModelVertex::glslInputs() << InstanceTransform::glslInputs();
+	if (!file) {
+		std::cerr << "failed to write " << output << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << output << ": " << ModelVertex::ATTRIBUTE_COUNT << " attributes, " << ModelVertex::STRIDE << " byte stride" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "bindless_slots.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("Bindless slots are handed out once until the table is full", "[bindless]")
+{
+  BindlessSlots slots;
+  slots.init(8);
+  std::vector<uint32_t> held;
+  for (uint32_t i = 0; i < 8; ++i) { held.push_back(slots.acquire()); }
+  std::sort(held.begin(), held.end());
+  CHECK(std::adjacent_find(held.begin(), held.end()) == held.end());
+  CHECK(held.back() < slots.capacity());
+  CHECK_THROWS_AS(slots.acquire(), std::runtime_error);
+  CHECK(slots.stats().resident == 8);
+  CHECK(slots.stats().peak == 8);
+}
+
+TEST_CASE("Released bindless slots wait for their timeline value", "[bindless]")
+{
+  BindlessSlots slots;
+  slots.init(4);
+  std::vector<uint32_t> held;
+  for (uint32_t i = 0; i < 4; ++i) { held.push_back(slots.acquire()); }
+  slots.release(held[0], 10);
+  slots.release(held[1], 11);
+  CHECK(slots.retiring() == 2);
+  CHECK(slots.stats().resident == 2);
+
+  //still in flight, nothing to hand out
+  slots.reclaim(9);
+  CHECK(slots.retiring() == 2);
+  CHECK_THROWS_AS(slots.acquire(), std::runtime_error);
+
+  //only the one retired at 10 comes back
+  slots.reclaim(10);
+  CHECK(slots.retiring() == 1);
+  CHECK(slots.acquire() == held[0]);
+  CHECK_THROWS_AS(slots.acquire(), std::runtime_error);
+
+  slots.reclaim(11);
+  CHECK(slots.retiring() == 0);
+  CHECK(slots.acquire() == held[1]);
+}
+
+TEST_CASE("Bindless slots retired at the same value come back together", "[bindless]")
+{
+  BindlessSlots slots;
+  slots.init(6);
+  std::vector<uint32_t> held;
+  for (uint32_t i = 0; i < 6; ++i) { held.push_back(slots.acquire()); }
+  for (uint32_t i = 0; i < 3; ++i) { slots.release(held[i], 5); }
+  slots.release(held[3], 6);
+
+  slots.reclaim(5);
+  CHECK(slots.retiring() == 1);
+  std::vector<uint32_t> reused;
+  for (uint32_t i = 0; i < 3; ++i) { reused.push_back(slots.acquire()); }
+  CHECK_THROWS_AS(slots.acquire(), std::runtime_error);
+  std::sort(reused.begin(), reused.end());
+  std::vector<uint32_t> released(held.begin(), held.begin() + 3);
+  std::sort(released.begin(), released.end());
+  CHECK(reused == released);
+
+  const BindlessStats stats = slots.stats();
+  CHECK(stats.adds == 9);
+  CHECK(stats.removes == 4);
+  CHECK(stats.resident == 5);
+  CHECK(stats.peak == 6);
+}
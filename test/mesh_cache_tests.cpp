@@ -0,0 +1,167 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "mesh_cache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace {
+const uint64_t VERTEX_OFFSET = (sizeof(MeshCacheHeader) + 15) / 16 * 16;
+
+// four 16 bit indexed vertices and two levels of detail, laid out the way bake() writes them
+MeshCacheHeader validHeader(uint64_t &fileSize)
+{
+  MeshCacheHeader header{};
+  header.magic = MeshCache::MAGIC;
+  header.version = MeshCache::VERSION;
+  header.vertexStride = sizeof(ModelVertex);
+  header.indexSize = sizeof(uint16_t);
+  header.vertexLayout = ModelVertex::LAYOUT_ID;
+  header.vertexCount = 4;
+  header.indexCount = 9;
+  header.vertexOffset = VERTEX_OFFSET;
+  header.indexOffset = (VERTEX_OFFSET + 4 * sizeof(ModelVertex) + 15) / 16 * 16;
+  header.lodCount = 2;
+  header.lods[0] = { 0, 6, 0.0f };
+  header.lods[1] = { 6, 3, 0.1f };
+  fileSize = header.indexOffset + header.indexCount * header.indexSize;
+  return header;
+}
+}// namespace
+
+TEST_CASE("A header as baked is accepted", "[mesh_cache]")
+{
+  uint64_t fileSize = 0;
+  const MeshCacheHeader header = validHeader(fileSize);
+  CHECK(MeshCache::validHeader(header, fileSize));
+  //trailing bytes are harmless
+  CHECK(MeshCache::validHeader(header, fileSize + 100));
+  CHECK(!MeshCache::validHeader(header, fileSize - 1));
+}
+
+TEST_CASE("Headers from another format are rejected", "[mesh_cache]")
+{
+  uint64_t fileSize = 0;
+  MeshCacheHeader header = validHeader(fileSize);
+  header.magic ^= 1;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.version = MeshCache::VERSION - 1;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.vertexStride += 4;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.vertexLayout ^= 1;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  for (uint32_t indexSize : { 0u, 1u, 3u, 8u }) {
+    header = validHeader(fileSize);
+    header.indexSize = indexSize;
+    CHECK(!MeshCache::validHeader(header, fileSize));
+  }
+
+  header = validHeader(fileSize);
+  header.lodCount = 0;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+  header.lodCount = MESH_MAX_LODS + 1;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+}
+
+TEST_CASE("Sections have to lie within the file", "[mesh_cache]")
+{
+  uint64_t fileSize = 0;
+  MeshCacheHeader header = validHeader(fileSize);
+  //over the header itself
+  header.vertexOffset = 0;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.vertexOffset = fileSize + 16;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.indexOffset = fileSize + 16;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.vertexCount = 5;
+  header.indexOffset = fileSize;
+  header.indexCount = 0;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  header = validHeader(fileSize);
+  header.indexCount = 10;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+}
+
+TEST_CASE("Counts that would wrap the section size are rejected", "[mesh_cache]")
+{
+  uint64_t fileSize = 0;
+  MeshCacheHeader header = validHeader(fileSize);
+  //more than a 32 bit index can reach
+  header.vertexCount = uint64_t{ std::numeric_limits<uint32_t>::max() } + 1;
+  CHECK(!MeshCache::validHeader(header, std::numeric_limits<uint64_t>::max()));
+
+  //offset + count * size comes out small once it wraps
+  header = validHeader(fileSize);
+  header.indexSize = sizeof(uint32_t);
+  header.indexCount = (std::numeric_limits<uint64_t>::max() / sizeof(uint32_t)) + 2;
+  header.lodCount = 1;
+  CHECK(!MeshCache::validHeader(header, fileSize));
+}
+
+TEST_CASE("Levels of detail have to stay within the index array", "[mesh_cache]")
+{
+  uint64_t fileSize = 0;
+  MeshCacheHeader header = validHeader(fileSize);
+  header.lods[1] = { 6, 4, 0.1f };
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  //firstIndex + indexCount would wrap in 32 bits
+  header.lods[1] = { std::numeric_limits<uint32_t>::max(), 2, 0.1f };
+  CHECK(!MeshCache::validHeader(header, fileSize));
+
+  //levels past lodCount are not looked at
+  header = validHeader(fileSize);
+  header.lodCount = 1;
+  header.lods[1] = { 100, 100, 0.1f };
+  CHECK(MeshCache::validHeader(header, fileSize));
+}
+
+TEST_CASE("A baked cache opens and reads back", "[mesh_cache]")
+{
+  const std::filesystem::path dir = std::filesystem::temp_directory_path();
+  const std::string source = (dir / "sim_p_mesh_cache_test.obj").string();
+  const std::string cache = (dir / "sim_p_mesh_cache_test.mesh").string();
+  std::ofstream(source) << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+
+  std::vector<Vertex> vertices(3);
+  vertices[1].pos = { 1.0f, 0.0f, 0.0f };
+  vertices[2].pos = { 0.0f, 1.0f, 0.0f };
+  const std::vector<uint32_t> indices = { 0, 1, 2, 2, 1, 0 };
+  REQUIRE(MeshCache::bake(cache, source, vertices, indices, { { 0, 3, 0.0f }, { 3, 3, 0.5f } }));
+
+  MeshCache mesh;
+  REQUIRE(mesh.open(cache, source));
+  CHECK(mesh.vertexCount() == 3);
+  CHECK(mesh.indexCount() == 6);
+  CHECK(mesh.indexSize() == sizeof(uint16_t));
+  CHECK(mesh.lods().size() == 2);
+  const auto *read = static_cast<const uint16_t *>(mesh.indices());
+  CHECK(std::vector<uint32_t>(read, read + 6) == indices);
+  mesh.close();
+
+  //a changed source invalidates it
+  std::ofstream(source, std::ios::app) << "v 0 0 1\n";
+  CHECK(!mesh.open(cache, source));
+
+  std::filesystem::remove(source);
+  std::filesystem::remove(cache);
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "mesh_dedup.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace {
+using VertexKey = std::tuple<float, float, float, float, float, float, float, float>;
+
+// a float comparison, so -0.0 and 0.0 are the same key just as they are the same Vertex
+VertexKey key(const Vertex &v)
+{
+  return { v.pos.x, v.pos.y, v.pos.z, v.color.x, v.color.y, v.color.z, v.texCoord.x, v.texCoord.y };
+}
+
+// the single threaded numbering the deduplicator has to reproduce: vertices in order of first appearance
+void referenceDedup(const std::vector<Vertex> &stream, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+  std::map<VertexKey, uint32_t> seen;
+  for (const Vertex &v : stream) {
+    auto found = seen.find(key(v));
+    if (found == seen.end()) {
+      found = seen.emplace(key(v), static_cast<uint32_t>(vertices.size())).first;
+      vertices.push_back(v);
+    }
+    indices.push_back(found->second);
+  }
+}
+
+// corners drawn from a small pool so most of them repeat, within a chunk and across chunks
+std::vector<Vertex> repeatingStream(size_t count, uint32_t pool, uint32_t seed)
+{
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<uint32_t> pick(0, pool - 1);
+  std::vector<Vertex> stream(count);
+  for (Vertex &v : stream) {
+    const float i = static_cast<float>(pick(random));
+    v.pos = { i, i * 0.5f, -i };
+    v.color = { 1.0f, 1.0f, 1.0f };
+    v.texCoord = { i * 0.25f, 1.0f - i * 0.25f };
+  }
+  return stream;
+}
+}// namespace
+
+TEST_CASE("Chunked dedup numbers vertices in order of first appearance", "[dedup]")
+{
+  const std::vector<Vertex> stream = repeatingStream(10000, 700, 3);
+  std::vector<Vertex> expectedVertices;
+  std::vector<uint32_t> expectedIndices;
+  referenceDedup(stream, expectedVertices, expectedIndices);
+
+  //uneven chunks, added out of order as worker threads would
+  const size_t bounds[] = { 0, 1, 1500, 1500, 6000, 10000 };
+  const size_t chunks = std::size(bounds) - 1;
+  VertexDeduplicator dedup(chunks);
+  for (size_t i = chunks; i-- > 0;) { dedup.addChunk(i, stream.data() + bounds[i], bounds[i + 1] - bounds[i]); }
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  dedup.finish(vertices, indices);
+
+  CHECK(vertices == expectedVertices);
+  CHECK(indices == expectedIndices);
+}
+
+TEST_CASE("dedupVertices matches the single threaded numbering", "[dedup]")
+{
+  //large enough to be split into chunks on a machine with a few cores
+  const std::vector<Vertex> stream = repeatingStream(1 << 18, 5000, 11);
+  std::vector<Vertex> expectedVertices;
+  std::vector<uint32_t> expectedIndices;
+  referenceDedup(stream, expectedVertices, expectedIndices);
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  dedupVertices(stream.data(), stream.size(), vertices, indices);
+  CHECK(vertices == expectedVertices);
+  CHECK(indices == expectedIndices);
+}
+
+TEST_CASE("Dedup treats negative zero as zero", "[dedup]")
+{
+  Vertex a{};
+  a.pos = { 0.0f, 1.0f, 2.0f };
+  Vertex b = a;
+  b.pos.x = -0.0f;
+  const std::vector<Vertex> stream = { a, b, a };
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  dedupVertices(stream.data(), stream.size(), vertices, indices);
+  CHECK(vertices.size() == 1);
+  CHECK(indices == std::vector<uint32_t>{ 0, 0, 0 });
+}
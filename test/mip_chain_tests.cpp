@@ -0,0 +1,119 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "mip_chain.h"
+
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+// an image whose alpha is given per texel, the filter weights show up there unchanged since alpha stays linear
+std::vector<uint8_t> alphaImage(const std::vector<uint8_t> &alpha)
+{
+  std::vector<uint8_t> pixels(alpha.size() * 4, 0);
+  for (size_t i = 0; i < alpha.size(); ++i) { pixels[i * 4 + 3] = alpha[i]; }
+  return pixels;
+}
+
+uint8_t alphaAt(const std::vector<uint8_t> &data, const MipLevel &level, uint32_t x, uint32_t y)
+{
+  return data[level.offset + (static_cast<size_t>(y) * level.width + x) * 4 + 3];
+}
+
+double meanAlpha(const std::vector<uint8_t> &data, const MipLevel &level)
+{
+  double sum = 0.0;
+  for (uint32_t y = 0; y < level.height; ++y) {
+    for (uint32_t x = 0; x < level.width; ++x) { sum += alphaAt(data, level, x, y); }
+  }
+  return sum / (static_cast<double>(level.width) * level.height);
+}
+}// namespace
+
+TEST_CASE("Mip levels are packed and aligned", "[mip]")
+{
+  const std::vector<uint8_t> pixels(7 * 5 * 4, 200);
+  std::vector<uint8_t> data;
+  std::vector<MipLevel> levels;
+  buildMipChain(pixels.data(), 7, 5, data, levels);
+
+  REQUIRE(levels.size() == mipLevelCount(7, 5));
+  REQUIRE(levels.size() == 3);
+  CHECK((levels[1].width == 3 && levels[1].height == 2));
+  CHECK((levels[2].width == 1 && levels[2].height == 1));
+  for (const MipLevel &level : levels) {
+    CHECK(level.offset % 16 == 0);
+    CHECK(level.size == static_cast<uint64_t>(level.width) * level.height * 4);
+    CHECK(level.offset + level.size <= data.size());
+  }
+  CHECK(std::vector<uint8_t>(data.begin(), data.begin() + 7 * 5 * 4) == pixels);
+}
+
+TEST_CASE("A constant image stays constant at every level", "[mip]")
+{
+  //odd sides take the 3 tap path, its weights have to add up to one
+  for (const auto &[width, height] : { std::pair{ 8u, 8u }, std::pair{ 7u, 5u }, std::pair{ 9u, 1u }, std::pair{ 1u, 13u } }) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+      pixels[i + 0] = 30;
+      pixels[i + 1] = 128;
+      pixels[i + 2] = 250;
+      pixels[i + 3] = 77;
+    }
+    std::vector<uint8_t> data;
+    std::vector<MipLevel> levels;
+    buildMipChain(pixels.data(), width, height, data, levels);
+    for (const MipLevel &level : levels) {
+      for (uint64_t i = 0; i < level.size; ++i) { CHECK(data[level.offset + i] == pixels[i % 4]); }
+    }
+  }
+}
+
+TEST_CASE("Even sides average 2x2 texels", "[mip]")
+{
+  const std::vector<uint8_t> pixels = alphaImage({ 0, 255, 255, 255 });
+  std::vector<uint8_t> data;
+  std::vector<MipLevel> levels;
+  buildMipChain(pixels.data(), 2, 2, data, levels);
+  //191.25
+  CHECK(alphaAt(data, levels[1], 0, 0) == 191);
+}
+
+TEST_CASE("Odd sides weight 3 taps by their coverage", "[mip]")
+{
+  std::vector<uint8_t> data;
+  std::vector<MipLevel> levels;
+
+  //3 -> 1 covers all three texels equally
+  std::vector<uint8_t> pixels = alphaImage({ 0, 255, 0 });
+  buildMipChain(pixels.data(), 3, 1, data, levels);
+  CHECK(alphaAt(data, levels[1], 0, 0) == 85);
+  buildMipChain(pixels.data(), 1, 3, data, levels);
+  CHECK(alphaAt(data, levels[1], 0, 0) == 85);
+
+  //5 -> 2: the first texel weighs 2/5, 2/5, 1/5 over texels 0-2 and the second 1/5, 2/5, 2/5 over texels 2-4
+  pixels = alphaImage({ 255, 0, 0, 0, 0 });
+  buildMipChain(pixels.data(), 5, 1, data, levels);
+  CHECK(alphaAt(data, levels[1], 0, 0) == 102);
+  CHECK(alphaAt(data, levels[1], 1, 0) == 0);
+
+  pixels = alphaImage({ 0, 0, 255, 0, 0 });
+  buildMipChain(pixels.data(), 5, 1, data, levels);
+  CHECK(alphaAt(data, levels[1], 0, 0) == 51);
+  CHECK(alphaAt(data, levels[1], 1, 0) == 51);
+}
+
+TEST_CASE("Odd sized levels keep the mean", "[mip]")
+{
+  //every source texel is covered by the same total weight, so nothing is dropped or counted twice
+  std::mt19937 random(5);
+  std::uniform_int_distribution<int> value(0, 255);
+  std::vector<uint8_t> alpha(15 * 9);
+  for (uint8_t &a : alpha) { a = static_cast<uint8_t>(value(random)); }
+  const std::vector<uint8_t> pixels = alphaImage(alpha);
+  std::vector<uint8_t> data;
+  std::vector<MipLevel> levels;
+  buildMipChain(pixels.data(), 15, 9, data, levels);
+  CHECK(std::abs(meanAlpha(data, levels[1]) - meanAlpha(data, levels[0])) < 0.5);
+}
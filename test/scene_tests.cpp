@@ -0,0 +1,116 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <catch2/catch_test_macros.hpp>
+
+#include "scene.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+const float WORLD_SIZE = 200.0f;
+
+Frustum cameraFrustum(const glm::vec3 &eye, const glm::vec3 &direction)
+{
+  glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, WORLD_SIZE * 0.5f);
+  proj[1][1] *= -1;
+  return Frustum::fromViewProj(proj * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 0.0f, 1.0f)));
+}
+
+// the plain per box test the hierarchy has to agree with
+bool boxVisible(const Frustum &frustum, const Aabb &box)
+{
+  for (const glm::vec4 &plane : frustum.planes) {
+    const glm::vec3 furthest(plane.x >= 0.0f ? box.max.x : box.min.x,
+      plane.y >= 0.0f ? box.max.y : box.min.y,
+      plane.z >= 0.0f ? box.max.z : box.min.z);
+    if (glm::dot(glm::vec3(plane), furthest) + plane.w < 0.0f) { return false; }
+  }
+  return true;
+}
+
+std::vector<uint32_t> bruteForce(const Scene &scene, const Frustum &frustum)
+{
+  std::vector<uint32_t> visible;
+  for (uint32_t i = 0; i < scene.size(); ++i) {
+    if (boxVisible(frustum, scene.bounds(i))) { visible.push_back(i); }
+  }
+  return visible;
+}
+
+std::vector<uint32_t> culled(Scene &scene, const Frustum &frustum)
+{
+  std::vector<uint32_t> visible;
+  scene.cull(frustum, visible);
+  //grouped by subtree, not sorted
+  std::sort(visible.begin(), visible.end());
+  return visible;
+}
+
+void addObjects(Scene &scene, uint32_t count, uint32_t meshes, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> place(0.0f, WORLD_SIZE);
+  std::uniform_real_distribution<float> size(0.25f, 3.0f);
+  std::uniform_real_distribution<float> angle(-3.14f, 3.14f);
+  for (uint32_t i = 0; i < count; ++i) {
+    scene.addObject({ glm::vec3(place(random), place(random), place(random)),
+      size(random),
+      glm::angleAxis(angle(random), glm::vec3(0.0f, 0.0f, 1.0f)),
+      i % meshes,
+      0 });
+  }
+}
+}// namespace
+
+TEST_CASE("BVH cull finds exactly what the per box test finds", "[scene]")
+{
+  for (uint32_t workers : { 1u, 3u }) {
+    std::mt19937 random(9);
+    Scene scene;
+    scene.init(workers);
+    scene.addMesh(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    //off centre, so rotated objects get boxes bigger than their scale
+    scene.addMesh(glm::vec4(0.5f, 0.0f, 0.25f, 0.75f));
+    //several subtrees' worth
+    addObjects(scene, 3 * Scene::SUBTREE_OBJECTS + 123, 2, random);
+    scene.build();
+
+    const glm::vec3 centre(WORLD_SIZE * 0.5f);
+    for (const glm::vec3 &direction : { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.3f, 0.2f), glm::vec3(0.0f, 0.1f, -1.0f) }) {
+      const Frustum frustum = cameraFrustum(centre, direction);
+      const std::vector<uint32_t> expected = bruteForce(scene, frustum);
+      CHECK(!expected.empty());
+      CHECK(culled(scene, frustum) == expected);
+    }
+
+    //everything behind a camera outside the world looking away from it
+    const Frustum away = cameraFrustum(glm::vec3(-10.0f), glm::vec3(-1.0f));
+    CHECK(culled(scene, away).empty());
+    scene.shutdown();
+  }
+}
+
+TEST_CASE("BVH cull stays exact after objects move", "[scene]")
+{
+  std::mt19937 random(4);
+  Scene scene;
+  scene.init(2);
+  scene.addMesh(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  addObjects(scene, 2 * Scene::SUBTREE_OBJECTS, 1, random);
+  scene.build();
+
+  const Frustum frustum = cameraFrustum(glm::vec3(WORLD_SIZE * 0.5f), glm::vec3(0.3f, 1.0f, 0.0f));
+  std::uniform_real_distribution<float> step(-4.0f, 4.0f);
+  for (int frame = 0; frame < 20; ++frame) {
+    //some far enough that their subtrees degrade and get rebuilt
+    for (uint32_t i = 0; i < scene.size(); ++i) {
+      const float scale = i % 7 == 0 ? 10.0f : 1.0f;
+      scene.object(i).position += glm::vec3(step(random), step(random), step(random)) * scale;
+    }
+    scene.update();
+    REQUIRE(culled(scene, frustum) == bruteForce(scene, frustum));
+  }
+  CHECK(scene.stats().subtreeRebuilds + scene.stats().fullRebuilds > 1);
+}
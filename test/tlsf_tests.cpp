@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "tlsf.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+//a copy, Catch takes its operands by reference and the class constant has no definition
+const uint32_t NIL = TlsfAllocator::NIL;
+
+struct Range
+{
+  uint32_t handle;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// every live range lies inside the allocator and none of them overlap
+bool disjoint(std::vector<Range> ranges, uint64_t size)
+{
+  std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.offset < b.offset; });
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (ranges[i].offset + ranges[i].size > size) { return false; }
+    if (i > 0 && ranges[i - 1].offset + ranges[i - 1].size > ranges[i].offset) { return false; }
+  }
+  return true;
+}
+}// namespace
+
+TEST_CASE("TLSF hands out the whole range and refuses more", "[tlsf]")
+{
+  TlsfAllocator tlsf;
+  tlsf.init(1024);
+  std::vector<Range> ranges;
+  for (int i = 0; i < 4; ++i) {
+    uint64_t offset = 0;
+    const uint32_t handle = tlsf.allocate(256, 1, offset);
+    REQUIRE(handle != NIL);
+    ranges.push_back({ handle, offset, 256 });
+  }
+  CHECK(disjoint(ranges, tlsf.size()));
+  CHECK(tlsf.freeBytes() == 0);
+  CHECK(tlsf.largestFree() == 0);
+  CHECK(tlsf.allocationCount() == 4);
+
+  uint64_t offset = 0;
+  CHECK(tlsf.allocate(1, 1, offset) == NIL);
+}
+
+TEST_CASE("TLSF aligns offsets", "[tlsf]")
+{
+  TlsfAllocator tlsf;
+  tlsf.init(1 << 20);
+  uint64_t offset = 0;
+  REQUIRE(tlsf.allocate(3, 1, offset) != NIL);
+  for (uint64_t alignment : { 16u, 256u, 4096u, 65536u }) {
+    REQUIRE(tlsf.allocate(100, alignment, offset) != NIL);
+    CHECK(offset % alignment == 0);
+  }
+}
+
+TEST_CASE("TLSF coalesces freed neighbours", "[tlsf]")
+{
+  TlsfAllocator tlsf;
+  tlsf.init(4096);
+  uint64_t offsets[3];
+  const uint32_t a = tlsf.allocate(1024, 1, offsets[0]);
+  const uint32_t b = tlsf.allocate(1024, 1, offsets[1]);
+  const uint32_t c = tlsf.allocate(1024, 1, offsets[2]);
+  REQUIRE((a != NIL && b != NIL && c != NIL));
+
+  //the middle one is still held, so what a and c leave behind can't join up
+  tlsf.free(a);
+  tlsf.free(c);
+  CHECK(tlsf.freeBytes() == 3072);
+  CHECK(tlsf.largestFree() < 3072);
+
+  tlsf.free(b);
+  CHECK(tlsf.freeBytes() == 4096);
+  CHECK(tlsf.largestFree() == 4096);
+  CHECK(tlsf.allocationCount() == 0);
+
+  uint64_t offset = 0;
+  CHECK(tlsf.allocate(4096, 1, offset) != NIL);
+  CHECK(offset == 0);
+}
+
+TEST_CASE("TLSF stays consistent under random allocation and free", "[tlsf]")
+{
+  const uint64_t size = 1 << 24;
+  TlsfAllocator tlsf;
+  tlsf.init(size);
+  std::mt19937 random(7);
+  std::uniform_int_distribution<uint64_t> sizes(1, 64 * 1024);
+  std::uniform_int_distribution<uint32_t> alignShift(0, 12);
+  std::vector<Range> ranges;
+  uint64_t held = 0;
+  for (int step = 0; step < 20000; ++step) {
+    if (ranges.empty() || random() % 3 != 0) {
+      uint64_t offset = 0;
+      const uint64_t bytes = sizes(random);
+      const uint64_t alignment = uint64_t{ 1 } << alignShift(random);
+      const uint32_t handle = tlsf.allocate(bytes, alignment, offset);
+      if (handle == NIL) { continue; }
+      REQUIRE(offset % alignment == 0);
+      ranges.push_back({ handle, offset, bytes });
+      held += bytes;
+    } else {
+      const size_t pick = random() % ranges.size();
+      tlsf.free(ranges[pick].handle);
+      held -= ranges[pick].size;
+      ranges[pick] = ranges.back();
+      ranges.pop_back();
+    }
+    //small remainders stay attached to an allocation, so it can use a little more than asked for
+    REQUIRE(tlsf.freeBytes() <= size - held);
+  }
+  CHECK(disjoint(ranges, size));
+  CHECK(tlsf.allocationCount() == ranges.size());
+
+  for (const Range &range : ranges) { tlsf.free(range.handle); }
+  CHECK(tlsf.freeBytes() == size);
+  CHECK(tlsf.largestFree() == size);
+}